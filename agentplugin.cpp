@@ -0,0 +1,254 @@
+#include "agentplugin.h"
+#include "commands.h"
+#include "commandtarget.h"
+
+#define CHARLES_PLUGIN_HOST
+#include "charlesplugin.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <exception>
+#include <utility>
+
+// Delay before reloading a changed plugin.
+const int RELOAD_DELAY_MSEC = 300;
+
+// C++ exceptions must not unwind through the plugin, its side of charlesplugin.h is plain C (and may come from
+// another compiler). The first exception of a host command is kept here instead. The program runs on without effect,
+// as in batch mode: commands do nothing and sensors answer at random, so its loops end. When the program has returned
+// to the host, the exception is thrown again (see hostAgent()).
+static std::exception_ptr pluginError;
+
+template <typename F>
+static void guardedCommand(F command) {
+    if (pluginError)
+        return;
+    try {
+        command();
+    }
+    catch (...) {
+        pluginError = std::current_exception();
+    }
+}
+
+template <typename F>
+static int guardedQuery(F query, bool randomAfterError) {
+    if (!pluginError) {
+        try {
+            return query();
+        }
+        catch (...) {
+            pluginError = std::current_exception();
+        }
+    }
+    return randomAfterError ? int(QRandomGenerator::global()->bounded(2)) : 0;
+}
+
+// The commands of commands.h for plugins. The place of the call in the plugin is not known here,
+// so the commands that are profiled (see callprofile.h) go to the target directly.
+static const CharlesCommands HOST_COMMANDS {
+    CHARLES_PLUGIN_ABI_VERSION,
+    []() { guardedCommand([]() { commandTarget->turnLeft(); }); },
+    []() { guardedCommand([]() { commandTarget->turnRight(); }); },
+    []() { guardedCommand([]() { commandTarget->step(); }); },
+    []() { return guardedQuery([]() -> int { return commandTarget->inFrontOfWall(); }, true); },
+    []() { return guardedQuery([]() -> int { return commandTarget->onBall(); }, true); },
+    []() { guardedCommand([]() { commandTarget->putBall(); }); },
+    []() { guardedCommand([]() { commandTarget->getBall(); }); },
+    [](const char *msg) { guardedCommand([=]() { commandTarget->debugMessage(msg); }); },
+    []() { return guardedQuery([]() { return robot_count(); }, false); },
+    [](int i) { return guardedQuery([=]() { return robot_id(i); }, false); },
+    [](int id) { guardedCommand([=]() { select_robot(id); }); },
+    []() { guardedCommand([]() { begin_tick(); }); },
+    []() { guardedCommand([]() { commandTarget->endTick(); }); }
+};
+
+// Returns a program that runs run of a plugin and throws the exception of a host command afterwards, if one failed.
+static AgentFunction hostAgent(void (*run)()) {
+    return [run]() {
+        pluginError = nullptr;
+        run();
+        if (std::exception_ptr error = std::exchange(pluginError, nullptr))
+            std::rethrow_exception(error);
+    };
+}
+
+AgentPluginLoader::AgentPluginLoader(QObject *parent)
+    : QObject{parent}
+{
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(RELOAD_DELAY_MSEC);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &AgentPluginLoader::onFileChanged);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &AgentPluginLoader::onDirectoryChanged);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &AgentPluginLoader::reloadChanged);
+}
+
+AgentPluginLoader::~AgentPluginLoader() {
+    for (Plugin &p : m_plugins) {
+        p.library->unload();
+        delete p.library;
+    }
+}
+
+QString AgentPluginLoader::load(const QString &fileName) {
+    const QString absolute = QFileInfo(fileName).absoluteFilePath();
+    if (!m_copies.isValid())
+        return "Could not create a temporary directory for plugins.";
+
+    // Load a private copy, see header.
+    const QString copy = m_copies.filePath(QString("%1-%2.%3").arg(QFileInfo(absolute).completeBaseName())
+                                               .arg(m_copyCounter++).arg(QFileInfo(absolute).suffix()));
+    if (!QFile::copy(absolute, copy))
+        return "Could not copy " + absolute + ".";
+
+    QLibrary *library = new QLibrary(copy);
+    auto fail = [&](const QString &error) {
+        library->unload();
+        delete library;
+        QFile::remove(copy);
+        return absolute + ": " + error;
+    };
+    if (!library->load())
+        return fail(library->errorString());
+    auto abiVersion = reinterpret_cast<CharlesPluginAbiFunction>(library->resolve(CHARLES_PLUGIN_ABI_SYMBOL));
+    auto init = reinterpret_cast<CharlesPluginInitFunction>(library->resolve(CHARLES_PLUGIN_INIT_SYMBOL));
+    if (!abiVersion || !init)
+        return fail("Not a QCharles plugin (CHARLES_AGENTS is missing).");
+    if (abiVersion() != CHARLES_PLUGIN_ABI_VERSION)
+        return fail(QString("Plugin is compiled against version %1 of charlesplugin.h, expected %2.")
+                        .arg(abiVersion()).arg(CHARLES_PLUGIN_ABI_VERSION));
+
+    int count = 0;
+    const CharlesAgent *agents = init(&HOST_COMMANDS, &count);
+    Plugin plugin{absolute, library, {}};
+    const QString prefix = QFileInfo(absolute).completeBaseName();
+    for (int i = 0; i < count; ++i)
+        plugin.agents.push_back(PluginAgent{prefix + ": " + agents[i].name, absolute, agents[i].run});
+
+    // Replace an earlier version of the same plugin.
+    int index = indexOf(absolute);
+    if (index != -1) {
+        m_plugins[index].library->unload();
+        delete m_plugins[index].library;
+        m_plugins[index] = plugin;
+    }
+    else
+        m_plugins.push_back(plugin);
+
+    if (!m_watcher.files().contains(absolute))
+        m_watcher.addPath(absolute);
+    emit agentsChanged();
+    return QString();
+}
+
+QStringList AgentPluginLoader::loadDirectory(const QString &dirName) {
+    QStringList errors;
+    QDir dir(dirName);
+    for (const QFileInfo &info : dir.entryInfoList(QDir::Files, QDir::Name)) {
+        if (isPluginFile(info.fileName()) && indexOf(info.absoluteFilePath()) == -1) {
+            QString error = load(info.absoluteFilePath());
+            if (!error.isEmpty())
+                errors.push_back(error);
+        }
+    }
+    if (!m_watcher.directories().contains(dir.absolutePath()))
+        m_watcher.addPath(dir.absolutePath());
+    return errors;
+}
+
+void AgentPluginLoader::unload(const QString &fileName) {
+    int index = indexOf(QFileInfo(fileName).absoluteFilePath());
+    if (index == -1)
+        return;
+    m_watcher.removePath(m_plugins[index].fileName);
+    m_plugins[index].library->unload();
+    delete m_plugins[index].library;
+    m_plugins.remove(index);
+    emit agentsChanged();
+}
+
+QVector<AgentPluginLoader::PluginAgent> AgentPluginLoader::agents() const {
+    QVector<PluginAgent> all;
+    for (const Plugin &p : m_plugins)
+        all.append(p.agents);
+    return all;
+}
+
+AgentFunction AgentPluginLoader::findAgent(const QString &name) const {
+    for (const Plugin &p : m_plugins) {
+        for (const PluginAgent &a : p.agents) {
+            if (a.name == name)
+                return hostAgent(a.run);
+        }
+    }
+    return nullptr;
+}
+
+bool AgentPluginLoader::isPluginFile(const QString &fileName) {
+    return QLibrary::isLibrary(fileName);
+}
+
+AgentFunction AgentPluginLoader::loadOnce(const QString &fileName, const QString &name, QString *error) {
+    // Not deleting the QLibrary keeps the plugin loaded.
+    QLibrary *library = new QLibrary(fileName);
+    if (!library->load()) {
+        *error = library->errorString();
+        delete library;
+        return nullptr;
+    }
+    auto abiVersion = reinterpret_cast<CharlesPluginAbiFunction>(library->resolve(CHARLES_PLUGIN_ABI_SYMBOL));
+    auto init = reinterpret_cast<CharlesPluginInitFunction>(library->resolve(CHARLES_PLUGIN_INIT_SYMBOL));
+    if (!abiVersion || !init || abiVersion() != CHARLES_PLUGIN_ABI_VERSION) {
+        *error = fileName + ": Not a QCharles plugin of version " + QString::number(CHARLES_PLUGIN_ABI_VERSION) + ".";
+        return nullptr;
+    }
+    int count = 0;
+    const CharlesAgent *agents = init(&HOST_COMMANDS, &count);
+    const QString prefix = QFileInfo(fileName).completeBaseName();
+    for (int i = 0; i < count; ++i) {
+        // Same names as in load().
+        if (prefix + ": " + agents[i].name == name)
+            return hostAgent(agents[i].run);
+    }
+    *error = fileName + ": No program named " + name + ".";
+    return nullptr;
+}
+
+void AgentPluginLoader::onFileChanged(const QString &path) {
+    m_changed.insert(path);
+    m_reloadTimer.start();
+}
+
+void AgentPluginLoader::onDirectoryChanged(const QString &path) {
+    QDir dir(path);
+    for (const QFileInfo &info : dir.entryInfoList(QDir::Files)) {
+        // New plugins, and loaded plugins that were replaced (and so dropped out of the file watcher).
+        const QString fileName = info.absoluteFilePath();
+        if (isPluginFile(info.fileName()) && (indexOf(fileName) == -1 || !m_watcher.files().contains(fileName)))
+            m_changed.insert(fileName);
+    }
+    m_reloadTimer.start();
+}
+
+void AgentPluginLoader::reloadChanged() {
+    const QSet<QString> changed = m_changed;
+    m_changed.clear();
+    for (const QString &fileName : changed) {
+        // Files that are replaced (instead of overwritten) drop out of the watcher.
+        if (!QFileInfo::exists(fileName))
+            continue;
+        QString error = load(fileName);
+        if (!error.isEmpty())
+            emit reloadFailed(fileName, error);
+    }
+}
+
+int AgentPluginLoader::indexOf(const QString &fileName) const {
+    for (int i = 0; i < m_plugins.size(); ++i) {
+        if (m_plugins[i].fileName == fileName)
+            return i;
+    }
+    return -1;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QVector>
+#include <QLibrary>
+#include <QFileSystemWatcher>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QSet>
+
+#include "commandtarget.h"
+
+/*
+ * Loads student programs from shared libraries at runtime (see charlesplugin.h).
+ *
+ * Every plugin is copied to a temporary directory before it is loaded. That way the student (or a build script)
+ * can overwrite the original while it is loaded, and the system never hands back a cached library on reload.
+ * Loaded files and directories are watched: changed plugins are reloaded and new plugins in a watched directory
+ * are loaded, after which agentsChanged() is emitted.
+ */
+
+class AgentPluginLoader : public QObject
+{
+    Q_OBJECT
+public:
+    // A program from a plugin. The name is prefixed with the plugin's file name, so names are unique.
+    struct PluginAgent {
+        QString name;
+        QString fileName;
+        void (*run)();
+    };
+
+    explicit AgentPluginLoader(QObject *parent = nullptr);
+    ~AgentPluginLoader();
+
+    // Load (or reload) a plugin. Returns an error message, or an empty string on success.
+    QString load(const QString &fileName);
+    // Load all plugins in a directory and watch it for new plugins. Returns the error messages.
+    QStringList loadDirectory(const QString &dirName);
+    // Unload a plugin. Its function pointers must not be used anymore.
+    void unload(const QString &fileName);
+
+    // Returns the programs of all loaded plugins.
+    QVector<PluginAgent> agents() const;
+    // Returns the program with this name, or nullptr. Errors of its commands are thrown when it has returned.
+    AgentFunction findAgent(const QString &name) const;
+
+    // Returns true iff fileName has the extension of a shared library on this platform.
+    static bool isPluginFile(const QString &fileName);
+    // Load a plugin in place, without copying or watching it, and return the program with this name (or nullptr).
+    // The plugin is never unloaded. Meant for short lived processes, like the sandbox workers (see workerpool.h).
+    static AgentFunction loadOnce(const QString &fileName, const QString &name, QString *error);
+
+signals:
+    // Plugins were loaded, reloaded or unloaded.
+    void agentsChanged();
+    // A plugin that changed on disk failed to reload.
+    void reloadFailed(const QString &fileName, const QString &error);
+
+private slots:
+    void onFileChanged(const QString &path);
+    void onDirectoryChanged(const QString &path);
+    void reloadChanged();
+
+private:
+    struct Plugin {
+        QString fileName;
+        QLibrary *library;
+        QVector<PluginAgent> agents;
+    };
+    int indexOf(const QString &fileName) const;
+
+    QVector<Plugin> m_plugins;
+    QFileSystemWatcher m_watcher;
+    QTemporaryDir m_copies;
+    int m_copyCounter = 0;
+    // Changed files are collected and reloaded together: compilers write a file in several steps.
+    QSet<QString> m_changed;
+    QTimer m_reloadTimer;
+};
@@ -0,0 +1,119 @@
+#include "callprofile.h"
+
+#include <QFileInfo>
+#include <QStringList>
+
+CallScope::CallScope(SourceLocation where) {
+    CallProfile::instance().enter(where);
+}
+
+CallScope::~CallScope() {
+    CallProfile::instance().leave();
+}
+
+CallProfile &CallProfile::instance() {
+    static CallProfile profile;
+    return profile;
+}
+
+void CallProfile::beginProgram(const QString &name) {
+    for (Node &n : m_nodes)
+        n.self = 0;
+    for (Site &s : m_sites)
+        s.count = 0;
+    if (!m_programs.contains(name)) {
+        m_programs.insert(name, m_nodes.size());
+        m_nodes.push_back(Node{-1, nullptr, name, QString(), 0});
+    }
+    m_program = m_programs.value(name);
+    m_stack = {m_program};
+    m_lastSite = NO_SITE;
+}
+
+void CallProfile::endProgram() {
+    m_stack.clear();
+    m_lastSite = NO_SITE;
+}
+
+int CallProfile::programNode() const {
+    return m_program;
+}
+
+void CallProfile::enter(const SourceLocation &where) {
+    m_stack.push_back(child(m_stack.isEmpty() ? -1 : m_stack.last(), where));
+}
+
+void CallProfile::leave() {
+    if (!m_stack.isEmpty())
+        m_stack.pop_back();
+}
+
+void CallProfile::command(const SourceLocation &where) {
+    int node = m_stack.isEmpty() ? -1 : m_stack.last();
+    // A command in the function of a CALL_SCOPE belongs to the node of the scope. The names are only compared
+    // when the pointers differ, the compiler may not merge equal names.
+    if (node == -1 || (m_nodes[node].key != where.function && qstrcmp(m_nodes[node].key, where.function) != 0))
+        node = child(node, where);
+
+    const QPair<int, int> key(node, where.line);
+    auto it = m_siteIndex.constFind(key);
+    int site;
+    if (it != m_siteIndex.constEnd())
+        site = *it;
+    else {
+        site = m_sites.size();
+        m_sites.push_back(Site{node, where.line});
+        m_siteIndex.insert(key, site);
+    }
+    ++m_sites[site].count;
+    ++m_nodes[node].self;
+    m_lastSite = site;
+}
+
+int CallProfile::takeSite() {
+    const int site = m_lastSite;
+    m_lastSite = NO_SITE;
+    return site;
+}
+
+const QVector<CallProfile::Node> &CallProfile::nodes() const {
+    return m_nodes;
+}
+
+const CallProfile::Site &CallProfile::site(int site) const {
+    assert(site >= 0 && site < m_sites.size() && "CallProfile::site: no such site.");
+    return m_sites[site];
+}
+
+QVector<qint64> CallProfile::totals() const {
+    // Children are made after their parent, so one pass from the back adds every node to its parent in time.
+    QVector<qint64> totals(m_nodes.size(), 0);
+    for (int i = m_nodes.size() - 1; i >= 0; --i) {
+        totals[i] += m_nodes[i].self;
+        if (m_nodes[i].parent != -1)
+            totals[m_nodes[i].parent] += totals[i];
+    }
+    return totals;
+}
+
+QString CallProfile::path(int node) const {
+    QStringList names;
+    for (int n = node; n != -1; n = m_nodes[n].parent)
+        names.push_front(m_nodes[n].name);
+    return names.join(" > ");
+}
+
+QString CallProfile::siteText(int site) const {
+    const Node &node = m_nodes[m_sites[site].node];
+    return QString("%1 (%2:%3)").arg(node.name, QFileInfo(node.file).fileName()).arg(m_sites[site].line);
+}
+
+int CallProfile::child(int parent, const SourceLocation &where) {
+    const QPair<int, const char*> key(parent, where.function);
+    auto it = m_children.constFind(key);
+    if (it != m_children.constEnd())
+        return *it;
+    m_nodes.push_back(Node{parent, where.function, QString(where.function), QString(where.file), where.line});
+    m_children.insert(key, m_nodes.size() - 1);
+    return m_nodes.size() - 1;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+#include "callscope.h"
+
+/*
+ * Counts the commands of a run per call path of the student program (see callscope.h).
+ *
+ * The call paths form a tree: a node is a function called from its parent node, the roots are the programs.
+ * Every place a command is called from is a site of a node, the trace items remember their site (see TraceEvent).
+ * Nodes and sites are kept for as long as QCharles runs, so old trace items stay valid. The counts are those
+ * of the last run.
+ *
+ * Counting a command costs a hash lookup or two, cheap enough to stay on for every run, also in batch mode.
+ * Programs of plugins and scripts do not pass their places, their commands are not counted.
+ */
+
+// Site of items that did not come from a command.
+const int NO_SITE = -1;
+
+class CallProfile
+{
+public:
+    struct Node {
+        // -1 for a program.
+        int parent;
+        // Function name of the compiler, nullptr for a program.
+        const char *key;
+        QString name;
+        // Place of the CALL_SCOPE, or of the first command that was counted. Empty for a program.
+        QString file;
+        int line;
+        // Commands called directly from this function in the last run.
+        qint64 self = 0;
+    };
+    struct Site {
+        int node;
+        int line;
+        qint64 count = 0;
+    };
+
+    // The profile of the programs that run in this process. Not thread safe, programs run one at a time.
+    static CallProfile &instance();
+
+    // Start counting the commands of program name, the counts of the last run are reset.
+    void beginProgram(const QString& name);
+    void endProgram();
+    // Returns the node of the last program, or -1 if no program ran.
+    int programNode() const;
+
+    // Called by CallScope.
+    void enter(const SourceLocation& where);
+    void leave();
+    // Count a command called from where.
+    void command(const SourceLocation& where);
+    // Returns the site of the last command and forgets it, NO_SITE if there was none since the last call.
+    // Called for every item that is added to the trace.
+    int takeSite();
+
+    const QVector<Node> &nodes() const;
+    const Site &site(int site) const;
+    // Returns the counts of the nodes including the commands of their children, by node.
+    QVector<qint64> totals() const;
+    // Returns the functions from the program down to node, e.g. "Clean Cave > clean_side > to_wall_get".
+    QString path(int node) const;
+    // Returns "function (file:line)" of a site.
+    QString siteText(int site) const;
+
+private:
+    CallProfile() = default;
+    // Returns the node of the function of where called from parent, a new one the first time.
+    int child(int parent, const SourceLocation& where);
+
+    QVector<Node> m_nodes;
+    QVector<Site> m_sites;
+    // (parent, function) -> node, (node, line) -> site.
+    QHash<QPair<int, const char*>, int> m_children;
+    QHash<QPair<int, int>, int> m_siteIndex;
+    QHash<QString, int> m_programs;
+    // Nodes of the functions that are running, the program first.
+    QVector<int> m_stack;
+    int m_program = -1;
+    int m_lastSite = NO_SITE;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ * Places in the program of the student, for the profile of a run (Programs > Show Profile, see callprofile.h).
+ *
+ * The commands in commands.h have a parameter with the place they are called from. The compiler fills it in,
+ * so you call them as before: step();
+ *
+ * The profile counts the commands per function that called them. Put CALL_SCOPE; as the first line of a function
+ * to count the commands of the functions it calls under it as well, e.g. clean_cave > clean_side > to_wall_get.
+ */
+
+// The file, function and line of a call. Like std::source_location (C++20), but made with the builtins
+// that GCC, Clang and MSVC offer in C++17.
+struct SourceLocation {
+    const char *file;
+    const char *function;
+    int line;
+
+    // Returns the place where current() is called. As a default argument: the place of the call of that function.
+    static constexpr SourceLocation current(const char *file = __builtin_FILE(), const char *function = __builtin_FUNCTION(),
+                                            int line = __builtin_LINE()) {
+        return SourceLocation{file, function, line};
+    }
+};
+
+// While a CallScope lives, its function is on the call path of the commands.
+class CallScope
+{
+public:
+    CallScope(SourceLocation where = SourceLocation::current());
+    ~CallScope();
+
+    CallScope(const CallScope&) = delete;
+    CallScope &operator=(const CallScope&) = delete;
+};
+
+#define CALL_SCOPE CallScope call_scope_
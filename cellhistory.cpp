@@ -0,0 +1,66 @@
+#include "cellhistory.h"
+
+#include <algorithm>
+
+void CellHistory::add(qint64 cell, int row) {
+    assert((m_log.isEmpty() || m_log.last().row <= row) && "CellHistory::add: rows must be added in increasing order.");
+    m_rows[cell].push_back(row);
+    m_log.push_back(CellTouch{cell, row});
+    if (m_log.size() > MAX_TOUCHES)
+        forgetOldest();
+}
+
+QVector<CellTouch> CellHistory::takeFrom(int row) {
+    const auto first = std::lower_bound(m_log.begin(), m_log.end(), row,
+                                        [](const CellTouch &t, int row) { return t.row < row; });
+    const int from = first - m_log.begin();
+    // The rows of a cell are sorted, so the ones that are taken are at the end of its list.
+    for (int i = m_log.size() - 1; i >= from; --i) {
+        auto it = m_rows.find(m_log[i].cell);
+        it->pop_back();
+        if (it->isEmpty())
+            m_rows.erase(it);
+    }
+    const QVector<CellTouch> taken = m_log.mid(from);
+    m_log.resize(from);
+    // Rows from row on are added again, in full.
+    m_firstRow = qMin(m_firstRow, row);
+    return taken;
+}
+
+void CellHistory::restore(const QVector<CellTouch> &touches) {
+    for (const CellTouch &t : touches)
+        add(t.cell, t.row);
+}
+
+void CellHistory::clear() {
+    m_rows.clear();
+    m_log.clear();
+    m_firstRow = 0;
+}
+
+QVector<int> CellHistory::rows(qint64 cell) const {
+    return m_rows.value(cell);
+}
+
+int CellHistory::firstRow() const {
+    return m_firstRow;
+}
+
+void CellHistory::forgetOldest() {
+    int count = m_log.size() / 4;
+    while (count < m_log.size() && m_log[count].row == m_log[count - 1].row)
+        ++count;
+    // The oldest rows of a cell are at the front of its list, count them first so each list is cut once.
+    QHash<qint64, int> forgotten;
+    for (int i = 0; i < count; ++i)
+        ++forgotten[m_log[i].cell];
+    for (auto f = forgotten.cbegin(); f != forgotten.cend(); ++f) {
+        auto it = m_rows.find(f.key());
+        it->remove(0, f.value());
+        if (it->isEmpty())
+            m_rows.erase(it);
+    }
+    m_firstRow = m_log[count - 1].row + 1;
+    m_log.remove(0, count);
+}
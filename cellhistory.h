@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+/*
+ * Which trace items touched a field: a robot stepped onto it, or put or took a ball on it.
+ * An inverted index from the field (WorldObject::pointToIndex) to the rows of those items in increasing order,
+ * built while items are added to the trace, so "when did this ball disappear" is a lookup instead of a search.
+ *
+ * Rows are only added at the end and taken from the end (when the trace branches, see DebugTraceWidget), the
+ * touches are logged in row order as well so taking them does not look at every field.
+ *
+ * The index is bounded: with more than MAX_TOUCHES touches the oldest quarter is forgotten, so a program that runs
+ * for hours does not fill the memory with it. The rows before firstRow() are not indexed then.
+ */
+
+struct CellTouch {
+    qint64 cell;
+    int row;
+};
+
+class CellHistory
+{
+public:
+    // Item row touched cell. Rows must be added in increasing order.
+    void add(qint64 cell, int row);
+    // Remove the touches of the rows from row on and return them in row order, e.g. to restore() them later.
+    QVector<CellTouch> takeFrom(int row);
+    // Add touches that were taken, their rows must come after all rows in the history.
+    void restore(const QVector<CellTouch>& touches);
+    void clear();
+
+    // Returns the rows of the items that touched cell, in increasing order.
+    QVector<int> rows(qint64 cell) const;
+    // Returns the first row whose touches are indexed, 0 until the oldest touches were forgotten.
+    int firstRow() const;
+
+    constexpr static int MAX_TOUCHES = 1 << 22;
+
+private:
+    // Forget the oldest touches, whole rows at a time.
+    void forgetOldest();
+
+    QHash<qint64, QVector<int>> m_rows;
+    QVector<CellTouch> m_log;
+    int m_firstRow = 0;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+ * This file is the interface for student programs that are loaded at runtime from a shared library
+ * (.so on Linux, .dll on Windows) instead of being compiled into QCharles.
+ *
+ * A plugin only needs this header, not Qt or any other file of QCharles. Compile it on its own, e.g.:
+ *     g++ -std=c++17 -shared -fPIC -O2 -I<QCharles> submission.cpp -o submission.so
+ * and load it from the Programs menu. The plugin is reloaded automatically when the file changes.
+ *
+ * In a plugin, include this file instead of commands.h. The same commands are available (see commands.h
+ * for their pre and post conditions). Register the programs at the end of the file, they will show up
+ * in the program menu:
+ *
+ *     CHARLES_AGENTS(
+ *         {"Agent 1", agent1},
+ *         {"Clean Cave", clean_cave}
+ *     )
+ *
+ * No exception crosses between the host and the plugin. After a command failed (e.g. a step into a wall) the
+ * program runs on without effect, the sensors answer at random, and the error is shown when it returns.
+ *
+ * The host and the plugin only share the plain C structs below. Bump CHARLES_PLUGIN_ABI_VERSION whenever
+ * they change, QCharles refuses plugins that are compiled against another version.
+ */
+
+#define CHARLES_PLUGIN_ABI_VERSION 1
+
+#if defined(_WIN32)
+#define CHARLES_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define CHARLES_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+extern "C" {
+
+// Commands of the host. Booleans are passed as int to keep the layout independent of the compiler.
+struct CharlesCommands {
+    int abiVersion;
+    void (*turn_left)();
+    void (*turn_right)();
+    void (*step)();
+    int (*in_front_of_wall)();
+    int (*on_ball)();
+    void (*put_ball)();
+    void (*get_ball)();
+    void (*debug)(const char *msg);
+    int (*robot_count)();
+    int (*robot_id)(int i);
+    void (*select_robot)(int id);
+    void (*begin_tick)();
+    void (*end_tick)();
+};
+
+// A program in the plugin.
+struct CharlesAgent {
+    const char *name;
+    void (*run)();
+};
+
+// Entry points of a plugin, defined by CHARLES_AGENTS.
+// Returns CHARLES_PLUGIN_ABI_VERSION of the plugin.
+typedef int (*CharlesPluginAbiFunction)();
+// Stores the commands of the host and returns the programs of the plugin.
+typedef const CharlesAgent *(*CharlesPluginInitFunction)(const CharlesCommands *commands, int *agentCount);
+
+}
+
+#define CHARLES_PLUGIN_ABI_SYMBOL "charles_plugin_abi_version"
+#define CHARLES_PLUGIN_INIT_SYMBOL "charles_plugin_init"
+
+// Everything below is only for the plugin itself.
+#ifndef CHARLES_PLUGIN_HOST
+
+inline const CharlesCommands *charles_commands = nullptr;
+
+inline void turn_left() { charles_commands->turn_left(); }
+inline void turn_right() { charles_commands->turn_right(); }
+inline void step() { charles_commands->step(); }
+inline bool in_front_of_wall() { return charles_commands->in_front_of_wall() != 0; }
+inline bool on_ball() { return charles_commands->on_ball() != 0; }
+inline void put_ball() { charles_commands->put_ball(); }
+inline void get_ball() { charles_commands->get_ball(); }
+inline void debug(const char *msg) { charles_commands->debug(msg); }
+inline int robot_count() { return charles_commands->robot_count(); }
+inline int robot_id(int i) { return charles_commands->robot_id(i); }
+inline void select_robot(int id) { charles_commands->select_robot(id); }
+inline void begin_tick() { charles_commands->begin_tick(); }
+inline void end_tick() { charles_commands->end_tick(); }
+
+#define CHARLES_AGENTS(...) \
+    extern "C" CHARLES_PLUGIN_EXPORT int charles_plugin_abi_version() { \
+        return CHARLES_PLUGIN_ABI_VERSION; \
+    } \
+    extern "C" CHARLES_PLUGIN_EXPORT const CharlesAgent *charles_plugin_init(const CharlesCommands *commands, int *agentCount) { \
+        static const CharlesAgent agents[] { __VA_ARGS__ }; \
+        charles_commands = commands; \
+        *agentCount = sizeof(agents) / sizeof(agents[0]); \
+        return agents; \
+    }
+
+#endif // CHARLES_PLUGIN_HOST
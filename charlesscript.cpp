@@ -0,0 +1,368 @@
+#include "charlesscript.h"
+
+#include <QHash>
+
+ScriptError::ScriptError(const QString &message, int line, int column)
+    : message(message),
+    line(line),
+    column(column),
+    m_what(QString("Line %1, column %2: %3").arg(line).arg(column).arg(message).toUtf8())
+{
+}
+
+const char *ScriptError::what() const {
+    return m_what.constData();
+}
+
+/*
+ * LEXER
+ */
+
+enum TokenKind { Identifier, String, Symbol, EndOfFile };
+
+struct Token {
+    TokenKind kind;
+    QString text;
+    int line, column;
+};
+
+static QVector<Token> tokenize(const QString &source) {
+    QVector<Token> tokens;
+    int i = 0, line = 1, lineStart = 0;
+    auto error = [&](const QString &message) {
+        return ScriptError(message, line, i - lineStart + 1);
+    };
+    while (i < source.size()) {
+        const QChar c = source.at(i);
+        const QChar next = i + 1 < source.size() ? source.at(i + 1) : QChar();
+        if (c == '\n') {
+            ++i;
+            ++line;
+            lineStart = i;
+        }
+        else if (c.isSpace())
+            ++i;
+        else if ((c == '/' && next == '/') || c == '#') {
+            while (i < source.size() && source.at(i) != '\n')
+                ++i;
+        }
+        else if (c == '/' && next == '*') {
+            const int end = source.indexOf("*/", i + 2);
+            if (end == -1)
+                throw error("Unterminated comment.");
+            for (; i < end + 2; ++i) {
+                if (source.at(i) == '\n') {
+                    ++line;
+                    lineStart = i + 1;
+                }
+            }
+        }
+        else if (c.isLetter() || c == '_') {
+            const int start = i;
+            while (i < source.size() && (source.at(i).isLetterOrNumber() || source.at(i) == '_'))
+                ++i;
+            tokens.push_back(Token{TokenKind::Identifier, source.mid(start, i - start), line, start - lineStart + 1});
+        }
+        else if (c == '"') {
+            const int start = i++;
+            QString text;
+            while (i < source.size() && source.at(i) != '"' && source.at(i) != '\n') {
+                if (source.at(i) == '\\' && i + 1 < source.size())
+                    ++i;
+                text += source.at(i++);
+            }
+            if (i == source.size() || source.at(i) != '"')
+                throw error("Unterminated string.");
+            ++i;
+            tokens.push_back(Token{TokenKind::String, text, line, start - lineStart + 1});
+        }
+        else if ((c == '&' && next == '&') || (c == '|' && next == '|')) {
+            tokens.push_back(Token{TokenKind::Symbol, source.mid(i, 2), line, i - lineStart + 1});
+            i += 2;
+        }
+        else if (QString("(){};!").contains(c)) {
+            tokens.push_back(Token{TokenKind::Symbol, QString(c), line, i - lineStart + 1});
+            ++i;
+        }
+        else
+            throw error(QString("Unexpected character '%1'.").arg(c));
+    }
+    tokens.push_back(Token{TokenKind::EndOfFile, QString(), line, i - lineStart + 1});
+    return tokens;
+}
+
+/*
+ * COMPILER
+ * Recursive descent, the code is emitted while parsing.
+ */
+
+static const QHash<QString, ScriptOp> COMMANDS {
+    {"step", OpStep},
+    {"turn_left", OpTurnLeft},
+    {"turn_right", OpTurnRight},
+    {"put_ball", OpPutBall},
+    {"get_ball", OpGetBall},
+    {"begin_tick", OpBeginTick},
+    {"end_tick", OpEndTick}
+};
+
+static const QHash<QString, ScriptOp> SENSORS {
+    {"on_ball", OpOnBall},
+    {"in_front_of_wall", OpInFrontOfWall}
+};
+
+class ScriptCompiler
+{
+public:
+    explicit ScriptCompiler(const QString &source)
+        : m_tokens(tokenize(source))
+    {
+    }
+
+    ScriptProgram compile() {
+        while (peek().kind != TokenKind::EndOfFile)
+            procedure();
+        // Calls may come before the procedure is defined.
+        for (const Call &call : m_calls) {
+            const int entry = m_program.entry(call.name.text);
+            if (entry == -1)
+                throw error(call.name, "Unknown procedure or command '" + call.name.text + "'.");
+            m_program.code[call.operand] = entry;
+        }
+        return m_program;
+    }
+
+private:
+    struct Call {
+        Token name;
+        int operand;
+    };
+
+    const Token &peek() const {
+        return m_tokens[m_pos];
+    }
+
+    bool isSymbol(const QString &s) const {
+        return peek().kind == TokenKind::Symbol && peek().text == s;
+    }
+
+    bool isKeyword(const QString &s) const {
+        return peek().kind == TokenKind::Identifier && peek().text == s;
+    }
+
+    static ScriptError error(const Token &t, const QString &message) {
+        return ScriptError(message, t.line, t.column);
+    }
+
+    Token expect(TokenKind kind, const QString &text, const QString &what) {
+        const Token &t = peek();
+        if (t.kind != kind || (!text.isEmpty() && t.text != text))
+            throw error(t, "Expected " + what + (t.kind == TokenKind::EndOfFile ? " at the end of the file." : " before '" + t.text + "'."));
+        return m_tokens[m_pos++];
+    }
+
+    void expectSymbol(const QString &s) {
+        expect(TokenKind::Symbol, s, "'" + s + "'");
+    }
+
+    // Emit an instruction, returns the index of its operand (or of the op without operand).
+    int emit(ScriptOp op, qint32 operand = 0) {
+        const int line = m_tokens[qMax(0, m_pos - 1)].line;
+        m_program.code.push_back(op);
+        m_program.lines.push_back(line);
+        if (ScriptProgram::instructionSize(op) == 1)
+            return m_program.code.size() - 1;
+        m_program.code.push_back(operand);
+        m_program.lines.push_back(line);
+        return m_program.code.size() - 1;
+    }
+
+    int here() const {
+        return m_program.code.size();
+    }
+
+    void patch(int operand, int target) {
+        m_program.code[operand] = target;
+    }
+
+    // void name() { ... }
+    void procedure() {
+        expect(TokenKind::Identifier, "void", "'void'");
+        const Token name = expect(TokenKind::Identifier, QString(), "a procedure name");
+        if (m_program.entry(name.text) != -1)
+            throw error(name, "Procedure '" + name.text + "' is defined twice.");
+        if (COMMANDS.contains(name.text) || SENSORS.contains(name.text) || name.text == "debug")
+            throw error(name, "'" + name.text + "' is a command, it cannot be redefined.");
+        expectSymbol("(");
+        expectSymbol(")");
+        m_program.procedures.push_back(ScriptProgram::Procedure{name.text, here()});
+        block();
+        emit(OpReturn);
+    }
+
+    void block() {
+        expectSymbol("{");
+        while (!isSymbol("}")) {
+            if (peek().kind == TokenKind::EndOfFile)
+                expectSymbol("}");
+            statement();
+        }
+        expectSymbol("}");
+    }
+
+    void statement() {
+        const Token &t = peek();
+        if (isSymbol("{"))
+            block();
+        else if (isSymbol(";"))
+            ++m_pos;
+        else if (isKeyword("while")) {
+            ++m_pos;
+            const int top = here();
+            expectSymbol("(");
+            condition();
+            expectSymbol(")");
+            const int exit = emit(OpJumpIfFalse);
+            statement();
+            emit(OpJump, top);
+            patch(exit, here());
+        }
+        else if (isKeyword("if")) {
+            ++m_pos;
+            expectSymbol("(");
+            condition();
+            expectSymbol(")");
+            const int skipThen = emit(OpJumpIfFalse);
+            statement();
+            if (isKeyword("else")) {
+                ++m_pos;
+                const int skipElse = emit(OpJump);
+                patch(skipThen, here());
+                statement();
+                patch(skipElse, here());
+            }
+            else
+                patch(skipThen, here());
+        }
+        else if (isKeyword("return")) {
+            ++m_pos;
+            expectSymbol(";");
+            emit(OpReturn);
+        }
+        else if (isKeyword("debug")) {
+            ++m_pos;
+            expectSymbol("(");
+            const Token text = expect(TokenKind::String, QString(), "a string");
+            expectSymbol(")");
+            expectSymbol(";");
+            int index = m_program.strings.indexOf(text.text);
+            if (index == -1) {
+                index = m_program.strings.size();
+                m_program.strings.push_back(text.text);
+            }
+            emit(OpDebug, index);
+        }
+        else if (t.kind == TokenKind::Identifier) {
+            const Token name = m_tokens[m_pos++];
+            if (SENSORS.contains(name.text))
+                throw error(name, "'" + name.text + "' is a condition, use it in an if or while.");
+            expectSymbol("(");
+            expectSymbol(")");
+            expectSymbol(";");
+            if (COMMANDS.contains(name.text))
+                emit(COMMANDS[name.text]);
+            else
+                m_calls.push_back(Call{name, emit(OpCall)});
+        }
+        else
+            throw error(t, "Expected a statement before '" + t.text + "'.");
+    }
+
+    // Conditions leave their value in the flag. && and || jump over the rest as soon as the value is known,
+    // the flag then still holds the value of the whole condition.
+    void condition() {
+        conjunction();
+        QVector<int> exits;
+        while (isSymbol("||")) {
+            ++m_pos;
+            exits.push_back(emit(OpJumpIfTrue));
+            conjunction();
+        }
+        for (int exit : exits)
+            patch(exit, here());
+    }
+
+    void conjunction() {
+        negation();
+        QVector<int> exits;
+        while (isSymbol("&&")) {
+            ++m_pos;
+            exits.push_back(emit(OpJumpIfFalse));
+            negation();
+        }
+        for (int exit : exits)
+            patch(exit, here());
+    }
+
+    void negation() {
+        const Token &t = peek();
+        if (isSymbol("!")) {
+            ++m_pos;
+            negation();
+            emit(OpNot);
+        }
+        else if (isSymbol("(")) {
+            ++m_pos;
+            condition();
+            expectSymbol(")");
+        }
+        else if (isKeyword("true") || isKeyword("false")) {
+            ++m_pos;
+            emit(t.text == "true" ? OpTrue : OpFalse);
+        }
+        else if (t.kind == TokenKind::Identifier && SENSORS.contains(t.text)) {
+            const ScriptOp op = SENSORS[t.text];
+            ++m_pos;
+            expectSymbol("(");
+            expectSymbol(")");
+            emit(op);
+        }
+        else
+            throw error(t, t.kind == TokenKind::EndOfFile ? "Expected a condition at the end of the file."
+                                                          : "Expected a condition before '" + t.text + "'.");
+    }
+
+    QVector<Token> m_tokens;
+    int m_pos = 0;
+    ScriptProgram m_program;
+    QVector<Call> m_calls;
+};
+
+/*
+ * PROGRAM
+ */
+
+ScriptProgram ScriptProgram::compile(const QString &source) {
+    return ScriptCompiler(source).compile();
+}
+
+int ScriptProgram::entry(const QString &name) const {
+    for (const Procedure &p : procedures) {
+        if (p.name == name)
+            return p.entry;
+    }
+    return -1;
+}
+
+int ScriptProgram::instructionSize(qint32 op) {
+    switch (op) {
+    case OpDebug:
+    case OpJump:
+    case OpJumpIfFalse:
+    case OpJumpIfTrue:
+    case OpCall:
+        return 2;
+    default:
+        return 1;
+    }
+}
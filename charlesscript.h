@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QException>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * CharlesScript: student programs as text, loaded at runtime (Programs > Load Script).
+ *
+ * The language is the subset of C++ that the programs in agent.cpp use, so the same code works in both:
+ *
+ *     // Comments, and lines starting with # (like #include "commands.h") are skipped.
+ *     void to_wall() {
+ *         while (!in_front_of_wall())
+ *             step();
+ *     }
+ *
+ *     void main() {
+ *         if (on_ball() && !in_front_of_wall()) {
+ *             get_ball();
+ *             to_wall();
+ *         }
+ *         else
+ *             debug("Nothing to do.");
+ *     }
+ *
+ * - Procedures: void name() { ... }, in any order. Every procedure shows up in the program menu.
+ * - Statements: blocks, while, if / else, return; and calls of procedures and commands.
+ * - Commands (see commands.h): step, turn_left, turn_right, put_ball, get_ball, begin_tick, end_tick, debug("...").
+ * - Conditions: on_ball(), in_front_of_wall(), true, false, !, &&, || and parentheses.
+ *
+ * A script is compiled to bytecode (ScriptProgram) that is executed by a ScriptVM.
+ */
+
+// A compile error, with the position in the source (1 based).
+struct ScriptError : public QException {
+    ScriptError(const QString& message, int line, int column);
+    const char *what() const override;
+
+    QString message;
+    int line, column;
+
+private:
+    QByteArray m_what;
+};
+
+// Instructions, an instruction with an operand is followed by that operand in the code.
+// Conditions work on a single flag: sensors, OpTrue and OpFalse set it, OpNot flips it, jumps test it.
+enum ScriptOp : qint32 {
+    OpHalt = 0,
+    OpStep, OpTurnLeft, OpTurnRight, OpPutBall, OpGetBall, OpBeginTick, OpEndTick,
+    OpOnBall, OpInFrontOfWall, OpTrue, OpFalse, OpNot,
+    OpDebug,        // Operand: index in strings.
+    OpJump,         // Operand: target.
+    OpJumpIfFalse,  // Operand: target.
+    OpJumpIfTrue,   // Operand: target.
+    OpCall,         // Operand: entry of the procedure.
+    OpReturn
+};
+
+struct ScriptProgram {
+    struct Procedure {
+        QString name;
+        int entry;
+    };
+
+    QVector<qint32> code;
+    // Source line of every word in code.
+    QVector<int> lines;
+    QStringList strings;
+    QVector<Procedure> procedures;
+
+    // Compile a script. Throws ScriptError.
+    static ScriptProgram compile(const QString& source);
+    // Returns the entry of the procedure with this name, or -1.
+    int entry(const QString& name) const;
+    // Returns the number of words of the instruction starting with op.
+    static int instructionSize(qint32 op);
+};
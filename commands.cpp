@@ -1,42 +1,70 @@
-#include "commands.h"
-#include "mainwindow.h"
-
-
-// pointer to mainwindow from main.cpp (code smell?).
-extern MainWindow* mainwindow;
-
-// stop after error: how?
-// - Do nothing in all functions
-// - Escape control structures by returning random true / false values.
-
-void turn_left() {
-    mainwindow->turnLeft();
-}
-
-void turn_right() {
-    mainwindow->turnRight();
-}
-
-void step() {
-    mainwindow->step();
-}
-
-bool in_front_of_wall() {
-    return mainwindow->inFrontOfWall();
-}
-
-bool on_ball() {
-    return mainwindow->onBall();
-}
-
-void put_ball() {
-    mainwindow->putBall();
-}
-
-void get_ball() {
-    mainwindow->getBall();
-}
-
-void debug(const char *msg) {
-    mainwindow->debugMessage(msg);
-}
+#include "commands.h"
+#include "commandtarget.h"
+#include "callprofile.h"
+
+CommandTarget *commandTarget = nullptr;
+
+// Stop after error (batch mode, see MainWindow::worldAction and HeadlessRunner):
+// - Do nothing in all functions
+// - Escape control structures by returning random true / false values.
+
+void turn_left(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->turnLeft();
+}
+
+void turn_right(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->turnRight();
+}
+
+void step(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->step();
+}
+
+bool in_front_of_wall(SourceLocation where) {
+    CallProfile::instance().command(where);
+    return commandTarget->inFrontOfWall();
+}
+
+bool on_ball(SourceLocation where) {
+    CallProfile::instance().command(where);
+    return commandTarget->onBall();
+}
+
+void put_ball(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->putBall();
+}
+
+void get_ball(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->getBall();
+}
+
+void debug(const char *msg, SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->debugMessage(msg);
+}
+
+int robot_count() {
+    return commandTarget->robotCount();
+}
+
+int robot_id(int i) {
+    return commandTarget->robotId(i);
+}
+
+void select_robot(int id) {
+    commandTarget->selectRobot(id);
+}
+
+void begin_tick() {
+    commandTarget->beginTick();
+}
+
+void end_tick(SourceLocation where) {
+    CallProfile::instance().command(where);
+    commandTarget->endTick();
+}
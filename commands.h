@@ -1,54 +1,86 @@
-#pragma once
-
-/*
- * This file contains the commands that the student has access to while making the assignment.
- * When an error occurs (such as Charles stepping into a wall), all functions lose their effect
- * and boolean functions result in random variables in order to escape any control structures.
- *
- * Read the pre and post condition carefully.
- * A pre condition describes desired attributes of the state must be before calling the function.
- * A post condition describes the (change in) state after execution of the function.
- *
- * Later in this course you will use assert() statements to automatically check on pre conditions.
- *
- * After inspecting this file, have a look at agent.cpp and agent.h.
- * You are free to inspect other files of this project, but for the assignments you do not need any files except
- * The world configuration files, agent.cpp, agent.h and the current file (commands.h).
- *
- */
-
-
-// Delay before every action.
-const int DELAY_MSEC = 200;
-
-// Pre condition: none.
-// Pre condition: Charles is turned left by 90 degrees.
-void turn_left();
-
-// Pre condition: none.
-// Post condition: Charles is turned right by 90 degrees.
-void turn_right();
-
-// Pre condition: Charles is not in front of a wall.
-// Post condition: Charles moved one step in the direction he was facing.
-void step();
-
-// Pre condition: none.
-// Post condition: true is returned iff Charles is facing a wall.
-bool in_front_of_wall();
-
-// Pre condition: none.
-// Post condition: true is returned iff Charles is standing on a ball.
-bool on_ball();
-
-// Pre condition: Charles is not standing on a ball.
-// Post condition: A ball is put on the field that Charles is standing on.
-void put_ball();
-
-// Pre condition: Charles is standing on a ball.
-// Post condition: The ball is taken from the field that Charles is standing on.
-void get_ball();
-
-// Print an arbitrary message to the debug.
-void debug(const char *msg);
-
+#pragma once
+
+/*
+ * This file contains the commands that the student has access to while making the assignment.
+ * When an error occurs (such as Charles stepping into a wall), all functions lose their effect
+ * and boolean functions result in random variables in order to escape any control structures.
+ *
+ * Read the pre and post condition carefully.
+ * A pre condition describes desired attributes of the state must be before calling the function.
+ * A post condition describes the (change in) state after execution of the function.
+ *
+ * Later in this course you will use assert() statements to automatically check on pre conditions.
+ *
+ * After inspecting this file, have a look at agent.cpp and agent.h.
+ * You are free to inspect other files of this project, but for the assignments you do not need any files except
+ * The world configuration files, agent.cpp, agent.h and the current file (commands.h).
+ *
+ * The where parameters are filled in by the compiler, leave them out. They tell the profile which of your
+ * functions called a command (see callscope.h).
+ */
+
+#include "callscope.h"
+
+
+// Delay between actions when the trace is played back (see traceplayer.h), at the default speed.
+const int DELAY_MSEC = 200;
+
+// Pre condition: none.
+// Pre condition: Charles is turned left by 90 degrees.
+void turn_left(SourceLocation where = SourceLocation::current());
+
+// Pre condition: none.
+// Post condition: Charles is turned right by 90 degrees.
+void turn_right(SourceLocation where = SourceLocation::current());
+
+// Pre condition: Charles is not in front of a wall.
+// Post condition: Charles moved one step in the direction he was facing.
+void step(SourceLocation where = SourceLocation::current());
+
+// Pre condition: none.
+// Post condition: true is returned iff Charles is facing a wall.
+bool in_front_of_wall(SourceLocation where = SourceLocation::current());
+
+// Pre condition: none.
+// Post condition: true is returned iff Charles is standing on a ball.
+bool on_ball(SourceLocation where = SourceLocation::current());
+
+// Pre condition: Charles is not standing on a ball.
+// Post condition: A ball is put on the field that Charles is standing on.
+void put_ball(SourceLocation where = SourceLocation::current());
+
+// Pre condition: Charles is standing on a ball.
+// Post condition: The ball is taken from the field that Charles is standing on.
+void get_ball(SourceLocation where = SourceLocation::current());
+
+// Print an arbitrary message to the debug.
+void debug(const char *msg, SourceLocation where = SourceLocation::current());
+
+/*
+ * Worlds with multiple robots. Every robot has an id (see the world file).
+ * All commands above act on the selected robot, at the start this is the first robot in the file.
+ */
+
+// Pre condition: none.
+// Post condition: the number of robots in the world is returned.
+int robot_count();
+
+// Pre condition: 0 <= i < robot_count().
+// Post condition: the id of the i-th robot is returned.
+int robot_id(int i);
+
+// Pre condition: a robot with this id exists.
+// Post condition: the following commands act on the robot with this id.
+void select_robot(int id);
+
+// Pre condition: none.
+// Post condition: actions are collected until end_tick() instead of executed. Each robot gets at most one action
+// (a later action of the same robot replaces the earlier one). Sensors answer for the world at the start of the tick.
+void begin_tick();
+
+// Pre condition: begin_tick() was called.
+// Post condition: the collected actions of all robots are executed at the same time.
+// A robot that steps onto a field that stays taken is blocked and does not move. If several robots step onto
+// the same field, only the robot with the lowest id moves. Blocked robots are no error.
+void end_tick(SourceLocation where = SourceLocation::current());
+
@@ -0,0 +1,176 @@
+#include "commandserver.h"
+
+#include <QException>
+
+// How long listen() waits for a server that already has the name.
+const static int CONNECT_MSEC = 500;
+
+CommandServer::CommandServer(CommandTarget *target, QObject *parent)
+    : QObject{parent},
+    m_target(target),
+    m_server(new QLocalServer(this))
+{
+    connect(m_server, &QLocalServer::newConnection, this, &CommandServer::onNewConnection);
+}
+
+bool CommandServer::listen(const QString &name) {
+    m_error.clear();
+    if (m_server->listen(name))
+        return true;
+    if (m_server->serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+    // On Unix a server that crashed leaves its socket file behind. Only a socket nobody answers on is removed,
+    // not the one of another Charles.
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(CONNECT_MSEC)) {
+        probe.abort();
+        m_error = "another program accepts external agents on " + name;
+        return false;
+    }
+    QLocalServer::removeServer(name);
+    return m_server->listen(name);
+}
+
+void CommandServer::close() {
+    disconnectClient();
+    m_server->close();
+}
+
+bool CommandServer::isListening() const {
+    return m_server->isListening();
+}
+
+QString CommandServer::fullServerName() const {
+    return m_server->fullServerName();
+}
+
+QString CommandServer::errorString() const {
+    return m_error.isEmpty() ? m_server->errorString() : m_error;
+}
+
+bool CommandServer::hasClient() const {
+    return m_client != nullptr;
+}
+
+void CommandServer::disconnectClient() {
+    if (m_client)
+        m_client->disconnectFromServer();
+}
+
+void CommandServer::abortClient() {
+    if (!m_client)
+        return;
+    // The disconnected handler only deletes a socket that is not m_client any more.
+    QLocalSocket *client = m_client;
+    m_client = nullptr;
+    m_buffer.clear();
+    client->abort();
+}
+
+QByteArray CommandServer::execute(const QByteArray &request) {
+    const int space = request.indexOf(' ');
+    const QByteArray command = space == -1 ? request : request.left(space);
+    const QByteArray argument = space == -1 ? QByteArray() : request.mid(space + 1);
+    bool ok = true;
+    const int number = argument.toInt(&ok);
+
+    try {
+        if (command == "step")
+            m_target->step();
+        else if (command == "turn_left")
+            m_target->turnLeft();
+        else if (command == "turn_right")
+            m_target->turnRight();
+        else if (command == "put_ball")
+            m_target->putBall();
+        else if (command == "get_ball")
+            m_target->getBall();
+        else if (command == "on_ball")
+            return m_target->onBall() ? "true" : "false";
+        else if (command == "in_front_of_wall")
+            return m_target->inFrontOfWall() ? "true" : "false";
+        else if (command == "debug")
+            m_target->debugMessage(QString::fromUtf8(argument));
+        else if (command == "robot_count")
+            return QByteArray::number(m_target->robotCount());
+        else if (command == "robot_id") {
+            if (!ok)
+                return "error bad robot index";
+            return QByteArray::number(m_target->robotId(number));
+        }
+        else if (command == "select_robot") {
+            if (!ok)
+                return "error bad robot id";
+            m_target->selectRobot(number);
+        }
+        else if (command == "begin_tick")
+            m_target->beginTick();
+        else if (command == "end_tick")
+            m_target->endTick();
+        else
+            return "error unknown request " + command;
+    }
+    catch (QException& e) {
+        return QByteArray("error ") + e.what();
+    }
+    return "ok";
+}
+
+void CommandServer::onNewConnection() {
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        if (m_client) {
+            socket->write("error busy\n");
+            socket->disconnectFromServer();
+            connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            continue;
+        }
+        m_client = socket;
+        m_buffer.clear();
+        connect(socket, &QLocalSocket::readyRead, this, &CommandServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            socket->deleteLater();
+            if (m_client != socket)
+                return;
+            m_client = nullptr;
+            emit clientDisconnected();
+        });
+        emit clientConnected();
+    }
+}
+
+void CommandServer::onReadyRead() {
+    m_buffer += m_client->readAll();
+    const int end = m_buffer.lastIndexOf('\n');
+    // A client that never ends its line must not fill the memory.
+    if (m_buffer.size() - end - 1 > MAX_LINE) {
+        m_client->write("error request too long\n");
+        m_buffer.clear();
+        disconnect(m_client, &QLocalSocket::readyRead, this, &CommandServer::onReadyRead);
+        m_client->disconnectFromServer();
+        return;
+    }
+    if (end == -1)
+        return;
+    const QList<QByteArray> requests = m_buffer.left(end).split('\n');
+    m_buffer.remove(0, end + 1);
+
+    emit batchStarted();
+    QByteArray replies;
+    bool failed = false;
+    for (QByteArray request : requests) {
+        if (request.endsWith('\r'))
+            request.chop(1);
+        if (failed) {
+            replies += "error skipped\n";
+            continue;
+        }
+        const QByteArray reply = execute(request);
+        failed = reply.startsWith("error");
+        replies += reply + '\n';
+    }
+    emit batchFinished(requests.size());
+    // The client may have gone while the batch ran.
+    if (m_client)
+        m_client->write(replies);
+}
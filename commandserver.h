@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "commandtarget.h"
+
+/*
+ * Lets a program in another process (another language, a test harness) drive Charles over a local socket
+ * (a named pipe on Windows). The commands go to a CommandTarget like the ones of commands.h, so they are traced
+ * and shown like those of any other program.
+ *
+ * The protocol is text, a line per request and a line per reply, in the same order:
+ *
+ *   step, turn_left, turn_right, put_ball, get_ball, begin_tick, end_tick   -> ok
+ *   on_ball, in_front_of_wall                                               -> true / false
+ *   debug <message>                                                         -> ok
+ *   robot_count, robot_id <i>                                               -> <number>
+ *   select_robot <id>                                                       -> ok
+ *
+ * A failing request is answered with "error <message>". The requests that follow it in the same batch are not
+ * executed, they are answered with "error skipped", so the client can match the replies.
+ *
+ * Requests can be pipelined: all complete lines that arrived are executed as one batch and their replies are
+ * written at once. A program that sends its steps and queries together pays one round trip per batch,
+ * not one per command. Only one client is served at a time. A line that has no end after MAX_LINE bytes is
+ * answered with "error request too long" and the client is disconnected.
+ */
+
+class CommandServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CommandServer(CommandTarget *target, QObject *parent = nullptr);
+
+    // Listen on name. A stale socket of the same name (a server that crashed) is removed, one that another server
+    // still answers on is not. Returns false if that fails (see errorString()).
+    bool listen(const QString& name);
+    // Stop listening, the client is disconnected.
+    void close();
+    bool isListening() const;
+    // The name clients connect to, including its path.
+    QString fullServerName() const;
+    QString errorString() const;
+    bool hasClient() const;
+    // Disconnect the client once its replies are written, clientDisconnected() follows.
+    void disconnectClient();
+    // Drop the client at once, without clientDisconnected(), e.g. when its run was ended already.
+    void abortClient();
+
+    // Returns the reply to a single request line (without the newline).
+    QByteArray execute(const QByteArray& request);
+
+    constexpr static int MAX_LINE = 64 * 1024;
+
+signals:
+    void clientConnected();
+    void clientDisconnected();
+    // Around every batch of requests, e.g. to turn off UI updates while it runs.
+    void batchStarted();
+    void batchFinished(int requests);
+
+private:
+    void onNewConnection();
+    void onReadyRead();
+
+    CommandTarget *m_target;
+    QLocalServer *m_server;
+    QLocalSocket *m_client = nullptr;
+    // Received data after the last complete line.
+    QByteArray m_buffer;
+    // Set if listen() failed before the server tried, otherwise the error of the server.
+    QString m_error;
+};
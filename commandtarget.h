@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QString>
+#include <functional>
+
+/*
+ * The receiver of the student commands (commands.h). The commands are passed on to the current target:
+ * the MainWindow when a program runs in the UI, a HeadlessRunner when it runs without UI (e.g. in a sandbox).
+ */
+
+class CommandTarget
+{
+public:
+    virtual ~CommandTarget() = default;
+
+    virtual bool onBall() = 0;
+    virtual bool inFrontOfWall() = 0;
+    virtual void step() = 0;
+    virtual void turnLeft() = 0;
+    virtual void turnRight() = 0;
+    virtual void getBall() = 0;
+    virtual void putBall() = 0;
+    virtual void debugMessage(const QString& msg) = 0;
+
+    virtual int robotCount() = 0;
+    virtual int robotId(int i) = 0;
+    virtual void selectRobot(int id) = 0;
+    virtual void beginTick() = 0;
+    virtual void endTick() = 0;
+};
+
+// A student program: a compiled in function, a function from a plugin or a procedure of a script.
+typedef std::function<void()> AgentFunction;
+
+// Seed for the random sensor values after an error (see commands.h), so runs are reproducible.
+const quint32 SENSOR_NOISE_SEED = 2023;
+
+// The target of the commands in commands.h, set in main.cpp.
+extern CommandTarget *commandTarget;
@@ -1,17 +1,223 @@
-#include "debugtraceitem.h"
-
-DebugTraceItem::DebugTraceItem(QListWidget *parent, DebugKind k, const QString& text)
-    :QListWidgetItem(text.isEmpty() ? DEFAULT_DEBUG_TEXTS[k] : text, parent),
-    debugKind(k)
-{
-}
-
-void DebugTraceItem::execute(WorldObject *world) const {
-    if (EXECUTE_FUNCTION[debugKind])
-        (world->*EXECUTE_FUNCTION[debugKind])();
-}
-
-void DebugTraceItem::reverse(WorldObject *world) const {
-    if (REVERSE_FUNCTION[debugKind])
-       (world->*REVERSE_FUNCTION[debugKind])();
-}
+#include "debugtraceitem.h"
+
+// Selects a robot for as long as it lives, afterwards (also on exceptions) the previous selection is restored.
+struct RobotSelection {
+    RobotSelection(WorldObject *world, int robot)
+        : world(world),
+        previous(world->selectedRobot())
+    {
+        if (robot != NO_ROBOT)
+            world->selectRobot(robot);
+    }
+    ~RobotSelection() {
+        world->selectRobot(previous);
+    }
+    WorldObject *world;
+    const int previous;
+};
+
+// Prefix the text with the robot when there are multiple robots. Sensors show their answer.
+QString eventText(const TraceEvent &e) {
+    QString base = e.text.isEmpty() ? DEFAULT_DEBUG_TEXTS[e.kind] : e.text;
+    if (isSensor(e.kind))
+        base += e.answer ? " True" : " False";
+    return e.robot == NO_ROBOT ? base : QString("Robot %1: %2").arg(e.robot).arg(base);
+}
+
+bool isSensor(DebugKind k) {
+    return SENSOR_FUNCTION[k] != nullptr;
+}
+
+RobotAction robotAction(DebugKind k) {
+    switch(k) {
+    case DebugKind::Step:
+        return RobotAction::StepAction;
+    case DebugKind::PutBall:
+        return RobotAction::PutBallAction;
+    case DebugKind::GetBall:
+        return RobotAction::GetBallAction;
+    case DebugKind::TurnLeft:
+        return RobotAction::TurnLeftAction;
+    case DebugKind::TurnRight:
+        return RobotAction::TurnRightAction;
+    default:
+        return RobotAction::NoAction;
+    }
+}
+
+void executeEvent(WorldObject *world, const TraceEvent &e) {
+    if (e.kind == DebugKind::Tick) {
+        world->tick(e.tickActions);
+        return;
+    }
+    if (EXECUTE_FUNCTION[e.kind]) {
+        RobotSelection selection(world, e.robot);
+        (world->*EXECUTE_FUNCTION[e.kind])();
+    }
+}
+
+bool senseEvent(WorldObject *world, const TraceEvent &e) {
+    assert(isSensor(e.kind) && "senseEvent: event is not a sensor.");
+    RobotSelection selection(world, e.robot);
+    return (world->*SENSOR_FUNCTION[e.kind])();
+}
+
+void appendSensorQuery(QBitArray &queries, DebugKind k, bool answer) {
+    assert(isSensor(k) && "appendSensorQuery: k must be a sensor.");
+    const qsizetype i = queries.size();
+    queries.resize(i + 2);
+    queries.setBit(i, k == DebugKind::InFrontOfWall);
+    queries.setBit(i + 1, answer);
+}
+
+TraceEvent sensorQuery(const QBitArray &queries, int i, int robot) {
+    return TraceEvent{queries.testBit(2 * i) ? DebugKind::InFrontOfWall : DebugKind::OnBall, robot, queries.testBit(2 * i + 1)};
+}
+
+QDataStream &operator<<(QDataStream &out, const TraceEvent &e) {
+    out << quint8(e.kind) << qint32(e.robot) << e.answer << e.text << qint32(e.tickActions.size());
+    for (RobotAction a : e.tickActions)
+        out << quint8(a);
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, TraceEvent &e) {
+    quint8 kind;
+    qint32 robot, actions;
+    in >> kind >> robot >> e.answer >> e.text >> actions;
+    e.kind = static_cast<DebugKind>(kind);
+    e.robot = robot;
+    e.tickActions.resize(actions);
+    for (RobotAction &a : e.tickActions) {
+        quint8 action;
+        in >> action;
+        a = static_cast<RobotAction>(action);
+    }
+    return in;
+}
+
+DebugTraceItem::DebugTraceItem(DebugKind k, const QString& text, int robot, int site)
+    :DebugTraceItem(TraceEvent{k, robot, false, text, {}, site})
+{
+}
+
+DebugTraceItem::DebugTraceItem(const TraceEvent &event)
+    :debugKind(event.kind),
+    robot(event.robot),
+    site(event.site),
+    m_message(event.text),
+    m_answer(event.answer),
+    m_tickActions(event.tickActions)
+{
+}
+
+DebugTraceItem::DebugTraceItem(const QVector<RobotAction> &actions, int site)
+    :DebugTraceItem(TraceEvent{DebugKind::Tick, NO_ROBOT, false, QString(), actions, site})
+{
+}
+
+void DebugTraceItem::execute(WorldObject *world) const {
+    if (debugKind == DebugKind::Tick) {
+        m_tickResults = world->tick(m_tickActions);
+        return;
+    }
+    if (EXECUTE_FUNCTION[debugKind]) {
+        RobotSelection selection(world, robot);
+        (world->*EXECUTE_FUNCTION[debugKind])();
+    }
+}
+
+ActionResult DebugTraceItem::tryExecute(WorldObject *world) const {
+    if (debugKind == DebugKind::Tick) {
+        execute(world);
+        return ActionResult::ActionOk;
+    }
+    if (TRY_EXECUTE_FUNCTION[debugKind]) {
+        RobotSelection selection(world, robot);
+        return (world->*TRY_EXECUTE_FUNCTION[debugKind])();
+    }
+    return ActionResult::ActionOk;
+}
+
+void DebugTraceItem::reverse(WorldObject *world) const {
+    if (debugKind == DebugKind::Tick) {
+        world->reverseTick(m_tickActions, m_tickResults);
+        return;
+    }
+    if (REVERSE_FUNCTION[debugKind]) {
+        RobotSelection selection(world, robot);
+        (world->*REVERSE_FUNCTION[debugKind])();
+    }
+}
+
+const QVector<ActionResult> &DebugTraceItem::tickResults() const {
+    return m_tickResults;
+}
+
+bool DebugTraceItem::sense(WorldObject *world) const {
+    assert(isSensor(debugKind) && "DebugTraceItem::sense: item is not a sensor.");
+    RobotSelection selection(world, robot);
+    return (world->*SENSOR_FUNCTION[debugKind])();
+}
+
+TraceEvent DebugTraceItem::event() const {
+    return TraceEvent{debugKind, robot, m_answer, m_message, m_tickActions, site};
+}
+
+QVariant DebugTraceItem::data(int role) const {
+    if (role == Qt::ToolTipRole && site != NO_SITE)
+        return CallProfile::instance().siteText(site);
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    QString text = eventText(event());
+    if (debugKind == DebugKind::Tick) {
+        int moved = 0, failed = 0;
+        for (int i = 0; i < m_tickResults.size(); ++i) {
+            if (m_tickResults[i] != ActionResult::ActionOk)
+                ++failed;
+            else if (m_tickActions[i] != RobotAction::NoAction)
+                ++moved;
+        }
+        text = m_tickResults.isEmpty() ? QString("Tick (%1 robots)").arg(m_tickActions.size())
+                                       : QString("Tick: %1 actions, %2 failed").arg(moved).arg(failed);
+    }
+    if (m_foldedSensors.isEmpty())
+        return text;
+    return QString("%1 (+%2 sensor queries)").arg(text).arg(foldedSensorCount());
+}
+
+void DebugTraceItem::setFoldedSensors(const QBitArray &queries) {
+    m_foldedSensors = queries;
+}
+
+int DebugTraceItem::foldedSensorCount() const {
+    return m_foldedSensors.size() / 2;
+}
+
+TraceEvent DebugTraceItem::foldedSensor(int i) const {
+    assert(i >= 0 && i < foldedSensorCount() && "DebugTraceItem::foldedSensor: i out of range.");
+    return sensorQuery(m_foldedSensors, i, robot);
+}
+
+void DebugTraceItem::write(QDataStream &out) const {
+    out << event() << qint32(site) << m_foldedSensors << qint32(m_tickResults.size());
+    for (ActionResult r : m_tickResults)
+        out << quint8(r);
+}
+
+DebugTraceItem *DebugTraceItem::read(QDataStream &in) {
+    TraceEvent e;
+    qint32 site, results;
+    in >> e >> site;
+    e.site = site;
+    DebugTraceItem *item = new DebugTraceItem(e);
+    in >> item->m_foldedSensors >> results;
+    item->m_tickResults.resize(results);
+    for (ActionResult &r : item->m_tickResults) {
+        quint8 result;
+        in >> result;
+        r = static_cast<ActionResult>(result);
+    }
+    return item;
+}
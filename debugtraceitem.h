@@ -1,60 +1,182 @@
-#pragma once
-
-#include <QListWidgetItem>
-#include "worldobject.h"
-
-enum DebugKind {
-    Step =0,
-    PutBall,
-    GetBall,
-    TurnLeft,
-    TurnRight,
-    Message,
-    BoolInfo, // Request such as onball.
-    Error     // Errors such as "tried to step into wall".
-};
-
-void(WorldObject::* const EXECUTE_FUNCTION[])() {
-    &WorldObject::step,
-    &WorldObject::putBall,
-    &WorldObject::getBall,
-    &WorldObject::turnLeft,
-    &WorldObject::turnRight,
-    nullptr,
-    nullptr,
-    nullptr
-};
-
-void(WorldObject::* const REVERSE_FUNCTION[])() {
-    &WorldObject::stepBack,
-    &WorldObject::getBall,
-    &WorldObject::putBall,
-    &WorldObject::turnRight,
-    &WorldObject::turnLeft,
-    nullptr,
-    nullptr,
-    nullptr
-};
-
-const QString DEFAULT_DEBUG_TEXTS[] {
-    "Step",
-    "Put Ball",
-    "Get Ball",
-    "Turn Left",
-    "Turn Right",
-    "Message",
-    "BoolInfo ? (true/false)",
-    "Error"
-};
-
-class DebugTraceItem : public QListWidgetItem
-{
-public:
-    DebugTraceItem(QListWidget *parent, DebugKind k, const QString& text ="");
-
-    // Execute current debug line on world.
-    void execute(WorldObject* world) const;
-    // Reverse current debug line on world.
-    void reverse(WorldObject* world) const;
-    const DebugKind debugKind;
-};
+#pragma once
+
+#include <QVariant>
+#include <QDataStream>
+#include <QBitArray>
+#include "worldobject.h"
+#include "callprofile.h"
+
+enum DebugKind {
+    Step =0,
+    PutBall,
+    GetBall,
+    TurnLeft,
+    TurnRight,
+    Message,
+    BoolInfo, // Request such as onball.
+    Error,    // Errors such as "tried to step into wall".
+    Tick,     // One action for every robot at the same time (see WorldObject::tick).
+    OnBall,   // Sensor on_ball(), the answer is recorded.
+    InFrontOfWall // Sensor in_front_of_wall(), the answer is recorded.
+};
+
+// Robot of items in a world with a single robot (the selected robot is used).
+const int NO_ROBOT = -1;
+
+void(WorldObject::* const EXECUTE_FUNCTION[])() {
+    &WorldObject::step,
+    &WorldObject::putBall,
+    &WorldObject::getBall,
+    &WorldObject::turnLeft,
+    &WorldObject::turnRight,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+void(WorldObject::* const REVERSE_FUNCTION[])() {
+    &WorldObject::stepBack,
+    &WorldObject::getBall,
+    &WorldObject::putBall,
+    &WorldObject::turnRight,
+    &WorldObject::turnLeft,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+ActionResult(WorldObject::* const TRY_EXECUTE_FUNCTION[])() {
+    &WorldObject::tryStep,
+    &WorldObject::tryPutBall,
+    &WorldObject::tryGetBall,
+    &WorldObject::tryTurnLeft,
+    &WorldObject::tryTurnRight,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+bool(WorldObject::* const SENSOR_FUNCTION[])() const {
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    &WorldObject::onBall,
+    &WorldObject::inFrontOfWall
+};
+
+const QString DEFAULT_DEBUG_TEXTS[] {
+    "Step",
+    "Put Ball",
+    "Get Ball",
+    "Turn Left",
+    "Turn Right",
+    "Message",
+    "BoolInfo ? (true/false)",
+    "Error",
+    "Tick",
+    "onBall?",
+    "inFrontOfWall?"
+};
+
+// Everything that is recorded about a trace item, enough to replay it without the list widget.
+struct TraceEvent {
+    DebugKind kind;
+    int robot = NO_ROBOT;
+    // Answer of sensor items.
+    bool answer = false;
+    // Text of messages and errors.
+    QString text;
+    // Actions of tick items.
+    QVector<RobotAction> tickActions;
+    // Place in the program that added the item (see CallProfile). Only valid in this process, so it is not encoded.
+    int site = NO_SITE;
+};
+
+// An item of the trace, kept in a TraceModel. Its text is made when it is shown.
+class DebugTraceItem
+{
+public:
+    // robot is the id of the robot that executes the item, or NO_ROBOT.
+    DebugTraceItem(DebugKind k, const QString& text ="", int robot = NO_ROBOT, int site = NO_SITE);
+    // Tick item, actions[i] belongs to the i-th robot of the world.
+    DebugTraceItem(const QVector<RobotAction>& actions, int site = NO_SITE);
+    // Item for a recorded event.
+    DebugTraceItem(const TraceEvent& event);
+
+    // Execute current debug line on world.
+    void execute(WorldObject* world) const;
+    // Execute current debug line on world without throwing. The world is untouched on failure.
+    ActionResult tryExecute(WorldObject* world) const;
+    // Reverse current debug line on world.
+    void reverse(WorldObject* world) const;
+    // Returns the answer of a sensor item for the current world.
+    bool sense(WorldObject* world) const;
+    // Results of the last execution of a tick item.
+    const QVector<ActionResult> &tickResults() const;
+    // Returns the recorded event of this item.
+    TraceEvent event() const;
+    // Returns the text (Qt::DisplayRole) or the tooltip (Qt::ToolTipRole) of the item.
+    // The tooltip of items with a site is the place in the program, looked up when it is shown.
+    // Items with folded sensor queries show their number.
+    QVariant data(int role) const;
+
+    // Sensor queries of the robot of this item that came right before it, folded into it instead of an item each
+    // (see DebugTraceWidget::setFoldingSensors and appendSensorQuery).
+    void setFoldedSensors(const QBitArray& queries);
+    int foldedSensorCount() const;
+    // Returns folded query i as a recorded event.
+    TraceEvent foldedSensor(int i) const;
+
+    // Binary encoding of the whole item, including its tick results (see TraceModel). The site is only valid
+    // in this process.
+    void write(QDataStream& out) const;
+    static DebugTraceItem *read(QDataStream& in);
+
+    const DebugKind debugKind;
+    const int robot;
+    const int site;
+
+private:
+    // Raw text of messages and errors (without robot prefix).
+    QString m_message;
+    bool m_answer = false;
+    QVector<RobotAction> m_tickActions;
+    QBitArray m_foldedSensors;
+    // Ticks are deterministic, so results are the same on every execution. Needed for reversing.
+    mutable QVector<ActionResult> m_tickResults;
+};
+
+// Returns true iff k is a sensor with a recorded answer.
+bool isSensor(DebugKind k);
+// Returns the robot action for a debug kind that changes the world, NoAction for other kinds.
+RobotAction robotAction(DebugKind k);
+// Returns the text of an item for e, without the results of ticks.
+QString eventText(const TraceEvent& e);
+// Execute a recorded event on world without a trace item (e.g. to replay a trace in the background).
+void executeEvent(WorldObject *world, const TraceEvent& e);
+// Returns the answer of a recorded sensor event on world, without a trace item.
+bool senseEvent(WorldObject *world, const TraceEvent& e);
+
+// Folded sensor queries take two bits each: the sensor (OnBall or InFrontOfWall) and the answer.
+void appendSensorQuery(QBitArray &queries, DebugKind k, bool answer);
+// Returns query i of queries as an event of robot.
+TraceEvent sensorQuery(const QBitArray &queries, int i, int robot);
+
+// Binary encoding of events (e.g. to send a trace to another process).
+QDataStream &operator<<(QDataStream &out, const TraceEvent &e);
+QDataStream &operator>>(QDataStream &in, TraceEvent &e);
@@ -1,73 +1,521 @@
-#include "debugtracewidget.h"
-#include <QVBoxLayout>
-
-DebugTraceWidget::DebugTraceWidget(QWidget *parent, WorldObject *world)
-    : QWidget(parent),
-    m_world(world)
-{
-    setupUi();
-    addDebugItem(DebugKind::Message, "Start of Program");
-
-    connect(m_button, &QPushButton::pressed, this, &DebugTraceWidget::removeFromCurrentIndex);
-    connect(m_listWidget, &QListWidget::currentRowChanged, this, &DebugTraceWidget::selectIndexChanged);
-    connect(m_world, &WorldObject::newWorldLoaded, this, &DebugTraceWidget::clearDebugTrace);
-}
-
-void DebugTraceWidget::addDebugItem(DebugKind k, const QString& text, bool rethrow) {
-    m_listWidget->addItem(new DebugTraceItem(m_listWidget, k, text));
-    try {
-        m_listWidget->setCurrentRow(m_listWidget->count() - 1);
-    }
-    catch(QException& e) {
-        delete m_listWidget->takeItem(m_listWidget->count() - 1);
-        m_listWidget->addItem(new DebugTraceItem(m_listWidget, DebugKind::Error, e.what()));
-        if (rethrow)
-            throw;
-    }
-}
-
-void DebugTraceWidget::executeTrace(int from, int to) {
-    assert(from <= to && "DebugTraceWidget::executeTrace: from should be less than/equal to to.");
-    for (int r = from + 1; r <= to; r++)
-        getDebugItem(r)->execute(m_world);
-}
-
-void DebugTraceWidget::reverseTrace(int from, int to) {
-    assert(from >= to && "DebugTraceWidget::executeTrace: from should be greater than/equal to to.");
-    for (int r = from; r > to; r--)
-        getDebugItem(r)->reverse(m_world);
-}
-
-void DebugTraceWidget::selectIndexChanged(int newIndex) {
-    if (m_tracingEnabled && m_index < newIndex)
-        executeTrace(m_index, newIndex);
-    else if(m_tracingEnabled)
-        reverseTrace(m_index, newIndex);
-    m_index = newIndex;
-}
-
-void DebugTraceWidget::removeFromCurrentIndex() {
-    for (int r = m_listWidget->count() - 1; r > m_index; --r)
-        delete m_listWidget->takeItem(r);
-}
-
-void DebugTraceWidget::clearDebugTrace() {
-    m_tracingEnabled = false;
-    m_index = 0;
-    while (m_listWidget->count() > 1)
-        delete m_listWidget->takeItem(1);
-    m_tracingEnabled = true;
-}
-
-void DebugTraceWidget::setupUi() {
-    QVBoxLayout* layout = new QVBoxLayout(this);
-    layout->addWidget(m_button = new QPushButton("Continue From Here", this));
-    layout->addWidget(m_listWidget = new QListWidget(this));
-    setLayout(layout);
-}
-
-const DebugTraceItem *DebugTraceWidget::getDebugItem(int index) const {
-    DebugTraceItem *debugItem = dynamic_cast<DebugTraceItem*>(m_listWidget->item(index));
-    assert(debugItem && "DebugTraceWidget::getDebugItem: debugItem should never be nullptr. Are there any functions that add non DebugTraceItem to DebugTraceWidget?");
-    return debugItem;
-}
+#include "debugtracewidget.h"
+#include <QVBoxLayout>
+#include <QMenu>
+
+DebugTraceWidget::DebugTraceWidget(QWidget *parent, WorldObject *world, std::unique_ptr<Parked> parked)
+    : QWidget(parent),
+    m_world(world),
+    m_model(parked ? parked->model.release() : new TraceModel),
+    m_branches({Branch{-1, 0, {}, 0}})
+{
+    m_model->setParent(this);
+    setupUi();
+    if (parked) {
+        // The world is at the current item already, the items are only shown.
+        m_tracingEnabled = false;
+        m_history = parked->history;
+        m_branches = parked->branches;
+        parked->branches.clear();
+        m_branch = parked->branch;
+        m_sensors = parked->sensors;
+        m_sensorRobot = parked->sensorRobot;
+        setCurrentRow(parked->index);
+        m_index = parked->index;
+        m_tracingEnabled = true;
+    }
+    else
+        addDebugItem(DebugKind::Message, "Start of Program");
+    updateBranchBox();
+
+    connect(m_button, &QPushButton::pressed, this, &DebugTraceWidget::branchFromCurrentIndex);
+    connect(m_branchBox, &QComboBox::currentIndexChanged, this, &DebugTraceWidget::switchToBranch);
+    connect(m_view->selectionModel(), &QItemSelectionModel::currentRowChanged, this, [this](const QModelIndex &current) {
+        if (current.isValid())
+            selectIndexChanged(current.row());
+    });
+    connect(m_view, &QListView::doubleClicked, this, [this](const QModelIndex &index) {
+        const int site = getDebugItem(index.row())->site;
+        if (site != NO_SITE)
+            emit sourceRequested(site);
+    });
+    connect(m_world, &WorldObject::newWorldLoaded, this, &DebugTraceWidget::clearDebugTrace);
+    m_view->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(m_view, &QListView::customContextMenuRequested, this, [this](QPoint pos) {
+        const QModelIndex index = m_view->indexAt(pos);
+        if (!index.isValid())
+            return;
+        QMenu menu;
+        {
+            // Not pinned while the menu is open, the trace may go on meanwhile.
+            const PinnedItem item = getDebugItem(index.row());
+            if (item->foldedSensorCount() == 0)
+                return;
+            // All rows have the same height (the view does not have to read every item for its layout),
+            // so the folded queries are listed in the menu.
+            const int MAX_LISTED = 40;
+            menu.addSection("Sensor Queries Before This Item");
+            for (int i = 0; i < qMin(item->foldedSensorCount(), MAX_LISTED); ++i)
+                menu.addAction(eventText(item->foldedSensor(i)))->setEnabled(false);
+            if (item->foldedSensorCount() > MAX_LISTED)
+                menu.addAction(QString("... %1 more").arg(item->foldedSensorCount() - MAX_LISTED))->setEnabled(false);
+        }
+        menu.exec(m_view->viewport()->mapToGlobal(pos));
+    });
+}
+
+std::unique_ptr<DebugTraceWidget::Parked> DebugTraceWidget::park() {
+    std::unique_ptr<Parked> parked(new Parked);
+    parked->branch = m_branch;
+    parked->index = m_index;
+    parked->sensors = m_sensors;
+    parked->sensorRobot = m_sensorRobot;
+    // The model moves as a whole, spilled items are not read back for it.
+    m_tracingEnabled = false;
+    m_view->setModel(nullptr);
+    m_model->setParent(nullptr);
+    parked->model.reset(m_model);
+    m_model = nullptr;
+    parked->history = m_history;
+    parked->branches = m_branches;
+    m_branches.clear();
+    return parked;
+}
+
+void DebugTraceWidget::addDebugItem(DebugKind k, const QString& text, bool rethrow) {
+    // Bring the world to the end of the trace first. Replaying traced items never fails.
+    if (m_model->count() > 0)
+        setCurrentRow(m_model->count() - 1);
+
+    const int site = CallProfile::instance().takeSite();
+    const QBitArray sensors = takeSensors(tracedRobot());
+    DebugTraceItem *item = new DebugTraceItem(k, text, tracedRobot(), site);
+    item->setFoldedSensors(sensors);
+    appendItem(item);
+    try {
+        setCurrentRow(m_model->count() - 1);
+        recordTouches(m_model->count() - 1);
+    }
+    catch(QException& e) {
+        delete m_model->takeLast();
+        item = new DebugTraceItem(DebugKind::Error, e.what(), tracedRobot(), site);
+        item->setFoldedSensors(sensors);
+        appendItem(item);
+        if (rethrow)
+            throw;
+    }
+}
+
+ActionResult DebugTraceWidget::tryAddDebugItem(DebugKind k, const QString &text) {
+    // Bring the world to the end of the trace first. Replaying traced items never fails.
+    setCurrentRow(m_model->count() - 1);
+
+    const int site = CallProfile::instance().takeSite();
+    const QBitArray sensors = takeSensors(tracedRobot());
+    DebugTraceItem *item = new DebugTraceItem(k, text, tracedRobot(), site);
+    item->setFoldedSensors(sensors);
+    appendItem(item);
+    ActionResult result = item->tryExecute(m_world);
+    if (result != ActionResult::ActionOk) {
+        delete m_model->takeLast();
+        item = new DebugTraceItem(DebugKind::Error, WorldObject::actionResultMessage(result), tracedRobot(), site);
+        item->setFoldedSensors(sensors);
+        appendItem(item);
+    }
+    else
+        recordTouches(m_model->count() - 1);
+
+    // The new item is already executed, so only move the index.
+    selectLastItem();
+    return result;
+}
+
+QVector<ActionResult> DebugTraceWidget::addTick(const QVector<RobotAction> &actions) {
+    setCurrentRow(m_model->count() - 1);
+
+    const QBitArray sensors = takeSensors(NO_ROBOT);
+    DebugTraceItem *item = new DebugTraceItem(actions, CallProfile::instance().takeSite());
+    item->setFoldedSensors(sensors);
+    appendItem(item);
+    // Its text shows the results (see DebugTraceItem::data).
+    item->execute(m_world);
+    recordTouches(m_model->count() - 1);
+
+    selectLastItem();
+    return item->tickResults();
+}
+
+void DebugTraceWidget::addSensorItem(DebugKind k, bool answer) {
+    assert(isSensor(k) && "DebugTraceWidget::addSensorItem: k must be a sensor.");
+    if (m_foldSensors) {
+        // Its place in the program is not kept.
+        CallProfile::instance().takeSite();
+        if (!m_sensors.isEmpty() && tracedRobot() != m_sensorRobot)
+            flushSensors();
+        m_sensorRobot = tracedRobot();
+        appendSensorQuery(m_sensors, k, answer);
+        return;
+    }
+    // Sensors do not change the world, so there is nothing to execute.
+    setCurrentRow(m_model->count() - 1);
+    appendItem(new DebugTraceItem(TraceEvent{k, tracedRobot(), answer, QString(), {}, CallProfile::instance().takeSite()}));
+    selectLastItem();
+}
+
+void DebugTraceWidget::setFoldingSensors(bool on) {
+    if (!on)
+        flushSensors();
+    m_foldSensors = on;
+}
+
+void DebugTraceWidget::flushSensors() {
+    if (m_sensors.isEmpty())
+        return;
+    // The last query gets the item, the ones before it are folded into it.
+    const int last = m_sensors.size() / 2 - 1;
+    QBitArray sensors = m_sensors;
+    m_sensors.clear();
+    setCurrentRow(m_model->count() - 1);
+    DebugTraceItem *item = new DebugTraceItem(sensorQuery(sensors, last, m_sensorRobot));
+    sensors.resize(2 * last);
+    item->setFoldedSensors(sensors);
+    appendItem(item);
+    selectLastItem();
+}
+
+void DebugTraceWidget::addRecordedItem(const TraceEvent &e) {
+    assert((e.kind == DebugKind::Message || e.kind == DebugKind::Error) && "DebugTraceWidget::addRecordedItem: only messages and errors can be added as recorded.");
+    const QBitArray sensors = takeSensors(e.robot);
+    setCurrentRow(m_model->count() - 1);
+    DebugTraceItem *item = new DebugTraceItem(e);
+    item->setFoldedSensors(sensors);
+    appendItem(item);
+    selectLastItem();
+}
+
+QVector<TraceEvent> DebugTraceWidget::events(int limit) const {
+    QVector<TraceEvent> events;
+    events.reserve(qMin(eventCount(), limit));
+    for (int r = 1; r < m_model->count() && events.size() < limit; ++r) {
+        const PinnedItem item = getDebugItem(r);
+        for (int i = 0; i < item->foldedSensorCount(); ++i)
+            events.push_back(item->foldedSensor(i));
+        events.push_back(item->event());
+    }
+    for (int i = 0; i < m_sensors.size() / 2; ++i)
+        events.push_back(sensorQuery(m_sensors, i, m_sensorRobot));
+    if (events.size() > limit)
+        events.resize(limit);
+    return events;
+}
+
+int DebugTraceWidget::eventCount() const {
+    return m_model->eventCount() + m_sensors.size() / 2;
+}
+
+int DebugTraceWidget::itemBeforeEvent(int event) const {
+    return m_model->itemBeforeEvent(event);
+}
+
+int DebugTraceWidget::replayEvents(const QVector<TraceEvent> &events) {
+    seekToEnd();
+    int replayed = 0;
+    for (; replayed < events.size(); ++replayed) {
+        const TraceEvent &e = events[replayed];
+        if (e.kind == DebugKind::Error)
+            break;
+        if (m_foldSensors && isSensor(e.kind)) {
+            if (senseEvent(m_world, e) != e.answer)
+                break;
+            if (!m_sensors.isEmpty() && e.robot != m_sensorRobot)
+                flushSensors();
+            m_sensorRobot = e.robot;
+            appendSensorQuery(m_sensors, e.kind, e.answer);
+            continue;
+        }
+        const QBitArray sensors = takeSensors(e.robot);
+        DebugTraceItem *item = new DebugTraceItem(e);
+        item->setFoldedSensors(sensors);
+        appendItem(item);
+        const bool same = isSensor(e.kind) ? item->sense(m_world) == e.answer
+                                           : item->tryExecute(m_world) == ActionResult::ActionOk;
+        if (!same) {
+            delete m_model->takeLast();
+            m_sensors = sensors;
+            break;
+        }
+        // The item is executed already, so a flush of the sensors must not execute it again.
+        m_index = m_model->count() - 1;
+        recordTouches(m_index);
+    }
+    flushSensors();
+    selectLastItem();
+    return replayed;
+}
+
+int DebugTraceWidget::currentIndex() const {
+    return m_index;
+}
+
+int DebugTraceWidget::itemCount() const {
+    return m_model->count();
+}
+
+void DebugTraceWidget::seek(int index) {
+    assert(index >= 0 && index < m_model->count() && "DebugTraceWidget::seek: index out of range.");
+    setCurrentRow(index);
+}
+
+void DebugTraceWidget::seekToEnd() {
+    seek(m_model->count() - 1);
+}
+
+WorldSnapshot DebugTraceWidget::startSnapshot() {
+    // The keyframe of the first item is the world before it.
+    WorldSnapshot start;
+    if (m_model->keyframeBefore(0, &start) == 0)
+        return start;
+    // Reverse to the start and come back with a snapshot, quietly: the world ends up as it was.
+    // The views are not told, they show the world as it is already.
+    const WorldSnapshot current = m_world->snapshot();
+    const bool emitting = m_world->emitsUpdates();
+    m_world->setEmitUpdates(false);
+    reverseTrace(m_index, 0);
+    start = m_world->snapshot();
+    m_world->restoreSnapshot(current);
+    m_world->setEmitUpdates(emitting, false);
+    return start;
+}
+
+void DebugTraceWidget::executeTrace(int from, int to) {
+    assert(from <= to && "DebugTraceWidget::executeTrace: from should be less than/equal to to.");
+    for (int r = from + 1; r <= to; r++)
+        getDebugItem(r)->execute(m_world);
+}
+
+void DebugTraceWidget::reverseTrace(int from, int to) {
+    assert(from >= to && "DebugTraceWidget::executeTrace: from should be greater than/equal to to.");
+    for (int r = from; r > to; r--)
+        getDebugItem(r)->reverse(m_world);
+}
+
+void DebugTraceWidget::setMemoryBudget(int items) {
+    m_model->setBudget(items);
+}
+
+int DebugTraceWidget::memoryBudget() const {
+    return m_model->budget();
+}
+
+QVector<int> DebugTraceWidget::cellHistory(QPoint p) const {
+    return m_history.rows(m_world->pointToIndex(p));
+}
+
+int DebugTraceWidget::cellHistoryStart() const {
+    return m_history.firstRow();
+}
+
+QString DebugTraceWidget::itemText(int index) const {
+    return getDebugItem(index)->data(Qt::DisplayRole).toString();
+}
+
+int DebugTraceWidget::branchCount() const {
+    return m_branches.size();
+}
+
+int DebugTraceWidget::currentBranch() const {
+    return m_branch;
+}
+
+void DebugTraceWidget::switchToBranch(int branch) {
+    assert(branch >= 0 && branch < m_branches.size() && "DebugTraceWidget::switchToBranch: branch out of range.");
+    if (branch == m_branch)
+        return;
+    const int shared = sharedItems(m_branch, branch);
+    const int oldIndex = m_index;
+    m_branches[m_branch].snapshot = m_world->snapshot();
+    m_branches[m_branch].snapshotIndex = m_index;
+
+    // Nothing is executed while the list changes, the world is restored at the end.
+    m_tracingEnabled = false;
+    // Put the items after shared aside, from the end of the list back, each in the branch that owns it.
+    const QVector<int> oldPath = branchPath(m_branch);
+    for (int j = oldPath.size() - 1; j >= 0 && m_model->count() > shared + 1; --j) {
+        Branch &b = m_branches[oldPath[j]];
+        const int first = qMax(b.forkIndex + 1, shared + 1);
+        m_model->putAside(oldPath[j], first);
+        b.putAsideTouches = m_history.takeFrom(first) + b.putAsideTouches;
+    }
+    // Show the rest of the new path, each branch up to the fork of the next one.
+    const QVector<int> newPath = branchPath(branch);
+    for (int j = 0; j < newPath.size(); ++j) {
+        Branch &b = m_branches[newPath[j]];
+        const int count = j + 1 < newPath.size() ? m_branches[newPath[j + 1]].forkIndex + 1 - m_model->count()
+                                                 : m_model->asideCount(newPath[j]);
+        if (count <= 0)
+            continue;
+        // The items go back to their rows, with the keyframes of their segments. Spilled ones are not read.
+        m_model->restoreAside(newPath[j], count);
+        int touches = 0;
+        while (touches < b.putAsideTouches.size() && b.putAsideTouches[touches].row < m_model->count())
+            ++touches;
+        m_history.restore(b.putAsideTouches.mid(0, touches));
+        b.putAsideTouches.remove(0, touches);
+    }
+
+    m_branch = branch;
+    Branch &b = m_branches[branch];
+    if (b.snapshot.fields) {
+        m_world->restoreSnapshot(b.snapshot);
+        m_index = b.snapshotIndex;
+        b.snapshot = WorldSnapshot();
+    }
+    else {
+        // A new branch, it starts where the world is.
+        assert(oldIndex <= shared && "DebugTraceWidget::switchToBranch: a branch without snapshot must start at the current item.");
+        m_index = oldIndex;
+    }
+    setCurrentRow(m_index);
+    m_tracingEnabled = true;
+    updateBranchBox();
+}
+
+void DebugTraceWidget::selectIndexChanged(int newIndex) {
+    WorldSnapshot keyframe;
+    // Far back, the last keyframe before newIndex may be closer than the current item.
+    const int keyRow = m_tracingEnabled && m_index - newIndex > TraceModel::SEGMENT_SIZE
+                           ? m_model->keyframeBefore(newIndex, &keyframe) : -1;
+    if (m_tracingEnabled && m_index < newIndex)
+        executeTrace(m_index, newIndex);
+    else if (keyRow != -1 && newIndex - keyRow < m_index - newIndex) {
+        // The keyframe is the world before keyRow.
+        m_world->restoreSnapshot(keyframe);
+        executeTrace(keyRow - 1, newIndex);
+    }
+    else if(m_tracingEnabled)
+        reverseTrace(m_index, newIndex);
+    m_index = newIndex;
+}
+
+void DebugTraceWidget::branchFromCurrentIndex() {
+    // At the end there is nothing to keep, the program simply continues.
+    if (m_index == m_model->count() - 1)
+        return;
+    // The new branch forks off the branch that owns the current item, which may be an ancestor of the current one.
+    int parent = 0;
+    for (int b : branchPath(m_branch)) {
+        if (m_branches[b].forkIndex < m_index)
+            parent = b;
+    }
+    m_branches.push_back(Branch{parent, m_index, {}, 0});
+    switchToBranch(m_branches.size() - 1);
+}
+
+void DebugTraceWidget::clearDebugTrace() {
+    m_tracingEnabled = false;
+    m_index = 0;
+    m_model->dropAside();
+    m_model->truncate(1);
+    // "Start of Program" stays, with the new world as its keyframe.
+    m_model->setKeyframe(0, m_world->snapshot());
+    m_branches = {Branch{-1, 0, {}, 0}};
+    m_branch = 0;
+    m_sensors.clear();
+    m_history.clear();
+    updateBranchBox();
+    m_tracingEnabled = true;
+}
+
+int DebugTraceWidget::tracedRobot() const {
+    return m_world->robotCount() > 1 ? m_world->selectedRobot() : NO_ROBOT;
+}
+
+void DebugTraceWidget::selectLastItem() {
+    m_tracingEnabled = false;
+    setCurrentRow(m_model->count() - 1);
+    m_tracingEnabled = true;
+}
+
+void DebugTraceWidget::recordTouches(int row) {
+    const PinnedItem item = getDebugItem(row);
+    if (item->debugKind == DebugKind::Tick) {
+        // Robots that stepped or put or took a ball, their actions are in the order of the robots.
+        const QVector<RobotAction> actions = item->event().tickActions;
+        for (int i = 0; i < item->tickResults().size(); ++i) {
+            const RobotAction a = actions[i];
+            const bool touches = a == RobotAction::StepAction || a == RobotAction::PutBallAction || a == RobotAction::GetBallAction;
+            if (touches && item->tickResults()[i] == ActionResult::ActionOk)
+                m_history.add(m_world->pointToIndex(m_world->robots()[i].pos), row);
+        }
+        return;
+    }
+    if (item->debugKind != DebugKind::Step && item->debugKind != DebugKind::PutBall && item->debugKind != DebugKind::GetBall)
+        return;
+    const QPoint pos = item->robot == NO_ROBOT ? m_world->getCharlesPos()
+                                               : m_world->robots()[m_world->robotIndex(item->robot)].pos;
+    m_history.add(m_world->pointToIndex(pos), row);
+}
+
+QBitArray DebugTraceWidget::takeSensors(int robot) {
+    if (!m_sensors.isEmpty() && robot != m_sensorRobot)
+        flushSensors();
+    QBitArray sensors;
+    sensors.swap(m_sensors);
+    return sensors;
+}
+
+QVector<int> DebugTraceWidget::branchPath(int branch) const {
+    QVector<int> path;
+    for (int b = branch; b != -1; b = m_branches[b].parent)
+        path.push_front(b);
+    return path;
+}
+
+int DebugTraceWidget::sharedItems(int a, int b) const {
+    const QVector<int> pathA = branchPath(a), pathB = branchPath(b);
+    int j = 0;
+    while (j + 1 < pathA.size() && j + 1 < pathB.size() && pathA[j + 1] == pathB[j + 1])
+        ++j;
+    // pathA[j] is the last common branch, the paths part at the first fork below it.
+    if (j + 1 == pathA.size())
+        return m_branches[pathB[j + 1]].forkIndex;
+    if (j + 1 == pathB.size())
+        return m_branches[pathA[j + 1]].forkIndex;
+    return qMin(m_branches[pathA[j + 1]].forkIndex, m_branches[pathB[j + 1]].forkIndex);
+}
+
+void DebugTraceWidget::updateBranchBox() {
+    QSignalBlocker blocker(m_branchBox);
+    m_branchBox->clear();
+    m_branchBox->addItem("Original Trace");
+    for (int b = 1; b < m_branches.size(); ++b)
+        m_branchBox->addItem(QString("Branch %1 (from item %2)").arg(b).arg(m_branches[b].forkIndex));
+    m_branchBox->setCurrentIndex(m_branch);
+    m_branchBox->setVisible(m_branches.size() > 1);
+}
+
+void DebugTraceWidget::setupUi() {
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(m_branchBox = new QComboBox(this));
+    layout->addWidget(m_button = new QPushButton("Continue From Here", this));
+    m_button->setToolTip("Continue the program from the selected item. The items after it are kept in their own branch.");
+    layout->addWidget(m_view = new QListView(this));
+    // Otherwise the view asks every item for its size, which reads the whole trace back from disk.
+    m_view->setUniformItemSizes(true);
+    m_view->setModel(m_model);
+    setLayout(layout);
+}
+
+PinnedItem DebugTraceWidget::getDebugItem(int index) const {
+    return PinnedItem(m_model, index);
+}
+
+void DebugTraceWidget::appendItem(DebugTraceItem *item) {
+    const int row = m_model->count();
+    m_model->append(item);
+    if (TraceModel::isSegmentStart(row))
+        m_model->setKeyframe(row, m_world->snapshot());
+}
+
+void DebugTraceWidget::setCurrentRow(int row) {
+    m_view->setCurrentIndex(m_model->index(row));
+}
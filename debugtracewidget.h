@@ -1,57 +1,199 @@
-#pragma once
-
-#include <QWidget>
-#include <QListWidget>
-#include <QPushButton>
-
-#include "debugtraceitem.h"
-
-/*
- * This class represents the execution trace of Charles.
- * If Charles does something, a DebugTraceItem will be appended to this list.
- * Because of this one to one correspondance, all charles actions will be
- * passed through this debug trace.
- *
- * The grand scheme of charles programs is then as follows:
- *
- * 1. Action gets called ->
- * 2. Appended to debug trace (this updates the current index) ->
- * 3. Current index is changed ->
- * 4. Debug trace item inspected to determine change (previous vs current index) ->
- * 5. World is updated ->
- * 6. Signal is emited and caught by worldwidget ->
- * 7. UI is updated.
- *
- * If the user wants to inspect execution, (s)he can just scroll / click in the
- * debug trace, and steps 3-7 still hold.
- */
-
-class DebugTraceWidget : public QWidget
-{
-    Q_OBJECT
-public:
-    DebugTraceWidget(QWidget* parent, WorldObject *world);
-
-    // Add at the end.
-    void addDebugItem(DebugKind k, const QString& text ="", bool rethrow=true);
-    // Execute debug trace items (from ... to].
-    void executeTrace(int from, int to);
-    // Reverse debug trace items (to ... from].
-    void reverseTrace(int from, int to);
-
-private slots:
-    void selectIndexChanged(int newIndex);
-    // Remove all debug items after (excluding) m_index.
-    void removeFromCurrentIndex();
-    void clearDebugTrace();
-
-private:
-    void setupUi();
-    const DebugTraceItem *getDebugItem(int index) const;
-
-    WorldObject *m_world;
-    QListWidget *m_listWidget;
-    QPushButton *m_button;
-    int m_index = 0;
-    bool m_tracingEnabled = true;
-};
+#pragma once
+
+#include <QWidget>
+#include <QListView>
+#include <QPushButton>
+#include <QComboBox>
+#include <climits>
+#include <memory>
+
+#include "debugtraceitem.h"
+#include "tracemodel.h"
+#include "cellhistory.h"
+
+/*
+ * This class represents the execution trace of Charles.
+ * If Charles does something, a DebugTraceItem will be appended to this list.
+ * Because of this one to one correspondance, all charles actions will be
+ * passed through this debug trace.
+ *
+ * The grand scheme of charles programs is then as follows:
+ *
+ * 1. Action gets called ->
+ * 2. Appended to debug trace (this updates the current index) ->
+ * 3. Current index is changed ->
+ * 4. Debug trace item inspected to determine change (previous vs current index) ->
+ * 5. World is updated ->
+ * 6. Signal is emited and caught by worldwidget ->
+ * 7. UI is updated.
+ *
+ * If the user wants to inspect execution, (s)he can just scroll / click in the
+ * debug trace, and steps 3-7 still hold.
+ *
+ * Branches: "Continue From Here" in the middle of the trace does not throw the rest away, it starts a new
+ * branch at the current item. The trace is a tree: a branch shares the items up to its fork point with its parent
+ * and only owns the items after it. The list shows the path of the current branch, the items of the other
+ * branches are put aside. When a branch is left a snapshot of the world is taken (see WorldObject::snapshot),
+ * so switching back restores the world in about the time of the changes, instead of replaying the trace.
+ *
+ * Folding sensors: programs ask on_ball() and in_front_of_wall() more often than they act. With folding on, a query
+ * gets no item of its own: its answer is kept in two bits and folded into the next item (see
+ * DebugTraceItem::setFoldedSensors). The recorded events stay the same, events() unfolds them.
+ *
+ * Memory: the items live in a TraceModel, which spills the ones that were not looked at for a while to disk once
+ * there are more than its budget (see setMemoryBudget). Every segment of items starts with a keyframe, a snapshot of
+ * the world before it, so seeking far back restores the keyframe and executes forward instead of reversing
+ * everything in between.
+ *
+ * Cell history: every item that steps onto a field or puts or takes a ball on it is indexed by that field (see
+ * CellHistory), so the items that touched a field are found without searching the trace (see cellHistory()).
+ *
+ * Parking: a trace whose session is not shown hands its model over (see park()), spilled items stay on disk.
+ * A new widget shows them again without executing anything.
+ */
+
+class DebugTraceWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    struct Branch {
+        int parent;
+        // Last item shared with the parent (0 for the first branch: "Start of Program").
+        int forkIndex;
+        // World at item snapshotIndex when the branch was left, no fields if it was never left.
+        WorldSnapshot snapshot;
+        int snapshotIndex = 0;
+        // The cell history of the put aside items. The items are aside in the model, under the index of the branch.
+        QVector<CellTouch> putAsideTouches;
+    };
+    // The items and branches of a trace without a widget. Owns the items.
+    struct Parked {
+        Parked() = default;
+        Parked(const Parked&) = delete;
+        Parked &operator=(const Parked&) = delete;
+
+        // The items of the list, "Start of Program" first.
+        std::unique_ptr<TraceModel> model;
+        CellHistory history;
+        QVector<Branch> branches;
+        int branch = 0;
+        int index = 0;
+        // Folded sensor queries that still wait for the next item.
+        QBitArray sensors;
+        int sensorRobot = NO_ROBOT;
+    };
+
+    // A new trace, or the trace that was parked. The world must still be as it was when it was parked.
+    DebugTraceWidget(QWidget* parent, WorldObject *world, std::unique_ptr<Parked> parked = nullptr);
+
+    // Take the items and branches out of the widget, the world stays at the current item.
+    // The widget is empty afterwards and has to be deleted.
+    std::unique_ptr<Parked> park();
+
+    // Add at the end.
+    void addDebugItem(DebugKind k, const QString& text ="", bool rethrow=true);
+    // Add at the end without exceptions. A failing action is traced as an Error item
+    // and its result is returned, the world is left untouched in that case.
+    ActionResult tryAddDebugItem(DebugKind k, const QString& text ="");
+    // Add a tick at the end, actions[i] belongs to the i-th robot. Returns the result per robot.
+    QVector<ActionResult> addTick(const QVector<RobotAction>& actions);
+    // Add a sensor item (OnBall, InFrontOfWall) with its answer at the end. With folding on, the query waits
+    // for the next item instead.
+    void addSensorItem(DebugKind k, bool answer);
+    // Fold sensor queries into the item after them, off by default. Turning it off flushes the waiting queries.
+    void setFoldingSensors(bool on);
+    // Add an item for the queries that wait for a next item, e.g. at the end of a program.
+    void flushSensors();
+
+    // Add a recorded Message or Error event at the end, for the robot it was recorded for.
+    void addRecordedItem(const TraceEvent& e);
+
+    // Returns the first limit recorded events of the trace (without the "Start of Program" item).
+    QVector<TraceEvent> events(int limit = INT_MAX) const;
+    // Returns the number of recorded events.
+    int eventCount() const;
+    // Returns the item before event: the world is there as it was before the event.
+    int itemBeforeEvent(int event) const;
+    // Append and execute recorded events until the first one that turns out different on the current world:
+    // a sensor with another answer, an action that fails or a recorded error.
+    // Returns the number of events that were replayed.
+    int replayEvents(const QVector<TraceEvent>& events);
+    // Returns the index of the current item, the world is in the state after it.
+    int currentIndex() const;
+    // Returns the number of items, including "Start of Program".
+    int itemCount() const;
+    // Move to item index, executing or reversing the items in between.
+    void seek(int index);
+    // Execute the trace up to its last item.
+    void seekToEnd();
+    // Returns the world as it was before the first item, the current item stays the same.
+    WorldSnapshot startSnapshot();
+    // Execute debug trace items (from ... to].
+    void executeTrace(int from, int to);
+    // Reverse debug trace items (to ... from].
+    void reverseTrace(int from, int to);
+
+    // Number of items kept in memory, the others are spilled to disk (see TraceModel).
+    void setMemoryBudget(int items);
+    int memoryBudget() const;
+
+    // Returns the indexes of the items that stepped onto p or put or took a ball on it, in trace order.
+    QVector<int> cellHistory(QPoint p) const;
+    // Returns the first index the cell history knows about, the oldest touches of a long trace are forgotten.
+    int cellHistoryStart() const;
+    // Returns the text of item index, as the list shows it.
+    QString itemText(int index) const;
+
+    // Returns the number of branches, the first one is the original trace.
+    int branchCount() const;
+    int currentBranch() const;
+    // Show branch, the world goes to the item that was current when the branch was left.
+    void switchToBranch(int branch);
+
+signals:
+    // An item that was added by a command of a program is double clicked, site is its place in the program.
+    void sourceRequested(int site);
+
+private slots:
+    void selectIndexChanged(int newIndex);
+    // Start a new branch at m_index, if there are items after it.
+    void branchFromCurrentIndex();
+    void clearDebugTrace();
+
+private:
+    void setupUi();
+    // The item stays in memory while it is held.
+    PinnedItem getDebugItem(int index) const;
+    // Add item at the end of the list. The world must be as after the last item, a new segment takes its keyframe.
+    void appendItem(DebugTraceItem *item);
+    // Make row the current item, the world follows (unless tracing is disabled).
+    void setCurrentRow(int row);
+    // Returns the robot to record in new items: the selected robot if there are several, NO_ROBOT otherwise.
+    int tracedRobot() const;
+    // Move the current index to the last item without executing anything.
+    void selectLastItem();
+    // Add the fields that item row touched to the cell history, the world must be right after the item.
+    void recordTouches(int row);
+    // Returns the waiting sensor queries to fold into a new item of robot. Queries of another robot get an item first.
+    QBitArray takeSensors(int robot);
+    // Returns the branches from the first one down to branch.
+    QVector<int> branchPath(int branch) const;
+    // Returns the last item that the paths of branches a and b have in common.
+    int sharedItems(int a, int b) const;
+    void updateBranchBox();
+
+    WorldObject *m_world;
+    TraceModel *m_model;
+    QListView *m_view;
+    QPushButton *m_button;
+    QComboBox *m_branchBox;
+    QVector<Branch> m_branches;
+    int m_branch = 0;
+    int m_index = 0;
+    bool m_tracingEnabled = true;
+    // Sensor queries of m_sensorRobot that wait for the next item (see appendSensorQuery).
+    bool m_foldSensors = false;
+    QBitArray m_sensors;
+    int m_sensorRobot = NO_ROBOT;
+    CellHistory m_history;
+};
@@ -0,0 +1,226 @@
+#include "fieldstorage.h"
+
+#include <cstring>
+
+FieldStorage::FieldStorage(QSize size)
+    : m_size(size)
+{
+    assert(size.width() > 0 && size.height() > 0 && "FieldStorage::FieldStorage: size must be positive.");
+}
+
+QSize FieldStorage::size() const {
+    return m_size;
+}
+
+qint64 FieldStorage::pointToIndex(QPoint p) const {
+    return static_cast<qint64>(p.y()) * m_size.width() + p.x();
+}
+
+Field FieldStorage::defaultField(QPoint p) const {
+    if (p.y() == 0 || p.y() == m_size.height() - 1 || p.x() == 0 || p.x() == m_size.width() - 1)
+        return Field::Wall;
+    return Field::Empty;
+}
+
+QVector<QPoint> FieldStorage::differences(const FieldStorage &other) const {
+    assert(other.size() == m_size && "FieldStorage::differences: other must have the same size.");
+    QVector<QPoint> points;
+    QVector<quint8> row(m_size.width()), otherRow(m_size.width());
+    for (int y = 0; y < m_size.height(); ++y) {
+        readRow(y, row.data());
+        other.readRow(y, otherRow.data());
+        if (memcmp(row.constData(), otherRow.constData(), m_size.width()) == 0)
+            continue;
+        for (int x = 0; x < m_size.width(); ++x) {
+            if (row[x] != otherRow[x])
+                points.push_back(QPoint(x, y));
+        }
+    }
+    return points;
+}
+
+void FieldStorage::fill(const QRect &rect, Field f) {
+    assert(QRect(QPoint(0, 0), m_size).contains(rect) && "FieldStorage::fill: rect must lie within size().");
+    const QVector<quint8> row(rect.width(), f);
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        writeRow(y, rect.left(), row.constData(), rect.width());
+}
+
+FieldStorage *FieldStorage::create(QSize size, StorageKind kind) {
+    if (kind == StorageKind::AutomaticStorage)
+        kind = static_cast<qint64>(size.width()) * size.height() > DENSE_FIELD_LIMIT ? StorageKind::TiledStorage : StorageKind::DenseStorage;
+    if (kind == StorageKind::TiledStorage)
+        return new TiledFieldStorage(size);
+    return new DenseFieldStorage(size);
+}
+
+/*
+ * DENSE STORAGE
+ */
+
+DenseFieldStorage::DenseFieldStorage(QSize size)
+    : FieldStorage(size)
+{
+    m_fields.reserve(static_cast<qint64>(size.width()) * size.height());
+    for (int y = 0; y < m_size.height(); ++y) {
+        for (int x = 0; x < m_size.width(); ++x)
+            m_fields.push_back(defaultField(QPoint(x, y)));
+    }
+}
+
+Field DenseFieldStorage::get(QPoint p) const {
+    return static_cast<Field>(m_fields[pointToIndex(p)]);
+}
+
+void DenseFieldStorage::set(QPoint p, Field f) {
+    m_fields[pointToIndex(p)] = f;
+}
+
+qint64 DenseFieldStorage::memoryUsage() const {
+    return m_fields.size();
+}
+
+StorageKind DenseFieldStorage::kind() const {
+    return StorageKind::DenseStorage;
+}
+
+FieldStorage *DenseFieldStorage::clone() const {
+    return new DenseFieldStorage(*this);
+}
+
+void DenseFieldStorage::readRow(int y, quint8 *out) const {
+    memcpy(out, m_fields.constData() + pointToIndex(QPoint(0, y)), m_size.width());
+}
+
+void DenseFieldStorage::writeRow(int y, int x, const quint8 *fields, int count) {
+    memcpy(m_fields.data() + pointToIndex(QPoint(x, y)), fields, count);
+}
+
+QVector<QPoint> DenseFieldStorage::differences(const FieldStorage &other) const {
+    // Still shared: neither was written to since the clone.
+    const DenseFieldStorage *dense = dynamic_cast<const DenseFieldStorage*>(&other);
+    if (dense && dense->m_fields.constData() == m_fields.constData())
+        return {};
+    return FieldStorage::differences(other);
+}
+
+/*
+ * TILED STORAGE
+ */
+
+TiledFieldStorage::TiledFieldStorage(QSize size)
+    : FieldStorage(size),
+    m_tilesPerRow((size.width() + TILE_MASK) >> TILE_SHIFT)
+{
+    const qint64 tileRows = (size.height() + TILE_MASK) >> TILE_SHIFT;
+    m_tiles.resize(tileRows * m_tilesPerRow);
+}
+
+Field TiledFieldStorage::get(QPoint p) const {
+    const QVector<quint8> &tile = m_tiles[tileIndex(p)];
+    if (tile.isEmpty())
+        return defaultField(p);
+    return static_cast<Field>(tile[indexInTile(p)]);
+}
+
+void TiledFieldStorage::set(QPoint p, Field f) {
+    const qint64 t = tileIndex(p);
+    if (m_tiles[t].isEmpty()) {
+        if (f == defaultField(p))
+            return;
+        allocateTile(t, p);
+    }
+    m_tiles[t][indexInTile(p)] = f;
+}
+
+qint64 TiledFieldStorage::memoryUsage() const {
+    return m_tiles.size() * static_cast<qint64>(sizeof(QVector<quint8>)) + m_allocatedTiles * TILE_SIZE * TILE_SIZE;
+}
+
+StorageKind TiledFieldStorage::kind() const {
+    return StorageKind::TiledStorage;
+}
+
+FieldStorage *TiledFieldStorage::clone() const {
+    return new TiledFieldStorage(*this);
+}
+
+void TiledFieldStorage::readRow(int y, quint8 *out) const {
+    for (int x = 0; x < m_size.width(); x += TILE_SIZE) {
+        const int count = qMin(TILE_SIZE, m_size.width() - x);
+        const QVector<quint8> &tile = m_tiles[tileIndex(QPoint(x, y))];
+        if (!tile.isEmpty())
+            memcpy(out + x, tile.constData() + indexInTile(QPoint(x, y)), count);
+        else {
+            for (int i = 0; i < count; ++i)
+                out[x + i] = defaultField(QPoint(x + i, y));
+        }
+    }
+}
+
+void TiledFieldStorage::writeRow(int y, int x, const quint8 *fields, int count) {
+    const int end = x + count;
+    while (x < end) {
+        // The part of the row in the tile of x.
+        const int n = qMin(end, ((x >> TILE_SHIFT) + 1) << TILE_SHIFT) - x;
+        const qint64 t = tileIndex(QPoint(x, y));
+        bool write = !m_tiles[t].isEmpty();
+        for (int i = 0; i < n && !write; ++i)
+            write = fields[i] != defaultField(QPoint(x + i, y));
+        if (write) {
+            if (m_tiles[t].isEmpty())
+                allocateTile(t, QPoint(x, y));
+            memcpy(m_tiles[t].data() + indexInTile(QPoint(x, y)), fields, n);
+        }
+        fields += n;
+        x += n;
+    }
+}
+
+QVector<QPoint> TiledFieldStorage::differences(const FieldStorage &other) const {
+    const TiledFieldStorage *tiled = dynamic_cast<const TiledFieldStorage*>(&other);
+    if (!tiled)
+        return FieldStorage::differences(other);
+    assert(other.size() == m_size && "TiledFieldStorage::differences: other must have the same size.");
+    // Only tiles that were written to since the clone are compared.
+    QVector<QPoint> points;
+    for (qint64 t = 0; t < m_tiles.size(); ++t) {
+        const QVector<quint8> &tile = m_tiles[t], &otherTile = tiled->m_tiles[t];
+        if (tile.isEmpty() && otherTile.isEmpty())
+            continue;
+        if (!tile.isEmpty() && tile.constData() == otherTile.constData())
+            continue;
+        const QPoint origin(static_cast<int>(t % m_tilesPerRow) << TILE_SHIFT, static_cast<int>(t / m_tilesPerRow) << TILE_SHIFT);
+        for (int y = origin.y(); y < qMin(origin.y() + TILE_SIZE, m_size.height()); ++y) {
+            for (int x = origin.x(); x < qMin(origin.x() + TILE_SIZE, m_size.width()); ++x) {
+                if (get(QPoint(x, y)) != tiled->get(QPoint(x, y)))
+                    points.push_back(QPoint(x, y));
+            }
+        }
+    }
+    return points;
+}
+
+qint64 TiledFieldStorage::allocatedTiles() const {
+    return m_allocatedTiles;
+}
+
+qint64 TiledFieldStorage::tileIndex(QPoint p) const {
+    return static_cast<qint64>(p.y() >> TILE_SHIFT) * m_tilesPerRow + (p.x() >> TILE_SHIFT);
+}
+
+int TiledFieldStorage::indexInTile(QPoint p) {
+    return ((p.y() & TILE_MASK) << TILE_SHIFT) + (p.x() & TILE_MASK);
+}
+
+void TiledFieldStorage::allocateTile(qint64 t, QPoint p) {
+    const QPoint origin((p.x() >> TILE_SHIFT) << TILE_SHIFT, (p.y() >> TILE_SHIFT) << TILE_SHIFT);
+    QVector<quint8> &tile = m_tiles[t];
+    tile.resize(TILE_SIZE * TILE_SIZE);
+    // Points of the tile outside of the world are never read, any value will do.
+    for (int y = 0; y < TILE_SIZE; ++y) {
+        for (int x = 0; x < TILE_SIZE; ++x)
+            tile[(y << TILE_SHIFT) + x] = defaultField(origin + QPoint(x, y));
+    }
+    ++m_allocatedTiles;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QVector>
+#include <QSize>
+#include <QPoint>
+#include <QRect>
+
+/*
+ * Storage backends for the fields of a WorldObject.
+ * Both backends start out as an empty world: walls on the boundary, empty fields inside.
+ *
+ * - DenseFieldStorage keeps one byte per field in a single array. Fast and simple, used for normal worlds.
+ * - TiledFieldStorage splits the world in square tiles that are only allocated on the first write
+ *   of a field that differs from its default. Large open worlds with a few walls and balls only pay
+ *   for the tiles they touch, so worlds of 100k x 100k fit in a few hundred MB.
+ *
+ * Indices are 64 bit, so width * height may exceed the int range.
+ */
+
+enum Field { Wall, Empty, Ball };
+
+enum StorageKind { AutomaticStorage, DenseStorage, TiledStorage };
+
+class FieldStorage
+{
+public:
+    explicit FieldStorage(QSize size);
+    virtual ~FieldStorage() = default;
+
+    // Returns the Field at position p. p must lie within size().
+    virtual Field get(QPoint p) const = 0;
+    // Set the Field at position p. p must lie within size().
+    virtual void set(QPoint p, Field f) = 0;
+    // Returns the (approximate) number of bytes used for the fields.
+    virtual qint64 memoryUsage() const = 0;
+    virtual StorageKind kind() const = 0;
+    // Returns a copy. The fields are shared until either storage is written to, so copies are cheap.
+    virtual FieldStorage *clone() const = 0;
+    // Copy the fields of row y to out, which holds size().width() fields.
+    virtual void readRow(int y, quint8 *out) const = 0;
+    // Write count fields to row y, starting at x. The fields must lie within size().
+    virtual void writeRow(int y, int x, const quint8 *fields, int count) = 0;
+    // Set all fields of rect to f, row by row. rect must lie within size().
+    void fill(const QRect& rect, Field f);
+    // Returns the points where other (of the same size) has another field. Parts that are still shared
+    // with a clone are skipped, so comparing a clone costs about as much as the writes since the clone.
+    virtual QVector<QPoint> differences(const FieldStorage& other) const;
+
+    // Size of the storage. Includes the surrounding ring of walls.
+    QSize size() const;
+    // Returns index for a 1D array: y * width + x.
+    qint64 pointToIndex(QPoint p) const;
+    // Returns the field a point has before anything is written: a wall on the boundary, empty otherwise.
+    Field defaultField(QPoint p) const;
+
+    // Creates a storage of the given kind. AutomaticStorage picks dense storage
+    // unless the world has more than DENSE_FIELD_LIMIT fields.
+    static FieldStorage *create(QSize size, StorageKind kind = AutomaticStorage);
+    constexpr static qint64 DENSE_FIELD_LIMIT = 16 * 1024 * 1024;
+
+protected:
+    QSize m_size;
+};
+
+class DenseFieldStorage : public FieldStorage
+{
+public:
+    explicit DenseFieldStorage(QSize size);
+
+    Field get(QPoint p) const override;
+    void set(QPoint p, Field f) override;
+    qint64 memoryUsage() const override;
+    StorageKind kind() const override;
+    FieldStorage *clone() const override;
+    void readRow(int y, quint8 *out) const override;
+    void writeRow(int y, int x, const quint8 *fields, int count) override;
+    QVector<QPoint> differences(const FieldStorage& other) const override;
+
+private:
+    QVector<quint8> m_fields;
+};
+
+class TiledFieldStorage : public FieldStorage
+{
+public:
+    explicit TiledFieldStorage(QSize size);
+
+    Field get(QPoint p) const override;
+    void set(QPoint p, Field f) override;
+    qint64 memoryUsage() const override;
+    StorageKind kind() const override;
+    FieldStorage *clone() const override;
+    void readRow(int y, quint8 *out) const override;
+    // Parts of tiles that are not allocated and only get their default fields are skipped.
+    void writeRow(int y, int x, const quint8 *fields, int count) override;
+    QVector<QPoint> differences(const FieldStorage& other) const override;
+
+    // Number of tiles that are allocated.
+    qint64 allocatedTiles() const;
+
+    // Tiles are TILE_SIZE x TILE_SIZE fields.
+    constexpr static int TILE_SHIFT = 7;
+    constexpr static int TILE_SIZE = 1 << TILE_SHIFT;
+    constexpr static int TILE_MASK = TILE_SIZE - 1;
+
+private:
+    // Returns the index of the tile containing p.
+    qint64 tileIndex(QPoint p) const;
+    // Returns the index of p inside its tile.
+    static int indexInTile(QPoint p);
+    // Allocate tile t, filled with the default fields of its points.
+    void allocateTile(qint64 t, QPoint p);
+
+    int m_tilesPerRow;
+    // Unallocated tiles are empty vectors.
+    QVector<QVector<quint8>> m_tiles;
+    qint64 m_allocatedTiles = 0;
+};
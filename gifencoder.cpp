@@ -0,0 +1,180 @@
+#include "gifencoder.h"
+
+#include <QVector>
+
+// Levels per color channel of the palette, 6 * 6 * 6 = 216 colors.
+const static int LEVELS = 6;
+const static int MAX_CODES = 4096;
+// Size of the LZW hash table, a prime well above MAX_CODES.
+const static int HASH_SIZE = 5003;
+
+static void appendWord(QByteArray &out, int value) {
+    out.append(char(value & 0xff));
+    out.append(char((value >> 8) & 0xff));
+}
+
+// Returns the palette index of the closest color of the cube.
+static quint8 paletteIndex(QRgb c) {
+    auto level = [](int v) { return (v * (LEVELS - 1) + 127) / 255; };
+    return quint8(level(qRed(c)) * LEVELS * LEVELS + level(qGreen(c)) * LEVELS + level(qBlue(c)));
+}
+
+/*
+ * LZW compression of the pixel indices, as in the classic compress / GIF encoders:
+ * codes of growing width (9 to 12 bits), a clear code when the table is full.
+ */
+class LzwWriter
+{
+public:
+    explicit LzwWriter(QByteArray &out)
+        : m_out(out),
+        m_hashKeys(HASH_SIZE, -1),
+        m_hashCodes(HASH_SIZE)
+    {
+    }
+
+    void compress(const QVector<quint8> &pixels) {
+        output(CLEAR);
+        int prefix = pixels.first();
+        for (qsizetype i = 1; i < pixels.size(); ++i) {
+            const int c = pixels[i];
+            const int key = (c << 12) | prefix;
+            // Open addressing with a secondary probe, as in compress.
+            int h = (c << 4) ^ prefix;
+            const int probe = h == 0 ? 1 : HASH_SIZE - h;
+            while (m_hashKeys[h] != -1 && m_hashKeys[h] != key) {
+                h -= probe;
+                if (h < 0)
+                    h += HASH_SIZE;
+            }
+            if (m_hashKeys[h] == key) {
+                prefix = m_hashCodes[h];
+                continue;
+            }
+            output(prefix);
+            prefix = c;
+            if (m_nextCode < MAX_CODES) {
+                m_hashKeys[h] = key;
+                m_hashCodes[h] = m_nextCode++;
+            }
+            else {
+                m_hashKeys.fill(-1);
+                m_nextCode = END + 1;
+                m_clear = true;
+                output(CLEAR);
+            }
+        }
+        output(prefix);
+        output(END);
+        flush();
+    }
+
+private:
+    constexpr static int CLEAR = 256;
+    constexpr static int END = 257;
+
+    void output(int code) {
+        m_bits |= quint32(code) << m_bitCount;
+        m_bitCount += m_codeSize;
+        while (m_bitCount >= 8) {
+            writeByte(m_bits & 0xff);
+            m_bits >>= 8;
+            m_bitCount -= 8;
+        }
+        // The decoder widens its codes one code later than the table grows, so check after the output.
+        if (m_clear) {
+            m_codeSize = 9;
+            m_clear = false;
+        }
+        else if (m_nextCode > (1 << m_codeSize) - 1 && m_codeSize < 12)
+            ++m_codeSize;
+    }
+
+    // Image data is written in sub-blocks of at most 255 bytes.
+    void writeByte(int b) {
+        m_block.append(char(b));
+        if (m_block.size() == 255)
+            writeBlock();
+    }
+
+    void writeBlock() {
+        m_out.append(char(m_block.size()));
+        m_out.append(m_block);
+        m_block.clear();
+    }
+
+    void flush() {
+        if (m_bitCount > 0)
+            writeByte(m_bits & 0xff);
+        m_bits = 0;
+        m_bitCount = 0;
+        if (!m_block.isEmpty())
+            writeBlock();
+        m_out.append(char(0));
+    }
+
+    QByteArray &m_out;
+    QByteArray m_block;
+    QVector<int> m_hashKeys;
+    QVector<int> m_hashCodes;
+    int m_nextCode = END + 1;
+    int m_codeSize = 9;
+    bool m_clear = false;
+    quint32 m_bits = 0;
+    int m_bitCount = 0;
+};
+
+QByteArray GifEncoder::header(QSize size) {
+    QByteArray out("GIF89a");
+    appendWord(out, size.width());
+    appendWord(out, size.height());
+    // Global color table of 256 entries, 8 bits per channel.
+    out.append(char(0xf7));
+    out.append(char(0));
+    out.append(char(0));
+    for (int i = 0; i < 256; ++i) {
+        const int r = i / (LEVELS * LEVELS), g = i / LEVELS % LEVELS, b = i % LEVELS;
+        const bool inCube = i < LEVELS * LEVELS * LEVELS;
+        out.append(char(inCube ? r * 255 / (LEVELS - 1) : 0));
+        out.append(char(inCube ? g * 255 / (LEVELS - 1) : 0));
+        out.append(char(inCube ? b * 255 / (LEVELS - 1) : 0));
+    }
+    // Loop forever (Netscape extension).
+    out.append("\x21\xff\x0bNETSCAPE2.0\x03\x01", 16);
+    appendWord(out, 0);
+    out.append(char(0));
+    return out;
+}
+
+QByteArray GifEncoder::frame(const QImage &image, int delayMsec) {
+    const QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QVector<quint8> pixels;
+    pixels.reserve(qsizetype(rgb.width()) * rgb.height());
+    for (int y = 0; y < rgb.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+        for (int x = 0; x < rgb.width(); ++x)
+            pixels.push_back(paletteIndex(line[x]));
+    }
+
+    QByteArray out;
+    // Graphic control extension: the delay of the frame.
+    out.append("\x21\xf9\x04\x00", 4);
+    appendWord(out, (delayMsec + 5) / 10);
+    out.append(char(0));
+    out.append(char(0));
+    // Image descriptor: the whole screen, global palette.
+    out.append(char(0x2c));
+    appendWord(out, 0);
+    appendWord(out, 0);
+    appendWord(out, rgb.width());
+    appendWord(out, rgb.height());
+    out.append(char(0));
+    // Minimum code size, then the compressed data.
+    out.append(char(8));
+    LzwWriter(out).compress(pixels);
+    return out;
+}
+
+QByteArray GifEncoder::trailer() {
+    return QByteArray(1, char(0x3b));
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+
+/*
+ * Minimal animated GIF (GIF89a) writer, Qt can read GIFs but not write them.
+ *
+ * All frames use one fixed global palette (the 6x6x6 color cube), so frames do not depend on each other
+ * and can be encoded on different threads: write header(), then the frame() blocks in order, then trailer().
+ */
+
+class GifEncoder
+{
+public:
+    // File header with the global palette. The animation loops forever.
+    static QByteArray header(QSize size);
+    // One frame (of the size given to header), shown for delayMsec (rounded to 10 msec).
+    static QByteArray frame(const QImage& image, int delayMsec);
+    static QByteArray trailer();
+};
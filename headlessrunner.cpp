@@ -0,0 +1,169 @@
+#include "headlessrunner.h"
+
+HeadlessRunner::HeadlessRunner(WorldObject *world, quint32 seed, qint64 maxEvents)
+    : m_world(world),
+    m_seed(seed),
+    m_maxEvents(maxEvents)
+{
+}
+
+void HeadlessRunner::setEventSink(EventSink sink) {
+    m_sink = sink;
+}
+
+bool HeadlessRunner::run(const AgentFunction &agent) {
+    m_events = 0;
+    m_fingerprint.reset();
+    m_failed = false;
+    m_error.clear();
+    m_inTick = false;
+    m_sensorNoise.seed(m_seed);
+
+    CommandTarget *previous = commandTarget;
+    commandTarget = this;
+    try {
+        agent();
+    }
+    catch (QException &e) {
+        // Only scripts throw here (see scriptvm.h), commands do not in batch mode.
+        fail(e.what());
+    }
+    endTick();
+    commandTarget = previous;
+    return !m_failed;
+}
+
+bool HeadlessRunner::failed() const {
+    return m_failed;
+}
+
+QString HeadlessRunner::errorMessage() const {
+    return m_error;
+}
+
+qint64 HeadlessRunner::eventCount() const {
+    return m_events;
+}
+
+quint64 HeadlessRunner::fingerprint() const {
+    return m_fingerprint.finish(*m_world);
+}
+
+bool HeadlessRunner::onBall() {
+    return sense(DebugKind::OnBall);
+}
+
+bool HeadlessRunner::inFrontOfWall() {
+    return sense(DebugKind::InFrontOfWall);
+}
+
+void HeadlessRunner::step() {
+    action(DebugKind::Step);
+}
+
+void HeadlessRunner::turnLeft() {
+    action(DebugKind::TurnLeft);
+}
+
+void HeadlessRunner::turnRight() {
+    action(DebugKind::TurnRight);
+}
+
+void HeadlessRunner::getBall() {
+    action(DebugKind::GetBall);
+}
+
+void HeadlessRunner::putBall() {
+    action(DebugKind::PutBall);
+}
+
+void HeadlessRunner::debugMessage(const QString &msg) {
+    if (!m_failed)
+        record(TraceEvent{DebugKind::Message, tracedRobot(), false, msg, {}});
+}
+
+int HeadlessRunner::robotCount() {
+    return m_world->robotCount();
+}
+
+int HeadlessRunner::robotId(int i) {
+    if (i < 0 || i >= m_world->robotCount()) {
+        fail(QString("robot_id: there is no robot with index %1.").arg(i));
+        return m_world->selectedRobot();
+    }
+    return m_world->robots()[i].id;
+}
+
+void HeadlessRunner::selectRobot(int id) {
+    if (m_failed)
+        return;
+    if (m_world->robotIndex(id) == -1)
+        fail(QString("select_robot: there is no robot with id %1.").arg(id));
+    else
+        m_world->selectRobot(id);
+}
+
+void HeadlessRunner::beginTick() {
+    m_inTick = true;
+    m_tickActions = QVector<RobotAction>(m_world->robotCount(), RobotAction::NoAction);
+}
+
+void HeadlessRunner::endTick() {
+    if (!m_inTick)
+        return;
+    m_inTick = false;
+    if (m_failed)
+        return;
+    m_world->tick(m_tickActions);
+    record(TraceEvent{DebugKind::Tick, NO_ROBOT, false, QString(), m_tickActions});
+}
+
+int HeadlessRunner::tracedRobot() const {
+    return m_world->robotCount() > 1 ? m_world->selectedRobot() : NO_ROBOT;
+}
+
+void HeadlessRunner::record(const TraceEvent &e) {
+    if (m_maxEvents >= 0 && m_events >= m_maxEvents) {
+        fail(QString("The program exceeded the limit of %1 actions.").arg(m_maxEvents));
+        return;
+    }
+    ++m_events;
+    m_fingerprint.add(e);
+    if (m_sink)
+        m_sink(e);
+}
+
+bool HeadlessRunner::sense(DebugKind k) {
+    if (m_failed)
+        return m_sensorNoise.bounded(2);
+    const bool answer = (m_world->*SENSOR_FUNCTION[k])();
+    record(TraceEvent{k, tracedRobot(), answer, QString(), {}});
+    return answer;
+}
+
+void HeadlessRunner::action(DebugKind k) {
+    if (m_failed)
+        return;
+    if (m_inTick) {
+        m_tickActions[m_world->robotIndex(m_world->selectedRobot())] = robotAction(k);
+        return;
+    }
+    ActionResult result = (m_world->*TRY_EXECUTE_FUNCTION[k])();
+    if (result == ActionResult::ActionOk)
+        record(TraceEvent{k, tracedRobot(), false, QString(), {}});
+    else
+        fail(WorldObject::actionResultMessage(result));
+}
+
+void HeadlessRunner::fail(const QString &msg) {
+    if (m_failed)
+        return;
+    // The error is always recorded, also when the event limit is reached.
+    ++m_events;
+    const TraceEvent error{DebugKind::Error, tracedRobot(), false, msg, {}};
+    m_fingerprint.add(error);
+    if (m_sink)
+        m_sink(error);
+    m_failed = true;
+    m_error = msg;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QRandomGenerator>
+#include <functional>
+
+#include "commandtarget.h"
+#include "debugtraceitem.h"
+#include "tracefingerprint.h"
+
+/*
+ * Runs student programs on a WorldObject without any UI.
+ * Behaves as a run in batch mode in the MainWindow: after the first error all actions are no-ops and the sensors
+ * return random values (see commands.h). Every command is reported as a TraceEvent to the event sink, the same
+ * events the DebugTraceWidget would record, so a trace can be rebuilt elsewhere. The events are also counted in
+ * a fingerprint of the run (see tracefingerprint.h), so runs can be compared without keeping their traces.
+ */
+
+class HeadlessRunner : public CommandTarget
+{
+public:
+    typedef std::function<void(const TraceEvent&)> EventSink;
+
+    // maxEvents limits the length of the trace, -1 for no limit. Exceeding it counts as an error.
+    explicit HeadlessRunner(WorldObject *world, quint32 seed = SENSOR_NOISE_SEED, qint64 maxEvents = -1);
+
+    void setEventSink(EventSink sink);
+    // Run a program with this runner as the command target. Returns true iff it ended without error.
+    bool run(const AgentFunction& agent);
+
+    // Returns true iff an error occured in the last run.
+    bool failed() const;
+    // Returns the message of the error in the last run.
+    QString errorMessage() const;
+    // Returns the number of events of the last run.
+    qint64 eventCount() const;
+    // Returns the fingerprint of the last run, including the world it ended with.
+    quint64 fingerprint() const;
+
+    bool onBall() override;
+    bool inFrontOfWall() override;
+    void step() override;
+    void turnLeft() override;
+    void turnRight() override;
+    void getBall() override;
+    void putBall() override;
+    void debugMessage(const QString& msg) override;
+
+    int robotCount() override;
+    int robotId(int i) override;
+    void selectRobot(int id) override;
+    void beginTick() override;
+    void endTick() override;
+
+private:
+    // Returns the robot to record in events (see DebugTraceWidget::tracedRobot).
+    int tracedRobot() const;
+    void record(const TraceEvent& e);
+    bool sense(DebugKind k);
+    void action(DebugKind k);
+    // Record an error, after this the run has no effect anymore.
+    void fail(const QString& msg);
+
+    WorldObject *m_world;
+    EventSink m_sink;
+    QRandomGenerator m_sensorNoise;
+    const quint32 m_seed;
+    const qint64 m_maxEvents;
+    qint64 m_events = 0;
+    TraceFingerprint m_fingerprint;
+    bool m_failed = false;
+    QString m_error;
+    bool m_inTick = false;
+    QVector<RobotAction> m_tickActions;
+};
@@ -1,14 +1,18 @@
-#include "mainwindow.h"
-
-#include <QApplication>
-
-MainWindow* mainwindow; // Make mainwindow accessible for commands.h (code smell?)
-
-int main(int argc, char *argv[])
-{
-    QApplication a(argc, argv);
-    MainWindow w;
-    mainwindow = &w;
-    w.show();
-    return a.exec();
-}
+#include "mainwindow.h"
+#include "workerpool.h"
+
+#include <QApplication>
+
+// Number of processes that run programs in the sandbox.
+const int SANDBOX_WORKERS = 2;
+
+int main(int argc, char *argv[])
+{
+    // Fork before Qt starts any threads.
+    WorkerPool::prefork(SANDBOX_WORKERS);
+    QApplication a(argc, argv);
+    MainWindow w;
+    commandTarget = &w; // Make mainwindow accessible for commands.h
+    w.show();
+    return a.exec();
+}
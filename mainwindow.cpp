@@ -1,229 +1,1327 @@
-#include "mainwindow.h"
-#include "worldwidget.h"
-#include "agent.h"
-#include "newworlddialog.h"
-
-#include <QHBoxLayout>
-#include <QPushButton>
-#include <QMenuBar>
-#include <QMenu>
-#include <QAction>
-#include <QToolBar>
-#include <QFileDialog>
-#include <QMessageBox>
-#include <QTimer>
-
-const static QString WORLD_DIRECTORY = "C:/Users/thoma/Documents/Qt/QCharles/worlds";
-
-MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent)
-{
-    setupUI();
-    connect(m_openWorldAction, &QAction::triggered, this, &MainWindow::onOpenWorldAction);
-    connect(m_saveWorldAction, &QAction::triggered, this, &MainWindow::onSaveWorldAction);
-    connect(m_newWorldAction, &QAction::triggered, this, &MainWindow::onNewWorldAction);
-
-    connect(m_stepAction, &QAction::triggered, this, &MainWindow::onStepAction);
-    connect(m_turnLeftAction, &QAction::triggered, this, &MainWindow::onTurnLeftAction);
-    connect(m_turnRightAction, &QAction::triggered, this, &MainWindow::onTurnRightAction);
-    connect(m_getBallAction, &QAction::triggered, this, &MainWindow::onGetBallAction);
-    connect(m_putBallAction, &QAction::triggered, this, &MainWindow::onPutBallAction);
-}
-
-/*
- *  WORLD ACTIONS
- *  With debugging. First execute and debug after. That way failed operations do not get logged.
- */
-
-bool MainWindow::onBall() {
-    bool ret = m_worldWidget->world()->onBall();
-    debugTrace(DebugKind::BoolInfo, QString("onBall? ") + (ret ? "True" : "False"));
-    return ret;
-}
-
-bool MainWindow::inFrontOfWall() {
-    bool ret = m_worldWidget->world()->inFrontOfWall();
-    debugTrace(DebugKind::BoolInfo, QString("inFrontOfWall? ") + (ret ? "True" : "False"));
-    return ret;
-}
-
-void MainWindow::step() {
-    //m_worldWidget->world()->step();
-    debugTrace(DebugKind::Step);
-    m_saved = false;
-}
-
-void MainWindow::turnLeft() {
-    //m_worldWidget->world()->turnLeft();
-    debugTrace(DebugKind::TurnLeft);
-    m_saved = false;
-}
-
-void MainWindow::turnRight() {
-    //m_worldWidget->world()->turnRight();
-    debugTrace(DebugKind::TurnRight);
-    m_saved = false;
-}
-
-void MainWindow::getBall() {
-    //m_worldWidget->world()->getBall();
-    debugTrace(DebugKind::GetBall);
-    m_saved = false;
-}
-
-void MainWindow::putBall() {
-    //m_worldWidget->world()->putBall();
-    debugTrace(DebugKind::PutBall);
-    m_saved = false;
-}
-
-void MainWindow::debugMessage(const QString& msg) {
-    debugTrace(DebugKind::Message, msg);
-}
-
-/*
- *  FILE ACTIONS
- */
-
-void MainWindow::onOpenWorldAction() {
-    askForSave();
-    auto retry = QMessageBox::Yes;
-    QString fileName;
-    while (retry == QMessageBox::Yes) {
-        try {
-            fileName = QFileDialog::getOpenFileName(this, "Open World Configuration File", WORLD_DIRECTORY, "*.txt");
-            if (!fileName.isEmpty()) { // Check if user clicked cancel on window selection.
-                m_worldWidget->world()->loadFromFile(fileName);
-                m_saved = true;
-            }
-            retry = QMessageBox::No;
-        }
-        catch (BadFileFormat& e) {
-            const QString msg = "File: " + fileName + "\nMessage: " + e.what() + "\n\nAn error occured, do you want to try again?";
-            retry = QMessageBox::critical(this, "Invalid File Format", msg, QMessageBox::Yes | QMessageBox::No);
-        }
-    }
-}
-
-void MainWindow::onSaveWorldAction() {
-    QString fileTo = QFileDialog::getSaveFileName(this, "Save World Configuration File", WORLD_DIRECTORY, "*.txt");
-    m_worldWidget->world()->saveToFile(fileTo);
-    m_saved = true;
-}
-
-void MainWindow::onNewWorldAction() {
-    askForSave();
-    NewWorldDialog* dialog = new NewWorldDialog(this);
-    if (dialog->exec() == QDialog::Accepted) {
-        m_worldWidget->world()->makeEmptyWorld(dialog->getDimension(), dialog->getCharlesPoint() + QPoint(1, 1), dialog->getCharlesDirection());
-        m_saved = false;
-    }
-}
-
-void MainWindow::onStepAction() {
-    try {
-        step();
-    }
-    catch(QException& e) {
-        QMessageBox::critical(this, "Error", e.what());
-    }
-}
-
-/*
- *  UI WORLD ACTIONS
- */
-
-void MainWindow::onTurnLeftAction() {
-    turnLeft();
-}
-
-void MainWindow::onTurnRightAction() {
-    turnRight();
-}
-
-void MainWindow::onGetBallAction() {
-    try {
-        getBall();
-    }
-    catch(QException& e) {
-        QMessageBox::critical(this, "Error", e.what());
-    }
-}
-
-void MainWindow::onPutBallAction() {
-    try {
-        putBall();
-    }
-    catch(QException& e) {
-        QMessageBox::critical(this, "Error", e.what());
-    }
-}
-
-/*
- * PRIVATE FUNCTIONS.
- */
-
-void MainWindow::debugTrace(DebugKind k, const QString &msg) {
-    m_debugWidget->addDebugItem(k, msg);
-}
-
-void MainWindow::setupUI() {
-    setupMenuBar();
-    setupToolBar();
-
-    QWidget *central = new QWidget(this);
-    QHBoxLayout *centralLayout = new QHBoxLayout(central);
-    centralLayout->addWidget(m_worldWidget = new WorldWidget(central));
-    centralLayout->setAlignment(m_worldWidget, Qt::AlignTop);
-    centralLayout->addWidget(m_debugWidget = new DebugTraceWidget(central, m_worldWidget->world()));
-    setCentralWidget(central);
-}
-
-void MainWindow::setupMenuBar() {
-    QMenuBar* menubar = new QMenuBar(this);
-
-    // Assign actions to variables and link them too.
-    QMenu* fileMenu = menubar->addMenu("&World");
-    fileMenu->addAction(m_openWorldAction = new QAction("&Open", this));
-    fileMenu->addAction(m_saveWorldAction = new QAction("&Save", this));
-    fileMenu->addAction(m_newWorldAction = new QAction("&New", this));
-
-    // Collect student programmed routines from agent.h.
-    QMenu* progamMenu = menubar->addMenu("&Programs");
-    for (const auto& agent : AGENTS_TABLE) {
-        QAction *a = progamMenu->addAction(agent.first);
-        connect(a, &QAction::triggered, this, [=](){
-            try {
-                m_worldWidget->setUpdatingUI(false);
-                m_debugWidget->setUpdatesEnabled(false);
-                agent.second();
-            }
-            catch (QException& e) {
-                debugTrace(DebugKind::Error, e.what());
-                QMessageBox::critical(this, "Error occured", e.what());
-            }
-            m_worldWidget->setUpdatingUI(true);
-            m_debugWidget->setUpdatesEnabled(true);
-        });
-    }
-
-    setMenuBar(menubar);
-}
-
-void MainWindow::setupToolBar()
-{
-    auto toolBar = addToolBar("Charles Actions");
-    toolBar->addAction(m_stepAction = new QAction("Step", this));
-    toolBar->addAction(m_turnLeftAction = new QAction("Left", this));
-    toolBar->addAction(m_turnRightAction = new QAction("Right", this));
-    toolBar->addAction(m_getBallAction = new QAction("Get Ball", this));
-    toolBar->addAction(m_putBallAction = new QAction("Put Ball", this));
-}
-
-void MainWindow::askForSave() {
-    if (!m_saved) {
-        auto answer = QMessageBox::question(this, "Unsaved changes", "Do you want to save the current file?");
-        if (answer == QMessageBox::Yes)
-            m_saveWorldAction->trigger();
-    }
-}
+#include "mainwindow.h"
+#include "worldwidget.h"
+#include "agent.h"
+#include "newworlddialog.h"
+#include "worlddiff.h"
+#include "renderstats.h"
+#include "worldlibrarywidget.h"
+#include "headlessrunner.h"
+#include "tracediffwindow.h"
+
+#include <QPushButton>
+#include <QMenuBar>
+#include <QMenu>
+#include <QAction>
+#include <QToolBar>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QTimer>
+#include <QStatusBar>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSlider>
+#include <QProgressDialog>
+#include <QLabel>
+#include <QInputDialog>
+#include <QTabWidget>
+#include <QDockWidget>
+#include <QPointer>
+#include <QEventLoop>
+#include <QCursor>
+#include <QDir>
+#include <QEvent>
+#include <cmath>
+#include <algorithm>
+
+// Loading and saving only show a progress dialog when they take longer than this.
+const static int PROGRESS_DELAY_MSEC = 400;
+// Steps of the playback speed slider.
+const static int SPEED_STEPS = 100;
+
+// Name of the local socket (named pipe on Windows) that external agents connect to.
+const static QString COMMAND_SERVER_NAME = "qcharles";
+
+// Programs listed per behaviour group, the rest is counted.
+const static int MAX_GROUP_NAMES = 8;
+
+// The render statistics heartbeat, and how late it must be to count as an event loop stall.
+const static int HEARTBEAT_MSEC = 20;
+const static int STALL_MSEC = 50;
+// The render statistics log, in the temporary directory.
+const static QString RENDER_STATS_LOG = "qcharles-render-stats.csv";
+
+const static QString WORLD_DIRECTORY = "C:/Users/thoma/Documents/Qt/QCharles/worlds";
+
+MainWindow::MainWindow(QWidget *parent)
+    : QMainWindow(parent),
+    m_plugins(new AgentPluginLoader(this)),
+    m_workerPool(new WorkerPool(this)),
+    m_commandServer(new CommandServer(this, this)),
+    m_heartbeat(new QTimer(this))
+{
+    setupUI();
+    connect(m_openWorldAction, &QAction::triggered, this, &MainWindow::onOpenWorldAction);
+    connect(m_openTabAction, &QAction::triggered, this, [=]() { openWorld(true); });
+    connect(m_newTabAction, &QAction::triggered, this, &MainWindow::addSession);
+    connect(m_library, &WorldLibraryWidget::worldActivated, this, [=](const QString& fileName) {
+        if (askForSave())
+            loadWorld(fileName);
+    });
+    connect(m_saveWorldAction, &QAction::triggered, this, &MainWindow::onSaveWorldAction);
+    connect(m_newWorldAction, &QAction::triggered, this, &MainWindow::onNewWorldAction);
+    connect(m_rerunAction, &QAction::triggered, this, &MainWindow::onRerunAction);
+    connect(m_exportRunAction, &QAction::triggered, this, &MainWindow::onExportRunAction);
+    connect(m_goalWorldAction, &QAction::triggered, this, &MainWindow::onGoalWorldAction);
+    connect(m_clearGoalWorldAction, &QAction::triggered, this, &MainWindow::onClearGoalWorldAction);
+    connect(m_heatmapAction, &QAction::toggled, this, [=](bool on) { m_worldWidget->setHeatmapVisible(on); });
+    connect(m_renderStatsAction, &QAction::toggled, this, &MainWindow::setRenderStats);
+    m_heartbeat->setInterval(HEARTBEAT_MSEC);
+    connect(m_heartbeat, &QTimer::timeout, this, [=]() {
+        const qint64 late = m_heartbeatClock.restart() - HEARTBEAT_MSEC;
+        if (late >= STALL_MSEC)
+            RenderStats::instance().record(RenderMeasure::EventLoopStall, late * 1000);
+    });
+    connect(m_foldSensorsAction, &QAction::toggled, this, [=](bool on) { m_debugWidget->setFoldingSensors(on); });
+    connect(m_externalAgentsAction, &QAction::toggled, this, [=](bool on) {
+        if (!on) {
+            m_commandServer->close();
+            statusBar()->showMessage("External agents are not accepted any more.");
+        }
+        else if (!m_commandServer->listen(COMMAND_SERVER_NAME)) {
+            QMessageBox::warning(this, "External Agents", "Cannot accept external agents: " + m_commandServer->errorString());
+            m_externalAgentsAction->setChecked(false);
+        }
+        else
+            statusBar()->showMessage("External agents can connect to " + m_commandServer->fullServerName() + ".");
+    });
+    connect(m_commandServer, &CommandServer::clientConnected, this, &MainWindow::onExternalAgentConnected);
+    connect(m_commandServer, &CommandServer::batchStarted, this, &MainWindow::onExternalBatchStarted);
+    connect(m_commandServer, &CommandServer::batchFinished, this, &MainWindow::onExternalBatchFinished);
+    connect(m_commandServer, &CommandServer::clientDisconnected, this, &MainWindow::onExternalAgentDisconnected);
+    connect(m_traceBudgetAction, &QAction::triggered, this, [=]() {
+        bool ok;
+        const int budget = QInputDialog::getInt(this, "Trace Memory Budget", "Trace items kept in memory, the rest is spilled to disk:",
+                                                m_traceBudget, 2 * TraceModel::SEGMENT_SIZE, INT_MAX, TraceModel::SEGMENT_SIZE, &ok);
+        if (!ok)
+            return;
+        m_traceBudget = budget;
+        m_debugWidget->setMemoryBudget(budget);
+    });
+
+    connect(m_loadPluginAction, &QAction::triggered, this, &MainWindow::onLoadPluginAction);
+    connect(m_loadPluginDirectoryAction, &QAction::triggered, this, &MainWindow::onLoadPluginDirectoryAction);
+    connect(m_loadScriptAction, &QAction::triggered, this, &MainWindow::onLoadScriptAction);
+    connect(m_scriptInstructionAction, &QAction::triggered, this, &MainWindow::onScriptInstructionAction);
+    connect(m_profileAction, &QAction::triggered, this, [=]() {
+        m_profileWindow->refresh();
+        m_profileWindow->show();
+        m_profileWindow->raise();
+    });
+    connect(m_plugins, &AgentPluginLoader::agentsChanged, this, &MainWindow::updatePluginMenu);
+    connect(m_plugins, &AgentPluginLoader::reloadFailed, this, [=](const QString& fileName, const QString& error) {
+        statusBar()->showMessage("Reloading " + fileName + " failed: " + error);
+    });
+    updatePluginMenu();
+    updateScriptMenu();
+    connect(m_workerPool, &WorkerPool::jobFinished, this, &MainWindow::onSandboxJobFinished);
+    connect(m_workerPool, &WorkerPool::jobFinished, this, &MainWindow::onGroupJobFinished);
+    // Also for jobs whose result is dropped (their tab was closed).
+    connect(m_workerPool, &WorkerPool::jobFinished, this, [=](int id) { releaseSandboxWorld(m_jobWorlds.take(id)); });
+    connect(m_groupProgramsAction, &QAction::triggered, this, &MainWindow::onGroupProgramsAction);
+    connect(m_stopSandboxAction, &QAction::triggered, this, &MainWindow::onStopSandboxAction);
+    connect(m_compareTraceAction, &QAction::triggered, this, &MainWindow::onCompareTraceAction);
+    m_sandboxAction->setEnabled(m_workerPool->isAvailable());
+    m_stopSandboxAction->setEnabled(m_workerPool->isAvailable());
+
+    connect(m_playAction, &QAction::toggled, this, [=](bool on) {
+        if (on)
+            m_player->play();
+        else
+            m_player->pause();
+        // Nothing to play at the end of the trace.
+        m_playAction->setChecked(m_player->isPlaying());
+    });
+    connect(m_player, &TracePlayer::playingChanged, m_playAction, &QAction::setChecked);
+    connect(m_speedSlider, &QSlider::valueChanged, this, &MainWindow::onSpeedChanged);
+    m_speedSlider->setValue(std::lround(std::log(TracePlayer::defaultSpeed() / TracePlayer::MIN_SPEED)
+                                       / std::log(TracePlayer::MAX_SPEED / TracePlayer::MIN_SPEED) * SPEED_STEPS));
+
+    connect(m_stepAction, &QAction::triggered, this, &MainWindow::onStepAction);
+    connect(m_turnLeftAction, &QAction::triggered, this, &MainWindow::onTurnLeftAction);
+    connect(m_turnRightAction, &QAction::triggered, this, &MainWindow::onTurnRightAction);
+    connect(m_getBallAction, &QAction::triggered, this, &MainWindow::onGetBallAction);
+    connect(m_putBallAction, &QAction::triggered, this, &MainWindow::onPutBallAction);
+}
+
+/*
+ *  WORLD ACTIONS
+ *  With debugging. First execute and debug after. That way failed operations do not get logged.
+ */
+
+bool MainWindow::onBall() {
+    if (m_runFailed)
+        return m_sensorNoise.bounded(2);
+    bool ret;
+    if (replayed(DebugKind::OnBall, &ret))
+        return ret;
+    ret = m_worldWidget->world()->onBall();
+    m_debugWidget->addSensorItem(DebugKind::OnBall, ret);
+    return ret;
+}
+
+bool MainWindow::inFrontOfWall() {
+    if (m_runFailed)
+        return m_sensorNoise.bounded(2);
+    bool ret;
+    if (replayed(DebugKind::InFrontOfWall, &ret))
+        return ret;
+    ret = m_worldWidget->world()->inFrontOfWall();
+    m_debugWidget->addSensorItem(DebugKind::InFrontOfWall, ret);
+    return ret;
+}
+
+void MainWindow::step() {
+    worldAction(DebugKind::Step);
+}
+
+void MainWindow::turnLeft() {
+    worldAction(DebugKind::TurnLeft);
+}
+
+void MainWindow::turnRight() {
+    worldAction(DebugKind::TurnRight);
+}
+
+void MainWindow::getBall() {
+    worldAction(DebugKind::GetBall);
+}
+
+void MainWindow::putBall() {
+    worldAction(DebugKind::PutBall);
+}
+
+void MainWindow::debugMessage(const QString& msg) {
+    if (m_runFailed || replayed(DebugKind::Message))
+        return;
+    debugTrace(DebugKind::Message, msg);
+}
+
+int MainWindow::robotCount() {
+    return m_worldWidget->world()->robotCount();
+}
+
+int MainWindow::robotId(int i) {
+    const WorldObject *world = m_worldWidget->world();
+    if (i < 0 || i >= world->robotCount()) {
+        robotError(QString("robot_id: there is no robot with index %1.").arg(i));
+        return world->selectedRobot();
+    }
+    return world->robots()[i].id;
+}
+
+void MainWindow::selectRobot(int id) {
+    if (m_runFailed)
+        return;
+    if (m_worldWidget->world()->robotIndex(id) == -1)
+        robotError(QString("select_robot: there is no robot with id %1.").arg(id));
+    else
+        m_worldWidget->world()->selectRobot(id);
+}
+
+void MainWindow::beginTick() {
+    m_inTick = true;
+    m_tickActions = QVector<RobotAction>(robotCount(), RobotAction::NoAction);
+}
+
+void MainWindow::endTick() {
+    if (!m_inTick)
+        return;
+    m_inTick = false;
+    if (m_runFailed || replayed(DebugKind::Tick))
+        return;
+    m_debugWidget->addTick(m_tickActions);
+    m_session->saved = false;
+}
+
+/*
+ *  TABS
+ */
+
+void MainWindow::onTabChanged(int index) {
+    if (index == -1 || m_sessions[index] == m_session)
+        return;
+    // Playback, script sessions and external agents belong to the trace that is left.
+    m_player->setTrace(nullptr);
+    m_scriptSession.reset();
+    endExternalRun();
+    if (m_session)
+        m_session->hideView();
+    m_session = m_sessions[index];
+    m_session->showView();
+    m_worldWidget = m_session->worldWidget();
+    m_debugWidget = m_session->debugWidget();
+    m_worldWidget->setHeatmapVisible(m_heatmapAction->isChecked());
+    m_worldWidget->setRenderStatsVisible(m_renderStatsAction->isChecked());
+    m_worldWidget->setGoalWorld(m_session->goalWorld);
+    connect(m_worldWidget, &WorldWidget::fieldClicked, this, &MainWindow::showCellHistory);
+    m_debugWidget->setFoldingSensors(m_foldSensorsAction->isChecked());
+    m_debugWidget->setMemoryBudget(m_traceBudget);
+    m_player->setTrace(m_debugWidget);
+    connect(m_debugWidget, &DebugTraceWidget::sourceRequested, this, [=](int site) {
+        m_profileWindow->refresh();
+        m_profileWindow->showSite(site);
+        m_profileWindow->show();
+        m_profileWindow->raise();
+    });
+}
+
+void MainWindow::endExternalRun() {
+    // The run of an external agent ends on the session it ran on, before that session is left or closed.
+    if (!m_commandServer->hasClient() || !m_session)
+        return;
+    m_commandServer->abortClient();
+    onExternalAgentDisconnected();
+}
+
+void MainWindow::onCloseTab(int index) {
+    m_tabs->setCurrentIndex(index);
+    if (!askForSave())
+        return;
+    // Before the session goes, m_session is the one that is closed.
+    endExternalRun();
+    if (m_tabs->count() == 1)
+        addSession();
+    WorldSession *session = m_sessions.takeAt(index);
+    if (session == m_session)
+        m_session = nullptr;
+    // The result of its sandbox run has nowhere to go.
+    if (session == m_sandboxSession && m_sandboxJob != -1) {
+        m_workerPool->cancel(m_sandboxJob);
+        m_sandboxJob = -1;
+    }
+    m_tabs->removeTab(index);
+    delete session->page();
+    delete session;
+}
+
+WorldSession *MainWindow::addSession() {
+    WorldSession *session = new WorldSession(this);
+    // Untitled worlds of different tabs autosave to files of their own. The first free name is taken, so the tabs of
+    // a new start use the same files again instead of names that depend on the tabs opened before.
+    QStringList taken;
+    for (WorldSession *s : m_sessions)
+        taken.push_back(s->autosaver()->untitledName());
+    QString untitled = "untitled";
+    for (int n = 2; taken.contains(untitled); ++n)
+        untitled = QString("untitled-%1").arg(n);
+    session->autosaver()->setUntitledName(untitled);
+    connect(session->autosaver(), &WorldAutosaver::failed, this, [=](const QString& message) {
+        statusBar()->showMessage("Autosave failed: " + message);
+    });
+    m_sessions.push_back(session);
+    m_tabs->setCurrentIndex(m_tabs->addTab(session->page(), session->title()));
+    return session;
+}
+
+/*
+ *  FILE ACTIONS
+ */
+
+void MainWindow::onOpenWorldAction() {
+    if (askForSave())
+        openWorld();
+}
+
+void MainWindow::onSaveWorldAction() {
+    saveWorld();
+}
+
+bool MainWindow::saveWorld(bool wait) {
+    QString fileTo = QFileDialog::getSaveFileName(this, "Save World Configuration File", worldDirectory(), "*.txt");
+    if (fileTo.isEmpty())
+        return false;
+    // The job saves a copy, so the world is saved as it is now.
+    WorldFileJob *job = WorldFileJob::save(*m_worldWidget->world(), fileTo, this);
+    m_session->worldFile = fileTo;
+    m_session->saved = true;
+    m_tabs->setTabText(m_sessions.indexOf(m_session), m_session->title());
+    QProgressDialog *dialog = showProgress("Saving " + fileTo + "...", job);
+    // The tab may be switched or closed before the job finishes.
+    const QPointer<WorldSession> session = m_session;
+    connect(job, &WorldFileJob::finished, this, [=]() {
+        job->deleteLater();
+        if (!session)
+            return;
+        if (job->isCancelled() || !job->errorMessage().isEmpty()) {
+            session->saved = false;
+            session->autosaver()->setWorldFile(fileTo);
+            statusBar()->showMessage(job->isCancelled() ? "Saving cancelled." : "Saving failed: " + job->errorMessage());
+        }
+        else
+            session->autosaver()->saved(fileTo);
+    });
+    if (!wait)
+        return true;
+    // The progress is shown at once and blocks the rest of the UI meanwhile, it can still be cancelled.
+    dialog->setWindowModality(Qt::ApplicationModal);
+    dialog->setMinimumDuration(0);
+    QEventLoop loop;
+    connect(job, &WorldFileJob::finished, &loop, &QEventLoop::quit);
+    loop.exec();
+    return session && session->saved;
+}
+
+void MainWindow::onNewWorldAction() {
+    if (!askForSave())
+        return;
+    NewWorldDialog* dialog = new NewWorldDialog(this);
+    if (dialog->exec() == QDialog::Accepted) {
+        m_worldWidget->world()->makeEmptyWorld(dialog->getDimension(), dialog->getCharlesPoint() + QPoint(1, 1), dialog->getCharlesDirection());
+        m_session->autosaver()->setWorldFile(QString());
+        m_session->saved = false;
+    }
+}
+
+void MainWindow::onRerunAction() {
+    const AgentFunction agent = findAgent(m_session->lastRun.name);
+    if (!agent || m_session->worldFile.isEmpty()) {
+        QMessageBox::information(this, "Rerun", "Open a world and run a program first.");
+        return;
+    }
+    // With the sandbox on the program does not run in this process, not even fast forwarded: only the trace before
+    // it is replayed, then the program runs in the sandbox again from its start.
+    const bool sandbox = m_sandboxAction->isChecked();
+    if (sandbox && m_sandboxJob != -1) {
+        statusBar()->showMessage("A program is still running in the sandbox.");
+        return;
+    }
+    const AgentRun run = m_session->lastRun;
+    try {
+        m_worldWidget->world()->loadFromFile(m_session->worldFile);
+        m_session->saved = true;
+    }
+    catch (BadFileFormat& e) {
+        QMessageBox::critical(this, "Invalid File Format", "File: " + m_session->worldFile + "\nMessage: " + e.what());
+        return;
+    }
+
+    // Replay the recorded trace up to the first difference, the world is left at that point.
+    // The reload forgot the counters, the replayed part counts for the run.
+    m_worldWidget->setUpdatingUI(false);
+    m_debugWidget->setUpdatesEnabled(false);
+    m_worldWidget->world()->setRecordingStats(true);
+    const int divergence = m_debugWidget->replayEvents(sandbox ? run.events.mid(0, run.firstEvent) : run.events);
+    m_worldWidget->world()->setRecordingStats(false);
+    if (divergence > 0)
+        m_session->saved = false;
+    m_worldWidget->setUpdatingUI(true);
+    m_debugWidget->setUpdatesEnabled(true);
+    if (divergence < run.firstEvent) {
+        statusBar()->showMessage("The trace before the program differs on the reloaded world, program not rerun.");
+        return;
+    }
+    if (sandbox) {
+        runInSandbox(run.name);
+        return;
+    }
+
+    // Fast forward the program through the replayed part, then it continues live.
+    m_replay = run.events;
+    m_replayPos = run.firstEvent;
+    m_replayEnd = divergence;
+    runAgent(run.name, agent);
+    m_replay.clear();
+    m_replayPos = m_replayEnd = 0;
+    statusBar()->showMessage(QString("Replayed %1 of %2 recorded events, the rest was executed live.")
+                                 .arg(divergence - run.firstEvent).arg(run.events.size() - run.firstEvent) + visitReport());
+}
+
+bool MainWindow::replayed(DebugKind k, bool *answer) {
+    if (m_replayPos >= m_replayEnd)
+        return false;
+    const TraceEvent &e = m_replay[m_replayPos];
+    if (e.kind != k) {
+        // Only happens for programs that do not behave the same on the same answers (e.g. random numbers).
+        m_replayEnd = m_replayPos;
+        debugTrace(DebugKind::Message, "Program deviates from its recorded run, continuing live.");
+        return false;
+    }
+    ++m_replayPos;
+    if (answer)
+        *answer = e.answer;
+    return true;
+}
+
+void MainWindow::onGoalWorldAction() {
+    const QString fileName = QFileDialog::getOpenFileName(this, "Open Goal World", worldDirectory(), "*.txt");
+    if (fileName.isEmpty())
+        return;
+    WorldObject *goal = new WorldObject(m_session);
+    try {
+        goal->loadFromFile(fileName);
+    }
+    catch (BadFileFormat& e) {
+        delete goal;
+        QMessageBox::critical(this, "Invalid File Format", "File: " + fileName + "\nMessage: " + e.what());
+        return;
+    }
+    delete m_session->goalWorld;
+    m_session->goalWorld = goal;
+    m_worldWidget->setGoalWorld(goal);
+    statusBar()->showMessage("Comparing with " + QFileInfo(fileName).fileName() + "." + goalReport());
+}
+
+void MainWindow::onClearGoalWorldAction() {
+    m_worldWidget->setGoalWorld(nullptr);
+    delete m_session->goalWorld;
+    m_session->goalWorld = nullptr;
+}
+
+void MainWindow::onExportRunAction() {
+    RunExport options;
+    QString filter;
+    options.fileName = QFileDialog::getSaveFileName(this, "Export Run", worldDirectory(),
+                                                    "Animated GIF (*.gif);;PNG Sequence (*.png)", &filter);
+    if (options.fileName.isEmpty())
+        return;
+    options.format = filter.startsWith("PNG") ? ExportFormat::PngExport : ExportFormat::GifExport;
+    bool ok;
+    options.everyNth = QInputDialog::getInt(this, "Export Run", "A frame every ... trace items:", 1, 1, INT_MAX, 1, &ok);
+    if (!ok)
+        return;
+
+    RunExportJob *job = RunExportJob::start(*m_worldWidget->world(), m_debugWidget->startSnapshot(), m_debugWidget->events(), options, this);
+    m_exportRunAction->setEnabled(false);
+    QProgressDialog *dialog = new QProgressDialog(QString("Exporting %1 frames...").arg(job->frameCount()), "Cancel", 0, 100, this);
+    dialog->setMinimumDuration(PROGRESS_DELAY_MSEC);
+    dialog->setAutoClose(false);
+    connect(job, &RunExportJob::progress, dialog, &QProgressDialog::setValue);
+    connect(dialog, &QProgressDialog::canceled, job, &RunExportJob::cancel);
+    connect(job, &RunExportJob::finished, this, [=]() {
+        dialog->deleteLater();
+        job->deleteLater();
+        m_exportRunAction->setEnabled(true);
+        if (job->isCancelled())
+            statusBar()->showMessage("Export cancelled.");
+        else if (!job->errorMessage().isEmpty())
+            QMessageBox::critical(this, "Export Run", job->errorMessage());
+        else
+            statusBar()->showMessage(QString("Exported %1 frames to %2.").arg(job->frameCount()).arg(options.fileName));
+    });
+}
+
+void MainWindow::onLoadPluginAction() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Load Program Plugin", QString(), "Plugins (*.so *.dll *.dylib)");
+    if (fileName.isEmpty())
+        return;
+    QString error = m_plugins->load(fileName);
+    if (!error.isEmpty())
+        QMessageBox::critical(this, "Plugin not loaded", error);
+}
+
+void MainWindow::onLoadPluginDirectoryAction() {
+    QString dirName = QFileDialog::getExistingDirectory(this, "Load Program Plugins");
+    if (dirName.isEmpty())
+        return;
+    QStringList errors = m_plugins->loadDirectory(dirName);
+    if (!errors.isEmpty())
+        QMessageBox::warning(this, "Some plugins not loaded", errors.join('\n'));
+}
+
+void MainWindow::updatePluginMenu() {
+    m_pluginMenu->clear();
+    for (const AgentPluginLoader::PluginAgent &agent : m_plugins->agents()) {
+        QAction *a = m_pluginMenu->addAction(agent.name);
+        // Look the program up on trigger, the plugin may have been reloaded in the mean time.
+        connect(a, &QAction::triggered, this, [=](){
+            if (const AgentFunction run = m_plugins->findAgent(agent.name))
+                runAgent(agent.name, run);
+        });
+    }
+    m_pluginMenu->setEnabled(!m_pluginMenu->isEmpty());
+}
+
+void MainWindow::onLoadScriptAction() {
+    QString fileName = QFileDialog::getOpenFileName(this, "Load Script", QString(), "Scripts (*.charles *.cpp *.txt)");
+    if (fileName.isEmpty())
+        return;
+    QFile file(fileName);
+    if (!file.open(QIODeviceBase::ReadOnly)) {
+        QMessageBox::critical(this, "Load Script", "Could not open " + fileName + ".");
+        return;
+    }
+    try {
+        Script script{QFileInfo(fileName).absoluteFilePath(), ScriptProgram::compile(QString::fromUtf8(file.readAll()))};
+        // Loading a script again replaces the old version.
+        m_scripts.removeIf([&](const Script& s) { return s.fileName == script.fileName; });
+        m_scripts.push_back(script);
+        updateScriptMenu();
+        statusBar()->showMessage(QString("Loaded %1 procedures from %2.").arg(script.program.procedures.size()).arg(fileName));
+    }
+    catch (ScriptError& e) {
+        QMessageBox::critical(this, "Script Error", fileName + "\n" + e.what());
+    }
+}
+
+void MainWindow::onScriptInstructionAction() {
+    if (!m_scriptSession) {
+        statusBar()->showMessage("Check Step Through Scripts and start a script procedure first.");
+        return;
+    }
+    m_debugWidget->seekToEnd();
+    try {
+        m_scriptSession->stepInstruction();
+        // Show the queries of the instruction now, not with the next action.
+        m_debugWidget->flushSensors();
+    }
+    catch (QException& e) {
+        debugTrace(DebugKind::Error, e.what());
+        QMessageBox::critical(this, "Error occured", e.what());
+        m_scriptSession.reset();
+        return;
+    }
+    if (m_scriptSession->isRunning()) {
+        statusBar()->showMessage(QString("%1: next instruction on line %2 (%3 executed).").arg(m_scriptSessionName)
+                                     .arg(m_scriptSession->currentLine()).arg(m_scriptSession->instructionCount()));
+        return;
+    }
+    // A procedure may end in the middle of a tick.
+    endTick();
+    statusBar()->showMessage(m_scriptSessionName + " finished.");
+    m_scriptSession.reset();
+}
+
+void MainWindow::onSandboxJobFinished(int id, const SandboxResult &result) {
+    if (id != m_sandboxJob)
+        return;
+    m_sandboxJob = -1;
+    // The trace is added to the session the program ran for.
+    m_tabs->setCurrentIndex(m_sessions.indexOf(m_sandboxSession));
+
+    m_worldWidget->setUpdatingUI(false);
+    m_debugWidget->setUpdatesEnabled(false);
+    m_worldWidget->world()->resetStats();
+    m_worldWidget->world()->setRecordingStats(true);
+    int replayed = m_debugWidget->replayEvents(result.events);
+    m_worldWidget->world()->setRecordingStats(false);
+    if (replayed < result.events.size() && result.events[replayed].kind == DebugKind::Error)
+        m_debugWidget->addRecordedItem(result.events[replayed++]);
+    const bool limited = result.status == SandboxStatus::SandboxTimeLimit || result.status == SandboxStatus::SandboxMemoryLimit
+                         || result.status == SandboxStatus::SandboxCrashed || result.status == SandboxStatus::SandboxCancelled;
+    if (limited)
+        debugTrace(DebugKind::Error, result.message);
+    if (replayed > 0)
+        m_session->saved = false;
+    m_worldWidget->setUpdatingUI(true);
+    m_debugWidget->setUpdatesEnabled(true);
+    m_session->lastRun = recordedRun(m_sandboxRun.name, m_sandboxRun.firstEvent);
+    animateFrom(m_sandboxRun.firstEvent);
+
+    if (replayed < result.events.size())
+        statusBar()->showMessage(QString("The world changed while the program ran, only %1 of %2 events were applied.")
+                                     .arg(replayed).arg(result.events.size()));
+    else if (result.status == SandboxStatus::SandboxFinished)
+        statusBar()->showMessage("Program finished in the sandbox." + visitReport());
+    else if (result.status == SandboxStatus::SandboxStoppedOnError)
+        statusBar()->showMessage("Program stopped after an error." + visitReport());
+    else
+        statusBar()->showMessage(result.message);
+}
+
+void MainWindow::onGroupProgramsAction() {
+    if (!m_groupJobs.isEmpty()) {
+        statusBar()->showMessage("The programs are still being grouped (Programs > Stop Sandbox Runs).");
+        return;
+    }
+    const QStringList names = programNames();
+    m_groupRuns.clear();
+    if (m_workerPool->isAvailable()) {
+        const QString worldFile = sandboxWorldFile();
+        if (worldFile.isEmpty())
+            return;
+        for (const QString &name : names) {
+            // Only the fingerprint comes back, the traces are not needed to compare the runs.
+            SandboxJob job = sandboxJob(name, worldFile);
+            job.sendEvents = false;
+            m_groupJobs.insert(submitSandboxJob(job), name);
+        }
+        statusBar()->showMessage(QString("Running %1 programs in the sandbox...").arg(names.size()));
+        return;
+    }
+
+    // Without a sandbox the programs run here one after the other, each on a copy of the world at the end of the trace.
+    m_debugWidget->seekToEnd();
+    for (const QString &name : names) {
+        const AgentFunction agent = findAgent(name);
+        if (!agent)
+            continue;
+        WorldObject world;
+        world.setEmitUpdates(false);
+        world.copyWorld(*m_worldWidget->world());
+        HeadlessRunner runner(&world, SENSOR_NOISE_SEED, SandboxJob().maxEvents);
+        CallProfile::instance().beginProgram(name);
+        const bool finished = runner.run(agent);
+        CallProfile::instance().endProgram();
+        m_groupRuns.push_back(RunOutcome{name, runner.fingerprint(), runner.eventCount(), finished ? QString() : runner.errorMessage()});
+    }
+    showBehaviourGroups();
+}
+
+void MainWindow::onStopSandboxAction() {
+    if (m_sandboxJob == -1 && m_groupJobs.isEmpty()) {
+        statusBar()->showMessage("No programs are running in the sandbox.");
+        return;
+    }
+    // They end as cancelled, the sandbox run with the part of its trace that came so far.
+    if (m_sandboxJob != -1)
+        m_workerPool->cancel(m_sandboxJob);
+    for (auto it = m_groupJobs.cbegin(); it != m_groupJobs.cend(); ++it)
+        m_workerPool->cancel(it.key());
+    statusBar()->showMessage("Stopping the programs in the sandbox...");
+}
+
+void MainWindow::onGroupJobFinished(int id, const SandboxResult &result) {
+    auto it = m_groupJobs.find(id);
+    if (it == m_groupJobs.end())
+        return;
+    // Runs that were killed (or could not start) have no fingerprint, they are grouped by their message.
+    const bool ended = result.status == SandboxStatus::SandboxFinished || result.status == SandboxStatus::SandboxStoppedOnError;
+    m_groupRuns.push_back(RunOutcome{*it, ended ? result.fingerprint : 0, result.eventCount,
+                                     result.status == SandboxStatus::SandboxFinished ? QString() : result.message});
+    m_groupJobs.erase(it);
+    if (m_groupJobs.isEmpty())
+        showBehaviourGroups();
+}
+
+void MainWindow::showBehaviourGroups() {
+    if (m_groupRuns.isEmpty()) {
+        statusBar()->showMessage("There are no programs to group.");
+        return;
+    }
+    // Sandbox jobs end in any order, the groups are listed in the order of the program names.
+    std::sort(m_groupRuns.begin(), m_groupRuns.end(), [](const RunOutcome &a, const RunOutcome &b) { return a.program < b.program; });
+    const QVector<QVector<RunOutcome>> groups = groupByBehaviour(m_groupRuns);
+    QStringList items;
+    for (const QVector<RunOutcome> &group : groups) {
+        QStringList names;
+        for (int i = 0; i < group.size() && i < MAX_GROUP_NAMES; ++i)
+            names.push_back(group[i].program);
+        if (group.size() > MAX_GROUP_NAMES)
+            names.push_back(QString("%1 more").arg(group.size() - MAX_GROUP_NAMES));
+        const RunOutcome &first = group.first();
+        QString outcome = first.fingerprint == 0 ? first.error : QString("%1 events").arg(first.events);
+        if (first.fingerprint != 0 && !first.error.isEmpty())
+            outcome += ", " + first.error;
+        items.push_back(QString("%1x: %2 (%3)").arg(group.size()).arg(names.join(", "), outcome));
+    }
+    bool ok;
+    const QString item = QInputDialog::getItem(this, "Group Programs By Behaviour",
+                                               QString("%1 programs behave in %2 ways on this world. Run the first program of a group to review it:")
+                                                   .arg(m_groupRuns.size()).arg(groups.size()), items, 0, false, &ok);
+    if (!ok)
+        return;
+    const QString name = groups[items.indexOf(item)].first().program;
+    if (const AgentFunction agent = findAgent(name))
+        runAgent(name, agent);
+}
+
+void MainWindow::onCompareTraceAction() {
+    QStringList titles;
+    QVector<WorldSession*> others;
+    for (int i = 0; i < m_sessions.size(); ++i) {
+        if (m_sessions[i] == m_session)
+            continue;
+        titles.push_back(QString("%1: %2").arg(i + 1).arg(m_sessions[i]->title()));
+        others.push_back(m_sessions[i]);
+    }
+    if (others.isEmpty()) {
+        QMessageBox::information(this, "Compare Trace", "Open the run to compare with in another tab first.");
+        return;
+    }
+    bool ok;
+    const QString title = QInputDialog::getItem(this, "Compare Trace", "Compare the trace of this tab with the trace of:",
+                                                titles, 0, false, &ok);
+    if (!ok)
+        return;
+    WorldSession *other = others[titles.indexOf(title)];
+
+    TraceDiffWindow::Trace a{m_session->title(), m_session->world()};
+    a.events = m_session->traceEvents(&a.start);
+    TraceDiffWindow::Trace b{other->title(), other->world()};
+    b.events = other->traceEvents(&b.start);
+    if (a.name == b.name) {
+        a.name += " (this tab)";
+        b.name += QString(" (tab %1)").arg(m_sessions.indexOf(other) + 1);
+    }
+    TraceDiffWindow *window = new TraceDiffWindow(a, b, this);
+    window->show();
+}
+
+void MainWindow::onExternalAgentConnected() {
+    CallProfile::instance().beginProgram("External Agent");
+    m_worldWidget->world()->resetStats();
+    statusBar()->showMessage("An external agent is connected.");
+}
+
+void MainWindow::onExternalBatchStarted() {
+    // The program continues at the end of the trace, even if the user looked back in the mean time.
+    m_debugWidget->seekToEnd();
+    m_worldWidget->world()->setRecordingStats(true);
+    m_worldWidget->setUpdatingUI(false);
+    m_debugWidget->setUpdatesEnabled(false);
+}
+
+void MainWindow::onExternalBatchFinished(int requests) {
+    // Show the queries of the batch now, the next action may take a while.
+    m_debugWidget->flushSensors();
+    m_worldWidget->world()->setRecordingStats(false);
+    m_worldWidget->setUpdatingUI(true);
+    m_debugWidget->setUpdatesEnabled(true);
+    m_session->saved = false;
+    statusBar()->showMessage(QString("External agent: %1 requests in the last batch.").arg(requests));
+}
+
+void MainWindow::onExternalAgentDisconnected() {
+    // A program may end in the middle of a tick.
+    endTick();
+    m_debugWidget->flushSensors();
+    m_worldWidget->world()->selectRobot(m_worldWidget->world()->robots().first().id);
+    CallProfile::instance().endProgram();
+    if (m_profileWindow->isVisible())
+        m_profileWindow->refresh();
+    statusBar()->showMessage("External agent finished." + visitReport());
+}
+
+void MainWindow::onSpeedChanged(int value) {
+    // Logarithmic, from slow motion to thousands of actions per second.
+    const double speed = TracePlayer::MIN_SPEED * std::pow(TracePlayer::MAX_SPEED / TracePlayer::MIN_SPEED, double(value) / SPEED_STEPS);
+    m_player->setSpeed(speed);
+    m_speedLabel->setText(QString("%1 actions/s").arg(m_player->speed(), 0, 'g', 3));
+}
+
+void MainWindow::onStepAction() {
+    try {
+        step();
+    }
+    catch(QException& e) {
+        QMessageBox::critical(this, "Error", e.what());
+    }
+}
+
+/*
+ *  UI WORLD ACTIONS
+ */
+
+void MainWindow::onTurnLeftAction() {
+    turnLeft();
+}
+
+void MainWindow::onTurnRightAction() {
+    turnRight();
+}
+
+void MainWindow::onGetBallAction() {
+    try {
+        getBall();
+    }
+    catch(QException& e) {
+        QMessageBox::critical(this, "Error", e.what());
+    }
+}
+
+void MainWindow::onPutBallAction() {
+    try {
+        putBall();
+    }
+    catch(QException& e) {
+        QMessageBox::critical(this, "Error", e.what());
+    }
+}
+
+/*
+ * PRIVATE FUNCTIONS.
+ */
+
+void MainWindow::openWorld(bool inNewTab) {
+    const QString fileName = QFileDialog::getOpenFileName(this, "Open World Configuration File", worldDirectory(), "*.txt");
+    if (fileName.isEmpty()) // Check if user clicked cancel on window selection.
+        return;
+    if (inNewTab)
+        addSession();
+    loadWorld(fileName);
+}
+
+void MainWindow::loadWorld(const QString &fileName) {
+    // An autosave that is newer than the file holds changes that were never saved.
+    const QFileInfo autosave(WorldAutosaver::autosaveFileFor(fileName));
+    const bool recover = autosave.exists() && autosave.lastModified() > QFileInfo(fileName).lastModified()
+        && QMessageBox::question(this, "Recover World", "There are unsaved changes of " + fileName
+                                 + " from " + autosave.lastModified().toString() + ". Do you want to recover them?") == QMessageBox::Yes;
+    WorldFileJob *job = WorldFileJob::load(recover ? autosave.filePath() : fileName, this);
+    showProgress("Loading " + fileName + "...", job);
+    // The world is loaded into the session of the tab that was shown, even if another tab is shown by now.
+    const QPointer<WorldSession> session = m_session;
+    connect(job, &WorldFileJob::finished, this, [=]() {
+        job->deleteLater();
+        if (!session)
+            return;
+        if (job->isCancelled()) {
+            statusBar()->showMessage("Loading cancelled.");
+            return;
+        }
+        if (!job->errorMessage().isEmpty()) {
+            const QString msg = "File: " + fileName + "\nMessage: " + job->errorMessage() + "\n\nAn error occured, do you want to try again?";
+            if (QMessageBox::critical(this, "Invalid File Format", msg, QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+                openWorld();
+            return;
+        }
+        session->world()->swapWorld(*job->world());
+        session->worldFile = fileName;
+        session->saved = !recover;
+        session->autosaver()->setWorldFile(fileName);
+        m_tabs->setTabText(m_sessions.indexOf(session), session->title());
+    });
+}
+
+QProgressDialog *MainWindow::showProgress(const QString& label, WorldFileJob *job) {
+    // The file actions wait for the jobs, the rest of the UI stays usable.
+    ++m_fileJobs;
+    m_openWorldAction->setEnabled(false);
+    m_saveWorldAction->setEnabled(false);
+    QProgressDialog *dialog = new QProgressDialog(label, "Cancel", 0, 100, this);
+    dialog->setMinimumDuration(PROGRESS_DELAY_MSEC);
+    dialog->setAutoClose(false);
+    connect(job, &WorldFileJob::progress, dialog, &QProgressDialog::setValue);
+    connect(dialog, &QProgressDialog::canceled, job, &WorldFileJob::cancel);
+    connect(job, &WorldFileJob::finished, this, [=]() {
+        dialog->deleteLater();
+        m_openWorldAction->setEnabled(--m_fileJobs == 0);
+        m_saveWorldAction->setEnabled(m_fileJobs == 0);
+    });
+    return dialog;
+}
+
+void MainWindow::debugTrace(DebugKind k, const QString &msg) {
+    m_debugWidget->addDebugItem(k, msg);
+}
+
+void MainWindow::worldAction(DebugKind k) {
+    if (m_runFailed)
+        return;
+    if (m_inTick) {
+        const WorldObject *world = m_worldWidget->world();
+        m_tickActions[world->robotIndex(world->selectedRobot())] = robotAction(k);
+        return;
+    }
+    if (replayed(k))
+        return;
+    if (m_batchMode)
+        m_runFailed = m_debugWidget->tryAddDebugItem(k) != ActionResult::ActionOk;
+    else
+        debugTrace(k);
+    m_session->saved = false;
+}
+
+void MainWindow::robotError(const QString &msg) {
+    debugTrace(DebugKind::Error, msg);
+    if (m_batchMode)
+        m_runFailed = true;
+    else
+        throw IllegalWorldAction();
+}
+
+void MainWindow::runAgent(const QString& name, const AgentFunction& agent) {
+    // A rerun with the sandbox on goes there as well (see onRerunAction()), nothing is fast forwarded then.
+    if (m_sandboxAction->isChecked()) {
+        runInSandbox(name);
+        return;
+    }
+    // When rerunning, the replayed part of the trace belongs to this run as well.
+    const int firstEvent = m_replayEnd > 0 ? m_replayPos : m_debugWidget->eventCount();
+    // A rerun runs the program from the start again, so it is profiled as a whole as well.
+    CallProfile::instance().beginProgram(name);
+    if (m_replayEnd == 0)
+        m_worldWidget->world()->resetStats();
+    m_worldWidget->world()->setRecordingStats(true);
+    m_worldWidget->setUpdatingUI(false);
+    m_debugWidget->setUpdatesEnabled(false);
+    if (m_batchModeAction->isChecked()) {
+        // No exceptions here: after an error the program runs on without effect until it ends.
+        m_batchMode = true;
+        m_runFailed = false;
+        m_sensorNoise.seed(SENSOR_NOISE_SEED);
+        try {
+            agent();
+        }
+        catch (QException& e) {
+            // Only scripts throw here (see scriptvm.h), commands do not in batch mode.
+            debugTrace(DebugKind::Error, e.what());
+            m_runFailed = true;
+        }
+        statusBar()->showMessage((m_runFailed ? "Program stopped after an error." : "Program finished.") + visitReport());
+        m_batchMode = false;
+        m_runFailed = false;
+    }
+    else {
+        bool failed = false;
+        try {
+            agent();
+        }
+        catch (QException& e) {
+            debugTrace(DebugKind::Error, e.what());
+            QMessageBox::critical(this, "Error occured", e.what());
+            failed = true;
+        }
+        statusBar()->showMessage((failed ? "Program stopped after an error." : "Program finished.") + visitReport());
+    }
+    // A program may end in the middle of a tick, or with sensor queries that wait for an action.
+    endTick();
+    m_debugWidget->flushSensors();
+    m_worldWidget->world()->selectRobot(m_worldWidget->world()->robots().first().id);
+    m_worldWidget->world()->setRecordingStats(false);
+    CallProfile::instance().endProgram();
+    m_worldWidget->setUpdatingUI(true);
+    m_debugWidget->setUpdatesEnabled(true);
+    if (m_profileWindow->isVisible())
+        m_profileWindow->refresh();
+    m_session->lastRun = recordedRun(name, firstEvent);
+    animateFrom(firstEvent);
+}
+
+AgentRun MainWindow::recordedRun(const QString &name, int firstEvent) const {
+    return AgentRun{name, m_debugWidget->events(qMax(firstEvent, m_debugWidget->memoryBudget())), firstEvent};
+}
+
+void MainWindow::setRenderStats(bool on) {
+    RenderStats &stats = RenderStats::instance();
+    // The samples are kept until QCharles quits, turning them off and on again adds to them.
+    stats.setEnabled(on);
+    m_worldWidget->setRenderStatsVisible(on);
+    m_inputLatency.invalidate();
+    if (!on) {
+        m_heartbeat->stop();
+        stats.setLogFile(QString());
+        statusBar()->showMessage("Render statistics are off.");
+        return;
+    }
+    m_heartbeatClock.start();
+    m_heartbeat->start();
+    m_worldWidget->takeRepaintedCells();
+    const QString log = QDir::temp().filePath(RENDER_STATS_LOG);
+    if (stats.setLogFile(log))
+        statusBar()->showMessage("Render statistics are logged to " + QDir::toNativeSeparators(log) + ".");
+    else
+        statusBar()->showMessage("Render statistics are on, but cannot be logged to " + QDir::toNativeSeparators(log) + ".");
+}
+
+bool MainWindow::event(QEvent *event) {
+    // Qt paints all widgets of the window that need it while handling the update request, one frame.
+    if (event->type() != QEvent::UpdateRequest || !RenderStats::instance().isEnabled())
+        return QMainWindow::event(event);
+    QElapsedTimer timer;
+    timer.start();
+    const bool result = QMainWindow::event(event);
+    const qint64 paintTime = timer.nsecsElapsed() / 1000;
+    RenderStats &stats = RenderStats::instance();
+    const int cells = m_worldWidget->takeRepaintedCells();
+    // A frame that only refreshed the overlay would measure the overlay, not the world.
+    const bool overlayOnly = m_worldWidget->takeStatsRefresh() && cells == 0 && !m_inputLatency.isValid();
+    if (!overlayOnly)
+        stats.record(RenderMeasure::PaintTime, paintTime);
+    if (cells)
+        stats.record(RenderMeasure::CellsRepainted, cells);
+    if (m_inputLatency.isValid()) {
+        stats.record(RenderMeasure::InputLatency, m_inputLatency.nsecsElapsed() / 1000);
+        m_inputLatency.invalidate();
+    }
+    return result;
+}
+
+QString MainWindow::visitReport() const {
+    const VisitStats stats = m_worldWidget->world()->visitStats();
+    return QString(" %1 fields visited, %2% of the visits redundant, %3 balls put or taken.")
+        .arg(stats.distinctCells).arg(stats.redundantVisitRatio() * 100, 0, 'f', 1).arg(stats.mutations) + goalReport();
+}
+
+QString MainWindow::goalReport() const {
+    if (!m_session->goalWorld)
+        return QString();
+    // Only counted, the fields are marked by the world widget.
+    const WorldDiff diff = diffWorlds(*m_worldWidget->world(), *m_session->goalWorld, 0);
+    if (diff.sizeDiffers)
+        return " The goal world has another size.";
+    if (diff.isEqual())
+        return " The goal world is reached.";
+    return QString(" %1 fields and %2 robots differ from the goal world.").arg(diff.mismatches).arg(diff.robots.size());
+}
+
+void MainWindow::showCellHistory(QPoint p) {
+    // The last items are the interesting ones (where did the ball go?), long histories are cut at the front.
+    const int MAX_LISTED = 30;
+    const QVector<int> items = m_debugWidget->cellHistory(p);
+    QMenu menu;
+    menu.addSection(QString("Field (%1, %2)").arg(p.x()).arg(p.y()));
+    if (items.isEmpty())
+        menu.addAction("No trace item touched this field")->setEnabled(false);
+    if (items.size() > MAX_LISTED)
+        menu.addAction(QString("... %1 earlier items").arg(items.size() - MAX_LISTED))->setEnabled(false);
+    if (m_debugWidget->cellHistoryStart() > 0)
+        menu.addAction(QString("Items before %1 are not indexed").arg(m_debugWidget->cellHistoryStart()))->setEnabled(false);
+    for (int i = qMax(0, int(items.size()) - MAX_LISTED); i < items.size(); ++i) {
+        const int index = items[i];
+        QAction *a = menu.addAction(QString("%1: %2").arg(index).arg(m_debugWidget->itemText(index)));
+        connect(a, &QAction::triggered, this, [=]() { m_debugWidget->seek(index); });
+    }
+    menu.exec(QCursor::pos());
+}
+
+void MainWindow::animateFrom(int event) {
+    if (!m_animateAction->isChecked())
+        return;
+    m_debugWidget->seek(m_debugWidget->itemBeforeEvent(event));
+    m_player->play();
+}
+
+void MainWindow::runInSandbox(const QString& name) {
+    if (m_sandboxJob != -1) {
+        statusBar()->showMessage("A program is still running in the sandbox (Programs > Stop Sandbox Runs).");
+        return;
+    }
+    // The program runs on the world at the end of the trace, its trace is appended there.
+    const QString worldFile = sandboxWorldFile();
+    if (worldFile.isEmpty())
+        return;
+    m_sandboxRun = AgentRun{name, {}, m_debugWidget->eventCount()};
+    m_sandboxSession = m_session;
+    m_sandboxJob = submitSandboxJob(sandboxJob(name, worldFile));
+    statusBar()->showMessage("Running " + name + " in the sandbox...");
+}
+
+QString MainWindow::sandboxWorldFile() {
+    m_debugWidget->seekToEnd();
+    if (m_session->saved && m_debugWidget->eventCount() == 0 && !m_session->worldFile.isEmpty())
+        return m_session->worldFile;    // Unchanged, the workers may have it loaded already.
+    const QString worldFile = m_sandboxDir.filePath(QString("world-%1.txt").arg(m_sandboxWorlds));
+    // Queued jobs may still read the last one, then the last of them removes it.
+    releaseSandboxWorld(m_sandboxDir.filePath(QString("world-%1.txt").arg(m_sandboxWorlds - 1)));
+    try {
+        m_worldWidget->world()->saveToFile(worldFile);
+    }
+    catch (FileNotSaved& e) {
+        statusBar()->showMessage(e.what());
+        return QString();
+    }
+    ++m_sandboxWorlds;
+    return worldFile;
+}
+
+int MainWindow::submitSandboxJob(const SandboxJob &job) {
+    const int id = m_workerPool->submit(job);
+    m_jobWorlds.insert(id, job.worldFile);
+    return id;
+}
+
+void MainWindow::releaseSandboxWorld(const QString &worldFile) {
+    // The world file of the session is not ours to remove, and neither is one a job still needs.
+    if (worldFile.isEmpty() || QFileInfo(worldFile).absolutePath() != QDir(m_sandboxDir.path()).absolutePath())
+        return;
+    if (m_jobWorlds.key(worldFile, -1) == -1)
+        QFile::remove(worldFile);
+}
+
+SandboxJob MainWindow::sandboxJob(const QString &name, const QString &worldFile) const {
+    SandboxJob job{worldFile, name, QString(), QString(), SENSOR_NOISE_SEED};
+    for (const AgentPluginLoader::PluginAgent &agent : m_plugins->agents()) {
+        if (agent.name == name)
+            job.pluginFile = agent.fileName;
+    }
+    for (const Script &script : m_scripts) {
+        if (name.startsWith(QFileInfo(script.fileName).completeBaseName() + ": "))
+            job.scriptFile = script.fileName;
+    }
+    return job;
+}
+
+QStringList MainWindow::programNames() const {
+    QStringList names;
+    for (const auto& agent : AGENTS_TABLE)
+        names.push_back(agent.first);
+    for (const Script &script : m_scripts) {
+        for (const ScriptProgram::Procedure &p : script.program.procedures)
+            names.push_back(QFileInfo(script.fileName).completeBaseName() + ": " + p.name);
+    }
+    for (const AgentPluginLoader::PluginAgent &agent : m_plugins->agents())
+        names.push_back(agent.name);
+    return names;
+}
+
+AgentFunction MainWindow::findAgent(const QString& name) const {
+    for (const auto& agent : AGENTS_TABLE) {
+        if (name == agent.first)
+            return agent.second;
+    }
+    for (const Script &script : m_scripts) {
+        for (const ScriptProgram::Procedure &p : script.program.procedures) {
+            if (name == QFileInfo(script.fileName).completeBaseName() + ": " + p.name) {
+                const ScriptProgram program = script.program;
+                return [program, p]() { ScriptVM::run(program, p.name, commandTarget); };
+            }
+        }
+    }
+    return m_plugins->findAgent(name);
+}
+
+void MainWindow::startScriptSession(const QString& name, const ScriptProgram& program, const QString& procedure) {
+    m_scriptSession.reset(new ScriptVM(program, this));
+    m_scriptSession->start(program.entry(procedure));
+    m_scriptSessionName = name;
+    m_debugWidget->seekToEnd();
+    statusBar()->showMessage(QString("%1: next instruction on line %2, press Next Instruction to execute it.")
+                                 .arg(name).arg(m_scriptSession->currentLine()));
+}
+
+void MainWindow::updateScriptMenu() {
+    m_scriptMenu->clear();
+    for (const Script &script : m_scripts) {
+        for (const ScriptProgram::Procedure &p : script.program.procedures) {
+            const QString name = QFileInfo(script.fileName).completeBaseName() + ": " + p.name;
+            const ScriptProgram program = script.program;
+            QAction *a = m_scriptMenu->addAction(name);
+            connect(a, &QAction::triggered, this, [=](){
+                if (m_stepScriptsAction->isChecked())
+                    startScriptSession(name, program, p.name);
+                else
+                    runAgent(name, [=]() { ScriptVM::run(program, p.name, commandTarget); });
+            });
+        }
+    }
+    m_scriptMenu->setEnabled(!m_scriptMenu->isEmpty());
+}
+
+QString MainWindow::worldDirectory() const {
+    return m_library->directory().isEmpty() ? WORLD_DIRECTORY : m_library->directory();
+}
+
+void MainWindow::setupUI() {
+    // Made before the menus, World > World Library shows and hides it.
+    m_libraryDock = new QDockWidget("World Library", this);
+    m_libraryDock->setWidget(m_library = new WorldLibraryWidget(m_libraryDock));
+    addDockWidget(Qt::LeftDockWidgetArea, m_libraryDock);
+    m_libraryDock->hide();
+    setupMenuBar();
+    setupToolBar();
+
+    // The player gets the trace of the tab that is shown.
+    m_player = new TracePlayer(nullptr, this);
+    m_profileWindow = new ProfileWindow(this);
+    m_tabs = new QTabWidget(this);
+    m_tabs->setTabsClosable(true);
+    m_tabs->setDocumentMode(true);
+    connect(m_tabs, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
+    connect(m_tabs, &QTabWidget::tabCloseRequested, this, &MainWindow::onCloseTab);
+    setCentralWidget(m_tabs);
+    addSession();
+}
+
+void MainWindow::setupMenuBar() {
+    QMenuBar* menubar = new QMenuBar(this);
+
+    // Assign actions to variables and link them too.
+    QMenu* fileMenu = menubar->addMenu("&World");
+    fileMenu->addAction(m_openWorldAction = new QAction("&Open", this));
+    fileMenu->addAction(m_openTabAction = new QAction("Open In New &Tab", this));
+    fileMenu->addAction(m_libraryDock->toggleViewAction());
+    m_libraryDock->toggleViewAction()->setText("World &Library");
+    fileMenu->addAction(m_newTabAction = new QAction("New T&ab", this));
+    fileMenu->addAction(m_saveWorldAction = new QAction("&Save", this));
+    fileMenu->addAction(m_newWorldAction = new QAction("&New", this));
+    fileMenu->addAction(m_rerunAction = new QAction("&Reload And Rerun Program", this));
+    fileMenu->addAction(m_exportRunAction = new QAction("&Export Run...", this));
+    fileMenu->addAction(m_heatmapAction = new QAction("Show &Heatmap", this));
+    m_heatmapAction->setCheckable(true);
+    // Render statistics: paint times, latencies and stalls over the world, and in a log (see renderstats.h).
+    fileMenu->addAction(m_renderStatsAction = new QAction("Show Render S&tatistics", this));
+    m_renderStatsAction->setCheckable(true);
+    fileMenu->addAction(m_goalWorldAction = new QAction("Compare With &Goal World...", this));
+    fileMenu->addAction(m_clearGoalWorldAction = new QAction("&Clear Goal World", this));
+
+    // Collect student programmed routines from agent.h.
+    QMenu* progamMenu = menubar->addMenu("&Programs");
+    for (const auto& agent : AGENTS_TABLE) {
+        QAction *a = progamMenu->addAction(agent.first);
+        connect(a, &QAction::triggered, this, [=](){
+            runAgent(agent.first, agent.second);
+        });
+    }
+    // Programs from plugins (see charlesplugin.h).
+    m_pluginMenu = progamMenu->addMenu("P&lugins");
+    progamMenu->addAction(m_loadPluginAction = new QAction("Load &Plugin...", this));
+    progamMenu->addAction(m_loadPluginDirectoryAction = new QAction("Load Plugin &Directory...", this));
+    // Programs from scripts (see charlesscript.h).
+    m_scriptMenu = progamMenu->addMenu("S&cripts");
+    progamMenu->addAction(m_loadScriptAction = new QAction("Load S&cript...", this));
+    progamMenu->addAction(m_stepScriptsAction = new QAction("S&tep Through Scripts", this));
+    m_stepScriptsAction->setCheckable(true);
+    progamMenu->addSeparator();
+    // Batch mode: errors do not throw, the program continues without effect (see commands.h).
+    progamMenu->addAction(m_batchModeAction = new QAction("&Batch Mode (Stop On Error)", this));
+    m_batchModeAction->setCheckable(true);
+    // Sandbox: run programs in a separate process, so crashes and endless loops do not take QCharles down.
+    // Programs always run in batch mode there.
+    progamMenu->addAction(m_sandboxAction = new QAction("Run In &Sandbox (Batch Mode)", this));
+    m_sandboxAction->setCheckable(true);
+    progamMenu->addAction(m_stopSandboxAction = new QAction("Sto&p Sandbox Runs", this));
+    // Group: run all programs, those that behave the same on the world need to be reviewed only once.
+    progamMenu->addAction(m_groupProgramsAction = new QAction("&Group Programs By Behaviour", this));
+    // Compare: align the trace of this tab with the trace of another one, e.g. a reference run (see tracediff.h).
+    progamMenu->addAction(m_compareTraceAction = new QAction("Compare Trace &With Tab...", this));
+    // Animate: after a run, play its trace back at the speed of the playback tool bar.
+    progamMenu->addAction(m_animateAction = new QAction("&Animate Runs", this));
+    m_animateAction->setCheckable(true);
+    progamMenu->addAction(m_profileAction = new QAction("Show Pro&file", this));
+    // Fold sensors: a sensor query gets no item of its own, it is shown with the next action (see debugtracewidget.h).
+    progamMenu->addAction(m_foldSensorsAction = new QAction("F&old Sensor Queries", this));
+    m_foldSensorsAction->setCheckable(true);
+    progamMenu->addAction(m_traceBudgetAction = new QAction("Trace &Memory Budget...", this));
+    // External agents: programs in other processes send their commands over a local socket (see commandserver.h).
+    progamMenu->addAction(m_externalAgentsAction = new QAction("Accept E&xternal Agents", this));
+    m_externalAgentsAction->setCheckable(true);
+
+    setMenuBar(menubar);
+}
+
+void MainWindow::setupToolBar()
+{
+    auto toolBar = addToolBar("Charles Actions");
+    toolBar->addAction(m_stepAction = new QAction("Step", this));
+    toolBar->addAction(m_turnLeftAction = new QAction("Left", this));
+    toolBar->addAction(m_turnRightAction = new QAction("Right", this));
+    toolBar->addAction(m_getBallAction = new QAction("Get Ball", this));
+    toolBar->addAction(m_putBallAction = new QAction("Put Ball", this));
+    toolBar->addAction(m_scriptInstructionAction = new QAction("Next Instruction", this));
+    for (QAction *a : toolBar->actions())
+        connect(a, &QAction::triggered, this, [=]() { m_inputLatency.start(); });
+
+    auto playbackBar = addToolBar("Playback");
+    playbackBar->addAction(m_playAction = new QAction("Play", this));
+    m_playAction->setCheckable(true);
+    playbackBar->addWidget(m_speedSlider = new QSlider(Qt::Horizontal, playbackBar));
+    m_speedSlider->setRange(0, SPEED_STEPS);
+    playbackBar->addWidget(m_speedLabel = new QLabel(playbackBar));
+}
+
+bool MainWindow::askForSave() {
+    if (m_session->saved)
+        return true;
+    auto answer = QMessageBox::question(this, "Unsaved changes", "Do you want to save the current file?",
+                                        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+    if (answer == QMessageBox::Cancel)
+        return false;
+    if (answer == QMessageBox::Yes) {
+        // Cancelling the file dialog leaves the world unsaved. The session may be dropped right after this, so
+        // the file must be written before.
+        return saveWorld(true);
+    }
+    return true;
+}
@@ -1,56 +1,257 @@
-#pragma once
-
-#include <QMainWindow>
-#include <QPixmap>
-#include <QAction>
-
-#include "worldwidget.h"
-#include "debugtracewidget.h"
-
-class MainWindow : public QMainWindow
-{
-    Q_OBJECT
-public:
-    MainWindow(QWidget *parent = nullptr);
-
-    // World actions via debug trace.
-    bool onBall();
-    bool inFrontOfWall();
-    void step();
-    void turnLeft();
-    void turnRight();
-    void getBall();
-    void putBall();
-    void debugMessage(const QString& msg);
-
-private slots:
-    // File actions
-    void onOpenWorldAction();
-    void onSaveWorldAction();
-    void onNewWorldAction();
-
-    // UI world actions: Execute functions and display any exception in a messagebox.
-    void onStepAction();
-    void onTurnLeftAction();
-    void onTurnRightAction();
-    void onGetBallAction();
-    void onPutBallAction();
-
-private:
-    // Insert into debug trace. World object will be updated if
-    // DebugKind represents an action that changes the world.
-    void debugTrace(DebugKind k, const QString& msg ="");
-
-    void setupUI();
-    void setupMenuBar();
-    void setupToolBar();
-    void askForSave();
-
-    WorldWidget *m_worldWidget;
-    DebugTraceWidget *m_debugWidget;
-    QAction *m_openWorldAction, *m_saveWorldAction, *m_newWorldAction,
-        *m_stepAction, *m_turnRightAction, *m_turnLeftAction,
-        *m_putBallAction, *m_getBallAction;
-    bool m_saved = true;
-};
-
+#pragma once
+
+#include <QMainWindow>
+#include <QPixmap>
+#include <QAction>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <memory>
+
+#include "worldsession.h"
+#include "agentplugin.h"
+#include "commandtarget.h"
+#include "workerpool.h"
+#include "scriptvm.h"
+#include "traceplayer.h"
+#include "worldfilejob.h"
+#include "worldautosaver.h"
+#include "runexportjob.h"
+#include "profilewindow.h"
+#include "commandserver.h"
+#include "tracefingerprint.h"
+
+class QSlider;
+class QLabel;
+class QTabWidget;
+class QDockWidget;
+class QProgressDialog;
+class WorldLibraryWidget;
+
+class MainWindow : public QMainWindow, public CommandTarget
+{
+    Q_OBJECT
+public:
+    MainWindow(QWidget *parent = nullptr);
+
+    // World actions via debug trace.
+    bool onBall() override;
+    bool inFrontOfWall() override;
+    void step() override;
+    void turnLeft() override;
+    void turnRight() override;
+    void getBall() override;
+    void putBall() override;
+    void debugMessage(const QString& msg) override;
+
+    // Robot actions (worlds with multiple robots).
+    int robotCount() override;
+    int robotId(int i) override;
+    void selectRobot(int id) override;
+    void beginTick() override;
+    void endTick() override;
+
+protected:
+    // Measures the frames of the window for the render statistics (see renderstats.h).
+    bool event(QEvent *event) override;
+
+private slots:
+    // Tabs
+    // Show the session of tab index, the view of the session that was shown is dropped.
+    void onTabChanged(int index);
+    // Close the session of tab index, after asking to save it. The last tab is replaced by an empty one.
+    void onCloseTab(int index);
+
+    // File actions
+    void onOpenWorldAction();
+    void onSaveWorldAction();
+    void onNewWorldAction();
+    // Reload the world file and rerun the last program, replaying the part of the trace that is unchanged.
+    void onRerunAction();
+    // Render the trace to an animated GIF or PNG sequence in the background.
+    void onExportRunAction();
+    // Load a goal world to compare the world with, the differences are marked in the world.
+    void onGoalWorldAction();
+    void onClearGoalWorldAction();
+
+    // Program actions
+    void onLoadPluginAction();
+    void onLoadPluginDirectoryAction();
+    void onLoadScriptAction();
+    // Execute the next instruction of the script that is being stepped through.
+    void onScriptInstructionAction();
+    // Rebuild the plugin menu after plugins were (re)loaded.
+    void updatePluginMenu();
+    // Append the trace of a program that ran in the sandbox.
+    void onSandboxJobFinished(int id, const SandboxResult& result);
+    // Run every program on the world and group them by behaviour (see tracefingerprint.h), in the sandbox if there is one.
+    void onGroupProgramsAction();
+    void onGroupJobFinished(int id, const SandboxResult& result);
+    // Cancel the sandbox run and the grouping runs.
+    void onStopSandboxAction();
+    // Show the diff of the trace of this tab and the trace of another tab (see tracediffwindow.h).
+    void onCompareTraceAction();
+    // A program in another process connected to the command server (see commandserver.h). It runs like
+    // runAgent() does, in batches as its requests arrive, until it disconnects.
+    void onExternalAgentConnected();
+    void onExternalBatchStarted();
+    void onExternalBatchFinished(int requests);
+    void onExternalAgentDisconnected();
+    // Drop the external agent and end its run on the current session, e.g. before the session is left.
+    void endExternalRun();
+
+    // Playback speed slider moved.
+    void onSpeedChanged(int value);
+
+    // UI world actions: Execute functions and display any exception in a messagebox.
+    void onStepAction();
+    void onTurnLeftAction();
+    void onTurnRightAction();
+    void onGetBallAction();
+    void onPutBallAction();
+
+private:
+    // Insert into debug trace. World object will be updated if
+    // DebugKind represents an action that changes the world.
+    void debugTrace(DebugKind k, const QString& msg ="");
+    // Execute a world changing action. In batch mode errors do not throw, but stop the run (see commands.h).
+    void worldAction(DebugKind k);
+    // Trace a robot error (bad robot id). Throws, or stops the run in batch mode.
+    void robotError(const QString& msg);
+    // Run a student program. Exceptions are caught and shown to the user.
+    void runAgent(const QString& name, const AgentFunction& agent);
+    // Move the trace back to the item before event and play it from there (when Animate Runs is checked).
+    void animateFrom(int event);
+    // Run a student program in a sandbox process (see workerpool.h), the trace is added when it finishes.
+    void runInSandbox(const QString& name);
+    // Returns a file with the world at the end of the trace for the sandbox, empty if it cannot be saved.
+    QString sandboxWorldFile();
+    // Returns the sandbox job that runs program name on worldFile.
+    SandboxJob sandboxJob(const QString& name, const QString& worldFile) const;
+    // Submit job to the worker pool and remember its world file. Returns the id of the job.
+    int submitSandboxJob(const SandboxJob& job);
+    // Remove worldFile if it is a sandbox world and no submitted job runs on it any more.
+    void releaseSandboxWorld(const QString& worldFile);
+    // Returns the names of all programs: compiled in, from scripts and from plugins.
+    QStringList programNames() const;
+    // Show the groups of m_groupRuns, choosing one runs its first program for review.
+    void showBehaviourGroups();
+    // Returns the program with this name (compiled in, from a script or from a plugin), or an empty function.
+    AgentFunction findAgent(const QString& name) const;
+    // Start stepping through a procedure of a script, see onScriptInstructionAction.
+    void startScriptSession(const QString& name, const ScriptProgram& program, const QString& procedure);
+    // Rebuild the script menu after a script was loaded.
+    void updateScriptMenu();
+    // During a rerun, consume the next recorded event instead of executing the command.
+    // Returns false when the recorded part is over (or the program deviates from it) and the command runs live.
+    bool replayed(DebugKind k, bool *answer = nullptr);
+
+    // Open a new tab with an untitled world and show it.
+    WorldSession *addSession();
+    // Ask for a world file and load it in the background, in a new tab if inNewTab. Errors offer to try again.
+    void openWorld(bool inNewTab = false);
+    // Load fileName (or the newer autosave of it, if the user wants to recover that) in the background.
+    void loadWorld(const QString& fileName);
+    // Show the progress of a background load or save, with a cancel button.
+    // Returns the dialog, which is deleted when the job has finished.
+    QProgressDialog *showProgress(const QString& label, WorldFileJob *job);
+    // Ask for a file name and save the world to it in the background. If wait, the rest of the UI waits until the file
+    // is written. Returns false if no file was chosen, or if wait and the save failed or was cancelled.
+    bool saveWorld(bool wait = false);
+    // Returns the visit counters of the last run for the status bar, e.g. " 12 fields visited, ...".
+    // With a goal world the differences with it follow.
+    QString visitReport() const;
+    // Returns the differences with the goal world for the status bar, empty without a goal world.
+    QString goalReport() const;
+    // Show a menu of the trace items that touched field p, choosing one seeks the trace to it.
+    void showCellHistory(QPoint p);
+    // The run of program name that just ended, for rerunning it. Only the events that fit the trace memory
+    // budget are kept (at least the ones before the program), the rest of a rerun is executed live.
+    AgentRun recordedRun(const QString &name, int firstEvent) const;
+    // Turn the render statistics, their heads-up display and their log on/off.
+    void setRenderStats(bool on);
+
+    // The directory the file dialogs start in: the one of the world library, WORLD_DIRECTORY without a library.
+    QString worldDirectory() const;
+
+    void setupUI();
+    void setupMenuBar();
+    void setupToolBar();
+    // Ask to save the world of the shown session if it has changes. Returns false if the user cancelled, or cancelled
+    // saving: the world must be kept.
+    bool askForSave();
+
+    // The sessions in the order of their tabs, and the one that is shown. The world and trace actions
+    // work on the shown session, m_worldWidget and m_debugWidget are its view.
+    QTabWidget *m_tabs;
+    QVector<WorldSession*> m_sessions;
+    WorldSession *m_session = nullptr;
+    WorldWidget *m_worldWidget = nullptr;
+    DebugTraceWidget *m_debugWidget = nullptr;
+    QAction *m_openWorldAction, *m_openTabAction, *m_newTabAction, *m_saveWorldAction, *m_newWorldAction, *m_rerunAction, *m_exportRunAction, *m_heatmapAction,
+        *m_renderStatsAction, *m_goalWorldAction, *m_clearGoalWorldAction,
+        *m_stepAction, *m_turnRightAction, *m_turnLeftAction,
+        *m_putBallAction, *m_getBallAction, *m_batchModeAction, *m_sandboxAction, *m_stopSandboxAction,
+        *m_loadPluginAction, *m_loadPluginDirectoryAction,
+        *m_loadScriptAction, *m_stepScriptsAction, *m_scriptInstructionAction,
+        *m_animateAction, *m_playAction, *m_profileAction, *m_foldSensorsAction, *m_traceBudgetAction,
+        *m_externalAgentsAction, *m_groupProgramsAction, *m_compareTraceAction;
+    QSlider *m_speedSlider;
+    QLabel *m_speedLabel;
+    TracePlayer *m_player;
+    ProfileWindow *m_profileWindow;
+    // The world library (see worldlibrary.h), docked on the left.
+    QDockWidget *m_libraryDock;
+    WorldLibraryWidget *m_library;
+    QMenu *m_pluginMenu, *m_scriptMenu;
+    AgentPluginLoader *m_plugins;
+    WorkerPool *m_workerPool;
+    // Serves external agents while Programs > Accept External Agents is checked.
+    CommandServer *m_commandServer;
+    // Trace items kept in memory per trace, the rest is spilled to disk (see TraceModel).
+    int m_traceBudget = TraceModel::DEFAULT_BUDGET;
+    // While the render statistics are on, a late heartbeat is an event loop stall. The input latency runs
+    // from a tool bar action to the end of the next frame, it is invalid while no action waits for its frame.
+    QTimer *m_heartbeat;
+    QElapsedTimer m_heartbeatClock, m_inputLatency;
+    // Number of worlds that are being loaded or saved in the background.
+    int m_fileJobs = 0;
+
+    // Batch mode: after the first error all actions are no-ops and
+    // sensors return values from m_sensorNoise (seeded per run, so runs are reproducible).
+    bool m_batchMode = false;
+    bool m_runFailed = false;
+    QRandomGenerator m_sensorNoise;
+
+    // Between begin_tick() and end_tick() actions are collected per robot index instead of executed.
+    bool m_inTick = false;
+    QVector<RobotAction> m_tickActions;
+
+    // Loaded scripts (see charlesscript.h). Their procedures are named "<file base name>: <procedure>".
+    struct Script {
+        QString fileName;
+        ScriptProgram program;
+    };
+    QVector<Script> m_scripts;
+    // The script procedure that is stepped through instruction by instruction, if any.
+    std::unique_ptr<ScriptVM> m_scriptSession;
+    QString m_scriptSessionName;
+
+    // While rerunning, commands are answered from m_replay[m_replayPos ... m_replayEnd), after that they run live.
+    QVector<TraceEvent> m_replay;
+    int m_replayPos = 0, m_replayEnd = 0;
+
+    // The program running in the sandbox (one at a time) for m_sandboxSession, its world is saved in m_sandboxDir.
+    int m_sandboxJob = -1;
+    WorldSession *m_sandboxSession = nullptr;
+    AgentRun m_sandboxRun;
+    QTemporaryDir m_sandboxDir;
+    int m_sandboxWorlds = 0;
+    // The world file of every submitted job that did not finish yet, by id.
+    QHash<int, QString> m_jobWorlds;
+
+    // Programs > Group Programs By Behaviour: the sandbox jobs that still run, by id, and the runs that ended.
+    QHash<int, QString> m_groupJobs;
+    QVector<RunOutcome> m_groupRuns;
+};
+
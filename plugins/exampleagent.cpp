@@ -0,0 +1,19 @@
+// Example of a student program that is loaded as a plugin (see charlesplugin.h).
+#include "charlesplugin.h"
+
+void to_wall() {
+    while (!in_front_of_wall())
+        step();
+}
+
+void around_the_block() {
+    for (int i = 0; i < 4; ++i) {
+        to_wall();
+        turn_right();
+    }
+}
+
+CHARLES_AGENTS(
+    {"To Wall", to_wall},
+    {"Around The Block", around_the_block}
+)
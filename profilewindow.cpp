@@ -0,0 +1,276 @@
+#include "profilewindow.h"
+#include "callprofile.h"
+
+#include <QVBoxLayout>
+#include <QSplitter>
+#include <QTabWidget>
+#include <QScrollArea>
+#include <QHeaderView>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextBlock>
+#include <QFontDatabase>
+#include <functional>
+
+const static int ROW_HEIGHT = 18;
+
+/*
+ * The call paths of the program as a flame graph: the program at the bottom, the functions it called on top of it,
+ * each as wide as its share of the commands.
+ */
+class FlameGraph : public QWidget
+{
+public:
+    explicit FlameGraph(QWidget *parent)
+        : QWidget{parent}
+    {
+        setMinimumHeight(ROW_HEIGHT);
+    }
+
+    // Called with the node of a function that is clicked.
+    std::function<void(int node)> onClicked;
+
+    void setProfile(int program, const QVector<qint64>& totals, const QVector<QVector<int>>& children) {
+        m_program = program;
+        m_totals = totals;
+        m_children = children;
+        setMinimumHeight((program == -1 ? 1 : depth(program)) * ROW_HEIGHT);
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override {
+        QPainter painter(this);
+        m_boxes.clear();
+        if (m_program == -1 || m_totals[m_program] == 0) {
+            painter.drawText(rect(), Qt::AlignCenter, "No commands were counted in the last run.");
+            return;
+        }
+        paintNode(painter, m_program, 0, width(), 0);
+    }
+
+    void mousePressEvent(QMouseEvent *event) override {
+        for (const auto &box : m_boxes) {
+            if (box.first.contains(event->position()) && onClicked)
+                onClicked(box.second);
+        }
+    }
+
+private:
+    // Returns the number of rows of node and the functions it called.
+    int depth(int node) const {
+        int d = 0;
+        for (int c : m_children[node])
+            d = qMax(d, depth(c));
+        return d + 1;
+    }
+
+    void paintNode(QPainter &painter, int node, double x, double w, int row) {
+        const CallProfile::Node &n = CallProfile::instance().nodes()[node];
+        const QRectF box(x, height() - (row + 1) * ROW_HEIGHT, w, ROW_HEIGHT - 1);
+        m_boxes.push_back(qMakePair(box, node));
+        // Warm colors, the same for the same function.
+        const int hash = static_cast<int>(qHash(n.name) % 3000);
+        painter.fillRect(box, QColor::fromHsv(hash % 50, 140 + hash / 50, 240));
+        const QString label = QString("%1 (%2)").arg(n.name).arg(m_totals[node]);
+        painter.drawText(box.adjusted(3, 0, -3, 0), Qt::AlignLeft | Qt::AlignVCenter,
+                         painter.fontMetrics().elidedText(label, Qt::ElideRight, qMax(0, int(w) - 6)));
+
+        double cx = x;
+        for (int c : m_children[node]) {
+            const double cw = w * m_totals[c] / m_totals[node];
+            // Functions narrower than a pixel are left out.
+            if (cw >= 1)
+                paintNode(painter, c, cx, cw, row + 1);
+            cx += cw;
+        }
+    }
+
+    int m_program = -1;
+    QVector<qint64> m_totals;
+    QVector<QVector<int>> m_children;
+    // The painted functions, for clicks.
+    QVector<QPair<QRectF, int>> m_boxes;
+};
+
+// Returns a table item that sorts as a number.
+static QTableWidgetItem *numberItem(qint64 value) {
+    QTableWidgetItem *item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, value);
+    return item;
+}
+
+static QTableWidget *makeTable(const QStringList &headers, QWidget *parent) {
+    QTableWidget *table = new QTableWidget(0, headers.size(), parent);
+    table->setHorizontalHeaderLabels(headers);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    return table;
+}
+
+ProfileWindow::ProfileWindow(QWidget *parent)
+    : QWidget{parent, Qt::Window}
+{
+    setWindowTitle("Profile");
+    resize(800, 600);
+
+    QTabWidget *tabs = new QTabWidget(this);
+    QScrollArea *scroll = new QScrollArea(tabs);
+    scroll->setWidgetResizable(true);
+    scroll->setWidget(m_flameGraph = new FlameGraph(scroll));
+    tabs->addTab(scroll, "Flame Graph");
+    tabs->addTab(m_functions = makeTable({"Function", "File", "Self", "Total"}, tabs), "Functions");
+    tabs->addTab(m_paths = makeTable({"Call Path", "Self", "Total"}, tabs), "Call Paths");
+
+    QWidget *sourcePane = new QWidget(this);
+    QVBoxLayout *sourceLayout = new QVBoxLayout(sourcePane);
+    sourceLayout->setContentsMargins(0, 0, 0, 0);
+    sourceLayout->addWidget(m_sourceLabel = new QLabel("Click a function or double click a trace item to see its source.", sourcePane));
+    sourceLayout->addWidget(m_source = new QPlainTextEdit(sourcePane));
+    m_source->setReadOnly(true);
+    m_source->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_source->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+    splitter->addWidget(tabs);
+    splitter->addWidget(sourcePane);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(splitter);
+
+    m_flameGraph->onClicked = [this](int node) { showNode(node); };
+    for (QTableWidget *table : {m_functions, m_paths}) {
+        connect(table, &QTableWidget::cellClicked, this, [this, table](int row) {
+            showNode(table->item(row, 0)->data(Qt::UserRole).toInt());
+        });
+    }
+}
+
+void ProfileWindow::refresh() {
+    const CallProfile &profile = CallProfile::instance();
+    const QVector<qint64> totals = profile.totals();
+    QVector<QVector<int>> children(profile.nodes().size());
+    for (int i = 0; i < profile.nodes().size(); ++i) {
+        if (profile.nodes()[i].parent != -1)
+            children[profile.nodes()[i].parent].push_back(i);
+    }
+    const int program = profile.programNode();
+    m_flameGraph->setProfile(program, totals, children);
+    fillFunctions(program, totals, children);
+    fillPaths(program, totals, children);
+    if (program != -1)
+        setWindowTitle(QString("Profile of %1: %2 commands").arg(profile.nodes()[program].name).arg(totals[program]));
+}
+
+void ProfileWindow::showSite(int site) {
+    const CallProfile &profile = CallProfile::instance();
+    showSource(profile.nodes()[profile.site(site).node].file, profile.site(site).line);
+}
+
+void ProfileWindow::showNode(int node) {
+    const CallProfile::Node &n = CallProfile::instance().nodes()[node];
+    if (!n.file.isEmpty())
+        showSource(n.file, n.line);
+}
+
+void ProfileWindow::showSource(const QString &fileName, int line) {
+    if (fileName != m_sourceFile) {
+        QFile file(fileName);
+        if (!file.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text)) {
+            m_sourceLabel->setText("The source " + fileName + " is not found.");
+            m_source->clear();
+            m_sourceFile.clear();
+            return;
+        }
+        m_source->setPlainText(QString::fromUtf8(file.readAll()));
+        m_sourceFile = fileName;
+    }
+    m_sourceLabel->setText(QString("%1, line %2").arg(QFileInfo(fileName).fileName()).arg(line));
+
+    QTextEdit::ExtraSelection selection;
+    selection.format.setBackground(QColor(255, 240, 150));
+    selection.format.setProperty(QTextFormat::FullWidthSelection, true);
+    selection.cursor = QTextCursor(m_source->document()->findBlockByNumber(line - 1));
+    m_source->setExtraSelections({selection});
+    m_source->setTextCursor(selection.cursor);
+    m_source->centerCursor();
+}
+
+void ProfileWindow::fillFunctions(int program, const QVector<qint64> &totals, const QVector<QVector<int>> &children) {
+    const QVector<CallProfile::Node> &nodes = CallProfile::instance().nodes();
+    struct Function {
+        int node;
+        qint64 self = 0;
+        qint64 total = 0;
+    };
+    // By name and file. A recursive function counts its total only once: at its outermost call.
+    QHash<QString, Function> functions;
+    QHash<QString, int> running;
+    // Depth first, a node is on the stack twice: to enter it (true) and to leave it (false).
+    QVector<QPair<int, bool>> stack;
+    if (program != -1) {
+        for (int c : children[program])
+            stack.push_back(qMakePair(c, true));
+    }
+    while (!stack.isEmpty()) {
+        const QPair<int, bool> top = stack.takeLast();
+        const QString key = nodes[top.first].name + '\n' + nodes[top.first].file;
+        if (!top.second) {
+            --running[key];
+            continue;
+        }
+        auto it = functions.find(key);
+        if (it == functions.end())
+            it = functions.insert(key, Function{top.first});
+        it->self += nodes[top.first].self;
+        if (running[key]++ == 0)
+            it->total += totals[top.first];
+        stack.push_back(qMakePair(top.first, false));
+        for (int c : children[top.first])
+            stack.push_back(qMakePair(c, true));
+    }
+
+    m_functions->setSortingEnabled(false);
+    m_functions->setRowCount(0);
+    for (const Function &f : functions) {
+        if (f.total == 0)
+            continue;
+        const int row = m_functions->rowCount();
+        m_functions->insertRow(row);
+        QTableWidgetItem *name = new QTableWidgetItem(nodes[f.node].name);
+        name->setData(Qt::UserRole, f.node);
+        m_functions->setItem(row, 0, name);
+        m_functions->setItem(row, 1, new QTableWidgetItem(QFileInfo(nodes[f.node].file).fileName()));
+        m_functions->setItem(row, 2, numberItem(f.self));
+        m_functions->setItem(row, 3, numberItem(f.total));
+    }
+    m_functions->setSortingEnabled(true);
+    m_functions->sortByColumn(3, Qt::DescendingOrder);
+}
+
+void ProfileWindow::fillPaths(int program, const QVector<qint64> &totals, const QVector<QVector<int>> &children) {
+    const CallProfile &profile = CallProfile::instance();
+    m_paths->setSortingEnabled(false);
+    m_paths->setRowCount(0);
+    QVector<int> stack;
+    if (program != -1)
+        stack = children[program];
+    while (!stack.isEmpty()) {
+        const int node = stack.takeLast();
+        if (totals[node] == 0)
+            continue;
+        const int row = m_paths->rowCount();
+        m_paths->insertRow(row);
+        QTableWidgetItem *path = new QTableWidgetItem(profile.path(node));
+        path->setData(Qt::UserRole, node);
+        m_paths->setItem(row, 0, path);
+        m_paths->setItem(row, 1, numberItem(profile.nodes()[node].self));
+        m_paths->setItem(row, 2, numberItem(totals[node]));
+        stack += children[node];
+    }
+    m_paths->setSortingEnabled(true);
+    m_paths->sortByColumn(2, Qt::DescendingOrder);
+}
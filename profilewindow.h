@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QWidget>
+#include <QTableWidget>
+#include <QPlainTextEdit>
+#include <QLabel>
+
+class FlameGraph;
+
+/*
+ * Shows the profile of the last run (see CallProfile): a flame graph of the call paths and sortable tables of the
+ * commands per function and per call path. Clicking a function in the graph or a row of a table, or double
+ * clicking an item of the trace, shows its line in the source.
+ */
+
+class ProfileWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ProfileWindow(QWidget *parent = nullptr);
+
+public slots:
+    // Read the profile of the last run again.
+    void refresh();
+    // Show the line of a site of the profile (see TraceEvent::site).
+    void showSite(int site);
+
+private:
+    // Show the place of a node: its CALL_SCOPE or first command.
+    void showNode(int node);
+    void showSource(const QString& fileName, int line);
+    void fillFunctions(int program, const QVector<qint64>& totals, const QVector<QVector<int>>& children);
+    void fillPaths(int program, const QVector<qint64>& totals, const QVector<QVector<int>>& children);
+
+    FlameGraph *m_flameGraph;
+    QTableWidget *m_functions;
+    QTableWidget *m_paths;
+    QLabel *m_sourceLabel;
+    QPlainTextEdit *m_source;
+    // The file in m_source.
+    QString m_sourceFile;
+};
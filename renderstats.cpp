@@ -0,0 +1,118 @@
+#include "renderstats.h"
+
+#include <cmath>
+
+// Values below this have a bucket of their own, above it a power of two is split in 8 buckets.
+const int EXACT_VALUES = 16;
+
+RenderStats &RenderStats::instance() {
+    static RenderStats stats;
+    return stats;
+}
+
+void RenderStats::setEnabled(bool on) {
+    m_enabled = on;
+    if (on)
+        m_clock.start();
+    else if (m_log.isOpen())
+        m_log.flush();
+}
+
+bool RenderStats::isEnabled() const {
+    return m_enabled;
+}
+
+bool RenderStats::setLogFile(const QString &fileName) {
+    m_log.close();
+    if (fileName.isEmpty())
+        return true;
+    m_log.setFileName(fileName);
+    return m_log.open(QIODeviceBase::WriteOnly | QIODeviceBase::Append | QIODeviceBase::Text);
+}
+
+QString RenderStats::logFile() const {
+    return m_log.isOpen() ? m_log.fileName() : QString();
+}
+
+void RenderStats::record(RenderMeasure m, qint64 value) {
+    if (!m_enabled)
+        return;
+    value = qMax<qint64>(value, 0);
+    Histogram &h = m_histograms[m];
+    ++h.buckets[bucketOf(value)];
+    h.min = h.count == 0 ? value : qMin(h.min, value);
+    h.max = h.count == 0 ? value : qMax(h.max, value);
+    ++h.count;
+    if (m_log.isOpen())
+        m_log.write(QString("%1,%2,%3\n").arg(m_clock.elapsed()).arg(measureName(m)).arg(value).toUtf8());
+}
+
+RenderStats::Summary RenderStats::summary(RenderMeasure m) const {
+    const Histogram &h = m_histograms[m];
+    return Summary{h.count, h.min, percentile(h, 0.5), percentile(h, 0.99), h.max};
+}
+
+void RenderStats::reset() {
+    m_histograms = {};
+}
+
+QStringList RenderStats::report() const {
+    QStringList lines;
+    for (int m = 0; m < RENDER_MEASURE_COUNT; ++m) {
+        const Summary s = summary(static_cast<RenderMeasure>(m));
+        // Times are shown in milliseconds, the cells as they are.
+        const double scale = m == RenderMeasure::CellsRepainted ? 1 : 1000;
+        lines.push_back(QString("%1: %2x  min %3  p50 %4  p99 %5  max %6").arg(measureName(static_cast<RenderMeasure>(m)))
+                            .arg(s.count).arg(s.min / scale, 0, 'g', 3).arg(s.p50 / scale, 0, 'g', 3)
+                            .arg(s.p99 / scale, 0, 'g', 3).arg(s.max / scale, 0, 'g', 3));
+    }
+    return lines;
+}
+
+QString RenderStats::measureName(RenderMeasure m) {
+    switch (m) {
+    case RenderMeasure::PaintTime:
+        return "paint ms";
+    case RenderMeasure::CellsRepainted:
+        return "cells repainted";
+    case RenderMeasure::LoadUITime:
+        return "load UI ms";
+    case RenderMeasure::ClearUITime:
+        return "clear UI ms";
+    case RenderMeasure::EventLoopStall:
+        return "event loop stall ms";
+    case RenderMeasure::InputLatency:
+        return "input latency ms";
+    }
+    return QString();
+}
+
+int RenderStats::bucketOf(qint64 value) {
+    if (value < EXACT_VALUES)
+        return static_cast<int>(value);
+    // The highest bit gives the power of two, the 3 bits below it the bucket within it.
+    int e = 63;
+    while (!(quint64(value) >> e))
+        --e;
+    return EXACT_VALUES + (e - 4) * 8 + static_cast<int>((value >> (e - 3)) & 7);
+}
+
+qint64 RenderStats::bucketValue(int bucket) {
+    if (bucket < EXACT_VALUES)
+        return bucket;
+    const int e = (bucket - EXACT_VALUES) / 8 + 4;
+    return (qint64(8 + (bucket - EXACT_VALUES) % 8)) << (e - 3);
+}
+
+qint64 RenderStats::percentile(const Histogram &h, double p) {
+    if (h.count == 0)
+        return 0;
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(p * h.count)));
+    quint64 seen = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+        seen += h.buckets[b];
+        if (seen >= rank)
+            return qBound(h.min, bucketValue(b), h.max);
+    }
+    return h.max;
+}
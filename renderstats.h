@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QElapsedTimer>
+#include <array>
+
+/*
+ * How long the UI takes to show the world, to set rendering budgets and to catch worlds that make it slower.
+ * Off unless World > Render Statistics is checked, then every sample is also written to a log file.
+ *
+ * The measures (times in microseconds):
+ * - PaintTime: a frame of the main window, from the update request until everything is painted.
+ * - CellsRepainted: the fields of WorldWidget that got a new pixmap since the frame before (frames that change the world).
+ * - LoadUITime, ClearUITime: WorldWidget::loadUIFromWorld() and clearUI().
+ * - EventLoopStall: time the event loop did not run, e.g. while a program runs (see MainWindow).
+ * - InputLatency: from a tool bar action to the end of the next frame.
+ *
+ * Samples are counted in histograms with 8 buckets per power of two, so the percentiles are within about 10%
+ * and the memory stays the same however long the session is.
+ */
+
+enum RenderMeasure { PaintTime = 0, CellsRepainted, LoadUITime, ClearUITime, EventLoopStall, InputLatency };
+const int RENDER_MEASURE_COUNT = 6;
+
+class RenderStats
+{
+public:
+    struct Summary {
+        qint64 count = 0;
+        qint64 min = 0, p50 = 0, p99 = 0, max = 0;
+    };
+
+    static RenderStats &instance();
+
+    void setEnabled(bool on);
+    bool isEnabled() const;
+    // Write every sample to fileName as "<msec since enabled>,<measure>,<value>", an empty name stops the log.
+    // Returns false if the file cannot be opened.
+    bool setLogFile(const QString& fileName);
+    QString logFile() const;
+
+    // Count a sample of measure m, if enabled.
+    void record(RenderMeasure m, qint64 value);
+    Summary summary(RenderMeasure m) const;
+    // Forget all samples.
+    void reset();
+    // Returns a line per measure with its summary, e.g. for a heads-up display.
+    QStringList report() const;
+    static QString measureName(RenderMeasure m);
+
+private:
+    RenderStats() = default;
+
+    constexpr static int BUCKETS = 8 * 64;
+    struct Histogram {
+        std::array<quint64, BUCKETS> buckets {};
+        qint64 count = 0;
+        qint64 min = 0, max = 0;
+    };
+    // Returns the bucket of value, and the smallest value of bucket.
+    static int bucketOf(qint64 value);
+    static qint64 bucketValue(int bucket);
+    // Returns the value below which fraction p of the samples of h lie.
+    static qint64 percentile(const Histogram &h, double p);
+
+    bool m_enabled = false;
+    std::array<Histogram, RENDER_MEASURE_COUNT> m_histograms;
+    QFile m_log;
+    QElapsedTimer m_clock;
+};
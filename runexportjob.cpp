@@ -0,0 +1,177 @@
+#include "runexportjob.h"
+#include "sprites.h"
+#include "gifencoder.h"
+
+#include <QThreadPool>
+#include <QSaveFile>
+#include <new>
+
+// Chunks per thread, more chunks balance the load better but need more snapshots.
+const static int CHUNKS_PER_THREAD = 4;
+
+ExportFailed::ExportFailed(const QString &fileName)
+    : m_what(QString("Could not write %1.").arg(fileName).toUtf8())
+{
+}
+
+const char *ExportFailed::what() const {
+    return m_what.constData();
+}
+
+RunExportJob::RunExportJob(const QVector<TraceEvent> &events, const RunExport &options, QObject *parent)
+    : QObject{parent},
+    m_events(events),
+    m_options(options),
+    m_world(new WorldObject)
+{
+    assert(options.everyNth > 0 && "RunExportJob::RunExportJob: everyNth must be positive.");
+    m_frameCount = (events.size() + options.everyNth - 1) / options.everyNth + 1;
+}
+
+RunExportJob *RunExportJob::start(const WorldObject &world, const WorldSnapshot &start, const QVector<TraceEvent> &events,
+                                  const RunExport &options, QObject *parent) {
+    RunExportJob *job = new RunExportJob(events, options, parent);
+    job->m_world->setEmitUpdates(false);
+    job->m_world->copyWorld(world);
+    job->m_world->restoreSnapshot(start);
+    job->m_thread = QThread::create([job]() { job->run(); });
+    connect(job->m_thread, &QThread::finished, job, &RunExportJob::finished);
+    job->m_thread->start();
+    return job;
+}
+
+RunExportJob::~RunExportJob() {
+    cancel();
+    m_thread->wait();
+    delete m_thread;
+}
+
+bool RunExportJob::isCancelled() const {
+    return m_cancelled;
+}
+
+QString RunExportJob::errorMessage() const {
+    return m_error;
+}
+
+int RunExportJob::frameCount() const {
+    return m_frameCount;
+}
+
+void RunExportJob::cancel() {
+    m_cancel = true;
+}
+
+void RunExportJob::run() {
+    const QSize size = m_world->size();
+    if (qMax(size.width(), size.height()) > MAX_FRAME_SIZE) {
+        m_error = QString("A world of %1 x %2 fields is too large to export.").arg(size.width()).arg(size.height());
+        return;
+    }
+    const Sprites sprites(qBound(1, MAX_FRAME_SIZE / qMax(size.width(), size.height()), Sprites::FIELD_SIZE));
+    const int threads = QThread::idealThreadCount();
+    const int chunks = qMin(m_frameCount, threads * CHUNKS_PER_THREAD);
+    const int chunkSize = (m_frameCount + chunks - 1) / chunks;
+
+    // Replay once, with a snapshot at the first frame of every chunk.
+    QVector<WorldSnapshot> snapshots;
+    try {
+        WorldObject world;
+        world.setEmitUpdates(false);
+        world.copyWorld(*m_world);
+        int item = 0;
+        for (int first = 0; first < m_frameCount; first += chunkSize) {
+            for (; item < frameItem(first); ++item)
+                executeEvent(&world, m_events[item]);
+            snapshots.push_back(world.snapshot());
+        }
+    }
+    catch (QException& e) {
+        m_error = e.what();
+        return;
+    }
+    catch (std::bad_alloc&) {
+        m_error = "Not enough memory to replay the trace.";
+        return;
+    }
+
+    // Every chunk writes its own result, through pointers so the vectors are not touched from several threads.
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QVector<QByteArray> blocks(snapshots.size());
+    QVector<QString> errors(snapshots.size());
+    QByteArray *block = blocks.data();
+    QString *error = errors.data();
+    for (int c = 0; c < snapshots.size(); ++c) {
+        pool.start([&, c]() {
+            try {
+                block[c] = renderChunk(sprites, snapshots.at(c), c * chunkSize, qMin((c + 1) * chunkSize, m_frameCount));
+            }
+            catch (QException& e) {
+                error[c] = e.what();
+                m_cancel = true;
+            }
+            // An exception must not leave a thread of the pool, that would end QCharles.
+            catch (std::bad_alloc&) {
+                error[c] = "Not enough memory to render the frames.";
+                m_cancel = true;
+            }
+        });
+    }
+    pool.waitForDone();
+
+    for (const QString &message : errors) {
+        if (!message.isEmpty()) {
+            m_error = message;
+            return;
+        }
+    }
+    if (m_cancel) {
+        m_cancelled = true;
+        return;
+    }
+    if (m_options.format == ExportFormat::GifExport) {
+        QSaveFile file(m_options.fileName);
+        file.open(QIODeviceBase::WriteOnly);
+        file.write(GifEncoder::header(QSize(size.width() * sprites.size(), size.height() * sprites.size())));
+        for (const QByteArray &block : blocks)
+            file.write(block);
+        file.write(GifEncoder::trailer());
+        if (!file.commit())
+            m_error = "Could not write " + m_options.fileName + ".";
+    }
+}
+
+QByteArray RunExportJob::renderChunk(const Sprites &sprites, const WorldSnapshot &snapshot, int first, int last) {
+    WorldObject world;
+    world.setEmitUpdates(false);
+    world.copyWorld(*m_world);
+    world.restoreSnapshot(snapshot);
+
+    QString baseName = m_options.fileName;
+    if (baseName.endsWith(".png", Qt::CaseInsensitive))
+        baseName.chop(4);
+    QByteArray gif;
+    int item = frameItem(first);
+    for (int frame = first; frame < last && !m_cancel; ++frame) {
+        for (; item < frameItem(frame); ++item)
+            executeEvent(&world, m_events[item]);
+        const QImage image = sprites.render(world);
+        if (m_options.format == ExportFormat::GifExport)
+            gif += GifEncoder::frame(image, m_options.frameDelayMsec);
+        else {
+            const QString fileName = QString("%1_%2.png").arg(baseName).arg(frame, 5, 10, QChar('0'));
+            if (!image.save(fileName))
+                throw ExportFailed(fileName);
+        }
+        // Only report changes of the percentage, the signals are queued to the UI thread.
+        const int done = ++m_framesDone;
+        if (done * 100LL / m_frameCount != (done - 1) * 100LL / m_frameCount)
+            emit progress(static_cast<int>(done * 100LL / m_frameCount));
+    }
+    return gif;
+}
+
+int RunExportJob::frameItem(int frame) const {
+    return static_cast<int>(qMin(static_cast<qint64>(frame) * m_options.everyNth, static_cast<qint64>(m_events.size())));
+}
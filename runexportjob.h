@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+#include "worldobject.h"
+#include "debugtraceitem.h"
+
+/*
+ * Exports a run as images, offscreen and in the background: the world after every Nth item of the trace
+ * (and after the last one) is drawn with the sprites of the WorldWidget (see Sprites) and saved as an
+ * animated GIF or as a numbered PNG sequence.
+ *
+ * The trace is first replayed once on a copy of the start world, taking a snapshot (cheap, copy on write)
+ * at the start of every chunk of frames. The chunks are then rendered and encoded on all cores:
+ * each replays its own part of the trace from its snapshot.
+ */
+
+class Sprites;
+
+enum ExportFormat { GifExport, PngExport };
+
+// Raised when a frame cannot be written.
+struct ExportFailed : public QException {
+    ExportFailed(const QString& fileName);
+    const char *what() const override;
+
+private:
+    QByteArray m_what;
+};
+
+struct RunExport {
+    // The GIF file, or the first part of the PNG file names: "<fileName>_00000.png", ...
+    QString fileName;
+    ExportFormat format = ExportFormat::GifExport;
+    // A frame every this many trace items.
+    int everyNth = 1;
+    int frameDelayMsec = 40;
+};
+
+class RunExportJob : public QObject
+{
+    Q_OBJECT
+public:
+    // Start exporting the run that starts with world start and executes events.
+    static RunExportJob *start(const WorldObject& world, const WorldSnapshot& start, const QVector<TraceEvent>& events,
+                               const RunExport& options, QObject *parent = nullptr);
+    // Cancels the job and waits for the thread.
+    ~RunExportJob();
+
+    // Returns true iff the job was cancelled (after finished()).
+    bool isCancelled() const;
+    // Returns the error, or an empty string if the job succeeded or was cancelled.
+    QString errorMessage() const;
+    int frameCount() const;
+
+    // Frames are at most this many pixels wide and high, huge worlds get smaller sprites.
+    constexpr static int MAX_FRAME_SIZE = 2048;
+
+public slots:
+    // Stop as soon as possible, finished() follows.
+    void cancel();
+
+signals:
+    // Progress in percent.
+    void progress(int percent);
+    // The job has ended: done, cancelled or failed.
+    void finished();
+
+private:
+    RunExportJob(const QVector<TraceEvent>& events, const RunExport& options, QObject *parent);
+    // Runs on the background thread.
+    void run();
+    // Render the frames [first, last) starting from a snapshot at the item of frame first.
+    // Returns the GIF blocks of the frames (empty for PNG). Runs on a pool thread.
+    QByteArray renderChunk(const Sprites& sprites, const WorldSnapshot& snapshot, int first, int last);
+    // Returns the trace item of a frame.
+    int frameItem(int frame) const;
+
+    const QVector<TraceEvent> m_events;
+    const RunExport m_options;
+    // The start world. Used by the background threads, so it has no parent.
+    std::unique_ptr<WorldObject> m_world;
+    QThread *m_thread = nullptr;
+    std::atomic<bool> m_cancel { false };
+    std::atomic<int> m_framesDone { 0 };
+    int m_frameCount = 0;
+    // Written by the thread, only read after it has finished.
+    bool m_cancelled = false;
+    QString m_error;
+};
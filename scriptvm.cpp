@@ -0,0 +1,122 @@
+#include "scriptvm.h"
+
+const char *ScriptStackOverflow::what() const {
+    return "Too many nested procedure calls (endless recursion?).";
+}
+
+ScriptVM::ScriptVM(const ScriptProgram &program, CommandTarget *target)
+    : m_program(program),
+    m_target(target)
+{
+}
+
+void ScriptVM::start(int entry) {
+    assert(entry >= 0 && entry < m_program.code.size() && "ScriptVM::start: entry is not in the program.");
+    m_pc = entry;
+    m_flag = false;
+    m_callStack.clear();
+    m_instructions = 0;
+}
+
+void ScriptVM::run() {
+    execute(-1);
+}
+
+bool ScriptVM::stepInstruction() {
+    if (isRunning())
+        execute(1);
+    return isRunning();
+}
+
+bool ScriptVM::isRunning() const {
+    return m_pc != -1;
+}
+
+int ScriptVM::currentLine() const {
+    return isRunning() ? m_program.lines[m_pc] : -1;
+}
+
+qint64 ScriptVM::instructionCount() const {
+    return m_instructions;
+}
+
+void ScriptVM::run(const ScriptProgram &program, const QString &procedure, CommandTarget *target) {
+    ScriptVM vm(program, target);
+    vm.start(program.entry(procedure));
+    vm.run();
+}
+
+void ScriptVM::execute(qint64 count) {
+    // The pc is moved past an instruction before it executes, so an exception leaves the VM at the next one.
+    const qint32 *code = m_program.code.constData();
+    int pc = m_pc;
+    for (; pc != -1 && count != 0; --count) {
+        ++m_instructions;
+        m_pc = pc + ScriptProgram::instructionSize(code[pc]);
+        switch (code[pc]) {
+        case OpHalt:
+            m_pc = -1;
+            break;
+        case OpStep:
+            m_target->step();
+            break;
+        case OpTurnLeft:
+            m_target->turnLeft();
+            break;
+        case OpTurnRight:
+            m_target->turnRight();
+            break;
+        case OpPutBall:
+            m_target->putBall();
+            break;
+        case OpGetBall:
+            m_target->getBall();
+            break;
+        case OpBeginTick:
+            m_target->beginTick();
+            break;
+        case OpEndTick:
+            m_target->endTick();
+            break;
+        case OpOnBall:
+            m_flag = m_target->onBall();
+            break;
+        case OpInFrontOfWall:
+            m_flag = m_target->inFrontOfWall();
+            break;
+        case OpTrue:
+            m_flag = true;
+            break;
+        case OpFalse:
+            m_flag = false;
+            break;
+        case OpNot:
+            m_flag = !m_flag;
+            break;
+        case OpDebug:
+            m_target->debugMessage(m_program.strings[code[pc + 1]]);
+            break;
+        case OpJump:
+            m_pc = code[pc + 1];
+            break;
+        case OpJumpIfFalse:
+            if (!m_flag)
+                m_pc = code[pc + 1];
+            break;
+        case OpJumpIfTrue:
+            if (m_flag)
+                m_pc = code[pc + 1];
+            break;
+        case OpCall:
+            if (m_callStack.size() == MAX_CALL_DEPTH)
+                throw ScriptStackOverflow();
+            m_callStack.push_back(m_pc);
+            m_pc = code[pc + 1];
+            break;
+        case OpReturn:
+            m_pc = m_callStack.isEmpty() ? -1 : m_callStack.takeLast();
+            break;
+        }
+        pc = m_pc;
+    }
+}
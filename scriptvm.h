@@ -0,0 +1,51 @@
+#pragma once
+
+#include "charlesscript.h"
+#include "commandtarget.h"
+
+/*
+ * Executes a compiled CharlesScript (see charlesscript.h) on a CommandTarget: the MainWindow when a script
+ * runs in the UI, a HeadlessRunner in the sandbox. Exceptions of the target (errors outside batch mode)
+ * are passed on, the VM stays at the instruction after the failed command.
+ *
+ * The VM keeps its state between calls, so a procedure can be run to the end at once, or instruction
+ * by instruction.
+ */
+
+// Raised when the calls of a script nest deeper than ScriptVM::MAX_CALL_DEPTH (endless recursion).
+struct ScriptStackOverflow : public QException { const char *what() const override; };
+
+class ScriptVM
+{
+public:
+    ScriptVM(const ScriptProgram& program, CommandTarget *target);
+
+    // Start the procedure at entry, see ScriptProgram::entry. Nothing is executed yet.
+    void start(int entry);
+    // Execute until the procedure returns.
+    void run();
+    // Execute one instruction. Returns false if the procedure has returned.
+    bool stepInstruction();
+    // Returns true iff the procedure has not returned yet.
+    bool isRunning() const;
+    // Returns the source line of the next instruction, or -1 if not running.
+    int currentLine() const;
+    // Number of instructions executed since start().
+    qint64 instructionCount() const;
+
+    // Run a procedure of a program to the end.
+    static void run(const ScriptProgram& program, const QString& procedure, CommandTarget *target);
+
+    constexpr static int MAX_CALL_DEPTH = 10000;
+
+private:
+    // Execute at most count instructions, -1 for no limit.
+    void execute(qint64 count);
+
+    const ScriptProgram m_program;
+    CommandTarget *m_target;
+    int m_pc = -1;
+    bool m_flag = false;
+    QVector<int> m_callStack;
+    qint64 m_instructions = 0;
+};
@@ -0,0 +1,95 @@
+#include "sprites.h"
+
+#include <QPainter>
+#include <cstring>
+
+// Load an image from the resources as an opaque size x size image.
+static QImage loadSprite(const QString &fileName, int size) {
+    QImage sprite(size, size, QImage::Format_RGB32);
+    sprite.fill(Qt::white);
+    QPainter painter(&sprite);
+    painter.drawImage(QRect(0, 0, size, size), QImage(fileName));
+    return sprite;
+}
+
+Sprites::Sprites(int size)
+    : m_size(size),
+    m_fields{loadSprite(":/images/wall.jpg", size),
+             loadSprite(":/images/emptyField.PNG", size),
+             loadSprite(":/images/ball.png", size)},
+    m_robots{{loadSprite(":/images/CharlesNorth.png", size), loadSprite(":/images/CharlesNorthBall.png", size)},
+             {loadSprite(":/images/CharlesEast.png", size), loadSprite(":/images/CharlesEastBall.png", size)},
+             {loadSprite(":/images/CharlesSouth.png", size), loadSprite(":/images/CharlesSouthBall.png", size)},
+             {loadSprite(":/images/CharlesWest.png", size), loadSprite(":/images/CharlesWestBall.png", size)}}
+{
+    assert(size > 0 && "Sprites::Sprites: size must be positive.");
+}
+
+const Sprites &Sprites::instance() {
+    static const Sprites sprites;
+    return sprites;
+}
+
+const QImage &Sprites::field(Field f) const {
+    return m_fields[f];
+}
+
+const QImage &Sprites::robot(Direction d, Field f) const {
+    return m_robots[d][f == Field::Ball ? 1 : 0];
+}
+
+int Sprites::size() const {
+    return m_size;
+}
+
+QImage Sprites::render(const WorldObject &world) const {
+    const QSize size = world.size();
+    QImage image(size.width() * m_size, size.height() * m_size, QImage::Format_RGB32);
+    const qsizetype spriteBytes = m_size * sizeof(QRgb);
+
+    // Robots per row, drawn over the fields of their row.
+    QHash<int, QVector<int>> robotsInRow;
+    for (int i = 0; i < world.robotCount(); ++i)
+        robotsInRow[world.robots()[i].pos.y()].push_back(i);
+
+    QVector<quint8> fields(size.width());
+    QVector<const QImage*> sprites(size.width());
+    for (int y = 0; y < size.height(); ++y) {
+        world.readRow(y, fields.data());
+        for (int x = 0; x < size.width(); ++x)
+            sprites[x] = &m_fields[fields[x]];
+        for (int i : robotsInRow.value(y)) {
+            const Robot &r = world.robots()[i];
+            sprites[r.pos.x()] = &robot(r.dir, static_cast<Field>(fields[r.pos.x()]));
+        }
+        for (int line = 0; line < m_size; ++line) {
+            uchar *out = image.scanLine(y * m_size + line);
+            for (int x = 0; x < size.width(); ++x)
+                memcpy(out + x * spriteBytes, sprites[x]->constScanLine(line), spriteBytes);
+        }
+    }
+    return image;
+}
+
+SpritePixmaps::SpritePixmaps() {
+    const Sprites &sprites = Sprites::instance();
+    for (Field f : {Field::Wall, Field::Empty, Field::Ball})
+        m_fields[f] = QPixmap::fromImage(sprites.field(f));
+    for (Direction d : {Direction::North, Direction::East, Direction::South, Direction::West}) {
+        m_robots[d][0] = QPixmap::fromImage(sprites.robot(d, Field::Empty));
+        m_robots[d][1] = QPixmap::fromImage(sprites.robot(d, Field::Ball));
+    }
+}
+
+const SpritePixmaps &SpritePixmaps::instance() {
+    static const SpritePixmaps pixmaps;
+    return pixmaps;
+}
+
+const QPixmap &SpritePixmaps::field(Field f) const {
+    return m_fields[f];
+}
+
+const QPixmap &SpritePixmaps::robot(Direction d, Field f) const {
+    return m_robots[d][f == Field::Ball ? 1 : 0];
+}
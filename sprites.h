@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QImage>
+#include <QPixmap>
+
+#include "worldobject.h"
+
+/*
+ * The images of fields and robots, shared by WorldWidget and offscreen rendering (see RunExportJob).
+ *
+ * Sprites are QImages, not QPixmaps, so they can be used outside of the GUI thread. They are converted to
+ * opaque RGB32 (transparent parts become white), so a world image is drawn by copying rows of sprites.
+ */
+
+class Sprites
+{
+public:
+    // Load the sprites from the resources, scaled to size x size pixels.
+    explicit Sprites(int size = FIELD_SIZE);
+
+    // The sprites at FIELD_SIZE, loaded once.
+    static const Sprites &instance();
+
+    const QImage &field(Field f) const;
+    const QImage &robot(Direction d, Field f) const;
+    int size() const;
+
+    // Draws the whole world, size() pixels per field.
+    QImage render(const WorldObject& world) const;
+
+    // Size of a field on screen in pixels.
+    constexpr static int FIELD_SIZE = 20;
+
+private:
+    int m_size;
+    // Indexed by Field.
+    QImage m_fields[3];
+    // Indexed by Direction, then empty / ball.
+    QImage m_robots[4][2];
+};
+
+// The sprites at FIELD_SIZE as pixmaps for the screen, converted once and shared by every WorldWidget.
+// Only for the GUI thread.
+class SpritePixmaps
+{
+public:
+    // Made on first use, QPixmaps can only be made once the QApplication is started.
+    static const SpritePixmaps &instance();
+
+    const QPixmap &field(Field f) const;
+    const QPixmap &robot(Direction d, Field f) const;
+
+private:
+    SpritePixmaps();
+
+    QPixmap m_fields[3];
+    QPixmap m_robots[4][2];
+};
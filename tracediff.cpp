@@ -0,0 +1,197 @@
+#include "tracediff.h"
+
+#include <QHash>
+
+// Scrambles x, so keys of events that differ in a single field are far apart.
+static quint64 mix(quint64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static quint64 eventKey(const TraceEvent &e) {
+    quint64 key = mix(quint64(e.kind) | quint64(quint32(e.robot)) << 8 | quint64(e.answer) << 40);
+    for (RobotAction a : e.tickActions)
+        key = mix(key ^ a);
+    if (!e.text.isEmpty())
+        key = mix(key ^ qHash(e.text));
+    return key;
+}
+
+/*
+ * The linear space diff of Myers on the segments, the variant of diff-match-patch: bisect() follows the edit
+ * paths from the start and from the end at the same time until they meet, diff() splits there and goes on with
+ * both halves. Only the diagonals of the current subproblem are kept.
+ */
+class SegmentDiff
+{
+public:
+    SegmentDiff(const QVector<TraceSegment> &a, const QVector<TraceSegment> &b)
+        : m_a(a),
+        m_b(b)
+    {
+    }
+
+    // Append the ops that turn a[aLo, aHi) into b[bLo, bHi).
+    void diff(int aLo, int aHi, int bLo, int bHi) {
+        int prefix = 0;
+        while (aLo + prefix < aHi && bLo + prefix < bHi && equal(aLo + prefix, bLo + prefix))
+            ++prefix;
+        add(TraceDiffOp::Equal, aLo, bLo, prefix);
+        aLo += prefix;
+        bLo += prefix;
+        int suffix = 0;
+        while (aHi - suffix > aLo && bHi - suffix > bLo && equal(aHi - suffix - 1, bHi - suffix - 1))
+            ++suffix;
+        aHi -= suffix;
+        bHi -= suffix;
+
+        int x, y;
+        if (aLo == aHi)
+            add(TraceDiffOp::Added, aLo, bLo, bHi - bLo);
+        else if (bLo == bHi)
+            add(TraceDiffOp::Removed, aLo, bLo, aHi - aLo);
+        else if (bisect(aLo, aHi, bLo, bHi, &x, &y)) {
+            diff(aLo, x, bLo, y);
+            diff(x, aHi, y, bHi);
+        }
+        else {
+            add(TraceDiffOp::Removed, aLo, bLo, aHi - aLo);
+            add(TraceDiffOp::Added, aHi, bLo, bHi - bLo);
+        }
+        add(TraceDiffOp::Equal, aHi, bHi, suffix);
+    }
+
+    QVector<TraceDiffOp> ops;
+    bool approximate = false;
+
+private:
+    bool equal(int i, int j) {
+        ++m_cost;
+        return m_a[i].key == m_b[j].key && m_a[i].count == m_b[j].count;
+    }
+
+    void add(TraceDiffOp::Kind kind, int a, int b, int count) {
+        if (count == 0)
+            return;
+        // Ops are added in order, so an op of the same kind as the last one continues it.
+        if (!ops.isEmpty() && ops.last().kind == kind)
+            ops.last().count += count;
+        else
+            ops.push_back(TraceDiffOp{kind, a, b, count});
+    }
+
+    // Find a point (x, y) on a shortest edit path of a[aLo, aHi) and b[bLo, bHi) that splits it in two.
+    // Returns false if there is none (nothing in common) or the cost limit is reached.
+    bool bisect(int aLo, int aHi, int bLo, int bHi, int *x, int *y) {
+        const int n = aHi - aLo;
+        const int m = bHi - bLo;
+        const int maxD = (n + m + 1) / 2;
+        const int offset = maxD;
+        // Room for diagonal maxD + 1 as well, which is set before the first step (one segment on each side reaches it).
+        const int length = 2 * maxD + 2;
+        // Furthest x on diagonal k (+ offset), from the start (forward) and from the end (backward).
+        QVector<int> forward(length, -1), backward(length, -1);
+        forward[offset + 1] = 0;
+        backward[offset + 1] = 0;
+        const int delta = n - m;
+        // With an odd delta the forward path meets the backward path, with an even one the other way around.
+        const bool front = delta % 2 != 0;
+        int k1Start = 0, k1End = 0, k2Start = 0, k2End = 0;
+        for (int d = 0; d < maxD; ++d) {
+            if (m_cost > MAX_DIFF_COST) {
+                approximate = true;
+                return false;
+            }
+            for (int k1 = -d + k1Start; k1 <= d - k1End; k1 += 2) {
+                const int k1Offset = offset + k1;
+                int x1 = k1 == -d || (k1 != d && forward[k1Offset - 1] < forward[k1Offset + 1])
+                    ? forward[k1Offset + 1] : forward[k1Offset - 1] + 1;
+                int y1 = x1 - k1;
+                while (x1 < n && y1 < m && equal(aLo + x1, bLo + y1)) {
+                    ++x1;
+                    ++y1;
+                }
+                forward[k1Offset] = x1;
+                if (x1 > n)
+                    k1End += 2;     // Ran off the right.
+                else if (y1 > m)
+                    k1Start += 2;   // Ran off the bottom.
+                else if (front) {
+                    const int k2Offset = offset + delta - k1;
+                    if (k2Offset >= 0 && k2Offset < length && backward[k2Offset] != -1 && x1 >= n - backward[k2Offset]) {
+                        *x = aLo + x1;
+                        *y = bLo + y1;
+                        return true;
+                    }
+                }
+            }
+            for (int k2 = -d + k2Start; k2 <= d - k2End; k2 += 2) {
+                const int k2Offset = offset + k2;
+                int x2 = k2 == -d || (k2 != d && backward[k2Offset - 1] < backward[k2Offset + 1])
+                    ? backward[k2Offset + 1] : backward[k2Offset - 1] + 1;
+                int y2 = x2 - k2;
+                while (x2 < n && y2 < m && equal(aHi - x2 - 1, bHi - y2 - 1)) {
+                    ++x2;
+                    ++y2;
+                }
+                backward[k2Offset] = x2;
+                if (x2 > n)
+                    k2End += 2;
+                else if (y2 > m)
+                    k2Start += 2;
+                else if (!front) {
+                    const int k1Offset = offset + delta - k2;
+                    if (k1Offset >= 0 && k1Offset < length && forward[k1Offset] != -1) {
+                        const int x1 = forward[k1Offset];
+                        const int y1 = offset + x1 - k1Offset;
+                        if (x1 >= n - x2) {
+                            *x = aLo + x1;
+                            *y = bLo + y1;
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    const QVector<TraceSegment> &m_a;
+    const QVector<TraceSegment> &m_b;
+    qint64 m_cost = 0;
+};
+
+QVector<TraceSegment> compressTrace(const QVector<TraceEvent> &events) {
+    QVector<TraceSegment> segments;
+    for (int i = 0; i < events.size(); ++i) {
+        const quint64 key = eventKey(events[i]);
+        if (!segments.isEmpty() && segments.last().key == key)
+            ++segments.last().count;
+        else
+            segments.push_back(TraceSegment{key, i, 1});
+    }
+    return segments;
+}
+
+TraceDiff diffTraces(const QVector<TraceEvent> &a, const QVector<TraceEvent> &b) {
+    TraceDiff result;
+    result.a = compressTrace(a);
+    result.b = compressTrace(b);
+    SegmentDiff diff(result.a, result.b);
+    diff.diff(0, result.a.size(), 0, result.b.size());
+    result.ops = diff.ops;
+    result.approximate = diff.approximate;
+
+    // Segments at the same place that repeat the same event are the same as far as the shorter one goes.
+    int s = 0;
+    while (s < result.a.size() && s < result.b.size() && result.a[s].key == result.b[s].key) {
+        result.divergence += qMin(result.a[s].count, result.b[s].count);
+        if (result.a[s].count != result.b[s].count)
+            break;
+        ++s;
+    }
+    return result;
+}
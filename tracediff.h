@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QVector>
+
+#include "debugtraceitem.h"
+
+/*
+ * Aligns two traces, e.g. the run of a student with a reference run, to show where they go apart.
+ *
+ * The traces are first compressed into segments: runs of equal events ("Step" x 120). Long traces are mostly
+ * repetition, so this makes a million events a few thousand segments. The segments are aligned with the diff
+ * of Myers, in linear space (the middle of the edit path is found from both ends, the halves are diffed on
+ * their own). Two segments match if they repeat the same event equally often.
+ *
+ * Events are equal if their kind, robot, answer, tick actions and text (messages, errors) are.
+ */
+
+// Equal events repeated count times, starting with event first of the trace.
+struct TraceSegment {
+    quint64 key;
+    int first;
+    int count;
+};
+
+// A step of the alignment: count segments that are in both traces, or only in the first (Removed)
+// or second (Added) trace. a and b are the first segment in each trace.
+struct TraceDiffOp {
+    enum Kind { Equal, Removed, Added };
+    Kind kind;
+    int a;
+    int b;
+    int count;
+};
+
+struct TraceDiff {
+    QVector<TraceSegment> a, b;
+    QVector<TraceDiffOp> ops;
+    // The length of the common start of the traces: the event where they first differ, in both traces.
+    // Equal to the length of both traces if they are the same.
+    int divergence = 0;
+    // True if the diff gave up on the most different parts (see MAX_DIFF_COST), they are shown as replaced.
+    bool approximate = false;
+
+    bool isEqual() const { return a.size() == b.size() && (ops.isEmpty() || (ops.size() == 1 && ops[0].kind == TraceDiffOp::Equal)); }
+};
+
+// Segments compared at most by a diff, past this the rest is replaced as a whole. Bounds the time of very different traces.
+const qint64 MAX_DIFF_COST = 200000000;
+
+// Returns the segments of events.
+QVector<TraceSegment> compressTrace(const QVector<TraceEvent>& events);
+TraceDiff diffTraces(const QVector<TraceEvent>& a, const QVector<TraceEvent>& b);
@@ -0,0 +1,156 @@
+#include "tracediffwindow.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QSplitter>
+#include <QScrollArea>
+#include <QHeaderView>
+#include <QPixmap>
+
+// Worlds are drawn at most this many pixels wide and high, smaller sprites are used for larger worlds.
+const static int MAX_PICTURE_SIZE = 1024;
+
+TraceDiffWindow::TraceDiffWindow(const Trace &a, const Trace &b, QWidget *parent)
+    : QWidget{parent, Qt::Window}
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(QString("Trace Diff: %1 / %2").arg(a.name, b.name));
+    resize(1000, 700);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_summary = new QLabel(this));
+    m_summary->setWordWrap(true);
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+    layout->addWidget(splitter);
+    splitter->addWidget(m_table = new QTableWidget(splitter));
+    m_table->setColumnCount(2);
+    m_table->setHorizontalHeaderLabels({a.name, b.name});
+    m_table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setSelectionMode(QAbstractItemView::SingleSelection);
+    QWidget *worlds = new QWidget(splitter);
+    QHBoxLayout *worldsLayout = new QHBoxLayout(worlds);
+    splitter->addWidget(worlds);
+
+    const Trace *traces[2] = {&a, &b};
+    for (int side = 0; side < 2; ++side) {
+        m_names[side] = traces[side]->name;
+        m_events[side] = traces[side]->events;
+        m_starts[side] = traces[side]->start;
+        m_worlds[side].reset(new WorldObject);
+        m_worlds[side]->setEmitUpdates(false);
+        m_worlds[side]->copyWorld(*traces[side]->world);
+        m_worlds[side]->restoreSnapshot(m_starts[side]);
+        const QSize size = m_worlds[side]->size();
+        if (qMax(size.width(), size.height()) <= MAX_PICTURE_SIZE)
+            m_sprites[side].reset(new Sprites(qBound(1, MAX_PICTURE_SIZE / qMax(size.width(), size.height()), Sprites::FIELD_SIZE)));
+
+        QVBoxLayout *column = new QVBoxLayout;
+        worldsLayout->addLayout(column);
+        column->addWidget(m_captions[side] = new QLabel(worlds));
+        QScrollArea *scrollArea = new QScrollArea(worlds);
+        scrollArea->setWidget(m_pictures[side] = new QLabel(scrollArea));
+        scrollArea->setWidgetResizable(true);
+        m_pictures[side]->setAlignment(Qt::AlignCenter);
+        column->addWidget(scrollArea);
+    }
+
+    m_diff = diffTraces(m_events[0], m_events[1]);
+    QString summary = m_diff.isEqual()
+        ? QString("The traces are the same, %1 events.").arg(m_events[0].size())
+        : QString("The traces go apart at event %1: %2 / %3.").arg(m_diff.divergence)
+              .arg(m_diff.divergence < m_events[0].size() ? eventText(m_events[0][m_diff.divergence]) : "end of trace",
+                   m_diff.divergence < m_events[1].size() ? eventText(m_events[1][m_diff.divergence]) : "end of trace");
+    summary += QString(" %1: %2 events in %3 segments, %4: %5 events in %6 segments.")
+                   .arg(m_names[0]).arg(m_events[0].size()).arg(m_diff.a.size())
+                   .arg(m_names[1]).arg(m_events[1].size()).arg(m_diff.b.size());
+    if (m_diff.approximate)
+        summary += " The traces differ too much to align them exactly, the most different parts are shown as replaced.";
+    m_summary->setText(summary);
+    fillTable();
+
+    connect(m_table, &QTableWidget::cellClicked, this, [this](int row) {
+        for (int side = 0; side < 2; ++side)
+            showWorld(side, m_table->item(row, side)->data(Qt::UserRole).toInt());
+    });
+    for (int side = 0; side < 2; ++side)
+        showWorld(side, m_diff.divergence);
+}
+
+void TraceDiffWindow::fillTable() {
+    // Returns the first event of segment s of side, or the end of the trace past its last segment.
+    auto eventOf = [this](int side, int s) {
+        const QVector<TraceSegment> &segments = side == 0 ? m_diff.a : m_diff.b;
+        return s < segments.size() ? segments[s].first : static_cast<int>(m_events[side].size());
+    };
+    auto segmentText = [this](int side, const TraceSegment &s) {
+        const QString text = eventText(m_events[side][s.first]);
+        return s.count == 1 ? text : QString("%1 x%2").arg(text).arg(s.count);
+    };
+
+    int total = 0;
+    for (const TraceDiffOp &op : m_diff.ops)
+        total += op.count;
+    m_table->setRowCount(qMin(total, MAX_ROWS));
+    int rows = 0, divergenceRow = -1;
+    for (const TraceDiffOp &op : m_diff.ops) {
+        if (op.kind != TraceDiffOp::Equal && divergenceRow == -1)
+            divergenceRow = rows;
+        for (int i = 0; i < op.count; ++i) {
+            if (rows == MAX_ROWS)
+                break;
+            // A segment that is only in one trace leaves the other one where its next segment starts.
+            const int segments[2] = {op.a + (op.kind == TraceDiffOp::Added ? 0 : i), op.b + (op.kind == TraceDiffOp::Removed ? 0 : i)};
+            const bool present[2] = {op.kind != TraceDiffOp::Added, op.kind != TraceDiffOp::Removed};
+            const QColor colors[2] = {QColor(255, 210, 210), QColor(210, 255, 210)};
+            for (int side = 0; side < 2; ++side) {
+                QTableWidgetItem *item = new QTableWidgetItem;
+                item->setData(Qt::UserRole, eventOf(side, segments[side]));
+                if (present[side]) {
+                    const TraceSegment &s = (side == 0 ? m_diff.a : m_diff.b)[segments[side]];
+                    item->setText(segmentText(side, s));
+                    item->setToolTip(s.count == 1 ? QString("Event %1").arg(s.first)
+                                                  : QString("Events %1 to %2").arg(s.first).arg(s.first + s.count - 1));
+                    if (op.kind != TraceDiffOp::Equal)
+                        item->setBackground(colors[side]);
+                }
+                m_table->setItem(rows, side, item);
+            }
+            ++rows;
+        }
+    }
+    if (total > rows)
+        m_summary->setText(m_summary->text() + QString(" The last %1 rows are not listed.").arg(total - rows));
+    if (divergenceRow != -1 && divergenceRow < rows) {
+        m_table->selectRow(divergenceRow);
+        m_table->scrollToItem(m_table->item(divergenceRow, 0), QAbstractItemView::PositionAtCenter);
+    }
+}
+
+void TraceDiffWindow::showWorld(int side, int event) {
+    WorldObject *world = m_worlds[side].get();
+    if (event < m_positions[side]) {
+        world->restoreSnapshot(m_starts[side]);
+        m_positions[side] = 0;
+    }
+    // Replayed like RunExportJob does. An action that failed when it was recorded fails again, the world stays as it is.
+    QString error;
+    for (; m_positions[side] < event; ++m_positions[side]) {
+        try {
+            executeEvent(world, m_events[side][m_positions[side]]);
+        }
+        catch (QException& ex) {
+            error = ex.what();
+        }
+    }
+
+    QString caption = QString("%1 before event %2 of %3").arg(m_names[side]).arg(event).arg(m_events[side].size());
+    if (!error.isEmpty())
+        caption += " (" + error + ")";
+    m_captions[side]->setText(caption);
+    if (m_sprites[side])
+        m_pictures[side]->setPixmap(QPixmap::fromImage(m_sprites[side]->render(*world)));
+    else
+        m_pictures[side]->setText(QString("A world of %1 x %2 fields is too large to show.").arg(world->size().width()).arg(world->size().height()));
+}
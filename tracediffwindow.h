@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QWidget>
+#include <QTableWidget>
+#include <QLabel>
+#include <memory>
+
+#include "tracediff.h"
+#include "sprites.h"
+
+/*
+ * Shows two traces side by side, aligned by their diff (see tracediff.h): a row per segment, segments that are
+ * only in one trace are colored. Both worlds are shown before the first event where the traces go apart;
+ * clicking a row shows them at that row instead.
+ */
+
+class TraceDiffWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    // A trace to compare: its events start on world as it is in start. The world is copied.
+    struct Trace {
+        QString name;
+        const WorldObject *world;
+        WorldSnapshot start;
+        QVector<TraceEvent> events;
+    };
+
+    TraceDiffWindow(const Trace& a, const Trace& b, QWidget *parent = nullptr);
+
+    // Rows shown at most, the rest of the diff is only counted.
+    constexpr static int MAX_ROWS = 20000;
+
+private:
+    // Fill the table with the ops of m_diff.
+    void fillTable();
+    // Show the world of trace side (0 or 1) before its event.
+    void showWorld(int side, int event);
+
+    QString m_names[2];
+    QVector<TraceEvent> m_events[2];
+    WorldSnapshot m_starts[2];
+    // The worlds are replayed from the start, or onwards from the event they are at.
+    std::unique_ptr<WorldObject> m_worlds[2];
+    int m_positions[2] = {0, 0};
+    std::unique_ptr<Sprites> m_sprites[2];
+    TraceDiff m_diff;
+
+    QLabel *m_summary;
+    QTableWidget *m_table;
+    QLabel *m_captions[2];
+    QLabel *m_pictures[2];
+};
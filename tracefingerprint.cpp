@@ -0,0 +1,85 @@
+#include "tracefingerprint.h"
+
+#include <QHash>
+
+// The finalizer of SplitMix64, every bit of the input changes about half of the bits of the output.
+static quint64 avalanche(quint64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void TraceFingerprint::reset() {
+    m_hash = 0;
+    m_events = 0;
+}
+
+void TraceFingerprint::add(const TraceEvent &e) {
+    if (e.kind == DebugKind::Message)
+        return;
+    mix(quint64(e.kind) | quint64(quint32(e.robot)) << 8 | quint64(e.answer) << 40);
+    for (RobotAction a : e.tickActions)
+        mix(a);
+    if (e.kind == DebugKind::Error)
+        mix(qHash(e.text));
+    ++m_events;
+}
+
+quint64 TraceFingerprint::value() const {
+    return m_hash;
+}
+
+qint64 TraceFingerprint::eventCount() const {
+    return m_events;
+}
+
+quint64 TraceFingerprint::finish(const WorldObject &world) const {
+    // Never 0, which stands for a run without a fingerprint.
+    return avalanche(m_hash ^ worldHash(world)) | 1;
+}
+
+void TraceFingerprint::mix(quint64 word) {
+    // Order matters: the hash so far is scrambled before the next word is added.
+    m_hash = avalanche(m_hash + 0x9e3779b97f4a7c15ULL) ^ word;
+}
+
+quint64 worldHash(const WorldObject &world) {
+    const QSize size = world.size();
+    quint64 hash = avalanche(quint64(size.width()) << 32 | quint32(size.height()));
+    // Rows are hashed 8 fields at a time.
+    QVector<quint8> row(size.width());
+    for (int y = 0; y < size.height(); ++y) {
+        world.readRow(y, row.data());
+        quint64 word = 0;
+        for (int x = 0; x < size.width(); ++x) {
+            word = word << 8 | row[x];
+            if (x % 8 == 7 || x == size.width() - 1) {
+                hash = avalanche(hash ^ word);
+                word = 0;
+            }
+        }
+    }
+    for (const Robot &r : world.robots()) {
+        hash = avalanche(hash ^ (quint64(quint32(r.id)) << 32 | quint32(r.dir)));
+        hash = avalanche(hash ^ (quint64(quint32(r.pos.x())) << 32 | quint32(r.pos.y())));
+    }
+    return hash;
+}
+
+QVector<QVector<RunOutcome>> groupByBehaviour(const QVector<RunOutcome> &runs) {
+    QVector<QVector<RunOutcome>> groups;
+    QHash<QPair<quint64, QString>, int> groupOf;
+    for (const RunOutcome &run : runs) {
+        // Only the killed runs (no fingerprint) are told apart by their error, for the others it is in the fingerprint.
+        const QPair<quint64, QString> key(run.fingerprint, run.fingerprint == 0 ? run.error : QString());
+        auto it = groupOf.find(key);
+        if (it == groupOf.end()) {
+            it = groupOf.insert(key, groups.size());
+            groups.push_back({});
+        }
+        groups[*it].push_back(run);
+    }
+    return groups;
+}
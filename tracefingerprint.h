@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QVector>
+#include <QString>
+
+#include "debugtraceitem.h"
+
+/*
+ * Behaviour of a program run as a single number, to see which programs of a cohort behave the same on a world.
+ *
+ * The fingerprint is a 64 bit hash that is updated with every event while the run is recorded, so it costs
+ * no pass over a stored trace (the sandbox does not even send the trace for it). It covers the actions and
+ * the sensor answers in order, and the errors. Debug messages are left out: two programs that only print
+ * something else behave the same. When the run ends the hash of the world after it is mixed in.
+ *
+ * Runs with the same fingerprint are one behaviour: grading, replaying and reviewing one of them is enough.
+ */
+
+class TraceFingerprint
+{
+public:
+    // Start over, for a new run.
+    void reset();
+    // Count event e of the run.
+    void add(const TraceEvent& e);
+    // Returns the fingerprint of the events so far.
+    quint64 value() const;
+    // Returns the number of events that were counted (debug messages are not).
+    qint64 eventCount() const;
+    // Returns the fingerprint of the run that ended with world.
+    quint64 finish(const WorldObject& world) const;
+
+private:
+    void mix(quint64 word);
+
+    quint64 m_hash = 0;
+    qint64 m_events = 0;
+};
+
+// Returns a hash of the fields and robots of world.
+quint64 worldHash(const WorldObject& world);
+
+// A program run of a cohort.
+struct RunOutcome {
+    QString program;
+    // 0 if the run was killed before it ended (see error).
+    quint64 fingerprint = 0;
+    qint64 events = 0;
+    // The error the run ended with, empty if it finished.
+    QString error;
+};
+
+// Returns the runs grouped by behaviour: the same fingerprint, or killed with the same error. The groups are
+// in the order of their first run, which stands for the group.
+QVector<QVector<RunOutcome>> groupByBehaviour(const QVector<RunOutcome>& runs);
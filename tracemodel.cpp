@@ -0,0 +1,582 @@
+#include "tracemodel.h"
+
+#include <QDir>
+#include <QDataStream>
+
+// Returns the number of events of item row. The first row is "Start of Program", it has none.
+static int itemEvents(int row, const DebugTraceItem *item) {
+    return row == 0 ? 0 : item->foldedSensorCount() + 1;
+}
+
+TraceModel::TraceModel(QObject *parent)
+    : QAbstractListModel{parent}
+{
+}
+
+TraceModel::~TraceModel() {
+    for (const Segment &s : m_segments)
+        qDeleteAll(s.items);
+    dropAside();
+}
+
+int TraceModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant TraceModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_count)
+        return QVariant();
+    return item(index.row())->data(role);
+}
+
+int TraceModel::count() const {
+    return m_count;
+}
+
+DebugTraceItem *TraceModel::item(int row) const {
+    assert(row >= 0 && row < m_count && "TraceModel::item: row out of range.");
+    const int segment = row / SEGMENT_SIZE;
+    if (!m_segments[segment].resident)
+        pageIn(segment);
+    Segment &s = m_segments[segment];
+    s.lastUse = ++m_clock;
+    return s.items[row % SEGMENT_SIZE];
+}
+
+void TraceModel::append(DebugTraceItem *item) {
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    if (isSegmentStart(m_count))
+        m_segments.push_back(Segment());
+    // The last segment is spilled only after takeLast emptied the one after it.
+    if (!m_segments.last().resident)
+        pageIn(m_segments.size() - 1);
+    Segment &s = m_segments.last();
+    s.items.push_back(item);
+    ++s.count;
+    s.events += itemEvents(m_count, item);
+    s.offset = -1;
+    s.lastUse = ++m_clock;
+    ++m_count;
+    ++m_resident;
+    endInsertRows();
+    enforceBudget(m_segments.size() - 1);
+}
+
+DebugTraceItem *TraceModel::takeLast() {
+    assert(m_count > 0 && "TraceModel::takeLast: the model is empty.");
+    if (!m_segments.last().resident)
+        pageIn(m_segments.size() - 1);
+    beginRemoveRows(QModelIndex(), m_count - 1, m_count - 1);
+    Segment &s = m_segments.last();
+    DebugTraceItem *item = s.items.takeLast();
+    --s.count;
+    --m_count;
+    s.events -= itemEvents(m_count, item);
+    s.offset = -1;
+    --m_resident;
+    // Its keyframe goes with it.
+    if (s.count == 0) {
+        assert(s.pins == 0 && "TraceModel::takeLast: the segment is pinned.");
+        m_segments.removeLast();
+        dropLastKeyframe();
+    }
+    endRemoveRows();
+    return item;
+}
+
+void TraceModel::truncate(int count) {
+    assert(count >= 0 && count <= m_count && "TraceModel::truncate: count out of range.");
+    if (count == m_count)
+        return;
+    beginRemoveRows(QModelIndex(), count, m_count - 1);
+    const int segments = (count + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+    for (int i = segments; i < m_segments.size(); ++i) {
+        assert(m_segments[i].pins == 0 && "TraceModel::truncate: a segment is pinned.");
+        if (m_segments[i].resident)
+            m_resident -= m_segments[i].count;
+        qDeleteAll(m_segments[i].items);
+    }
+    m_segments.resize(segments);
+    dropLastKeyframe();
+    if (count % SEGMENT_SIZE != 0) {
+        const int last = segments - 1;
+        if (!m_segments[last].resident)
+            pageIn(last);
+        Segment &s = m_segments[last];
+        while (s.count > count % SEGMENT_SIZE) {
+            --s.count;
+            DebugTraceItem *item = s.items.takeLast();
+            s.events -= itemEvents(last * SEGMENT_SIZE + s.count, item);
+            delete item;
+            --m_resident;
+        }
+        s.offset = -1;
+    }
+    m_count = count;
+    endRemoveRows();
+    // With only the first segment left (e.g. a new world cleared the trace), the file starts over. Not while items
+    // that are aside may still be in it.
+    if (m_segments.size() <= 1 && m_file && m_aside.isEmpty()) {
+        if (!m_segments.isEmpty()) {
+            Segment &s = m_segments[0];
+            if (!s.resident)
+                pageIn(0);
+            s.offset = -1;
+            s.keyframeOffset = -1;
+        }
+        m_file->resize(0);
+    }
+}
+
+void TraceModel::putAside(int key, int first) {
+    assert(first > 0 && first <= m_count && "TraceModel::putAside: first out of range.");
+    if (first == m_count)
+        return;
+    Aside taken;
+    taken.first = first;
+    taken.count = m_count - first;
+    beginRemoveRows(QModelIndex(), first, m_count - 1);
+    const int segment = first / SEGMENT_SIZE;
+    int next = segment;
+    if (!isSegmentStart(first)) {
+        // The segment of first is split, its tail goes aside in memory. The keyframe stays with the head.
+        if (!m_segments[segment].resident)
+            pageIn(segment);
+        Segment &s = m_segments[segment];
+        const int keep = first % SEGMENT_SIZE;
+        Segment tail;
+        tail.items = s.items.mid(keep);
+        tail.count = tail.items.size();
+        for (int i = 0; i < tail.count; ++i)
+            tail.events += itemEvents(first + i, tail.items[i]);
+        s.items.resize(keep);
+        s.count = keep;
+        s.events -= tail.events;
+        s.offset = -1;
+        m_resident -= tail.count;
+        taken.segments.push_back(tail);
+        ++next;
+    }
+    for (int i = next; i < m_segments.size(); ++i) {
+        assert(m_segments[i].pins == 0 && "TraceModel::putAside: a segment is pinned.");
+        if (m_segments[i].resident)
+            m_resident -= m_segments[i].count;
+        taken.segments.push_back(m_segments[i]);
+    }
+    m_segments.resize(next);
+    m_count = first;
+    dropLastKeyframe();
+    endRemoveRows();
+
+    Aside &aside = m_aside[key];
+    if (aside.count > 0) {
+        assert(aside.first == first + taken.count && "TraceModel::putAside: the items must end right before the ones aside.");
+        // The items aside may continue the last segment that was taken, they become one segment again.
+        if (!isSegmentStart(aside.first)) {
+            Segment &s = taken.segments.last();
+            if (!s.resident)
+                read(s);
+            const Segment &tail = aside.segments.first();
+            s.items += tail.items;
+            s.count += tail.count;
+            s.events += tail.events;
+            s.offset = -1;
+            aside.segments.removeFirst();
+        }
+        taken.segments += aside.segments;
+        taken.count += aside.count;
+    }
+    // Whole segments are spilled, so only a part of a segment stays in memory. Without a file they all do.
+    for (int i = isSegmentStart(first) ? 0 : 1; i < taken.segments.size(); ++i) {
+        Segment &s = taken.segments[i];
+        if (s.resident && write(s)) {
+            qDeleteAll(s.items);
+            s.items.clear();
+            s.items.squeeze();
+            s.resident = false;
+        }
+    }
+    aside = taken;
+}
+
+void TraceModel::restoreAside(int key, int count) {
+    if (count <= 0)
+        return;
+    Aside &aside = m_aside[key];
+    assert(count <= aside.count && aside.first == m_count && "TraceModel::restoreAside: the items must go back to their rows.");
+    beginInsertRows(QModelIndex(), m_count, m_count + count - 1);
+    for (int left = count; left > 0;) {
+        Segment &piece = aside.segments.first();
+        int n;
+        if (!isSegmentStart(m_count)) {
+            // The piece continues the last segment.
+            if (!m_segments.last().resident)
+                pageIn(m_segments.size() - 1);
+            if (!piece.resident)
+                read(piece);
+            Segment &s = m_segments.last();
+            n = qMin(left, piece.count);
+            for (int i = 0; i < n; ++i) {
+                const int events = itemEvents(m_count + i, piece.items[i]);
+                s.items.push_back(piece.items[i]);
+                s.events += events;
+                piece.events -= events;
+            }
+            s.count += n;
+            s.offset = -1;
+            s.lastUse = ++m_clock;
+            m_resident += n;
+            piece.items.remove(0, n);
+            piece.count -= n;
+            piece.offset = -1;
+        }
+        else if (left >= piece.count) {
+            // A whole segment goes back as it is, a spilled one is not read.
+            n = piece.count;
+            if (piece.resident)
+                m_resident += n;
+            piece.lastUse = ++m_clock;
+            m_segments.push_back(piece);
+            piece.count = 0;
+        }
+        else {
+            // The head goes back with the keyframe, the rest stays aside without one.
+            if (!piece.resident)
+                read(piece);
+            n = left;
+            Segment head = piece;
+            head.items = piece.items.mid(0, n);
+            head.count = n;
+            head.events = 0;
+            for (int i = 0; i < n; ++i)
+                head.events += itemEvents(m_count + i, head.items[i]);
+            head.offset = -1;
+            head.lastUse = ++m_clock;
+            m_segments.push_back(head);
+            m_resident += n;
+            piece.items.remove(0, n);
+            piece.count -= n;
+            piece.events -= head.events;
+            piece.offset = -1;
+            piece.hasKeyframe = false;
+            piece.keyframe = KeyframeDelta();
+            piece.keyframeOffset = -1;
+            piece.keyframeChanges = 0;
+        }
+        if (piece.count == 0)
+            aside.segments.removeFirst();
+        m_count += n;
+        aside.first += n;
+        aside.count -= n;
+        left -= n;
+    }
+    if (aside.count == 0)
+        m_aside.remove(key);
+    endInsertRows();
+    enforceBudget(m_segments.size() - 1);
+}
+
+int TraceModel::asideCount(int key) const {
+    return m_aside.value(key).count;
+}
+
+void TraceModel::dropAside() {
+    for (const Aside &a : m_aside) {
+        for (const Segment &s : a.segments)
+            qDeleteAll(s.items);
+    }
+    m_aside.clear();
+}
+
+int TraceModel::eventCount() const {
+    int events = 0;
+    for (const Segment &s : m_segments)
+        events += s.events;
+    return events;
+}
+
+int TraceModel::itemBeforeEvent(int event) const {
+    // Skip whole segments by their event counts, only the segment of the event is read.
+    int segment = 0, events = 0;
+    while (segment + 1 < m_segments.size() && events + m_segments[segment].events <= event)
+        events += m_segments[segment++].events;
+    // Item r holds the events up to and including events.
+    int r = qMax(segment * SEGMENT_SIZE - 1, 0);
+    while (r + 1 < m_count && events + itemEvents(r + 1, item(r + 1)) <= event) {
+        ++r;
+        events += itemEvents(r, item(r));
+    }
+    return r;
+}
+
+bool TraceModel::isSegmentStart(int row) {
+    return row % SEGMENT_SIZE == 0;
+}
+
+void TraceModel::setKeyframe(int row, const WorldSnapshot &before) {
+    assert(isSegmentStart(row) && row < m_count && "TraceModel::setKeyframe: row must be the first item of a segment.");
+    const int segment = row / SEGMENT_SIZE;
+    Segment &s = m_segments[segment];
+    s.hasKeyframe = false;
+    s.keyframe = KeyframeDelta();
+    s.keyframeOffset = -1;
+    s.keyframeChanges = 0;
+    if (segment == 0) {
+        m_first = before;
+        s.hasKeyframe = true;
+    }
+    else {
+        WorldSnapshot previous;
+        if (keyframeOf(segment - 1, &previous) && previous.fields->size() == before.fields->size()) {
+            // Mostly the last keyframe, compared with it only the parts that were written since are read.
+            s.keyframe.points = before.fields->differences(*previous.fields);
+            for (QPoint p : s.keyframe.points) {
+                s.keyframe.before.append(char(previous.fields->get(p)));
+                s.keyframe.after.append(char(before.fields->get(p)));
+            }
+            s.keyframe.robots = before.robots;
+            s.keyframe.selected = before.selected;
+            s.keyframeChanges = s.keyframe.points.size();
+            s.hasKeyframe = true;
+        }
+    }
+    // The keyframes after it were made from the old one.
+    for (int i = segment + 1; i < m_segments.size(); ++i)
+        m_segments[i].hasKeyframe = false;
+    m_last = before;
+    m_lastKeyframe = segment;
+}
+
+int TraceModel::keyframeBefore(int row, WorldSnapshot *keyframe) const {
+    for (int segment = row / SEGMENT_SIZE; segment >= 0; --segment) {
+        if ((segment == m_lastKeyframe || m_segments[segment].hasKeyframe) && keyframeOf(segment, keyframe))
+            return segment * SEGMENT_SIZE;
+    }
+    return -1;
+}
+
+bool TraceModel::keyframeOf(int segment, WorldSnapshot *keyframe) const {
+    if (segment == m_lastKeyframe) {
+        *keyframe = m_last;
+        return true;
+    }
+    if (segment == 0) {
+        *keyframe = m_first;
+        return m_segments[0].hasKeyframe && m_first.fields;
+    }
+    if (!m_segments[segment].hasKeyframe)
+        return false;
+    // Forward from the first keyframe or back from the last one, whichever has fewer changes on the way.
+    bool forward = m_segments[0].hasKeyframe && m_first.fields;
+    bool back = m_lastKeyframe > segment;
+    qint64 forwardChanges = 0, backChanges = 0;
+    for (int i = 1; i <= segment; ++i) {
+        forward = forward && m_segments[i].hasKeyframe;
+        forwardChanges += m_segments[i].keyframeChanges;
+    }
+    for (int i = segment + 1; back && i <= m_lastKeyframe; ++i) {
+        back = m_segments[i].hasKeyframe;
+        backChanges += m_segments[i].keyframeChanges;
+    }
+    if (!forward && !back)
+        return false;
+    if (forward && back && forwardChanges <= backChanges)
+        back = false;
+
+    std::shared_ptr<FieldStorage> fields((back ? m_last : m_first).fields->clone());
+    KeyframeDelta delta;
+    if (back) {
+        for (int i = m_lastKeyframe; i > segment; --i) {
+            if (!readKeyframe(i, &delta))
+                return false;
+            applyDelta(fields.get(), delta, true);
+        }
+        // For the robots.
+        if (!readKeyframe(segment, &delta))
+            return false;
+    }
+    else {
+        for (int i = 1; i <= segment; ++i) {
+            if (!readKeyframe(i, &delta))
+                return false;
+            applyDelta(fields.get(), delta, false);
+        }
+    }
+    keyframe->fields = fields;
+    keyframe->robots = delta.robots;
+    keyframe->selected = delta.selected;
+    return true;
+}
+
+bool TraceModel::readKeyframe(int segment, KeyframeDelta *delta) const {
+    const Segment &s = m_segments[segment];
+    if (s.keyframeOffset == -1) {
+        *delta = s.keyframe;
+        return true;
+    }
+    QFile *f = file();
+    if (!f || !f->seek(s.keyframeOffset))
+        return false;
+    QDataStream in(f);
+    readDelta(in, delta);
+    return in.status() == QDataStream::Ok;
+}
+
+void TraceModel::dropLastKeyframe() const {
+    if (m_lastKeyframe >= m_segments.size()) {
+        m_lastKeyframe = -1;
+        m_last = WorldSnapshot();
+    }
+}
+
+void TraceModel::writeDelta(QDataStream &out, const KeyframeDelta &delta) {
+    out << delta.points << delta.before << delta.after << qint32(delta.robots.size());
+    for (const Robot &r : delta.robots)
+        out << qint32(r.id) << r.pos << quint8(r.dir);
+    out << qint32(delta.selected);
+}
+
+void TraceModel::readDelta(QDataStream &in, KeyframeDelta *delta) {
+    qint32 robots, selected;
+    in >> delta->points >> delta->before >> delta->after >> robots;
+    if (in.status() != QDataStream::Ok || robots < 0 || delta->before.size() != delta->points.size()
+        || delta->after.size() != delta->points.size()) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return;
+    }
+    delta->robots.resize(robots);
+    for (Robot &r : delta->robots) {
+        qint32 id;
+        quint8 dir;
+        in >> id >> r.pos >> dir;
+        r.id = id;
+        r.dir = static_cast<Direction>(dir);
+    }
+    in >> selected;
+    delta->selected = selected;
+}
+
+void TraceModel::applyDelta(FieldStorage *fields, const KeyframeDelta &delta, bool back) {
+    const QByteArray &values = back ? delta.before : delta.after;
+    for (int i = 0; i < delta.points.size(); ++i)
+        fields->set(delta.points[i], static_cast<Field>(values[i]));
+}
+
+void TraceModel::setBudget(int items) {
+    m_budget = qMax(items, 2 * SEGMENT_SIZE);
+    enforceBudget(m_segments.size() - 1);
+}
+
+int TraceModel::budget() const {
+    return m_budget;
+}
+
+void TraceModel::pageIn(int segment) const {
+    Segment &s = m_segments[segment];
+    read(s);
+    s.lastUse = ++m_clock;
+    m_resident += s.count;
+    enforceBudget(segment);
+}
+
+void TraceModel::enforceBudget(int keep) const {
+    while (m_resident > m_budget && !m_spillFailed) {
+        int victim = -1;
+        for (int i = 0; i + 1 < m_segments.size(); ++i) {
+            const Segment &s = m_segments[i];
+            if (i != keep && s.resident && s.pins == 0 && (victim == -1 || s.lastUse < m_segments[victim].lastUse))
+                victim = i;
+        }
+        // Without a file the trace simply stays in memory.
+        if (victim == -1 || !spill(victim))
+            return;
+    }
+}
+
+bool TraceModel::spill(int segment) const {
+    Segment &s = m_segments[segment];
+    if (!write(s))
+        return false;
+    qDeleteAll(s.items);
+    s.items.clear();
+    s.items.squeeze();
+    s.resident = false;
+    m_resident -= s.count;
+    return true;
+}
+
+bool TraceModel::write(Segment &s) const {
+    QFile *f = file();
+    if (!f)
+        return false;
+    QDataStream out(f);
+    // Offsets are only taken over once everything is in the file, a short write is written again next time.
+    qint64 offset = s.offset;
+    if (offset == -1) {
+        offset = f->size();
+        if (!f->seek(offset))
+            return false;
+        for (const DebugTraceItem *item : s.items)
+            item->write(out);
+        if (out.status() != QDataStream::Ok || !f->flush())
+            return false;
+    }
+    qint64 keyframeOffset = s.keyframeOffset;
+    if (s.hasKeyframe && keyframeOffset == -1) {
+        keyframeOffset = f->size();
+        if (!f->seek(keyframeOffset))
+            return false;
+        writeDelta(out, s.keyframe);
+        if (out.status() != QDataStream::Ok || !f->flush())
+            return false;
+    }
+    s.offset = offset;
+    if (s.hasKeyframe) {
+        s.keyframeOffset = keyframeOffset;
+        s.keyframe = KeyframeDelta();
+    }
+    return true;
+}
+
+void TraceModel::read(Segment &s) const {
+    assert(!s.resident && s.offset != -1 && "TraceModel::read: segment is not spilled.");
+    m_file->seek(s.offset);
+    QDataStream in(m_file.get());
+    s.items.reserve(s.count);
+    for (int i = 0; i < s.count; ++i)
+        s.items.push_back(DebugTraceItem::read(in));
+    s.resident = true;
+}
+
+void TraceModel::pin(int row) const {
+    ++m_segments[row / SEGMENT_SIZE].pins;
+}
+
+void TraceModel::unpin(int row) const {
+    --m_segments[row / SEGMENT_SIZE].pins;
+}
+
+QFile *TraceModel::file() const {
+    // Tried once, not again for every item over the budget.
+    if (!m_file && !m_spillFailed) {
+        m_file.reset(new QTemporaryFile(QDir::tempPath() + "/charles-trace-XXXXXX"));
+        if (!m_file->open()) {
+            qWarning("TraceModel: cannot open a file to spill the trace, it is kept in memory.");
+            m_file.reset();
+            m_spillFailed = true;
+        }
+    }
+    return m_file.get();
+}
+
+PinnedItem::PinnedItem(const TraceModel *model, int row)
+    : m_model(model),
+    m_row(row),
+    m_item(model->item(row))
+{
+    model->pin(row);
+}
+
+PinnedItem::~PinnedItem() {
+    m_model->unpin(m_row);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QTemporaryFile>
+#include <QHash>
+#include <memory>
+
+#include "debugtraceitem.h"
+
+/*
+ * The items of the trace that DebugTraceWidget shows, with a memory budget.
+ *
+ * Items are kept in segments of SEGMENT_SIZE. When more items than the budget are in memory, the segment that was
+ * used longest ago is spilled: written to an append-only temporary file in the binary encoding of DebugTraceItem,
+ * and dropped. Asking for one of its items (the view scrolls to it, the trace seeks through it) reads the segment
+ * back. A segment that did not change since it was written is not written again. The last segment, where items
+ * are added, stays in memory. So the memory of a trace stays about the same, however long a program runs.
+ *
+ * Keyframes: the first item of a segment has the world before it (see setKeyframe), so the trace can jump back to an
+ * item far away without reversing every item in between. Only two keyframes are kept whole: the first one and the
+ * last one that was set. The others are the fields that changed since the keyframe of the segment before (and the
+ * robots), which are spilled with their segment. A keyframe is made again from the nearest whole one.
+ *
+ * Branches (see DebugTraceWidget): items that are put aside keep their segments, spilled ones stay in the file with
+ * their keyframes. They go back to the rows they came from, so a switch of branches does not read them.
+ */
+
+class PinnedItem;
+
+class TraceModel : public QAbstractListModel
+{
+public:
+    explicit TraceModel(QObject *parent = nullptr);
+    ~TraceModel();
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role) const override;
+
+    int count() const;
+    // Returns item row, its segment is read back if it was spilled, which may spill other segments. The pointer is
+    // valid until the next call that adds, takes or returns items, a PinnedItem keeps it valid while it is held.
+    DebugTraceItem *item(int row) const;
+    // Add item at the end, the model owns it.
+    void append(DebugTraceItem *item);
+    // Remove the last item, the caller owns it.
+    DebugTraceItem *takeLast();
+    // Delete the items from row count on, spilled items are not read back for it.
+    void truncate(int count);
+
+    // Put the items from row first on aside under key, in front of the ones that are aside under key already.
+    void putAside(int key, int first);
+    // Append the first count items that are aside under key. They go back to the rows they came from, so
+    // the model must end right before them.
+    void restoreAside(int key, int count);
+    // Returns the number of items aside under key.
+    int asideCount(int key) const;
+    // Delete all items that are aside.
+    void dropAside();
+
+    // Returns the number of recorded events: the items with their folded sensor queries, except the first item
+    // ("Start of Program").
+    int eventCount() const;
+    // Returns the item before event: the last item whose events all come before it.
+    int itemBeforeEvent(int event) const;
+
+    // Returns true iff row is the first item of a segment.
+    static bool isSegmentStart(int row);
+    // Set the world before item row, which must start a segment. The keyframes after it must be set again.
+    void setKeyframe(int row, const WorldSnapshot& before);
+    // Returns the last row <= row with a keyframe and sets keyframe to the world before it. -1 if there is none.
+    int keyframeBefore(int row, WorldSnapshot *keyframe) const;
+
+    // Number of items kept in memory, at least two segments.
+    void setBudget(int items);
+    int budget() const;
+
+    constexpr static int SEGMENT_SIZE = 4096;
+    constexpr static int DEFAULT_BUDGET = 64 * SEGMENT_SIZE;
+
+private:
+    friend class PinnedItem;
+
+    // The fields that changed since the keyframe of the segment before, and the robots.
+    struct KeyframeDelta {
+        QVector<QPoint> points;
+        QByteArray before;
+        QByteArray after;
+        QVector<Robot> robots;
+        int selected = 0;
+    };
+
+    struct Segment {
+        // Empty while spilled.
+        QVector<DebugTraceItem*> items;
+        int count = 0;
+        // Items plus their folded sensor queries.
+        int events = 0;
+        bool resident = true;
+        // Place of the items in the file, -1 if they changed since they were written.
+        qint64 offset = -1;
+        // The keyframe of the first segment is m_first. The others are a delta, in memory or in the file at
+        // keyframeOffset.
+        bool hasKeyframe = false;
+        KeyframeDelta keyframe;
+        qint64 keyframeOffset = -1;
+        int keyframeChanges = 0;
+        // Least recently used segments are spilled first, pinned ones are not.
+        quint64 lastUse = 0;
+        int pins = 0;
+    };
+
+    // Items that are put aside, from row first on.
+    struct Aside {
+        int first = 0;
+        int count = 0;
+        // The first one may start within a segment, it is in memory then.
+        QVector<Segment> segments;
+    };
+
+    // Read spilled segment back, other segments may be spilled for it.
+    void pageIn(int segment) const;
+    // Spill the least recently used segments until the budget is met, never keep or the last segment.
+    void enforceBudget(int keep) const;
+    // Write segment to the file (if needed) and drop its items. Returns false if the file cannot be written.
+    bool spill(int segment) const;
+    // Write the items of s (if they changed) and its keyframe (if it is only in memory) to the file. Returns false if
+    // the file cannot be written, s is not changed then.
+    bool write(Segment& s) const;
+    // Read the items of spilled segment s back.
+    void read(Segment& s) const;
+    // Sets delta to the keyframe of segment, which must not be the first one. Returns false if it cannot be read.
+    bool readKeyframe(int segment, KeyframeDelta *delta) const;
+    // Sets keyframe to the world before segment, made from the nearest whole keyframe. Returns false if there is
+    // no way to it.
+    bool keyframeOf(int segment, WorldSnapshot *keyframe) const;
+    // Forget m_last if its segment is gone.
+    void dropLastKeyframe() const;
+    // Returns the spill file, opened on first use. nullptr if it cannot be opened, then it is not tried again.
+    QFile *file() const;
+
+    // Keyframes are written as the changed points with their fields before and after, then the robots.
+    static void writeDelta(QDataStream& out, const KeyframeDelta& delta);
+    static void readDelta(QDataStream& in, KeyframeDelta *delta);
+    // Set the changed fields of delta to their value after it, or before it if back.
+    static void applyDelta(FieldStorage *fields, const KeyframeDelta& delta, bool back);
+
+    void pin(int row) const;
+    void unpin(int row) const;
+
+    // Segments are a cache of the file, so reading an item (also from data()) may change them.
+    mutable QVector<Segment> m_segments;
+    mutable int m_resident = 0;
+    mutable quint64 m_clock = 0;
+    mutable std::unique_ptr<QTemporaryFile> m_file;
+    // The file could not be opened, nothing is spilled.
+    mutable bool m_spillFailed = false;
+    int m_count = 0;
+    int m_budget = DEFAULT_BUDGET;
+    QHash<int, Aside> m_aside;
+    // The whole keyframes: of the first segment, and of segment m_lastKeyframe (-1 for none).
+    WorldSnapshot m_first;
+    mutable WorldSnapshot m_last;
+    mutable int m_lastKeyframe = -1;
+};
+
+// An item of a TraceModel whose segment stays in memory while this is held, so other calls of the model do not
+// spill it.
+class PinnedItem
+{
+public:
+    PinnedItem(const TraceModel *model, int row);
+    ~PinnedItem();
+    PinnedItem(const PinnedItem&) = delete;
+    PinnedItem &operator=(const PinnedItem&) = delete;
+
+    DebugTraceItem *operator->() const { return m_item; }
+
+private:
+    const TraceModel *m_model;
+    const int m_row;
+    DebugTraceItem *m_item;
+};
@@ -0,0 +1,83 @@
+#include "traceplayer.h"
+#include "commands.h"
+
+#include <cmath>
+
+// Items executed between two checks of the frame budget.
+const int SEEK_BATCH = 256;
+
+TracePlayer::TracePlayer(DebugTraceWidget *trace, QObject *parent)
+    : QObject{parent},
+    m_trace(trace)
+{
+    connect(&m_timer, &QTimer::timeout, this, &TracePlayer::onTimeout);
+    setSpeed(defaultSpeed());
+}
+
+void TracePlayer::setTrace(DebugTraceWidget *trace) {
+    pause();
+    m_trace = trace;
+}
+
+void TracePlayer::setSpeed(double actionsPerSecond) {
+    m_speed = qBound(MIN_SPEED, actionsPerSecond, MAX_SPEED);
+    m_timer.setInterval(qMax(FRAME_MSEC, static_cast<int>(1000 / m_speed)));
+    if (isPlaying())
+        restartClock();
+}
+
+double TracePlayer::speed() const {
+    return m_speed;
+}
+
+bool TracePlayer::isPlaying() const {
+    return m_timer.isActive();
+}
+
+double TracePlayer::defaultSpeed() {
+    return 1000.0 / DELAY_MSEC;
+}
+
+void TracePlayer::play() {
+    if (isPlaying() || m_trace->currentIndex() == m_trace->itemCount() - 1)
+        return;
+    restartClock();
+    m_timer.start();
+    emit playingChanged(true);
+}
+
+void TracePlayer::pause() {
+    if (!isPlaying())
+        return;
+    m_timer.stop();
+    emit playingChanged(false);
+}
+
+void TracePlayer::onTimeout() {
+    // The user (or a program) moved the trace, continue from there.
+    if (m_trace->currentIndex() != m_lastIndex)
+        restartClock();
+
+    const int last = m_trace->itemCount() - 1;
+    const qint64 due = m_startIndex + static_cast<qint64>(std::floor(m_clock.elapsed() * m_speed / 1000));
+    const int target = static_cast<int>(qMin<qint64>(due, last));
+
+    QElapsedTimer frame;
+    frame.start();
+    int index = m_trace->currentIndex();
+    while (index < target && frame.elapsed() < FRAME_BUDGET_MSEC) {
+        index = qMin(target, index + SEEK_BATCH);
+        m_trace->seek(index);
+    }
+    m_lastIndex = index;
+
+    if (index == last)
+        pause();
+    else if (index < target)
+        restartClock();     // Too slow for this speed, do not build up a backlog.
+}
+
+void TracePlayer::restartClock() {
+    m_startIndex = m_lastIndex = m_trace->currentIndex();
+    m_clock.start();
+}
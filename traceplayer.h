@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "debugtracewidget.h"
+
+/*
+ * Animated playback of the debug trace: moves the current item forward at a given speed.
+ *
+ * Playback is driven by the clock, not by counting timer ticks: every tick seeks to the item that is due by now.
+ * At low speeds a tick executes one item, at high speeds the intermediate items are executed in a batch
+ * and only the last state is painted (frame skipping). A tick never works longer than FRAME_BUDGET_MSEC,
+ * if the items cannot be executed that fast the clock is reset, so playback slows down instead of building up
+ * a backlog that blocks the UI.
+ */
+
+class TracePlayer : public QObject
+{
+    Q_OBJECT
+public:
+    TracePlayer(DebugTraceWidget *trace, QObject *parent = nullptr);
+
+    // Play trace from now on (e.g. the trace of another tab), playback is paused.
+    void setTrace(DebugTraceWidget *trace);
+
+    // Speed in actions (trace items) per second.
+    void setSpeed(double actionsPerSecond);
+    double speed() const;
+    bool isPlaying() const;
+
+    // Default speed: one action every DELAY_MSEC (commands.h).
+    static double defaultSpeed();
+    constexpr static double MIN_SPEED = 0.5;
+    constexpr static double MAX_SPEED = 100000;
+    // Timer interval at high speeds, about one frame of the screen.
+    constexpr static int FRAME_MSEC = 16;
+    constexpr static int FRAME_BUDGET_MSEC = 12;
+
+public slots:
+    // Play from the current item to the end of the trace.
+    void play();
+    void pause();
+
+signals:
+    // Playback started or stopped (paused, or at the end of the trace).
+    void playingChanged(bool playing);
+
+private slots:
+    void onTimeout();
+
+private:
+    // Start counting from the current item at the current time.
+    void restartClock();
+
+    DebugTraceWidget *m_trace;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    double m_speed;
+    // Item at the time the clock started, and the item playback moved to last.
+    int m_startIndex = 0;
+    int m_lastIndex = 0;
+};
@@ -0,0 +1,574 @@
+#include "workerpool.h"
+
+#include <QDataStream>
+
+#ifdef Q_OS_UNIX
+
+#include "headlessrunner.h"
+#include "agentplugin.h"
+#include "agent.h"
+#include "scriptvm.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QtEndian>
+#include <QDeadlineTimer>
+
+#include <new>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+ * All pipes carry frames: a quint32 length (big endian) followed by a FrameKind and its data.
+ * UI -> worker:    JobFrame, CancelFrame while the job runs
+ * Job -> worker:   EventsFrame*, MessageFrame?, FingerprintFrame
+ * Worker -> UI:    the complete frames of the job, then an OutcomeFrame.
+ */
+enum FrameKind : quint8 { JobFrame, EventsFrame, MessageFrame, FingerprintFrame, OutcomeFrame, CancelFrame };
+
+// Exit codes of a job process.
+enum JobExitCode { ExitFinished = 0, ExitStoppedOnError, ExitBadJob, ExitOutOfMemory };
+
+// Why the worker killed a job process, if it did.
+enum JobKill { NotKilled, KilledAtWallLimit, KilledOnCancel };
+
+// Number of events per EventsFrame.
+const int EVENT_CHUNK_SIZE = 4096;
+const int READ_BUFFER_SIZE = 64 * 1024;
+
+// Workers started by prefork(), until a WorkerPool takes them over.
+struct PreforkedWorker {
+    int pid;
+    int toWorker;
+    int fromWorker;
+};
+static QVector<PreforkedWorker> preforkedWorkers;
+
+static QDataStream &operator<<(QDataStream &out, const SandboxJob &job) {
+    return out << job.worldFile << job.agent << job.pluginFile << job.scriptFile << job.seed
+               << job.cpuSeconds << job.wallSeconds << job.memoryMegabytes << job.maxEvents << job.sendEvents;
+}
+
+static QDataStream &operator>>(QDataStream &in, SandboxJob &job) {
+    return in >> job.worldFile >> job.agent >> job.pluginFile >> job.scriptFile >> job.seed
+              >> job.cpuSeconds >> job.wallSeconds >> job.memoryMegabytes >> job.maxEvents >> job.sendEvents;
+}
+
+template <typename... Args>
+static QByteArray frame(FrameKind kind, const Args&... args) {
+    QByteArray data;
+    QDataStream out(&data, QIODeviceBase::WriteOnly);
+    out << quint32(0) << quint8(kind);
+    (out << ... << args);
+    qToBigEndian<quint32>(data.size() - sizeof(quint32), data.data());
+    return data;
+}
+
+// Returns the length of the first frame in buffer including its header, or 0 if it is not complete yet.
+static qsizetype completeFrame(const QByteArray &buffer) {
+    if (buffer.size() < qsizetype(sizeof(quint32)))
+        return 0;
+    const qsizetype length = sizeof(quint32) + qFromBigEndian<quint32>(buffer.constData());
+    return buffer.size() >= length ? length : 0;
+}
+
+// Blocking write of all data. Returns false if the other side is gone.
+static bool writeAll(int fd, const QByteArray &data) {
+    const char *p = data.constData();
+    qsizetype left = data.size();
+    while (left > 0) {
+        const ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+// Blocking read of exactly size bytes. Returns false on end of file.
+static bool readAll(int fd, char *p, qsizetype size) {
+    while (size > 0) {
+        const ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Blocking read of one frame, without its header.
+static bool readFrame(int fd, QByteArray *payload) {
+    quint32 length;
+    if (!readAll(fd, reinterpret_cast<char*>(&length), sizeof(length)))
+        return false;
+    payload->resize(qFromBigEndian(length));
+    return readAll(fd, payload->data(), payload->size());
+}
+
+// Returns the virtual memory the process uses now, in bytes (0 if unknown).
+static qint64 currentAddressSpace() {
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODeviceBase::ReadOnly))
+        return 0;
+    return statm.readAll().split(' ').first().toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+// The job process: run the program of the job on world and stream the trace to out.
+[[noreturn]] static void runJob(const SandboxJob &job, WorldObject *world, int out) {
+    // The memory limit comes on top of what the process already uses (Qt, the world).
+    const rlim_t memory = currentAddressSpace() + (rlim_t(job.memoryMegabytes) << 20);
+    const rlimit memoryLimit{memory, memory};
+    const rlimit cpuLimit{rlim_t(job.cpuSeconds), rlim_t(job.cpuSeconds) + 1};
+    setrlimit(RLIMIT_AS, &memoryLimit);
+    setrlimit(RLIMIT_CPU, &cpuLimit);
+
+    AgentFunction agent;
+    QString error = "There is no program named " + job.agent + ".";
+    if (!job.scriptFile.isEmpty()) {
+        QFile file(job.scriptFile);
+        if (!file.open(QIODeviceBase::ReadOnly))
+            error = "Could not open " + job.scriptFile + ".";
+        else {
+            try {
+                const ScriptProgram program = ScriptProgram::compile(QString::fromUtf8(file.readAll()));
+                // Same names as in the program menu, see MainWindow::updateScriptMenu.
+                for (const ScriptProgram::Procedure &p : program.procedures) {
+                    if (job.agent == QFileInfo(job.scriptFile).completeBaseName() + ": " + p.name)
+                        agent = [=]() { ScriptVM::run(program, p.name, commandTarget); };
+                }
+            }
+            catch (ScriptError &e) {
+                error = job.scriptFile + ": " + e.what();
+            }
+        }
+    }
+    else if (!job.pluginFile.isEmpty())
+        agent = AgentPluginLoader::loadOnce(job.pluginFile, job.agent, &error);
+    else {
+        for (const auto& a : AGENTS_TABLE) {
+            if (job.agent == a.first)
+                agent = a.second;
+        }
+    }
+    if (!agent) {
+        writeAll(out, frame(MessageFrame, error));
+        _exit(ExitBadJob);
+    }
+
+    HeadlessRunner runner(world, job.seed, job.maxEvents);
+    QVector<TraceEvent> chunk;
+    auto flush = [&]() {
+        if (!chunk.isEmpty() && !writeAll(out, frame(EventsFrame, chunk)))
+            _exit(ExitBadJob);
+        chunk.clear();
+    };
+    if (job.sendEvents) {
+        runner.setEventSink([&](const TraceEvent &e) {
+            chunk.push_back(e);
+            if (chunk.size() == EVENT_CHUNK_SIZE)
+                flush();
+        });
+    }
+    try {
+        runner.run(agent);
+    }
+    catch (const std::bad_alloc&) {
+        _exit(ExitOutOfMemory);
+    }
+    flush();
+    if (runner.failed())
+        writeAll(out, frame(MessageFrame, runner.errorMessage()));
+    writeAll(out, frame(FingerprintFrame, runner.fingerprint(), runner.eventCount()));
+    _exit(runner.failed() ? ExitStoppedOnError : ExitFinished);
+}
+
+// Forward the complete frames from in to out until in is closed. A partial frame (killed job) is dropped.
+// Job process child is killed when it runs longer than the wall clock limit of job, or when a CancelFrame comes on
+// control (or the UI is gone). Returns why it was killed.
+static JobKill forwardFrames(int in, int out, int control, pid_t child, const SandboxJob &job) {
+    QByteArray buffer;
+    char data[READ_BUFFER_SIZE];
+    const QDeadlineTimer deadline(qint64(job.wallSeconds) * 1000);
+    JobKill killed = NotKilled;
+    for (;;) {
+        // After the kill only the job is waited for, until its end of the pipe is closed.
+        pollfd fds[2] = {{in, POLLIN, 0}, {control, POLLIN, 0}};
+        const int timeout = killed == NotKilled ? int(qMin<qint64>(deadline.remainingTime(), INT_MAX)) : -1;
+        const int ready = poll(fds, killed == NotKilled ? 2 : 1, timeout);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready == 0 || (ready < 0 && killed == NotKilled)) {
+            kill(child, SIGKILL);
+            killed = KilledAtWallLimit;
+            continue;
+        }
+        if (ready < 0)
+            return killed;
+        if (killed == NotKilled && fds[1].revents) {
+            // Only cancel frames come while a job runs, an end of file means the UI is gone.
+            QByteArray payload;
+            readFrame(control, &payload);
+            kill(child, SIGKILL);
+            killed = KilledOnCancel;
+        }
+        if (!fds[0].revents)
+            continue;
+        const ssize_t n = read(in, data, sizeof(data));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return killed;
+        buffer.append(data, n);
+        qsizetype length;
+        while ((length = completeFrame(buffer)) > 0) {
+            writeAll(out, buffer.left(length));
+            buffer.remove(0, length);
+        }
+    }
+}
+
+// Returns the outcome of a job process from its wait status, its resource usage and why the worker killed it.
+static QPair<SandboxStatus, QString> jobOutcome(int status, const rusage &usage, JobKill killed, const SandboxJob &job) {
+    const int sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+    // A job that ended on its own before the kill keeps its outcome.
+    if (sig == SIGKILL && killed == KilledOnCancel)
+        return {SandboxStatus::SandboxCancelled, QString("The program was cancelled.")};
+    if (sig == SIGKILL && killed == KilledAtWallLimit)
+        return {SandboxStatus::SandboxTimeLimit, QString("The program ran for more than %1 seconds.").arg(job.wallSeconds)};
+    if (WIFEXITED(status)) {
+        switch (WEXITSTATUS(status)) {
+        case ExitFinished:
+            return {SandboxStatus::SandboxFinished, QString()};
+        case ExitStoppedOnError:
+            return {SandboxStatus::SandboxStoppedOnError, QString()};
+        case ExitBadJob:
+            return {SandboxStatus::SandboxBadJob, QString()};
+        case ExitOutOfMemory:
+            return {SandboxStatus::SandboxMemoryLimit, QString("The program used more than %1 MB of memory.").arg(job.memoryMegabytes)};
+        default:
+            return {SandboxStatus::SandboxCrashed, QString("The program exited with code %1.").arg(WEXITSTATUS(status))};
+        }
+    }
+    // SIGXCPU at the soft CPU limit, SIGKILL at the hard limit. Other kills (the OOM killer, a user) are no time limit.
+    const qint64 cpuMsec = (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000
+                           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+    if (sig == SIGXCPU || (sig == SIGKILL && cpuMsec >= qint64(job.cpuSeconds) * 1000))
+        return {SandboxStatus::SandboxTimeLimit, QString("The program used more than %1 seconds of CPU time.").arg(job.cpuSeconds)};
+    if (sig == SIGKILL)
+        return {SandboxStatus::SandboxCrashed, QString("The program was killed, maybe the system ran out of memory.")};
+    return {SandboxStatus::SandboxCrashed, QString("The program crashed (%1).").arg(strsignal(sig))};
+}
+
+// The worker process: read jobs from in and run each in a fresh job process. Exits when the UI is gone.
+[[noreturn]] static void workerMain(int in, int out) {
+    // The last world, jobs on the same (unchanged) file do not load it again.
+    WorldObject world;
+    QString worldFile;
+    QDateTime worldModified;
+
+    QByteArray payload;
+    while (readFrame(in, &payload)) {
+        QDataStream stream(payload);
+        quint8 kind;
+        SandboxJob job;
+        stream >> kind;
+        // A cancel that came after its job had ended.
+        if (kind != FrameKind::JobFrame)
+            continue;
+        stream >> job;
+        auto outcome = [&](SandboxStatus status, const QString &message) {
+            if (!writeAll(out, frame(OutcomeFrame, quint8(status), message)))
+                _exit(0);
+        };
+
+        const QDateTime modified = QFileInfo(job.worldFile).lastModified();
+        if (job.worldFile != worldFile || modified != worldModified) {
+            try {
+                world.loadFromFile(job.worldFile);
+                worldFile = job.worldFile;
+                worldModified = modified;
+            }
+            catch (QException &e) {
+                worldFile.clear();
+                outcome(SandboxStatus::SandboxBadJob, job.worldFile + ": " + e.what());
+                continue;
+            }
+        }
+
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            outcome(SandboxStatus::SandboxCrashed, QString("Could not create a pipe: ") + strerror(errno));
+            continue;
+        }
+        const pid_t child = fork();
+        if (child == 0) {
+            close(pipeFds[0]);
+            close(in);
+            close(out);
+            runJob(job, &world, pipeFds[1]);
+        }
+        close(pipeFds[1]);
+        if (child < 0) {
+            close(pipeFds[0]);
+            outcome(SandboxStatus::SandboxCrashed, QString("Could not start the program: ") + strerror(errno));
+            continue;
+        }
+        const JobKill killed = forwardFrames(pipeFds[0], out, in, child, job);
+        close(pipeFds[0]);
+        int status = 0;
+        rusage usage{};
+        while (wait4(child, &status, 0, &usage) < 0 && errno == EINTR)
+            continue;
+        const auto result = jobOutcome(status, usage, killed, job);
+        outcome(result.first, result.second);
+    }
+    _exit(0);
+}
+
+void WorkerPool::prefork(int n) {
+    // Writing to a worker that died must not kill the UI (and the other way around).
+    signal(SIGPIPE, SIG_IGN);
+    for (int i = 0; i < n; ++i) {
+        int toWorker[2], fromWorker[2];
+        if (pipe(toWorker) != 0)
+            return;
+        if (pipe(fromWorker) != 0) {
+            close(toWorker[0]);
+            close(toWorker[1]);
+            return;
+        }
+        const pid_t pid = fork();
+        if (pid == 0) {
+            // Only keep the own pipes, so every worker sees the end of file when the UI goes away.
+            for (const PreforkedWorker &w : preforkedWorkers) {
+                close(w.toWorker);
+                close(w.fromWorker);
+            }
+            close(toWorker[1]);
+            close(fromWorker[0]);
+            workerMain(toWorker[0], fromWorker[1]);
+        }
+        close(toWorker[0]);
+        close(fromWorker[1]);
+        if (pid < 0) {
+            close(toWorker[1]);
+            close(fromWorker[0]);
+            return;
+        }
+        // Do not leak the pipes into processes started by the UI.
+        fcntl(toWorker[1], F_SETFD, FD_CLOEXEC);
+        fcntl(fromWorker[0], F_SETFD, FD_CLOEXEC);
+        preforkedWorkers.push_back(PreforkedWorker{pid, toWorker[1], fromWorker[0]});
+    }
+}
+
+WorkerPool::WorkerPool(QObject *parent)
+    : QObject{parent}
+{
+    for (const PreforkedWorker &p : preforkedWorkers) {
+        Worker worker{p.pid, p.toWorker, p.fromWorker};
+        fcntl(worker.fromWorker, F_SETFL, fcntl(worker.fromWorker, F_GETFL) | O_NONBLOCK);
+        worker.notifier = new QSocketNotifier(worker.fromWorker, QSocketNotifier::Read, this);
+        const int w = m_workers.size();
+        connect(worker.notifier, &QSocketNotifier::activated, this, [=]() { readWorker(w); });
+        m_workers.push_back(worker);
+    }
+    preforkedWorkers.clear();
+}
+
+WorkerPool::~WorkerPool() {
+    // Closing the pipes ends the workers, they kill their running jobs.
+    for (Worker &worker : m_workers) {
+        if (worker.pid == -1)
+            continue;
+        close(worker.toWorker);
+        close(worker.fromWorker);
+        kill(worker.pid, SIGTERM);
+        waitpid(worker.pid, nullptr, 0);
+    }
+}
+
+bool WorkerPool::isAvailable() const {
+    for (const Worker &worker : m_workers) {
+        if (worker.pid != -1)
+            return true;
+    }
+    return false;
+}
+
+int WorkerPool::submit(const SandboxJob &job) {
+    const int id = m_nextId++;
+    m_queue.enqueue({id, job});
+    // Later, so that the caller knows the id before jobFinished() is emitted.
+    QMetaObject::invokeMethod(this, &WorkerPool::dispatch, Qt::QueuedConnection);
+    return id;
+}
+
+void WorkerPool::cancel(int id) {
+    for (int i = 0; i < m_queue.size(); ++i) {
+        if (m_queue[i].first == id) {
+            m_queue.removeAt(i);
+            // Later, as for a job that ran, so a caller can cancel all of its jobs in one loop.
+            QMetaObject::invokeMethod(this, [=]() {
+                emit jobFinished(id, SandboxResult{SandboxStatus::SandboxCancelled, "The program was cancelled.", {}});
+            }, Qt::QueuedConnection);
+            return;
+        }
+    }
+    // A running job is killed by its worker, the outcome comes as for any other job.
+    for (const Worker &worker : m_workers) {
+        if (worker.pid != -1 && worker.jobId == id)
+            writeAll(worker.toWorker, frame(CancelFrame));
+    }
+}
+
+void WorkerPool::readWorker(int w) {
+    Worker &worker = m_workers[w];
+    char data[READ_BUFFER_SIZE];
+    bool closed = false;
+    for (;;) {
+        const ssize_t n = read(worker.fromWorker, data, sizeof(data));
+        if (n > 0)
+            worker.buffer.append(data, n);
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else {
+            closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+    }
+
+    qsizetype length;
+    while ((length = completeFrame(worker.buffer)) > 0) {
+        QDataStream stream(worker.buffer.mid(sizeof(quint32), length - sizeof(quint32)));
+        worker.buffer.remove(0, length);
+        quint8 kind;
+        stream >> kind;
+        if (kind == FrameKind::EventsFrame) {
+            QVector<TraceEvent> events;
+            stream >> events;
+            worker.result.events.append(events);
+        }
+        else if (kind == FrameKind::MessageFrame)
+            stream >> worker.result.message;
+        else if (kind == FrameKind::FingerprintFrame)
+            stream >> worker.result.fingerprint >> worker.result.eventCount;
+        else if (kind == FrameKind::OutcomeFrame) {
+            quint8 status;
+            QString message;
+            stream >> status >> message;
+            SandboxResult result = std::move(worker.result);
+            result.status = static_cast<SandboxStatus>(status);
+            if (!message.isEmpty())
+                result.message = message;
+            const int id = worker.jobId;
+            worker.result = SandboxResult();
+            worker.jobId = -1;
+            emit jobFinished(id, result);
+        }
+    }
+    if (closed)
+        dropWorker(w);
+    dispatch();
+}
+
+void WorkerPool::dropWorker(int w) {
+    Worker &worker = m_workers[w];
+    worker.notifier->setEnabled(false);
+    close(worker.toWorker);
+    close(worker.fromWorker);
+    waitpid(worker.pid, nullptr, 0);
+    worker.pid = -1;
+    if (worker.jobId != -1) {
+        SandboxResult result = std::move(worker.result);
+        result.status = SandboxStatus::SandboxCrashed;
+        result.message = "The sandbox worker stopped unexpectedly.";
+        emit jobFinished(worker.jobId, result);
+        worker.jobId = -1;
+    }
+}
+
+void WorkerPool::dispatch() {
+    for (int w = 0; w < m_workers.size() && !m_queue.isEmpty(); ++w) {
+        Worker &worker = m_workers[w];
+        if (worker.pid == -1 || worker.jobId != -1)
+            continue;
+        const QPair<int, SandboxJob> job = m_queue.dequeue();
+        if (!writeAll(worker.toWorker, frame(JobFrame, job.second))) {
+            m_queue.prepend(job);
+            dropWorker(w);
+            continue;
+        }
+        worker.jobId = job.first;
+    }
+    if (!isAvailable()) {
+        while (!m_queue.isEmpty())
+            emit jobFinished(m_queue.dequeue().first, SandboxResult{SandboxStatus::SandboxCrashed, "No sandbox workers are running.", {}});
+    }
+}
+
+#else
+
+// No sandbox on this system: there are never any workers.
+
+void WorkerPool::prefork(int) {
+}
+
+WorkerPool::WorkerPool(QObject *parent)
+    : QObject{parent}
+{
+}
+
+WorkerPool::~WorkerPool() {
+}
+
+bool WorkerPool::isAvailable() const {
+    return false;
+}
+
+int WorkerPool::submit(const SandboxJob &job) {
+    const int id = m_nextId++;
+    m_queue.enqueue({id, job});
+    QMetaObject::invokeMethod(this, &WorkerPool::dispatch, Qt::QueuedConnection);
+    return id;
+}
+
+void WorkerPool::cancel(int id) {
+    for (int i = 0; i < m_queue.size(); ++i) {
+        if (m_queue[i].first == id) {
+            m_queue.removeAt(i);
+            QMetaObject::invokeMethod(this, [=]() {
+                emit jobFinished(id, SandboxResult{SandboxStatus::SandboxCancelled, "The program was cancelled.", {}});
+            }, Qt::QueuedConnection);
+            return;
+        }
+    }
+}
+
+void WorkerPool::readWorker(int) {
+}
+
+void WorkerPool::dropWorker(int) {
+}
+
+void WorkerPool::dispatch() {
+    while (!m_queue.isEmpty())
+        emit jobFinished(m_queue.dequeue().first, SandboxResult{SandboxStatus::SandboxBadJob, "The sandbox is only available on Unix systems.", {}});
+}
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QObject>
+#include <QVector>
+#include <QQueue>
+#include <QByteArray>
+#include <QPair>
+
+#include "debugtraceitem.h"
+
+class QSocketNotifier;
+
+/*
+ * Runs student programs in sandboxed processes (Unix only).
+ *
+ * WorkerPool::prefork() starts the workers at the start of main(), before QApplication exists, so forking is
+ * cheap and safe. A worker waits for jobs on a pipe. It keeps the last loaded world, and forks a child for
+ * every job: the child gets the world for free (copy on write), sets its CPU and memory limits, runs the program
+ * headless (see headlessrunner.h) and streams the trace back in chunks. A crash, endless loop or huge allocation
+ * only takes down the child. The worker forwards the trace and reports how the child ended. It kills a child that
+ * runs longer than its wall clock limit (a program that sleeps or blocks uses no CPU time) or that is cancelled.
+ *
+ * In the UI a WorkerPool object hands out the jobs to idle workers and emits jobFinished().
+ */
+
+struct SandboxJob {
+    QString worldFile;
+    // Name as in the program menu. Programs from a plugin also need the plugin file.
+    QString agent;
+    QString pluginFile;
+    // Programs from a script also need the script file (see charlesscript.h).
+    QString scriptFile;
+    quint32 seed;
+    int cpuSeconds = 5;
+    int wallSeconds = 20;
+    int memoryMegabytes = 512;
+    // Limit on the length of the trace, -1 for no limit.
+    qint64 maxEvents = 1000000;
+    // Without the events only the fingerprint of the run comes back (see tracefingerprint.h).
+    bool sendEvents = true;
+};
+
+enum SandboxStatus {
+    SandboxFinished = 0,
+    SandboxStoppedOnError,  // The program made an error, the trace ends with it.
+    SandboxTimeLimit,
+    SandboxMemoryLimit,
+    SandboxCrashed,
+    SandboxBadJob,          // The world or program could not be loaded.
+    SandboxCancelled
+};
+
+struct SandboxResult {
+    SandboxStatus status = SandboxStatus::SandboxCrashed;
+    QString message;
+    QVector<TraceEvent> events;
+    // Fingerprint of the run and its number of events (see TraceFingerprint), 0 if the run was killed.
+    quint64 fingerprint = 0;
+    qint64 eventCount = 0;
+};
+
+class WorkerPool : public QObject
+{
+    Q_OBJECT
+public:
+    // Start n worker processes. Must be called before QApplication is created. Does nothing on non Unix systems.
+    static void prefork(int n);
+
+    // Takes over the workers started by prefork().
+    explicit WorkerPool(QObject *parent = nullptr);
+    ~WorkerPool();
+
+    // Returns true iff there are workers to run jobs on.
+    bool isAvailable() const;
+    // Queue a job. Returns its id, as passed to jobFinished().
+    int submit(const SandboxJob &job);
+    // Stop job id, it finishes with SandboxCancelled (and the events it sent so far). Does nothing for a job that
+    // finished already.
+    void cancel(int id);
+
+signals:
+    void jobFinished(int id, const SandboxResult &result);
+
+private:
+    struct Worker {
+        int pid;
+        int toWorker;
+        int fromWorker;
+        QSocketNotifier *notifier = nullptr;
+        int jobId = -1;
+        QByteArray buffer;
+        SandboxResult result;
+    };
+
+    // Read all available data from worker w and handle the complete frames.
+    void readWorker(int w);
+    // The worker died, fail its job and drop it.
+    void dropWorker(int w);
+    // Hand out queued jobs to idle workers.
+    void dispatch();
+
+    QVector<Worker> m_workers;
+    QQueue<QPair<int, SandboxJob>> m_queue;
+    int m_nextId = 0;
+};
@@ -0,0 +1,103 @@
+#include "worldautosaver.h"
+
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+WorldAutosaver::WorldAutosaver(WorldObject *world, QObject *parent)
+    : QObject{parent},
+    m_world(world),
+    m_timer(new QTimer(this))
+{
+    setWorldFile(QString());
+    connect(m_world, &WorldObject::newWorldLoaded, this, &WorldAutosaver::invalidate);
+    connect(m_timer, &QTimer::timeout, this, &WorldAutosaver::autosave);
+    m_timer->start(AUTOSAVE_MSEC);
+}
+
+void WorldAutosaver::setWorldFile(const QString &worldFile) {
+    m_file = autosaveFileFor(worldFile, m_untitledName);
+    invalidate();
+}
+
+void WorldAutosaver::setUntitledName(const QString &name) {
+    m_untitledName = name;
+    setWorldFile(QString());
+}
+
+void WorldAutosaver::saved(const QString &worldFile) {
+    QFile::remove(m_file);
+    setWorldFile(worldFile);
+    QFile::remove(m_file);
+}
+
+QString WorldAutosaver::untitledName() const {
+    return m_untitledName;
+}
+
+QString WorldAutosaver::autosaveFile() const {
+    return m_file;
+}
+
+QString WorldAutosaver::autosaveFileFor(const QString &worldFile, const QString &untitledName) {
+    if (worldFile.isEmpty())
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/" + untitledName + ".txt.autosave";
+    return worldFile + ".autosave";
+}
+
+void WorldAutosaver::autosave() {
+    // Rows that change while the whole file is written stay dirty for the next autosave.
+    if (m_job)
+        return;
+    const QVector<int> rows = m_world->takeDirtyRows();
+    // After a failed write the whole file is written again, even if nothing changed since.
+    if (rows.isEmpty() && !m_retry)
+        return;
+    if (!m_valid || !writeRows(rows))
+        writeAll();
+}
+
+bool WorldAutosaver::writeRows(const QVector<int> &rows) {
+    const QSize size = m_world->size();
+    const qint64 rowBytes = size.width() - 1;
+    const qint64 gridBytes = (size.height() - 2) * rowBytes;
+    QFile file(m_file);
+    if (!file.open(QIODeviceBase::ReadWrite) || file.size() < gridBytes)
+        return false;
+    for (int y : rows) {
+        const QByteArray row = m_world->encodeRow(y);
+        if (!file.seek((y - 1) * rowBytes) || file.write(row) != row.size())
+            return false;
+    }
+    const QByteArray trailer = m_world->encodeTrailer();
+    return file.seek(gridBytes) && file.write(trailer) == trailer.size() && file.resize(gridBytes + trailer.size());
+}
+
+void WorldAutosaver::writeAll() {
+    m_valid = false;
+    QDir().mkpath(QFileInfo(m_file).absolutePath());
+    // The job saves a copy, later changes are marked dirty in the world.
+    WorldFileJob *job = WorldFileJob::save(*m_world, m_file, this);
+    m_job = job;
+    connect(job, &WorldFileJob::finished, this, [=]() {
+        job->deleteLater();
+        // A job that was overtaken by invalidate() no longer matches the world.
+        if (job != m_job)
+            return;
+        m_job = nullptr;
+        m_valid = !job->isCancelled() && job->errorMessage().isEmpty();
+        m_retry = !job->isCancelled() && !m_valid;
+        if (m_retry)
+            emit failed(job->errorMessage());
+    });
+}
+
+void WorldAutosaver::invalidate() {
+    m_valid = false;
+    m_retry = false;
+    if (m_job) {
+        m_job->cancel();
+        m_job = nullptr;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include "worldobject.h"
+#include "worldfilejob.h"
+
+/*
+ * Periodic autosave of the world to "<world file>.autosave" (or to an untitled file in the app data directory).
+ *
+ * The first autosave after a world was made or loaded writes the whole file (on a background thread, see
+ * WorldFileJob). After that only the rows that changed (WorldObject::takeDirtyRows) are rewritten in place:
+ * every row of a world file has the same length, so row y starts at (y - 1) * (inner width + 1).
+ * The robot id lines after the grid are rewritten as well, they are short.
+ *
+ * The rows are written over the old ones, so unlike a real save an autosave is not atomic. That is fine for
+ * a file that is only used when the application did not exit normally.
+ */
+
+class WorldAutosaver : public QObject
+{
+    Q_OBJECT
+public:
+    WorldAutosaver(WorldObject *world, QObject *parent = nullptr);
+
+    // The world now belongs to worldFile (empty for an untitled world).
+    void setWorldFile(const QString& worldFile);
+    // Untitled worlds of different sessions need their own autosave file: <app data>/<name>.txt.autosave.
+    // The default is "untitled". Sets the world file to untitled.
+    void setUntitledName(const QString& name);
+    QString untitledName() const;
+    // The world was saved explicitly to worldFile: the autosaves of the old and the new file are obsolete.
+    void saved(const QString& worldFile);
+    // Returns the autosave file of the current world.
+    QString autosaveFile() const;
+    // Returns the autosave file of worldFile.
+    static QString autosaveFileFor(const QString& worldFile, const QString& untitledName = "untitled");
+
+    constexpr static int AUTOSAVE_MSEC = 30000;
+
+public slots:
+    // Write the changes since the last autosave.
+    void autosave();
+
+signals:
+    // An autosave failed, the next one writes the whole file.
+    void failed(const QString& message);
+
+private:
+    // Rewrite rows of the autosave file. Returns false if the file does not fit the world.
+    bool writeRows(const QVector<int>& rows);
+    // Write the whole world to the autosave file.
+    void writeAll();
+    // The autosave file no longer matches the world, the next autosave writes it completely.
+    void invalidate();
+
+    WorldObject *m_world;
+    QTimer *m_timer;
+    QString m_file;
+    QString m_untitledName = "untitled";
+    // True iff the autosave file holds the world, apart from the dirty rows.
+    bool m_valid = false;
+    // True iff the last whole write failed, the next autosave tries again.
+    bool m_retry = false;
+    WorldFileJob *m_job = nullptr;
+};
@@ -0,0 +1,81 @@
+#include "worlddiff.h"
+
+#include <QtAlgorithms>
+#include <cstring>
+
+// Fields are 0 ... 2, so a byte of a ^ b is nonzero iff one of its two low bits is set.
+const quint64 LOW_BITS = 0x0101010101010101ULL;
+
+// Returns a word with the lowest bit set in every byte of a ^ b that is nonzero, for 8 fields at x.
+static quint64 differingFields(const quint8 *a, const quint8 *b, int x) {
+    quint64 wa, wb;
+    memcpy(&wa, a + x, sizeof(wa));
+    memcpy(&wb, b + x, sizeof(wb));
+    const quint64 d = wa ^ wb;
+    return (d | (d >> 1)) & LOW_BITS;
+}
+
+bool WorldDiff::isEqual() const {
+    return !sizeDiffers && mismatches == 0 && robots.isEmpty();
+}
+
+qint64 countRowMismatches(const quint8 *a, const quint8 *b, int count) {
+    qint64 mismatches = 0;
+    int x = 0;
+    for (; x + 8 <= count; x += 8)
+        mismatches += qPopulationCount(differingFields(a, b, x));
+    for (; x < count; ++x)
+        mismatches += a[x] != b[x];
+    return mismatches;
+}
+
+// Add the fields in which row y of a and b differ to cells, until there are maxCells.
+static void listRowMismatches(const quint8 *a, const quint8 *b, int count, int y, int maxCells, QVector<QPoint> &cells) {
+    int x = 0;
+    for (; x + 8 <= count && cells.size() < maxCells; x += 8) {
+        if (differingFields(a, b, x) == 0)
+            continue;
+        for (int i = x; i < x + 8 && cells.size() < maxCells; ++i) {
+            if (a[i] != b[i])
+                cells.push_back(QPoint(i, y));
+        }
+    }
+    for (; x < count && cells.size() < maxCells; ++x) {
+        if (a[x] != b[x])
+            cells.push_back(QPoint(x, y));
+    }
+}
+
+WorldDiff diffWorlds(const WorldObject &world, const WorldObject &expected, int maxCells) {
+    WorldDiff diff;
+    if (world.size() != expected.size()) {
+        diff.sizeDiffers = true;
+        return diff;
+    }
+
+    const int width = world.size().width();
+    QVector<quint8> row(width), expectedRow(width);
+    for (int y = 0; y < world.size().height(); ++y) {
+        world.readRow(y, row.data());
+        expected.readRow(y, expectedRow.data());
+        if (memcmp(row.constData(), expectedRow.constData(), width) == 0)
+            continue;
+        diff.mismatches += countRowMismatches(row.constData(), expectedRow.constData(), width);
+        if (diff.cells.size() < maxCells)
+            listRowMismatches(row.constData(), expectedRow.constData(), width, y, maxCells, diff.cells);
+    }
+
+    // Robots are matched by id, the ones of world that are not expected come last.
+    for (const Robot &e : expected.robots()) {
+        const int i = world.robotIndex(e.id);
+        if (i == -1)
+            diff.robots.push_back(RobotMismatch{e.id, QPoint(-1, -1), e.pos, Direction::North, e.dir});
+        else if (world.robots()[i].pos != e.pos || world.robots()[i].dir != e.dir)
+            diff.robots.push_back(RobotMismatch{e.id, world.robots()[i].pos, e.pos, world.robots()[i].dir, e.dir});
+    }
+    for (const Robot &r : world.robots()) {
+        if (expected.robotIndex(r.id) == -1)
+            diff.robots.push_back(RobotMismatch{r.id, r.pos, QPoint(-1, -1), r.dir, Direction::North});
+    }
+    return diff;
+}
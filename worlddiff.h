@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QVector>
+#include <QPoint>
+
+#include "worldobject.h"
+
+/*
+ * Comparing a world with the world it should be (e.g. the goal world of an exercise), for grading.
+ *
+ * The fields are compared row by row. Rows that are equal are skipped with a memcmp, differing rows are compared
+ * eight fields at a time: XOR the packed words and count the nonzero bytes with a popcount (see
+ * countRowMismatches). That is fast enough to compare a million fields in about a millisecond.
+ */
+
+// A robot that is in another place or faces another direction than expected, by id.
+// A robot that is missing from one of the worlds has the position (-1, -1) there.
+struct RobotMismatch {
+    int id;
+    QPoint pos, expectedPos;
+    Direction dir, expectedDir;
+};
+
+struct WorldDiff {
+    // The worlds have different sizes, nothing else is compared.
+    bool sizeDiffers = false;
+    // Number of fields that differ.
+    qint64 mismatches = 0;
+    // The fields that differ in reading order, at most the maxCells of diffWorlds().
+    QVector<QPoint> cells;
+    QVector<RobotMismatch> robots;
+
+    // Returns true iff the worlds are the same.
+    bool isEqual() const;
+};
+
+// Default number of differing fields that are listed.
+const int MAX_DIFF_CELLS = 10000;
+
+// Compare world with expected, the differing fields are listed up to maxCells (they are all counted).
+WorldDiff diffWorlds(const WorldObject& world, const WorldObject& expected, int maxCells = MAX_DIFF_CELLS);
+// Returns the number of fields in which rows a and b of count fields differ.
+qint64 countRowMismatches(const quint8 *a, const quint8 *b, int count);
@@ -0,0 +1,81 @@
+#include "worldfilejob.h"
+
+WorldFileJob::WorldFileJob(Operation operation, const QString &fileName, QObject *parent)
+    : QObject{parent},
+    m_operation(operation),
+    m_fileName(fileName),
+    m_world(new WorldObject)
+{
+}
+
+WorldFileJob *WorldFileJob::load(const QString &fileName, QObject *parent) {
+    WorldFileJob *job = new WorldFileJob(Operation::LoadOperation, fileName, parent);
+    job->start();
+    return job;
+}
+
+WorldFileJob *WorldFileJob::save(const WorldObject &world, const QString &fileName, QObject *parent) {
+    WorldFileJob *job = new WorldFileJob(Operation::SaveOperation, fileName, parent);
+    job->m_world->copyWorld(world);
+    job->start();
+    return job;
+}
+
+WorldFileJob::~WorldFileJob() {
+    // A save is finished: the world may already be shown as saved, e.g. when QCharles quits meanwhile.
+    if (m_operation == Operation::LoadOperation)
+        cancel();
+    m_thread->wait();
+    delete m_thread;
+}
+
+WorldFileJob::Operation WorldFileJob::operation() const {
+    return m_operation;
+}
+
+QString WorldFileJob::fileName() const {
+    return m_fileName;
+}
+
+bool WorldFileJob::isCancelled() const {
+    return m_cancelled;
+}
+
+QString WorldFileJob::errorMessage() const {
+    return m_error;
+}
+
+WorldObject *WorldFileJob::world() const {
+    return m_world.get();
+}
+
+void WorldFileJob::cancel() {
+    m_cancel = true;
+}
+
+void WorldFileJob::start() {
+    m_thread = QThread::create([this]() {
+        // Emitted from the background thread, so the receivers get it queued.
+        auto report = [this](int percent) {
+            emit progress(percent);
+            return !m_cancel;
+        };
+        try {
+            if (m_operation == Operation::LoadOperation)
+                m_world->loadFromFile(m_fileName, StorageKind::AutomaticStorage, report);
+            else
+                m_world->saveToFile(m_fileName, report);
+        }
+        catch (FileOperationCancelled&) {
+            m_cancelled = true;
+        }
+        catch (QException& e) {
+            m_error = e.what();
+        }
+        catch (std::bad_alloc&) {
+            m_error = "Not enough memory for this world.";
+        }
+    });
+    connect(m_thread, &QThread::finished, this, &WorldFileJob::finished);
+    m_thread->start();
+}
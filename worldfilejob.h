@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <atomic>
+#include <memory>
+
+#include "worldobject.h"
+
+/*
+ * Loads or saves a world file on a background thread, so the UI stays responsive for huge worlds.
+ *
+ * A load reads into a separate world buffer: the world in the UI is untouched until the job has finished
+ * and the result is swapped in with WorldObject::swapWorld(). A save writes a copy of the world that is made
+ * when the job starts (cheap, see WorldObject::copyWorld), so the world may change while it is being saved.
+ */
+
+class WorldFileJob : public QObject
+{
+    Q_OBJECT
+public:
+    enum Operation { LoadOperation, SaveOperation };
+
+    // Start loading fileName.
+    static WorldFileJob *load(const QString& fileName, QObject *parent = nullptr);
+    // Start saving world to fileName.
+    static WorldFileJob *save(const WorldObject& world, const QString& fileName, QObject *parent = nullptr);
+    // Cancels a load, or waits until a save has written the file, and waits for the thread.
+    ~WorldFileJob();
+
+    Operation operation() const;
+    QString fileName() const;
+    // Returns true iff the job was cancelled (after finished()).
+    bool isCancelled() const;
+    // Returns the error (the what() of the exception), or an empty string if the job succeeded or was cancelled.
+    QString errorMessage() const;
+    // Returns the world that was loaded or saved. After a successful load, swap it into the UI world.
+    WorldObject *world() const;
+
+public slots:
+    // Stop as soon as possible, finished() follows.
+    void cancel();
+
+signals:
+    // Progress in percent.
+    void progress(int percent);
+    // The job has ended: done, cancelled or failed.
+    void finished();
+
+private:
+    WorldFileJob(Operation operation, const QString& fileName, QObject *parent);
+    // Run the job on the background thread.
+    void start();
+
+    const Operation m_operation;
+    const QString m_fileName;
+    // Used by the background thread, so it has no parent.
+    std::unique_ptr<WorldObject> m_world;
+    QThread *m_thread = nullptr;
+    std::atomic<bool> m_cancel { false };
+    // Written by the thread, only read after it has finished.
+    bool m_cancelled = false;
+    QString m_error;
+};
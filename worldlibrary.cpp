@@ -0,0 +1,208 @@
+#include "worldlibrary.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QPainter>
+#include <algorithm>
+
+// Start of the index file, it is read again only with the same version.
+const static quint32 INDEX_MAGIC = 0x51434c49; // "QCLI"
+const static quint32 INDEX_VERSION = 1;
+
+QDataStream &operator<<(QDataStream &out, const LibraryEntry &e) {
+    out << e.fileName << e.modified << e.fileSize << e.error << e.size << e.charles << qint32(e.dir)
+        << qint32(e.robots) << e.balls << e.hash << e.thumbnail;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, LibraryEntry &e) {
+    qint32 dir, robots;
+    in >> e.fileName >> e.modified >> e.fileSize >> e.error >> e.size >> e.charles >> dir >> robots >> e.balls >> e.hash >> e.thumbnail;
+    e.dir = static_cast<Direction>(dir);
+    e.robots = robots;
+    return in;
+}
+
+LibraryEntry scanWorldFile(const QString &fileName, const std::atomic<bool> *cancel) {
+    LibraryEntry e;
+    const QFileInfo info(fileName);
+    e.fileName = fileName;
+    e.modified = info.lastModified().toMSecsSinceEpoch();
+    e.fileSize = info.size();
+
+    // Loading validates the file first, an invalid world throws the same error as when it is opened.
+    WorldObject world;
+    world.setEmitUpdates(false);
+    try {
+        world.loadFromFile(fileName, StorageKind::AutomaticStorage, [cancel](int) { return !cancel || !*cancel; });
+    }
+    catch (QException& ex) {
+        e.error = ex.what();
+        return e;
+    }
+    catch (std::bad_alloc&) {
+        e.error = "Not enough memory for this world.";
+        return e;
+    }
+
+    e.size = world.size() - QSize(2, 2);
+    e.charles = world.robots().first().pos;
+    e.dir = world.robots().first().dir;
+    e.robots = world.robotCount();
+    QVector<quint8> row(world.size().width());
+    for (int y = 1; y < world.size().height() - 1; ++y) {
+        world.readRow(y, row.data());
+        e.balls += std::count(row.cbegin(), row.cend(), quint8(Field::Ball));
+    }
+    e.thumbnail = worldThumbnail(world);
+    QFile file(fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (file.open(QIODeviceBase::ReadOnly) && hash.addData(&file))
+        e.hash = hash.result();
+    return e;
+}
+
+QImage worldThumbnail(const WorldObject &world) {
+    const QSize size = world.size();
+    const int longest = qMax(size.width(), size.height());
+    // Small worlds get a square of pixels per field, large ones a pixel for every so many fields.
+    const QSize imageSize = longest <= THUMBNAIL_SIZE
+        ? size * (THUMBNAIL_SIZE / longest)
+        : QSize(qMax<qint64>(1, qint64(size.width()) * THUMBNAIL_SIZE / longest),
+                qMax<qint64>(1, qint64(size.height()) * THUMBNAIL_SIZE / longest));
+    const QRgb colors[3] = { qRgb(90, 90, 90), qRgb(255, 255, 255), qRgb(0, 120, 255) }; // Indexed by Field.
+
+    QImage image(imageSize, QImage::Format_RGB32);
+    for (int py = 0; py < imageSize.height(); ++py) {
+        const int y = static_cast<int>(qint64(py) * size.height() / imageSize.height());
+        for (int px = 0; px < imageSize.width(); ++px) {
+            const int x = static_cast<int>(qint64(px) * size.width() / imageSize.width());
+            image.setPixel(px, py, colors[world.get(QPoint(x, y))]);
+        }
+    }
+    QPainter painter(&image);
+    for (const Robot &r : world.robots()) {
+        const QPoint topLeft(static_cast<int>(qint64(r.pos.x()) * imageSize.width() / size.width()),
+                             static_cast<int>(qint64(r.pos.y()) * imageSize.height() / size.height()));
+        painter.fillRect(QRect(topLeft, QSize(qMax(1, imageSize.width() / size.width()), qMax(1, imageSize.height() / size.height()))),
+                         QColor(220, 0, 0));
+    }
+    return image;
+}
+
+QString libraryIndexFile() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/library.index";
+}
+
+QVector<LibraryEntry> readLibraryIndex(QString *directory) {
+    QFile file(libraryIndexFile());
+    if (!file.open(QIODeviceBase::ReadOnly))
+        return {};
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != INDEX_MAGIC || version != INDEX_VERSION)
+        return {};
+    QString dir;
+    QVector<LibraryEntry> entries;
+    in >> dir >> entries;
+    if (in.status() != QDataStream::Ok)
+        return {};
+    *directory = dir;
+    return entries;
+}
+
+bool writeLibraryIndex(const QString &directory, const QVector<LibraryEntry> &entries) {
+    QDir().mkpath(QFileInfo(libraryIndexFile()).path());
+    QSaveFile file(libraryIndexFile());
+    if (!file.open(QIODeviceBase::WriteOnly))
+        return false;
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << INDEX_MAGIC << INDEX_VERSION << directory << entries;
+    return file.commit();
+}
+
+WorldLibraryScan::WorldLibraryScan(const QString &directory, const QVector<LibraryEntry> &cached, QObject *parent)
+    : QObject{parent},
+    m_directory(directory),
+    m_cached(cached)
+{
+}
+
+WorldLibraryScan *WorldLibraryScan::start(const QString &directory, const QVector<LibraryEntry> &cached, QObject *parent) {
+    WorldLibraryScan *scan = new WorldLibraryScan(directory, cached, parent);
+    scan->m_thread = QThread::create([scan]() { scan->run(); });
+    connect(scan->m_thread, &QThread::finished, scan, &WorldLibraryScan::finished);
+    scan->m_thread->start();
+    return scan;
+}
+
+WorldLibraryScan::~WorldLibraryScan() {
+    cancel();
+    m_thread->wait();
+    delete m_thread;
+}
+
+QString WorldLibraryScan::directory() const {
+    return m_directory;
+}
+
+bool WorldLibraryScan::isCancelled() const {
+    return m_cancelled;
+}
+
+QVector<LibraryEntry> WorldLibraryScan::entries() const {
+    return m_entries;
+}
+
+int WorldLibraryScan::scannedCount() const {
+    return m_scanned;
+}
+
+void WorldLibraryScan::cancel() {
+    m_cancel = true;
+}
+
+void WorldLibraryScan::run() {
+    QHash<QString, const LibraryEntry*> cached;
+    for (const LibraryEntry &e : m_cached)
+        cached.insert(e.fileName, &e);
+
+    // Files that have the same modification time and size as in the cache are taken over, the others are loaded.
+    const QFileInfoList files = QDir(m_directory).entryInfoList({"*.txt"}, QDir::Files, QDir::Name);
+    m_entries.resize(files.size());
+    QVector<int> changed;
+    for (int i = 0; i < files.size(); ++i) {
+        const LibraryEntry *e = cached.value(files[i].absoluteFilePath());
+        if (e && e->modified == files[i].lastModified().toMSecsSinceEpoch() && e->fileSize == files[i].size())
+            m_entries[i] = *e;
+        else
+            changed.push_back(i);
+    }
+    m_scanned = changed.size();
+
+    // Every file writes its own entry, through a pointer so the vector is not touched from several threads.
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    LibraryEntry *entry = m_entries.data();
+    for (int i : changed) {
+        pool.start([&, i]() {
+            if (m_cancel)
+                return;
+            entry[i] = scanWorldFile(files[i].absoluteFilePath(), &m_cancel);
+            // Only report changes of the percentage, the signals are queued to the UI thread.
+            const int done = ++m_filesDone;
+            if (done * 100LL / changed.size() != (done - 1) * 100LL / changed.size())
+                emit progress(static_cast<int>(done * 100LL / changed.size()));
+        });
+    }
+    pool.waitForDone();
+    m_cancelled = m_cancel;
+}
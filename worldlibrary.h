@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QImage>
+#include <QDataStream>
+#include <atomic>
+
+#include "worldobject.h"
+
+/*
+ * The world library: an overview of a directory of world files, e.g. thousands of generated worlds.
+ *
+ * Every *.txt file of the directory is loaded once (which validates it like WorldObject::validateFile) to learn
+ * its size, Charles' position, its balls, a hash of its contents and a small thumbnail. The entries are kept
+ * in an index file in the app data directory, keyed by the modification time and size of the file, so on the
+ * next start the library is shown at once and only the files that changed are loaded again.
+ *
+ * A WorldLibraryScan loads the changed files on all cores, in the background.
+ */
+
+struct LibraryEntry {
+    QString fileName;
+    // Modification time (msecs since the epoch) and size of the file when it was scanned.
+    qint64 modified = 0;
+    qint64 fileSize = 0;
+    // Why the file is not a valid world, empty if it is. The rest is only set for valid worlds.
+    QString error;
+    // Size of the world in the file, without the boundary of walls that is added when it is loaded.
+    QSize size;
+    // Position (in world coordinates, like WorldObject) and direction of the first robot.
+    QPoint charles;
+    Direction dir = Direction::North;
+    int robots = 0;
+    qint64 balls = 0;
+    // SHA-1 of the file, equal files are the same world.
+    QByteArray hash;
+    QImage thumbnail;
+
+    bool isValid() const { return error.isEmpty(); }
+};
+
+QDataStream &operator<<(QDataStream &out, const LibraryEntry &e);
+QDataStream &operator>>(QDataStream &in, LibraryEntry &e);
+
+// Load fileName and describe it. Returns an entry with an error if the file is not a valid world,
+// or when cancel is set while it is loaded. Can be called from any thread.
+LibraryEntry scanWorldFile(const QString& fileName, const std::atomic<bool> *cancel = nullptr);
+// Returns a picture of world of at most THUMBNAIL_SIZE pixels wide and high, a field per pixel or less.
+QImage worldThumbnail(const WorldObject& world);
+const int THUMBNAIL_SIZE = 64;
+
+// The index of the library: its directory and entries, in <app data>/library.index.
+QString libraryIndexFile();
+// Returns the entries of the index and sets directory to its directory. Empty if there is no (readable) index.
+QVector<LibraryEntry> readLibraryIndex(QString *directory);
+// Replace the index. Returns false if it cannot be written.
+bool writeLibraryIndex(const QString& directory, const QVector<LibraryEntry>& entries);
+
+class WorldLibraryScan : public QObject
+{
+    Q_OBJECT
+public:
+    // Start scanning the *.txt files of directory. The entries of cached whose file did not change are taken over.
+    static WorldLibraryScan *start(const QString& directory, const QVector<LibraryEntry>& cached, QObject *parent = nullptr);
+    // Cancels the scan and waits for the thread.
+    ~WorldLibraryScan();
+
+    QString directory() const;
+    // Returns true iff the scan was cancelled (after finished()).
+    bool isCancelled() const;
+    // The entries of all files of the directory, sorted by file name (after finished()).
+    QVector<LibraryEntry> entries() const;
+    // Number of files that were loaded, the others came from the cache (after finished()).
+    int scannedCount() const;
+
+public slots:
+    // Stop as soon as possible, finished() follows.
+    void cancel();
+
+signals:
+    // Progress in percent.
+    void progress(int percent);
+    // The scan has ended: done or cancelled.
+    void finished();
+
+private:
+    WorldLibraryScan(const QString& directory, const QVector<LibraryEntry>& cached, QObject *parent);
+    // Runs on the background thread.
+    void run();
+
+    const QString m_directory;
+    const QVector<LibraryEntry> m_cached;
+    QThread *m_thread = nullptr;
+    std::atomic<bool> m_cancel { false };
+    std::atomic<int> m_filesDone { 0 };
+    // Written by the thread, only read after it has finished.
+    bool m_cancelled = false;
+    QVector<LibraryEntry> m_entries;
+    int m_scanned = 0;
+};
@@ -0,0 +1,111 @@
+#include "worldlibrarywidget.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDir>
+
+WorldLibraryWidget::WorldLibraryWidget(QWidget *parent)
+    : QWidget{parent}
+{
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(m_folderButton = new QPushButton("&Folder...", this));
+    buttons->addWidget(m_rescanButton = new QPushButton("Re&scan", this));
+    buttons->addStretch();
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(buttons);
+    layout->addWidget(m_status = new QLabel(this));
+    layout->addWidget(m_list = new QListWidget(this));
+    m_list->setIconSize(QSize(THUMBNAIL_SIZE, THUMBNAIL_SIZE));
+
+    connect(m_folderButton, &QPushButton::clicked, this, [=]() {
+        const QString dir = QFileDialog::getExistingDirectory(this, "World Library Folder", m_directory);
+        if (!dir.isEmpty())
+            setDirectory(dir);
+    });
+    connect(m_rescanButton, &QPushButton::clicked, this, &WorldLibraryWidget::rescan);
+    connect(m_list, &QListWidget::itemDoubleClicked, this, [=](QListWidgetItem *item) {
+        emit worldActivated(item->data(Qt::UserRole).toString());
+    });
+
+    // The library of the last session, the files that changed since then are scanned again.
+    QString dir;
+    m_entries = readLibraryIndex(&dir);
+    m_directory = dir;
+    showEntries();
+    if (m_directory.isEmpty())
+        m_status->setText("Choose a folder of worlds.");
+    else
+        rescan();
+}
+
+QString WorldLibraryWidget::directory() const {
+    return m_directory;
+}
+
+void WorldLibraryWidget::setDirectory(const QString &directory) {
+    if (!m_directory.isEmpty() && QDir(directory) == QDir(m_directory))
+        return;
+    m_directory = directory;
+    m_entries.clear();
+    showEntries();
+    rescan();
+}
+
+void WorldLibraryWidget::rescan() {
+    if (m_directory.isEmpty())
+        return;
+    // A scan of another directory (or of this one, which may have changed since) is of no use anymore.
+    delete m_scan;
+    m_scan = WorldLibraryScan::start(m_directory, m_entries, this);
+    m_status->setText("Scanning " + QDir::toNativeSeparators(m_directory) + "...");
+    connect(m_scan, &WorldLibraryScan::progress, this, [=](int percent) {
+        m_status->setText(QString("Scanning %1... %2%").arg(QDir::toNativeSeparators(m_directory)).arg(percent));
+    });
+    connect(m_scan, &WorldLibraryScan::finished, this, &WorldLibraryWidget::onScanFinished);
+}
+
+void WorldLibraryWidget::onScanFinished() {
+    WorldLibraryScan *scan = m_scan;
+    scan->deleteLater();
+    if (scan->isCancelled())
+        return;
+    m_entries = scan->entries();
+    showEntries();
+    QString status = QString("%1 worlds, %2 scanned.").arg(m_entries.size()).arg(scan->scannedCount());
+    if (!writeLibraryIndex(m_directory, m_entries))
+        status += " The index cannot be written to " + QDir::toNativeSeparators(libraryIndexFile()) + ".";
+    m_status->setText(status);
+}
+
+void WorldLibraryWidget::showEntries() {
+    // Worlds with the same contents are told apart in the tooltip.
+    QHash<QByteArray, QStringList> sameHash;
+    for (const LibraryEntry &e : m_entries) {
+        if (e.isValid())
+            sameHash[e.hash].push_back(QFileInfo(e.fileName).fileName());
+    }
+
+    m_list->clear();
+    for (const LibraryEntry &e : m_entries) {
+        const QString name = QFileInfo(e.fileName).fileName();
+        QListWidgetItem *item = new QListWidgetItem(m_list);
+        item->setData(Qt::UserRole, e.fileName);
+        if (!e.isValid()) {
+            item->setText(name + "\n" + e.error);
+            item->setForeground(Qt::gray);
+            continue;
+        }
+        item->setIcon(QPixmap::fromImage(e.thumbnail));
+        item->setText(QString("%1\n%2 x %3, %4 balls").arg(name).arg(e.size.width()).arg(e.size.height()).arg(e.balls));
+        QString tip = QString("%1\nCharles at (%2, %3), %4 robots\nSHA-1 %5")
+                          .arg(QDir::toNativeSeparators(e.fileName)).arg(e.charles.x()).arg(e.charles.y())
+                          .arg(e.robots).arg(QString::fromLatin1(e.hash.toHex()));
+        QStringList same = sameHash.value(e.hash);
+        same.removeOne(name);
+        if (!same.isEmpty())
+            tip += "\nSame world as " + same.join(", ");
+        item->setToolTip(tip);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QWidget>
+#include <QListWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QPointer>
+
+#include "worldlibrary.h"
+
+/*
+ * The world library panel (see worldlibrary.h): the worlds of a directory with their thumbnails, sizes and balls.
+ * Invalid files are listed greyed out with their error. Double clicking a world opens it.
+ *
+ * The index of the last session is shown at once, a scan in the background then loads the files that changed
+ * and writes the index again.
+ */
+
+class WorldLibraryWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit WorldLibraryWidget(QWidget *parent = nullptr);
+
+    // The directory of the library, empty if none was chosen yet.
+    QString directory() const;
+
+public slots:
+    // Show the worlds of directory, from the index where the files did not change.
+    void setDirectory(const QString& directory);
+    // Scan the directory again for new and changed files.
+    void rescan();
+
+signals:
+    // A world of the library was double clicked.
+    void worldActivated(const QString& fileName);
+
+private:
+    void onScanFinished();
+    // Fill the list with m_entries.
+    void showEntries();
+
+    QString m_directory;
+    QVector<LibraryEntry> m_entries;
+    QPointer<WorldLibraryScan> m_scan;
+    QPushButton *m_folderButton, *m_rescanButton;
+    QLabel *m_status;
+    QListWidget *m_list;
+};
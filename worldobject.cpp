@@ -1,390 +1,998 @@
-#include "worldobject.h"
-
-#include <QFile>
-#include <QTextStream>
-
-/*
- * HELPER FUNCTIONS / VARIABLES
- */
-
-const QString ALL_CHARS = []() -> QString {
-    QString all;
-    all.push_back(EMPTY);
-    all.push_back(BALL);
-    all.push_back(WALL);
-    all.push_back(CHARLES_NORTH);
-    all.push_back(CHARLES_EAST);
-    all.push_back(CHARLES_SOUTH);
-    all.push_back(CHARLES_WEST);
-    all.push_back(CHARLES_NORTH_BALL);
-    all.push_back(CHARLES_EAST_BALL);
-    all.push_back(CHARLES_SOUTH_BALL);
-    all.push_back(CHARLES_WEST_BALL);
-    return all;
-}();
-
-const QString CHARLES_CHARS = ALL_CHARS.mid(3);
-
-// Returns the difference (delta) of a single step in direction d.
-QPoint deltaPos(Direction d) {
-    switch(d) {
-    case Direction::North:
-        return QPoint(0, -1);
-    case Direction::East:
-        return QPoint(1, 0);
-    case Direction::South:
-        return QPoint(0, 1);
-    case Direction::West:
-        return QPoint(-1, 0);
-    }
-    return QPoint(0, 0); // False Positive compiler warning.
-
-}
-
-Direction turnLeftOne(Direction d) {
-    return static_cast<Direction>((static_cast<int>(d) +3) % 4);
-}
-
-Direction turnRightOne(Direction d) {
-    return static_cast<Direction>((static_cast<int>(d) + 1) % 4);
-}
-
-/*
- * EXCEPTION MESSAGES
- */
-
-const char *BadFileFormat::what() const {
-    return "Bad file format when trying to read a WorldObject.";
-}
-
-const char *FileNotFound::what() const {
-    return "File not found when trying to read a WorldObject";
-}
-
-const char *IllegalCharacter::what() const {
-    return  "Illegal character encountered while reading a WorldObject";
-}
-
-const char *NonRectangularWorld::what() const {
-    return "Non rectangular configuration encountered while reading a WorldObject";
-}
-
-const char *EmptyWorld::what() const {
-    return "Empty world encountered in file while reading a WorldObject";
-}
-
-const char *MultipleCharles::what() const {
-    return "Multiple Charles's where encountered while reading a WorldObject";
-}
-
-const char *IllegalWorldAction::what() const {
-    return "An illegal action occured on a WorldObject.";
-}
-
-const char *IllegalStep::what() const {
-    return "Charles tried to step into a wall.";
-}
-
-const char *IllegalBackStep::what() const {
-    return "Charles tried to step backwards into a wall.";
-}
-
-const char *IllegalGetBall::what() const {
-    return "Charles tried to get a ball when he was not standing on one.";
-}
-
-const char *IllegalPutBall::what() const {
-    return "Charles tried to put a ball when he was already standing on one.";
-}
-
-// IMPLEMENTATION OF CLASS
-WorldObject::WorldObject(QObject *parent)
-    : QObject{parent}
-{
-    makeEmptyWorld();
-}
-
-void WorldObject::makeEmptyWorld(QSize size, QPoint charles, Direction dir) {
-    assert(!size.isNull() && "WorldObject::makeEmptyWorld: Size cannot be Null");
-    m_size = QSize(size.width() + 2, size.height() + 2);
-    assert(isInnerPoint(charles) && "WorldObject::makeEmptyWorld: Charles has to be located on an inner point");
-    m_posCharles = charles;
-    m_dirCharles = dir;
-    m_fields.clear();
-    for (int y = 0; y < m_size.height(); ++y) {
-        for (int x = 0; x < m_size.width(); ++x) {
-            if (y == 0 || y == m_size.height() - 1 || x == 0 || x == m_size.width() -1)
-                m_fields.push_back(Field::Wall);
-            else
-                m_fields.push_back(Field::Empty);
-        }
-    }
-    emit newWorldLoaded();
-}
-
-void WorldObject::loadFromFile(const QString &name) {
-    QSize size = validateFile(name);
-    if (!size.isValid() || size.isNull())
-        throwFileException(size, name);
-
-    m_size = QSize(size.width() + 2, size.height() + 2);
-    m_fields.clear();
-    QFile file(name);
-    file.open(QIODeviceBase::ReadOnly);
-    for (int i = 0; i < size.width() + 2; ++i)
-        m_fields.push_back(Field::Wall);
-    for (int y = 0; y < size.height(); ++y) {
-        QString line = file.readLine();
-        while(!line.isEmpty() && (line.back() == '\r' || line.back() == '\n'))
-            line.removeLast();
-        m_fields.push_back(Field::Wall);
-        for (int x = 0; x < size.width(); ++x) {
-            m_fields.push_back(QCharToField(line.at(x)));
-            if (isCharles(line.at(x))) {
-                // Do not use setCharles here, because we only want to emit the newWorldLoaded signal here.
-                // (This emit can cause problems because the previous charles' position will be from another world.)
-                m_posCharles = QPoint(x + 1, y + 1);
-                m_dirCharles = charlesQCharToDir(line.at(x));
-            }
-        }
-        m_fields.push_back(Field::Wall);
-    }
-    for (int i = 0; i < size.width() + 2; ++i)
-        m_fields.push_back(Field::Wall);
-
-    emit newWorldLoaded();
-}
-
-void WorldObject::saveToFile(const QString &name) {
-    QFile fileOut(name);
-
-    fileOut.open(QIODeviceBase::WriteOnly);
-    QTextStream out(&fileOut);
-    for (int y = 1; y < m_size.height() - 1; ++y) {
-        for (int x = 1; x < m_size.width() - 1; ++x) {
-            if (QPoint(x, y) == m_posCharles)
-                out << charlesToQChar(m_dirCharles, at(QPoint(x, y)));
-            else
-                out << fieldToQChar(at(QPoint(x, y)));
-        }
-        out << '\n';
-    }
-}
-
-void WorldObject::setEmitUpdates(bool on) {
-    m_emitUpdates = on;
-    if (on)
-        emit emitsTurnedOn();
-}
-
-Field WorldObject::get(QPoint p) const {
-    return at(p);
-}
-
-void WorldObject::set(QPoint p, Field f) {
-    assert(isInnerPoint(p) && "WorldObject::set: p must be an inner point.");
-    assert(f != Field::Wall || p != m_posCharles && "WorldObject::set: Cannot set field to wall because Charles is standing on it.");
-    at(p) = f;
-
-    if (m_emitUpdates)
-        emit fieldChanged(p);
-}
-
-void WorldObject::setCharles(QPoint p, Direction dir) {
-    assert (isInnerPoint(p) && "WorldObject::setCharles: p must be an inner point.");
-
-    if (m_emitUpdates)
-        emit charlesPositionChanged(m_posCharles, p, dir);
-    m_posCharles = p;
-    m_dirCharles = dir;
-}
-
-QPoint WorldObject::getCharlesPos() const {
-    return m_posCharles;
-}
-
-Field WorldObject::getCharlesField() const {
-    return get(m_posCharles);
-}
-
-Direction WorldObject::getCharlesDir() const {
-    return m_dirCharles;
-}
-
-QSize WorldObject::size() const {
-    return m_size;
-}
-
-int WorldObject::pointToIndex(QPoint p) const {
-    return p.y() * m_size.width() +  p.x();
-}
-
-bool WorldObject::isInnerPoint(QPoint p) const {
-    return 0 < p.y() && p.y() < m_size.height() - 1 && 0 < p.x() && p.x() < m_size.width() -1;
-}
-
-bool WorldObject::inFrontOfWall() const {
-    return get(m_posCharles + deltaPos(m_dirCharles)) == Field::Wall;
-}
-
-bool WorldObject::onBall() const {
-    return get(m_posCharles) == Field::Ball;
-}
-
-void WorldObject::turnLeft() {
-    setCharles(m_posCharles, turnLeftOne(m_dirCharles));
-}
-
-void WorldObject::turnRight() {
-    setCharles(m_posCharles, turnRightOne(m_dirCharles));
-}
-
-void WorldObject::step() {
-    if (inFrontOfWall())
-        throw IllegalStep();
-    setCharles(m_posCharles + deltaPos(m_dirCharles), m_dirCharles);
-}
-
-void WorldObject::stepBack() {
-    QPoint newPos = m_posCharles - deltaPos(m_dirCharles);
-    if (at(newPos) == Field::Wall)
-        throw IllegalStep();
-    setCharles(newPos, m_dirCharles);
-}
-
-void WorldObject::putBall() {
-    if (at(getCharlesPos()) != Field::Empty)
-        throw IllegalPutBall();
-    set(getCharlesPos(), Field::Ball);
-}
-
-void WorldObject::getBall() {
-    if (at(getCharlesPos()) != Field::Ball)
-        throw IllegalGetBall();
-    set(getCharlesPos(), Field::Empty);
-}
-
-QSize WorldObject::validateFile(const QString& fileName) {
-    QFile file(fileName);
-    if (file.exists()) {
-        int width =  -1, height = 0, charlesCount = 0;
-        file.open(QIODeviceBase::ReadOnly);
-        while(!file.atEnd()) {
-            QString line = file.readLine();
-            while(!line.isEmpty() && (line.back() == '\r' || line.back() == '\n'))
-                line.removeLast();
-
-            if (width == -1)
-                width = line.size();
-
-            if (width != line.size())
-                return NON_RECTANGULAR_WORLD;
-
-            for (QChar c : line) {
-                if (!validQChar(c))
-                    return ILLEGAL_CHARACTER;
-
-                if (isCharles(c))
-                    charlesCount += 1;
-            }
-            height++;
-        }
-        if (charlesCount == 1)
-            return QSize(width, height);
-        if (height == 0 || width == 0)
-            return QSize(0, 0);
-        return MULTIPLE_CHARLES;
-    }
-    return FILE_NOT_FOUND;
-}
-
-bool WorldObject::validQChar(QChar c) {
-    return ALL_CHARS.contains(c);
-}
-
-Field WorldObject::QCharToField(QChar c) {
-    assert(validQChar(c));
-    if (c == WALL)
-        return Field::Wall;
-    if (c == BALL || c == CHARLES_NORTH_BALL || c == CHARLES_EAST_BALL ||
-        c == CHARLES_SOUTH_BALL || c == CHARLES_WEST_BALL)
-        return Field::Ball;
-    return Empty;
-}
-
-bool WorldObject::isCharles(QChar c) {
-    return CHARLES_CHARS.contains(c);
-}
-
-Direction WorldObject::charlesQCharToDir(QChar c) {
-    assert(isCharles(c));
-
-    if (c == CHARLES_NORTH || c == CHARLES_NORTH_BALL)
-        return Direction::North;
-    if (c == CHARLES_EAST || c == CHARLES_EAST_BALL)
-        return Direction::East;
-    if (c == CHARLES_SOUTH || c == CHARLES_SOUTH_BALL)
-        return Direction::South;
-    return Direction::West;
-}
-
-QChar WorldObject::charlesToQChar(Direction d, Field f) {
-    assert(f != Field::Wall && "WorldObject::charlesToQChar: Charles should not be on a ball.");
-    if (f == Field::Empty) {
-        switch(d) {
-        case Direction::North:
-            return CHARLES_NORTH;
-        case Direction::East:
-            return CHARLES_EAST;
-        case Direction::South:
-            return CHARLES_SOUTH;
-        case Direction::West:
-            return CHARLES_WEST;
-        }
-    }
-    switch(d) {
-    case Direction::North:
-        return CHARLES_NORTH_BALL;
-    case Direction::East:
-        return CHARLES_EAST_BALL;
-    case Direction::South:
-        return CHARLES_SOUTH_BALL;
-    case Direction::West:
-        return CHARLES_WEST_BALL;
-    }
-    return CHARLES_WEST_BALL;
-}
-
-QChar WorldObject::fieldToQChar(Field f) {
-    switch(f) {
-    case Field::Ball:
-        return BALL;
-    case Field::Empty:
-        return EMPTY;
-    case Field::Wall:
-        return WALL;
-    }
-    return WALL;
-}
-
-void WorldObject::throwFileException(QSize error, const QString &fileName) {
-    if (error == QSize(0, 0))
-        throw EmptyWorld();
-    if (error == FILE_NOT_FOUND)
-        throw FileNotFound();
-    if (error == ILLEGAL_CHARACTER)
-        throw IllegalCharacter();
-    if (error == NON_RECTANGULAR_WORLD)
-        throw NonRectangularWorld();
-    if (error == MULTIPLE_CHARLES)
-        throw MultipleCharles();
-    throw BadFileFormat();
-}
-
-Field WorldObject::at(QPoint p) const {
-    return m_fields[pointToIndex(p)];
-}
-
-Field &WorldObject::at(QPoint p) {
-    return m_fields[pointToIndex(p)];
-}
+#include "worldobject.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSet>
+#include <QVarLengthArray>
+#include <algorithm>
+
+// Size of the blocks that saveToFile writes.
+const int SAVE_BUFFER_SIZE = 1 << 20;
+
+// Calls progress with the part done / total, scaled to [from, to] percent, when that percentage changed.
+// Returns false if the operation is cancelled.
+static bool reportProgress(const ProgressFunction &progress, qint64 done, qint64 total, int from, int to, int *reported) {
+    if (!progress)
+        return true;
+    const int percent = from + static_cast<int>(total > 0 ? (to - from) * done / total : 0);
+    if (percent == *reported)
+        return true;
+    *reported = percent;
+    return progress(percent);
+}
+
+/*
+ * HELPER FUNCTIONS / VARIABLES
+ */
+
+const QString ALL_CHARS = []() -> QString {
+    QString all;
+    all.push_back(EMPTY);
+    all.push_back(BALL);
+    all.push_back(WALL);
+    all.push_back(CHARLES_NORTH);
+    all.push_back(CHARLES_EAST);
+    all.push_back(CHARLES_SOUTH);
+    all.push_back(CHARLES_WEST);
+    all.push_back(CHARLES_NORTH_BALL);
+    all.push_back(CHARLES_EAST_BALL);
+    all.push_back(CHARLES_SOUTH_BALL);
+    all.push_back(CHARLES_WEST_BALL);
+    return all;
+}();
+
+const QString CHARLES_CHARS = ALL_CHARS.mid(3);
+
+// Returns the difference (delta) of a single step in direction d.
+QPoint deltaPos(Direction d) {
+    switch(d) {
+    case Direction::North:
+        return QPoint(0, -1);
+    case Direction::East:
+        return QPoint(1, 0);
+    case Direction::South:
+        return QPoint(0, 1);
+    case Direction::West:
+        return QPoint(-1, 0);
+    }
+    return QPoint(0, 0); // False Positive compiler warning.
+
+}
+
+Direction turnLeftOne(Direction d) {
+    return static_cast<Direction>((static_cast<int>(d) +3) % 4);
+}
+
+Direction turnRightOne(Direction d) {
+    return static_cast<Direction>((static_cast<int>(d) + 1) % 4);
+}
+
+/*
+ * EXCEPTION MESSAGES
+ */
+
+const char *BadFileFormat::what() const {
+    return "Bad file format when trying to read a WorldObject.";
+}
+
+const char *FileNotFound::what() const {
+    return "File not found when trying to read a WorldObject";
+}
+
+const char *IllegalCharacter::what() const {
+    return  "Illegal character encountered while reading a WorldObject";
+}
+
+const char *NonRectangularWorld::what() const {
+    return "Non rectangular configuration encountered while reading a WorldObject";
+}
+
+const char *EmptyWorld::what() const {
+    return "Empty world encountered in file while reading a WorldObject";
+}
+
+const char *MultipleCharles::what() const {
+    return "Multiple Charles's where encountered while reading a WorldObject";
+}
+
+const char *BadRobotIds::what() const {
+    return "Invalid robot id lines encountered while reading a WorldObject";
+}
+
+const char *FileOperationCancelled::what() const {
+    return "Loading or saving a WorldObject was cancelled";
+}
+
+const char *FileNotSaved::what() const {
+    return "Could not write the file while saving a WorldObject";
+}
+
+const char *IllegalWorldAction::what() const {
+    return "An illegal action occured on a WorldObject.";
+}
+
+const char *IllegalStep::what() const {
+    return WorldObject::actionResultMessage(ActionResult::StepIntoWall);
+}
+
+const char *IllegalBackStep::what() const {
+    return WorldObject::actionResultMessage(ActionResult::BackStepIntoWall);
+}
+
+const char *IllegalGetBall::what() const {
+    return WorldObject::actionResultMessage(ActionResult::GetBallWithoutBall);
+}
+
+const char *IllegalPutBall::what() const {
+    return WorldObject::actionResultMessage(ActionResult::PutBallOnBall);
+}
+
+const char *IllegalRobotCollision::what() const {
+    return WorldObject::actionResultMessage(ActionResult::StepIntoRobot);
+}
+
+// IMPLEMENTATION OF CLASS
+WorldObject::WorldObject(QObject *parent)
+    : QObject{parent}
+{
+    makeEmptyWorld();
+}
+
+void WorldObject::makeEmptyWorld(QSize size, QPoint charles, Direction dir, StorageKind kind) {
+    assert(!size.isNull() && "WorldObject::makeEmptyWorld: Size cannot be Null");
+    m_size = QSize(size.width() + 2, size.height() + 2);
+    assert(isInnerPoint(charles) && "WorldObject::makeEmptyWorld: Charles has to be located on an inner point");
+    m_fields.reset(FieldStorage::create(m_size, kind));
+    setRobots({Robot{0, charles, dir}});
+    clearDirtyRows();
+    resetStats();
+    emit newWorldLoaded();
+}
+
+void WorldObject::loadFromFile(const QString &name, StorageKind kind, const ProgressFunction &progress) {
+    // Validating reads the file once, loading a second time: each gets half of the progress.
+    QSize size = validateFile(name, [&](int percent) { return !progress || progress(percent / 2); });
+    if (!size.isValid() || size.isNull())
+        throwFileException(size, name);
+
+    // Load into new storage, the world only changes when everything is read.
+    const QSize worldSize(size.width() + 2, size.height() + 2);
+    // Fields start out as walls on the boundary, the inside is written a row at a time. Tiled storage skips empty tiles.
+    std::unique_ptr<FieldStorage> fields(FieldStorage::create(worldSize, kind));
+    QFile file(name);
+    file.open(QIODeviceBase::ReadOnly);
+    int reported = -1;
+    QVector<Robot> robots;
+    QVector<QPoint> robotPositions;
+    QVector<quint8> row(size.width());
+    for (int y = 0; y < size.height(); ++y) {
+        if (!reportProgress(progress, file.pos(), file.size(), 50, 100, &reported))
+            throw FileOperationCancelled();
+        QString line = file.readLine();
+        while(!line.isEmpty() && (line.back() == '\r' || line.back() == '\n'))
+            line.removeLast();
+        for (int x = 0; x < size.width(); ++x) {
+            row[x] = QCharToField(line.at(x));
+            if (isCharles(line.at(x))) {
+                // Do not use setCharles here, because we only want to emit the newWorldLoaded signal here.
+                // (This emit can cause problems because the previous charles' position will be from another world.)
+                robots.push_back(Robot{static_cast<int>(robots.size()), QPoint(x + 1, y + 1), charlesQCharToDir(line.at(x))});
+                robotPositions.push_back(QPoint(x, y));
+            }
+        }
+        fields->writeRow(y + 1, 1, row.constData(), size.width());
+    }
+    QStringList idLines;
+    while (!file.atEnd())
+        idLines.push_back(file.readLine());
+    QVector<int> ids = parseRobotIds(idLines, robotPositions);
+    for (int i = 0; i < robots.size(); ++i)
+        robots[i].id = ids[i];
+
+    m_size = worldSize;
+    m_fields = std::move(fields);
+    setRobots(robots);
+    clearDirtyRows();
+    resetStats();
+    emit newWorldLoaded();
+}
+
+void WorldObject::saveToFile(const QString &name, const ProgressFunction &progress) {
+    QSaveFile fileOut(name);
+    fileOut.open(QIODeviceBase::WriteOnly);
+
+    // Robots per row, so rows can be encoded without looking up every point.
+    QHash<int, QVector<int>> robotsInRow;
+    for (int i = 0; i < m_robots.size(); ++i)
+        robotsInRow[m_robots[i].pos.y()].push_back(i);
+
+    // Rows are encoded into a buffer that is written in large blocks.
+    const int rowBytes = m_size.width() - 1;
+    QByteArray buffer;
+    buffer.reserve(qMax<qint64>(SAVE_BUFFER_SIZE, rowBytes));
+    int reported = -1;
+    for (int y = 1; y < m_size.height() - 1; ++y) {
+        if (!reportProgress(progress, y - 1, m_size.height() - 2, 0, 100, &reported)) {
+            fileOut.cancelWriting();
+            throw FileOperationCancelled();
+        }
+        const qsizetype offset = buffer.size();
+        buffer.resize(offset + rowBytes);
+        encodeRow(y, buffer.data() + offset, robotsInRow.value(y));
+        buffer[offset + rowBytes - 1] = '\n';
+        if (buffer.size() + rowBytes > SAVE_BUFFER_SIZE) {
+            fileOut.write(buffer);
+            buffer.clear();
+        }
+    }
+    buffer.append(encodeTrailer());
+    fileOut.write(buffer);
+    if (!fileOut.commit())
+        throw FileNotSaved();
+}
+
+QByteArray WorldObject::encodeRow(int y) const {
+    assert(0 < y && y < m_size.height() - 1 && "WorldObject::encodeRow: y must be an inner row.");
+    QVector<int> robotsInRow;
+    for (int i = 0; i < m_robots.size(); ++i) {
+        if (m_robots[i].pos.y() == y)
+            robotsInRow.push_back(i);
+    }
+    QByteArray row(m_size.width() - 2, EMPTY.toLatin1());
+    encodeRow(y, row.data(), robotsInRow);
+    return row;
+}
+
+QByteArray WorldObject::encodeTrailer() const {
+    // A single robot keeps the original file format.
+    QByteArray trailer;
+    if (m_robots.size() > 1) {
+        for (const Robot &r : m_robots)
+            trailer += QString("%1%2 %3 %4\n").arg(ROBOT_ID_PREFIX).arg(r.id).arg(r.pos.x() - 1).arg(r.pos.y() - 1).toLatin1();
+    }
+    return trailer;
+}
+
+QVector<int> WorldObject::takeDirtyRows() {
+    QVector<int> rows;
+    for (int y = 0; y < m_dirtyRows.size(); ++y) {
+        if (m_dirtyRows[y])
+            rows.push_back(y);
+    }
+    clearDirtyRows();
+    return rows;
+}
+
+void WorldObject::copyWorld(const WorldObject &other) {
+    m_size = other.m_size;
+    m_fields.reset(other.m_fields->clone());
+    setRobots(other.m_robots);
+    m_selected = other.m_selected;
+    clearDirtyRows();
+    resetStats();
+    emit newWorldLoaded();
+}
+
+void WorldObject::swapWorld(WorldObject &other) {
+    std::swap(m_size, other.m_size);
+    std::swap(m_fields, other.m_fields);
+    std::swap(m_robots, other.m_robots);
+    std::swap(m_selected, other.m_selected);
+    std::swap(m_robotAt, other.m_robotAt);
+    std::swap(m_robotIndex, other.m_robotIndex);
+    std::swap(m_dirtyRows, other.m_dirtyRows);
+    std::swap(m_cellStats, other.m_cellStats);
+    std::swap(m_visitStats, other.m_visitStats);
+    emit newWorldLoaded();
+}
+
+WorldSnapshot WorldObject::snapshot() const {
+    return WorldSnapshot{std::shared_ptr<const FieldStorage>(m_fields->clone()), m_robots, m_selected};
+}
+
+void WorldObject::restoreSnapshot(const WorldSnapshot &snapshot) {
+    assert(snapshot.fields && snapshot.fields->size() == m_size && snapshot.robots.size() == m_robots.size()
+           && "WorldObject::restoreSnapshot: the snapshot belongs to another world.");
+    const QVector<QPoint> changedFields = m_fields->differences(*snapshot.fields);
+    const QVector<Robot> oldRobots = m_robots;
+    m_fields.reset(snapshot.fields->clone());
+    setRobots(snapshot.robots);
+    m_selected = snapshot.selected;
+
+    for (QPoint p : changedFields)
+        markDirty(p.y());
+    for (int i = 0; i < m_robots.size(); ++i) {
+        if (oldRobots[i].pos != m_robots[i].pos) {
+            markDirty(oldRobots[i].pos.y());
+            markDirty(m_robots[i].pos.y());
+        }
+        else if (oldRobots[i].dir != m_robots[i].dir)
+            markDirty(m_robots[i].pos.y());
+    }
+    if (m_emitUpdates) {
+        for (QPoint p : changedFields)
+            emit fieldChanged(p);
+        for (int i = 0; i < m_robots.size(); ++i) {
+            if (oldRobots[i].pos != m_robots[i].pos || oldRobots[i].dir != m_robots[i].dir)
+                emit charlesPositionChanged(oldRobots[i].pos, m_robots[i].pos, m_robots[i].dir);
+        }
+    }
+}
+
+void WorldObject::setRecordingStats(bool on) {
+    m_recordStats = on;
+}
+
+void WorldObject::resetStats() {
+    m_cellStats.clear();
+    m_visitStats = VisitStats();
+    for (const Robot &r : m_robots)
+        countVisit(r.pos);
+}
+
+const QHash<qint64, CellStats> &WorldObject::cellStats() const {
+    return m_cellStats;
+}
+
+VisitStats WorldObject::visitStats() const {
+    return m_visitStats;
+}
+
+void WorldObject::setEmitUpdates(bool on, bool announce) {
+    m_emitUpdates = on;
+    if (on && announce)
+        emit emitsTurnedOn();
+}
+
+bool WorldObject::emitsUpdates() const {
+    return m_emitUpdates;
+}
+
+Field WorldObject::get(QPoint p) const {
+    return at(p);
+}
+
+void WorldObject::set(QPoint p, Field f) {
+    assert(isInnerPoint(p) && "WorldObject::set: p must be an inner point.");
+    assert((f != Field::Wall || robotAt(p) == -1) && "WorldObject::set: Cannot set field to wall because Charles is standing on it.");
+    m_fields->set(p, f);
+    markDirty(p.y());
+    if (m_recordStats)
+        countMutation(p);
+
+    if (m_emitUpdates)
+        emit fieldChanged(p);
+}
+
+void WorldObject::fillRect(const QRect &rect, Field f) {
+    if (rect.isEmpty())
+        return;
+    assert(innerRect().contains(rect) && "WorldObject::fillRect: rect must lie within the inner points.");
+    for (const Robot &r : m_robots)
+        assert((f != Field::Wall || !rect.contains(r.pos)) && "WorldObject::fillRect: Cannot set fields to wall because a robot is standing on them.");
+    m_fields->fill(rect, f);
+    regionWritten(rect);
+}
+
+void WorldObject::applyPatches(const QVector<FieldPatch> &patches) {
+    if (patches.isEmpty())
+        return;
+    for (const FieldPatch &patch : patches) {
+        assert(isInnerPoint(patch.p) && "WorldObject::applyPatches: every point must be an inner point.");
+        assert((patch.f != Field::Wall || robotAt(patch.p) == -1) && "WorldObject::applyPatches: Cannot set field to wall because a robot is standing on it.");
+    }
+
+    // Grouped by row, the sort is stable so of several patches of the same field the last one still wins.
+    QVector<FieldPatch> sorted = patches;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const FieldPatch &a, const FieldPatch &b) { return a.p.y() < b.p.y(); });
+    QVector<quint8> row(m_size.width());
+    QRect region;
+    for (int i = 0; i < sorted.size();) {
+        const int y = sorted[i].p.y();
+        readRow(y, row.data());
+        int left = sorted[i].p.x(), right = left;
+        for (; i < sorted.size() && sorted[i].p.y() == y; ++i) {
+            row[sorted[i].p.x()] = sorted[i].f;
+            left = qMin(left, sorted[i].p.x());
+            right = qMax(right, sorted[i].p.x());
+        }
+        // Only the part of the row between the first and last patch is written.
+        m_fields->writeRow(y, left, row.constData() + left, right - left + 1);
+        region |= QRect(left, y, right - left + 1, 1);
+    }
+    regionWritten(region);
+}
+
+void WorldObject::copyRegion(const WorldObject &other, const QRect &rect, QPoint target) {
+    if (rect.isEmpty())
+        return;
+    const QRect to(target, rect.size());
+    assert(QRect(QPoint(0, 0), other.m_size).contains(rect) && "WorldObject::copyRegion: rect must lie within other.");
+    assert(innerRect().contains(to) && "WorldObject::copyRegion: the target must lie within the inner points.");
+    for (const Robot &r : m_robots)
+        assert((!to.contains(r.pos) || other.get(r.pos - target + rect.topLeft()) != Field::Wall)
+               && "WorldObject::copyRegion: Cannot copy a wall onto a robot.");
+
+    QVector<quint8> row(other.m_size.width());
+    // Within the same world a copy downwards goes from the bottom up, so no row is read after it is overwritten.
+    const bool bottomUp = &other == this && target.y() > rect.y();
+    for (int i = 0; i < rect.height(); ++i) {
+        const int dy = bottomUp ? rect.height() - 1 - i : i;
+        other.readRow(rect.y() + dy, row.data());
+        m_fields->writeRow(target.y() + dy, target.x(), row.constData() + rect.x(), rect.width());
+    }
+    regionWritten(to);
+}
+
+void WorldObject::setCharles(QPoint p, Direction dir) {
+    assert (isInnerPoint(p) && "WorldObject::setCharles: p must be an inner point.");
+    assert ((robotAt(p) == -1 || robotAt(p) == m_selected) && "WorldObject::setCharles: another robot stands on p.");
+
+    QPoint oldPos = charles().pos;
+    m_robotAt.remove(pointToIndex(oldPos));
+    m_robotAt.insert(pointToIndex(p), m_selected);
+    charles().pos = p;
+    charles().dir = dir;
+    markDirty(oldPos.y());
+    markDirty(p.y());
+    if (m_recordStats && p != oldPos)
+        countVisit(p);
+    if (m_emitUpdates)
+        emit charlesPositionChanged(oldPos, p, dir);
+}
+
+QPoint WorldObject::getCharlesPos() const {
+    return charles().pos;
+}
+
+Field WorldObject::getCharlesField() const {
+    return get(charles().pos);
+}
+
+Direction WorldObject::getCharlesDir() const {
+    return charles().dir;
+}
+
+const QVector<Robot> &WorldObject::robots() const {
+    return m_robots;
+}
+
+int WorldObject::robotCount() const {
+    return m_robots.size();
+}
+
+int WorldObject::robotAt(QPoint p) const {
+    return m_robotAt.value(pointToIndex(p), -1);
+}
+
+int WorldObject::robotIndex(int id) const {
+    return m_robotIndex.value(id, -1);
+}
+
+void WorldObject::selectRobot(int id) {
+    assert(robotIndex(id) != -1 && "WorldObject::selectRobot: there is no robot with this id.");
+    m_selected = robotIndex(id);
+}
+
+int WorldObject::selectedRobot() const {
+    return charles().id;
+}
+
+QSize WorldObject::size() const {
+    return m_size;
+}
+
+qint64 WorldObject::pointToIndex(QPoint p) const {
+    return m_fields->pointToIndex(p);
+}
+
+qint64 WorldObject::fieldCount() const {
+    return static_cast<qint64>(m_size.width()) * m_size.height();
+}
+
+void WorldObject::readRow(int y, quint8 *out) const {
+    m_fields->readRow(y, out);
+}
+
+StorageKind WorldObject::storageKind() const {
+    return m_fields->kind();
+}
+
+qint64 WorldObject::memoryUsage() const {
+    return m_fields->memoryUsage();
+}
+
+bool WorldObject::isInnerPoint(QPoint p) const {
+    return 0 < p.y() && p.y() < m_size.height() - 1 && 0 < p.x() && p.x() < m_size.width() -1;
+}
+
+bool WorldObject::inFrontOfWall() const {
+    return get(getCharlesPos() + deltaPos(getCharlesDir())) == Field::Wall;
+}
+
+bool WorldObject::onBall() const {
+    return get(getCharlesPos()) == Field::Ball;
+}
+
+void WorldObject::turnLeft() {
+    tryTurnLeft();
+}
+
+void WorldObject::turnRight() {
+    tryTurnRight();
+}
+
+void WorldObject::step() {
+    if (ActionResult r = tryStep())
+        throwActionException(r);
+}
+
+void WorldObject::stepBack() {
+    if (ActionResult r = tryStepBack())
+        throwActionException(r);
+}
+
+void WorldObject::putBall() {
+    if (ActionResult r = tryPutBall())
+        throwActionException(r);
+}
+
+void WorldObject::getBall() {
+    if (ActionResult r = tryGetBall())
+        throwActionException(r);
+}
+
+ActionResult WorldObject::tryTurnLeft() {
+    setCharles(getCharlesPos(), turnLeftOne(getCharlesDir()));
+    return ActionResult::ActionOk;
+}
+
+ActionResult WorldObject::tryTurnRight() {
+    setCharles(getCharlesPos(), turnRightOne(getCharlesDir()));
+    return ActionResult::ActionOk;
+}
+
+ActionResult WorldObject::tryStep() {
+    QPoint newPos = getCharlesPos() + deltaPos(getCharlesDir());
+    if (at(newPos) == Field::Wall)
+        return ActionResult::StepIntoWall;
+    if (robotAt(newPos) != -1)
+        return ActionResult::StepIntoRobot;
+    setCharles(newPos, getCharlesDir());
+    return ActionResult::ActionOk;
+}
+
+ActionResult WorldObject::tryStepBack() {
+    QPoint newPos = getCharlesPos() - deltaPos(getCharlesDir());
+    if (at(newPos) == Field::Wall)
+        return ActionResult::BackStepIntoWall;
+    if (robotAt(newPos) != -1)
+        return ActionResult::StepIntoRobot;
+    setCharles(newPos, getCharlesDir());
+    return ActionResult::ActionOk;
+}
+
+ActionResult WorldObject::tryPutBall() {
+    if (at(getCharlesPos()) != Field::Empty)
+        return ActionResult::PutBallOnBall;
+    set(getCharlesPos(), Field::Ball);
+    return ActionResult::ActionOk;
+}
+
+ActionResult WorldObject::tryGetBall() {
+    if (at(getCharlesPos()) != Field::Ball)
+        return ActionResult::GetBallWithoutBall;
+    set(getCharlesPos(), Field::Empty);
+    return ActionResult::ActionOk;
+}
+
+const char *WorldObject::actionResultMessage(ActionResult r) {
+    switch(r) {
+    case ActionResult::ActionOk:
+        return "No error occured.";
+    case ActionResult::StepIntoWall:
+        return "Charles tried to step into a wall.";
+    case ActionResult::BackStepIntoWall:
+        return "Charles tried to step backwards into a wall.";
+    case ActionResult::GetBallWithoutBall:
+        return "Charles tried to get a ball when he was not standing on one.";
+    case ActionResult::PutBallOnBall:
+        return "Charles tried to put a ball when he was already standing on one.";
+    case ActionResult::StepIntoRobot:
+        return "Charles tried to step onto a field of another robot.";
+    }
+    return "An illegal action occured on a WorldObject."; // False Positive compiler warning.
+}
+
+QVector<ActionResult> WorldObject::tick(const QVector<RobotAction> &actions) {
+    assert(actions.size() == m_robots.size() && "WorldObject::tick: there must be one action per robot.");
+    QVector<ActionResult> results(actions.size(), ActionResult::ActionOk);
+    QVector<QPoint> targets(actions.size());
+    QVector<bool> moving(actions.size(), false);
+    // Field index -> robot index of the lowest id that steps onto it.
+    QHash<qint64, int> claims;
+
+    // Turns and balls only concern the robot's own field, so only steps can conflict.
+    for (int i = 0; i < actions.size(); ++i) {
+        const Robot &r = m_robots[i];
+        switch(actions[i]) {
+        case RobotAction::PutBallAction:
+            if (at(r.pos) != Field::Empty)
+                results[i] = ActionResult::PutBallOnBall;
+            break;
+        case RobotAction::GetBallAction:
+            if (at(r.pos) != Field::Ball)
+                results[i] = ActionResult::GetBallWithoutBall;
+            break;
+        case RobotAction::StepAction: {
+            targets[i] = r.pos + deltaPos(r.dir);
+            if (at(targets[i]) == Field::Wall) {
+                results[i] = ActionResult::StepIntoWall;
+                break;
+            }
+            moving[i] = true;
+            auto claim = claims.find(pointToIndex(targets[i]));
+            if (claim == claims.end())
+                claims.insert(pointToIndex(targets[i]), i);
+            else if (r.id < m_robots[*claim].id)
+                *claim = i;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Contested fields go to the lowest id.
+    for (int i = 0; i < actions.size(); ++i) {
+        if (moving[i] && claims.value(pointToIndex(targets[i])) != i) {
+            moving[i] = false;
+            results[i] = ActionResult::StepIntoRobot;
+        }
+    }
+    // A robot may only enter a field that is free or that is left in this tick. Blocked robots can block others in turn.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < actions.size(); ++i) {
+            if (!moving[i])
+                continue;
+            int other = robotAt(targets[i]);
+            if (other != -1 && (!moving[other] || targets[other] == m_robots[i].pos)) {
+                moving[i] = false;
+                results[i] = ActionResult::StepIntoRobot;
+                changed = true;
+            }
+        }
+    }
+
+    applyTick(actions, results, false);
+    return results;
+}
+
+void WorldObject::reverseTick(const QVector<RobotAction> &actions, const QVector<ActionResult> &results) {
+    applyTick(actions, results, true);
+}
+
+void WorldObject::applyTick(const QVector<RobotAction> &actions, const QVector<ActionResult> &results, bool reverse) {
+    QVector<QPoint> oldPositions(actions.size());
+    QVector<QPoint> changedFields;
+    // Remove all moving robots first, so robots can move into fields that are left in the same tick.
+    for (int i = 0; i < actions.size(); ++i) {
+        oldPositions[i] = m_robots[i].pos;
+        if (actions[i] == RobotAction::StepAction && results[i] == ActionResult::ActionOk)
+            m_robotAt.remove(pointToIndex(m_robots[i].pos));
+    }
+    for (int i = 0; i < actions.size(); ++i) {
+        if (results[i] != ActionResult::ActionOk)
+            continue;
+        Robot &r = m_robots[i];
+        switch(actions[i]) {
+        case RobotAction::StepAction:
+            r.pos = reverse ? r.pos - deltaPos(r.dir) : r.pos + deltaPos(r.dir);
+            m_robotAt.insert(pointToIndex(r.pos), i);
+            break;
+        case RobotAction::TurnLeftAction:
+            r.dir = reverse ? turnRightOne(r.dir) : turnLeftOne(r.dir);
+            break;
+        case RobotAction::TurnRightAction:
+            r.dir = reverse ? turnLeftOne(r.dir) : turnRightOne(r.dir);
+            break;
+        case RobotAction::PutBallAction:
+            m_fields->set(r.pos, reverse ? Field::Empty : Field::Ball);
+            changedFields.push_back(r.pos);
+            break;
+        case RobotAction::GetBallAction:
+            m_fields->set(r.pos, reverse ? Field::Ball : Field::Empty);
+            changedFields.push_back(r.pos);
+            break;
+        case RobotAction::NoAction:
+            break;
+        }
+    }
+
+    for (QPoint p : changedFields)
+        markDirty(p.y());
+    for (int i = 0; i < actions.size(); ++i) {
+        if (actions[i] != RobotAction::NoAction && results[i] == ActionResult::ActionOk) {
+            markDirty(oldPositions[i].y());
+            markDirty(m_robots[i].pos.y());
+        }
+    }
+    if (m_recordStats) {
+        for (QPoint p : changedFields)
+            countMutation(p);
+        for (int i = 0; i < actions.size(); ++i) {
+            if (oldPositions[i] != m_robots[i].pos)
+                countVisit(m_robots[i].pos);
+        }
+    }
+
+    // Emit only after the whole tick is applied, so listeners never see a half moved world.
+    if (m_emitUpdates) {
+        for (QPoint p : changedFields)
+            emit fieldChanged(p);
+        for (int i = 0; i < actions.size(); ++i) {
+            if (actions[i] != RobotAction::NoAction && results[i] == ActionResult::ActionOk)
+                emit charlesPositionChanged(oldPositions[i], m_robots[i].pos, m_robots[i].dir);
+        }
+    }
+}
+
+QSize WorldObject::validateFile(const QString& fileName, const ProgressFunction& progress) {
+    QFile file(fileName);
+    if (file.exists()) {
+        int width =  -1, height = 0;
+        QVector<QPoint> robots;
+        QStringList idLines;
+        file.open(QIODeviceBase::ReadOnly);
+        int reported = -1;
+        while(!file.atEnd()) {
+            if (!reportProgress(progress, file.pos(), file.size(), 0, 100, &reported))
+                return VALIDATION_CANCELLED;
+            QString line = file.readLine();
+            while(!line.isEmpty() && (line.back() == '\r' || line.back() == '\n'))
+                line.removeLast();
+
+            // The grid ends at the first robot id line.
+            if (!idLines.isEmpty() || line.startsWith(ROBOT_ID_PREFIX)) {
+                idLines.push_back(line);
+                continue;
+            }
+
+            if (width == -1)
+                width = line.size();
+
+            if (width != line.size())
+                return NON_RECTANGULAR_WORLD;
+
+            for (int x = 0; x < line.size(); ++x) {
+                if (!validQChar(line.at(x)))
+                    return ILLEGAL_CHARACTER;
+
+                if (isCharles(line.at(x)))
+                    robots.push_back(QPoint(x, height));
+            }
+            height++;
+        }
+        if (height == 0 || width == 0)
+            return QSize(0, 0);
+        if (robots.isEmpty())
+            return MULTIPLE_CHARLES;
+        if (parseRobotIds(idLines, robots).isEmpty())
+            return BAD_ROBOT_IDS;
+        return QSize(width, height);
+    }
+    return FILE_NOT_FOUND;
+}
+
+QVector<int> WorldObject::parseRobotIds(const QStringList &lines, const QVector<QPoint> &robots) {
+    QVector<int> ids(robots.size());
+    bool hasIdLines = false;
+    for (int i = 0; i < robots.size(); ++i)
+        ids[i] = i;
+
+    QHash<int, int> robotOnLine; // Robot index -> id.
+    for (QString line : lines) {
+        line = line.trimmed();
+        if (line.isEmpty())
+            continue;
+        if (!line.startsWith(ROBOT_ID_PREFIX))
+            return {};
+        const QStringList parts = line.mid(1).split(' ', Qt::SkipEmptyParts);
+        bool okId = false, okX = false, okY = false;
+        if (parts.size() != 3)
+            return {};
+        const int id = parts[0].toInt(&okId);
+        const QPoint pos(parts[1].toInt(&okX), parts[2].toInt(&okY));
+        const int robot = robots.indexOf(pos);
+        if (!okId || !okX || !okY || robot == -1 || robotOnLine.contains(robot))
+            return {};
+        robotOnLine.insert(robot, id);
+        hasIdLines = true;
+    }
+    if (!hasIdLines)
+        return ids;
+
+    // With id lines, every robot needs exactly one unique id.
+    QSet<int> used;
+    for (int i = 0; i < robots.size(); ++i) {
+        if (!robotOnLine.contains(i) || used.contains(robotOnLine[i]))
+            return {};
+        ids[i] = robotOnLine[i];
+        used.insert(ids[i]);
+    }
+    return ids;
+}
+
+void WorldObject::setRobots(const QVector<Robot> &robots) {
+    assert(!robots.isEmpty() && "WorldObject::setRobots: there must be at least one robot.");
+    m_robots = robots;
+    m_selected = 0;
+    m_robotAt.clear();
+    m_robotIndex.clear();
+    for (int i = 0; i < m_robots.size(); ++i) {
+        m_robotAt.insert(pointToIndex(m_robots[i].pos), i);
+        m_robotIndex.insert(m_robots[i].id, i);
+    }
+}
+
+void WorldObject::encodeRow(int y, char *out, const QVector<int> &robotsInRow) const {
+    static const char FIELD_CHARS[] = { fieldToQChar(Field::Wall).toLatin1(), fieldToQChar(Field::Empty).toLatin1(), fieldToQChar(Field::Ball).toLatin1() };
+    // Read the whole row at once, skip the boundary walls.
+    const int width = m_size.width();
+    QVarLengthArray<quint8, 1024> fields(width);
+    m_fields->readRow(y, fields.data());
+    for (int x = 1; x < width - 1; ++x)
+        out[x - 1] = FIELD_CHARS[fields[x]];
+    for (int i : robotsInRow)
+        out[m_robots[i].pos.x() - 1] = charlesToQChar(m_robots[i].dir, static_cast<Field>(fields[m_robots[i].pos.x()])).toLatin1();
+}
+
+void WorldObject::markDirty(int y) {
+    m_dirtyRows[y] = 1;
+}
+
+void WorldObject::clearDirtyRows() {
+    m_dirtyRows.fill(0, m_size.height());
+}
+
+void WorldObject::regionWritten(const QRect &region) {
+    for (int y = region.top(); y <= region.bottom(); ++y)
+        markDirty(y);
+    if (m_emitUpdates)
+        emit regionChanged(region);
+}
+
+QRect WorldObject::innerRect() const {
+    return QRect(1, 1, m_size.width() - 2, m_size.height() - 2);
+}
+
+void WorldObject::countVisit(QPoint p) {
+    CellStats &stats = m_cellStats[pointToIndex(p)];
+    if (stats.visits++ == 0)
+        ++m_visitStats.distinctCells;
+    ++m_visitStats.visits;
+}
+
+void WorldObject::countMutation(QPoint p) {
+    ++m_cellStats[pointToIndex(p)].mutations;
+    ++m_visitStats.mutations;
+}
+
+Robot &WorldObject::charles() {
+    return m_robots[m_selected];
+}
+
+const Robot &WorldObject::charles() const {
+    return m_robots[m_selected];
+}
+
+bool WorldObject::validQChar(QChar c) {
+    return ALL_CHARS.contains(c);
+}
+
+Field WorldObject::QCharToField(QChar c) {
+    assert(validQChar(c));
+    if (c == WALL)
+        return Field::Wall;
+    if (c == BALL || c == CHARLES_NORTH_BALL || c == CHARLES_EAST_BALL ||
+        c == CHARLES_SOUTH_BALL || c == CHARLES_WEST_BALL)
+        return Field::Ball;
+    return Empty;
+}
+
+bool WorldObject::isCharles(QChar c) {
+    return CHARLES_CHARS.contains(c);
+}
+
+Direction WorldObject::charlesQCharToDir(QChar c) {
+    assert(isCharles(c));
+
+    if (c == CHARLES_NORTH || c == CHARLES_NORTH_BALL)
+        return Direction::North;
+    if (c == CHARLES_EAST || c == CHARLES_EAST_BALL)
+        return Direction::East;
+    if (c == CHARLES_SOUTH || c == CHARLES_SOUTH_BALL)
+        return Direction::South;
+    return Direction::West;
+}
+
+QChar WorldObject::charlesToQChar(Direction d, Field f) {
+    assert(f != Field::Wall && "WorldObject::charlesToQChar: Charles should not be on a ball.");
+    if (f == Field::Empty) {
+        switch(d) {
+        case Direction::North:
+            return CHARLES_NORTH;
+        case Direction::East:
+            return CHARLES_EAST;
+        case Direction::South:
+            return CHARLES_SOUTH;
+        case Direction::West:
+            return CHARLES_WEST;
+        }
+    }
+    switch(d) {
+    case Direction::North:
+        return CHARLES_NORTH_BALL;
+    case Direction::East:
+        return CHARLES_EAST_BALL;
+    case Direction::South:
+        return CHARLES_SOUTH_BALL;
+    case Direction::West:
+        return CHARLES_WEST_BALL;
+    }
+    return CHARLES_WEST_BALL;
+}
+
+QChar WorldObject::fieldToQChar(Field f) {
+    switch(f) {
+    case Field::Ball:
+        return BALL;
+    case Field::Empty:
+        return EMPTY;
+    case Field::Wall:
+        return WALL;
+    }
+    return WALL;
+}
+
+void WorldObject::throwFileException(QSize error, const QString &fileName) {
+    if (error == QSize(0, 0))
+        throw EmptyWorld();
+    if (error == FILE_NOT_FOUND)
+        throw FileNotFound();
+    if (error == ILLEGAL_CHARACTER)
+        throw IllegalCharacter();
+    if (error == NON_RECTANGULAR_WORLD)
+        throw NonRectangularWorld();
+    if (error == MULTIPLE_CHARLES)
+        throw MultipleCharles();
+    if (error == BAD_ROBOT_IDS)
+        throw BadRobotIds();
+    if (error == VALIDATION_CANCELLED)
+        throw FileOperationCancelled();
+    throw BadFileFormat();
+}
+
+void WorldObject::throwActionException(ActionResult r) {
+    switch(r) {
+    case ActionResult::ActionOk:
+        return;
+    case ActionResult::StepIntoWall:
+        throw IllegalStep();
+    case ActionResult::BackStepIntoWall:
+        throw IllegalBackStep();
+    case ActionResult::GetBallWithoutBall:
+        throw IllegalGetBall();
+    case ActionResult::PutBallOnBall:
+        throw IllegalPutBall();
+    case ActionResult::StepIntoRobot:
+        throw IllegalRobotCollision();
+    }
+    throw IllegalWorldAction();
+}
+
+Field WorldObject::at(QPoint p) const {
+    return m_fields->get(p);
+}
@@ -1,176 +1,379 @@
-#ifndef WORLDOBJECT_H
-#define WORLDOBJECT_H
-
-#include <QObject>
-#include <QVector>
-#include <QSize>
-#include <QPoint>
-#include <QException>
-
-/*
- * This file contains the representation for the world in which the robot charles operates.
- * The world is a square grid of a width and height.
- * The coordinates are an x coordinate in [0 ... width) and an y coordinate in [0 ... height).
- * The boundary points are always walls.
- * The inner points can be empty, a ball and a wall.
- * Charles is always on an inner point that is either empty or contains a ball.
- * Charles can move one step at a time, going either North, East, South or West.
- * Charles is only allowed to move to an empty field or a ball field.
- * Charles is allowed to pick up balls and place them, but each field can only contain one ball.
- */
-
-// Character encodings for .txt world configurations.
-const QChar CHARLES_NORTH = 'n';
-const QChar CHARLES_EAST = 'e';
-const QChar CHARLES_SOUTH = 's';
-const QChar CHARLES_WEST = 'w';
-const QChar CHARLES_NORTH_BALL = 'N';
-const QChar CHARLES_EAST_BALL = 'E';
-const QChar CHARLES_SOUTH_BALL = 'S';
-const QChar CHARLES_WEST_BALL = 'W';
-const QChar EMPTY = '.';
-const QChar BALL = 'o';
-const QChar WALL = 'x';
-
-enum Field { Wall, Empty, Ball };
-enum Direction : int { North = 0, East = 1, South = 2, West = 3 }; // Explicit int enum, other code can rely on the values underneath.
-
-// Exceptions for illegal actions
-
-// Note: I would like to pass extra information to the exceptions such as the file path.
-// But const char* what() does not allow for that and I did not find any other way yet.
-
-struct BadFileFormat : public QException { const char* what() const override; };
-struct FileNotFound : public BadFileFormat { const char* what() const override; };
-struct IllegalCharacter : public BadFileFormat { const char* what() const override; };
-struct NonRectangularWorld : public BadFileFormat { const char* what() const override; };
-struct EmptyWorld : public BadFileFormat { const char* what() const override; };
-struct MultipleCharles : public BadFileFormat { const char* what() const override; };
-
-struct IllegalWorldAction : public QException { const char *what() const override; };
-struct IllegalStep : public IllegalWorldAction { const char* what() const override; };
-struct IllegalBackStep : public IllegalWorldAction { const char* what() const override; };
-struct IllegalGetBall : public IllegalWorldAction { const char* what() const override; };
-struct IllegalPutBall : public IllegalWorldAction { const char* what() const override; };
-
-class WorldObject : public QObject
-{
-    Q_OBJECT
-public:    
-    explicit WorldObject(QObject *parent = nullptr);
-
-    // Creates an empty grid of dimension size (+ added wall).
-    void makeEmptyWorld(QSize size = QSize(15, 10), QPoint charles = QPoint(1, 1), Direction dir = Direction::East);
-
-    // Checks if a file contains a valid world encoding.
-    // - If file is not found, returns QSize(-1, 0).
-    // - If file contains non recognized characters, return QSize(-2, 0).
-    // - If world is not a rectangle, returns QSize(-3, 0).
-    // - If multiple Charles' are found, returns QSize(-4, 0).
-    // Otherwise returns the size of the world in the file.
-    static QSize validateFile(const QString& fileName);
-    constexpr static QSize FILE_NOT_FOUND = QSize(-1, 0);
-    constexpr static QSize ILLEGAL_CHARACTER = QSize(-2, 0);
-    constexpr static QSize NON_RECTANGULAR_WORLD = QSize(-3, 0);
-    constexpr static QSize MULTIPLE_CHARLES = QSize(-4, 0);
-
-    // Loads a world from a file. An extra boundary of walls is added to the world.
-    // - File must exist.
-    // - Only contains recognized characters and one newline after every line.
-    // - World inside is valid: square, one charles.
-    void loadFromFile(const QString &name);
-
-    // Save world configuration to a file.
-    void saveToFile(const QString& name);
-
-
-    // Set on/off if updates to the world should be emitted or not.
-    // When value is on, newWorldLoaded() is emitted.
-    void setEmitUpdates(bool on);
-
-    // Returns the Field at position q.
-    Field get(QPoint p) const;
-    // Set coordinate p to field f.
-    // -p must be an inner point.
-    // -If f is a wall, then Charles' position must not be p.
-    void set(QPoint p, Field f);
-
-    // Set Charles's coordinate to p, facing dir.
-    // -p must be an inner point.
-    void setCharles(QPoint p, Direction dir);
-    // Returns Charles' current position.
-    QPoint getCharlesPos() const;
-    // Returns the field Charles is standing on.
-    Field getCharlesField() const;
-    // Returns the direction that Charles' is facing.
-    Direction getCharlesDir() const;
-
-    // Returns the size of the field. Including the boundary of walls.
-    QSize size() const;
-    // Returns index for a 1D array: y * width + x.
-    int pointToIndex(QPoint p) const;
-    // Returns true iff p is an innerpoint on the World (so not on the boundary of walls).
-    bool isInnerPoint(QPoint p) const;
-
-    /*
-     * "Game" functionality.
-     */
-
-    // Returns true iff Charles is facing a wall.
-    bool inFrontOfWall() const;
-    // Returns true iff Charles is on a ball.
-    bool onBall() const;
-    // Turns Charles left.
-    void turnLeft();
-    // Turns Charles right.
-    void turnRight();
-    // Step Charles if not in front of a wall.
-    void step();
-    // Step Charles backwards if not standing at a wall.
-    void stepBack();
-    // Put a ball on Charles' point.
-    // - There must not be a ball on Charles' point before calling this function.
-    void putBall();
-    // Remove the ball on Charles' point.
-    // - There must be a ball on Charles' point before calling this function.
-    void getBall();
-
-
-
-    //bool isSolved(); Charles op 1,1 facing east met 0 ballen over.
-
-
-signals:
-    // Signal that the entire world changed.
-    void newWorldLoaded();
-    // Signal that emits are turned on.
-    void emitsTurnedOn();
-    // Signal that Charles' position and/or direction changed.
-    void charlesPositionChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection);
-    // Signal that a single field on point p changed.
-    void fieldChanged(QPoint p);
-
-private:
-    static bool validQChar(QChar c);
-    static Field QCharToField(QChar c);
-    static bool isCharles(QChar c);
-    static Direction charlesQCharToDir(QChar c);
-    static QChar charlesToQChar(Direction d, Field f);
-    static QChar fieldToQChar(Field f);
-
-    static void throwFileException(QSize error, const QString& fileName);
-
-    // Direct constant access to field.
-    Field at(QPoint p) const;
-    // Direct access to field.
-    Field &at(QPoint p);
-
-    QVector<Field> m_fields;
-    // Size of the world. Includes the surrounding ring of walls.
-    QSize m_size;
-    QPoint m_posCharles;
-    Direction m_dirCharles;
-    bool m_emitUpdates = true;
-};
-
-#endif // WORLDOBJECT_H
+#ifndef WORLDOBJECT_H
+#define WORLDOBJECT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QSize>
+#include <QPoint>
+#include <QRect>
+#include <QException>
+#include <QHash>
+#include <QStringList>
+#include <memory>
+#include <functional>
+
+#include "fieldstorage.h"
+
+/*
+ * This file contains the representation for the world in which the robot charles operates.
+ * The world is a square grid of a width and height.
+ * The coordinates are an x coordinate in [0 ... width) and an y coordinate in [0 ... height).
+ * The boundary points are always walls.
+ * The inner points can be empty, a ball and a wall.
+ * Charles is always on an inner point that is either empty or contains a ball.
+ * Charles can move one step at a time, going either North, East, South or West.
+ * Charles is only allowed to move to an empty field or a ball field.
+ * Charles is allowed to pick up balls and place them, but each field can only contain one ball.
+ *
+ * A world can contain several Charles' (robots), each with its own id. Robots cannot stand on the same field.
+ * The single robot functions below act on the selected robot (the first one unless selectRobot() is called).
+ * tick() executes one action for every robot at the same time.
+ *
+ * The fields are kept in a FieldStorage. Normal worlds use dense storage, huge worlds use
+ * tiles that are allocated on demand (see fieldstorage.h). The kind is chosen when a world is made or loaded.
+ */
+
+// Character encodings for .txt world configurations.
+const QChar CHARLES_NORTH = 'n';
+const QChar CHARLES_EAST = 'e';
+const QChar CHARLES_SOUTH = 's';
+const QChar CHARLES_WEST = 'w';
+const QChar CHARLES_NORTH_BALL = 'N';
+const QChar CHARLES_EAST_BALL = 'E';
+const QChar CHARLES_SOUTH_BALL = 'S';
+const QChar CHARLES_WEST_BALL = 'W';
+const QChar EMPTY = '.';
+const QChar BALL = 'o';
+const QChar WALL = 'x';
+// Lines after the grid that give a robot its id: "@<id> <x> <y>", with x, y the position in the file (0 based).
+// Without these lines robots get the ids 0, 1, 2, ... in reading order.
+const QChar ROBOT_ID_PREFIX = '@';
+
+enum Direction : int { North = 0, East = 1, South = 2, West = 3 }; // Explicit int enum, other code can rely on the values underneath.
+// Outcome of a world action. The try* functions return these instead of throwing.
+enum ActionResult { ActionOk = 0, StepIntoWall, BackStepIntoWall, GetBallWithoutBall, PutBallOnBall, StepIntoRobot };
+// Action of a single robot during a tick.
+enum RobotAction { NoAction = 0, StepAction, TurnLeftAction, TurnRightAction, PutBallAction, GetBallAction };
+
+// Reports the progress of loading or saving a world in percent. Returning false cancels the operation.
+typedef std::function<bool(int percent)> ProgressFunction;
+
+// A robot (Charles) in the world.
+struct Robot {
+    int id;
+    QPoint pos;
+    Direction dir;
+};
+
+// A change of a single field, see WorldObject::applyPatches().
+struct FieldPatch {
+    QPoint p;
+    Field f;
+};
+
+// Counters of a single field, see WorldObject::setRecordingStats().
+struct CellStats {
+    // Number of times a robot stepped onto the field.
+    quint32 visits = 0;
+    // Number of times the field was changed (balls put or taken).
+    quint32 mutations = 0;
+};
+
+// Totals of the cell counters.
+struct VisitStats {
+    qint64 visits = 0;
+    qint64 distinctCells = 0;
+    qint64 mutations = 0;
+
+    // Part of the visits that went to a field that was visited before.
+    double redundantVisitRatio() const { return visits > 0 ? double(visits - distinctCells) / visits : 0; }
+};
+
+// The state of a world at one moment, see WorldObject::snapshot(). The fields are shared with the world
+// until either of them is written to.
+struct WorldSnapshot {
+    std::shared_ptr<const FieldStorage> fields;
+    QVector<Robot> robots;
+    int selected = 0;
+};
+
+// Exceptions for illegal actions
+
+// Note: I would like to pass extra information to the exceptions such as the file path.
+// But const char* what() does not allow for that and I did not find any other way yet.
+
+struct BadFileFormat : public QException { const char* what() const override; };
+struct FileNotFound : public BadFileFormat { const char* what() const override; };
+struct IllegalCharacter : public BadFileFormat { const char* what() const override; };
+struct NonRectangularWorld : public BadFileFormat { const char* what() const override; };
+struct EmptyWorld : public BadFileFormat { const char* what() const override; };
+struct MultipleCharles : public BadFileFormat { const char* what() const override; };
+struct BadRobotIds : public BadFileFormat { const char* what() const override; };
+
+// Loading or saving was cancelled by the ProgressFunction.
+struct FileOperationCancelled : public QException { const char* what() const override; };
+struct FileNotSaved : public QException { const char* what() const override; };
+
+struct IllegalWorldAction : public QException { const char *what() const override; };
+struct IllegalStep : public IllegalWorldAction { const char* what() const override; };
+struct IllegalBackStep : public IllegalWorldAction { const char* what() const override; };
+struct IllegalGetBall : public IllegalWorldAction { const char* what() const override; };
+struct IllegalPutBall : public IllegalWorldAction { const char* what() const override; };
+struct IllegalRobotCollision : public IllegalWorldAction { const char* what() const override; };
+
+class WorldObject : public QObject
+{
+    Q_OBJECT
+public:    
+    explicit WorldObject(QObject *parent = nullptr);
+
+    // Creates an empty grid of dimension size (+ added wall).
+    void makeEmptyWorld(QSize size = QSize(15, 10), QPoint charles = QPoint(1, 1), Direction dir = Direction::East,
+                        StorageKind kind = StorageKind::AutomaticStorage);
+
+    // Checks if a file contains a valid world encoding.
+    // - If file is not found, returns QSize(-1, 0).
+    // - If file contains non recognized characters, return QSize(-2, 0).
+    // - If world is not a rectangle, returns QSize(-3, 0).
+    // - If no Charles is found, returns QSize(-4, 0).
+    // - If the robot id lines are invalid (unknown position, duplicate id, missing id), returns QSize(-5, 0).
+    // - If progress cancelled the validation, returns QSize(-6, 0).
+    // Otherwise returns the size of the world in the file.
+    static QSize validateFile(const QString& fileName, const ProgressFunction& progress = ProgressFunction());
+    constexpr static QSize FILE_NOT_FOUND = QSize(-1, 0);
+    constexpr static QSize ILLEGAL_CHARACTER = QSize(-2, 0);
+    constexpr static QSize NON_RECTANGULAR_WORLD = QSize(-3, 0);
+    constexpr static QSize MULTIPLE_CHARLES = QSize(-4, 0);
+    constexpr static QSize BAD_ROBOT_IDS = QSize(-5, 0);
+    constexpr static QSize VALIDATION_CANCELLED = QSize(-6, 0);
+
+    // Loads a world from a file. An extra boundary of walls is added to the world.
+    // - File must exist.
+    // - Only contains recognized characters and one newline after every line.
+    // - World inside is valid: square, at least one charles, valid robot ids.
+    // Progress is reported while reading, when the load is cancelled (or fails) the world is left unchanged.
+    void loadFromFile(const QString &name, StorageKind kind = StorageKind::AutomaticStorage,
+                      const ProgressFunction& progress = ProgressFunction());
+
+    // Save world configuration to a file. The file is replaced at once when everything is written,
+    // a cancelled or failed save leaves an existing file unchanged. Throws FileNotSaved when writing fails.
+    void saveToFile(const QString& name, const ProgressFunction& progress = ProgressFunction());
+
+    // Returns inner row y as it is saved in a world file, without the newline.
+    QByteArray encodeRow(int y) const;
+    // Returns the robot id lines that are saved after the grid (empty for a single robot).
+    QByteArray encodeTrailer() const;
+    // Returns the rows that changed since the last call, or since the world was made or loaded, in increasing order.
+    // The rows are forgotten, so there should be a single caller (the autosave).
+    QVector<int> takeDirtyRows();
+
+    // Make this world a copy of other. The fields are shared until one of the worlds changes, so this is cheap.
+    void copyWorld(const WorldObject& other);
+    // Exchange the contents of this world and other, e.g. to swap in a world that was loaded in the background.
+    // Emits newWorldLoaded() for this world.
+    void swapWorld(WorldObject& other);
+    // Returns the current state. Cheap, like copyWorld.
+    WorldSnapshot snapshot() const;
+    // Go back to a snapshot of this world. Unlike a load this is not a new world: only the fields and robots
+    // that differ are emitted as changed, which costs about as much as the changes since the snapshot.
+    void restoreSnapshot(const WorldSnapshot& snapshot);
+
+
+    // Set on/off if visits and changes of fields are counted. Off by default, the UI turns it on while a program runs,
+    // so moving through the trace does not count. Counting costs a hash lookup per step.
+    void setRecordingStats(bool on);
+    // Forget all counters. The fields the robots stand on count as visited.
+    void resetStats();
+    // Returns the counters of the fields that were visited or changed, by pointToIndex().
+    const QHash<qint64, CellStats> &cellStats() const;
+    VisitStats visitStats() const;
+
+    // Set on/off if updates to the world should be emitted or not.
+    // When value is on, emitsTurnedOn() is emitted, unless announce is false: the world is as it was when they
+    // were turned off.
+    void setEmitUpdates(bool on, bool announce = true);
+    bool emitsUpdates() const;
+
+    // Returns the Field at position q.
+    Field get(QPoint p) const;
+    // Set coordinate p to field f.
+    // -p must be an inner point.
+    // -If f is a wall, then no robot may stand on p.
+    void set(QPoint p, Field f);
+
+    /*
+     * Bulk changes of fields, e.g. for generators and editors. They are checked once, written to the storage row by row
+     * and emitted as a single regionChanged() instead of a fieldChanged() per field. They do not count in the cell stats.
+     */
+
+    // Set all fields of rect to f.
+    // -rect must lie within the inner points.
+    // -If f is a wall, then no robot may stand in rect.
+    void fillRect(const QRect& rect, Field f);
+    // Set the fields of the patches, in order.
+    // -Every point must be an inner point.
+    // -No robot may stand on a point that is set to a wall.
+    void applyPatches(const QVector<FieldPatch>& patches);
+    // Copy the fields of rect of other (which may be this world) to the rect of the same size at target. Robots are not copied.
+    // -rect must lie within other, including its boundary of walls.
+    // -The target rect must lie within the inner points.
+    // -No robot may stand on a field that becomes a wall.
+    void copyRegion(const WorldObject& other, const QRect& rect, QPoint target);
+
+    // Set Charles's coordinate to p, facing dir.
+    // -p must be an inner point.
+    // -No other robot may stand on p.
+    void setCharles(QPoint p, Direction dir);
+    // Returns Charles' current position.
+    QPoint getCharlesPos() const;
+    // Returns the field Charles is standing on.
+    Field getCharlesField() const;
+    // Returns the direction that Charles' is facing.
+    Direction getCharlesDir() const;
+
+    // Returns all robots, ordered as in the file.
+    const QVector<Robot> &robots() const;
+    // Returns the number of robots.
+    int robotCount() const;
+    // Returns the index in robots() of the robot standing on p, or -1 if there is none.
+    int robotAt(QPoint p) const;
+    // Returns the index in robots() of the robot with this id, or -1 if there is none.
+    int robotIndex(int id) const;
+    // Select the robot that the single robot functions act on.
+    // -A robot with this id must exist.
+    void selectRobot(int id);
+    // Returns the id of the selected robot.
+    int selectedRobot() const;
+
+    // Returns the size of the field. Including the boundary of walls.
+    QSize size() const;
+    // Returns index for a 1D array: y * width + x.
+    qint64 pointToIndex(QPoint p) const;
+    // Returns the number of fields, including the boundary of walls.
+    qint64 fieldCount() const;
+    // Copy the fields of row y to out, which holds size().width() fields.
+    void readRow(int y, quint8 *out) const;
+    // Returns the kind of storage that is used for the fields.
+    StorageKind storageKind() const;
+    // Returns the (approximate) number of bytes used for the fields.
+    qint64 memoryUsage() const;
+    // Returns true iff p is an innerpoint on the World (so not on the boundary of walls).
+    bool isInnerPoint(QPoint p) const;
+
+    /*
+     * "Game" functionality.
+     */
+
+    // Returns true iff Charles is facing a wall.
+    bool inFrontOfWall() const;
+    // Returns true iff Charles is on a ball.
+    bool onBall() const;
+    // Turns Charles left.
+    void turnLeft();
+    // Turns Charles right.
+    void turnRight();
+    // Step Charles if not in front of a wall.
+    void step();
+    // Step Charles backwards if not standing at a wall.
+    void stepBack();
+    // Put a ball on Charles' point.
+    // - There must not be a ball on Charles' point before calling this function.
+    void putBall();
+    // Remove the ball on Charles' point.
+    // - There must be a ball on Charles' point before calling this function.
+    void getBall();
+
+    // Exception free variants of the actions above. The world is left untouched
+    // when something other than ActionOk is returned.
+    ActionResult tryTurnLeft();
+    ActionResult tryTurnRight();
+    ActionResult tryStep();
+    ActionResult tryStepBack();
+    ActionResult tryPutBall();
+    ActionResult tryGetBall();
+
+    // Returns the message that belongs to an action result (same as the exception messages).
+    static const char *actionResultMessage(ActionResult r);
+
+    // Execute one action per robot at the same time, actions[i] belongs to robots()[i].
+    // Robots only block each other when stepping: a robot may enter a field that is free or left in the same tick.
+    // If several robots step onto the same field, the robot with the lowest id moves and the others get StepIntoRobot.
+    // Two robots that would swap fields both get StepIntoRobot. Failed actions have no effect.
+    QVector<ActionResult> tick(const QVector<RobotAction> &actions);
+    // Undo a tick, given the actions and the results that tick() returned.
+    void reverseTick(const QVector<RobotAction> &actions, const QVector<ActionResult> &results);
+
+
+
+    //bool isSolved(); Charles op 1,1 facing east met 0 ballen over.
+
+
+signals:
+    // Signal that the entire world changed.
+    void newWorldLoaded();
+    // Signal that emits are turned on.
+    void emitsTurnedOn();
+    // Signal that Charles' position and/or direction changed.
+    void charlesPositionChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection);
+    // Signal that a single field on point p changed.
+    void fieldChanged(QPoint p);
+    // Signal that fields in region changed at once (see fillRect()).
+    void regionChanged(QRect region);
+
+private:
+    static bool validQChar(QChar c);
+    static Field QCharToField(QChar c);
+    static bool isCharles(QChar c);
+    static Direction charlesQCharToDir(QChar c);
+    static QChar charlesToQChar(Direction d, Field f);
+    static QChar fieldToQChar(Field f);
+
+    static void throwFileException(QSize error, const QString& fileName);
+    static void throwActionException(ActionResult r);
+
+    // Validates the robot id lines after the grid, robots are the positions of the Charles' in the grid (0 based).
+    // Returns the ids of the robots in the same order, or an empty vector if the lines are invalid.
+    static QVector<int> parseRobotIds(const QStringList &lines, const QVector<QPoint> &robots);
+    // Apply the (already checked) results of a tick, or undo them.
+    void applyTick(const QVector<RobotAction> &actions, const QVector<ActionResult> &results, bool reverse);
+    // Replace all robots, rebuilds the lookup tables.
+    void setRobots(const QVector<Robot> &robots);
+    // Returns the selected robot.
+    Robot &charles();
+    const Robot &charles() const;
+
+    // Direct constant access to field.
+    Field at(QPoint p) const;
+    // Write row y to out (size().width() - 2 chars), robotsInRow are the indices of the robots standing in row y.
+    void encodeRow(int y, char *out, const QVector<int> &robotsInRow) const;
+    // Mark row y as changed, see takeDirtyRows().
+    void markDirty(int y);
+    // Mark the rows of region as changed and emit it.
+    void regionWritten(const QRect& region);
+    // Returns the rect of the inner points.
+    QRect innerRect() const;
+    // Forget all changes.
+    void clearDirtyRows();
+    // Count a robot stepping onto p / a change of p.
+    void countVisit(QPoint p);
+    void countMutation(QPoint p);
+
+    std::unique_ptr<FieldStorage> m_fields;
+    // Size of the world. Includes the surrounding ring of walls.
+    QSize m_size;
+    QVector<Robot> m_robots;
+    // Index in m_robots of the selected robot.
+    int m_selected = 0;
+    // Lookup tables: field index -> robot index and robot id -> robot index.
+    QHash<qint64, int> m_robotAt;
+    QHash<int, int> m_robotIndex;
+    bool m_emitUpdates = true;
+    // Per row: 1 if the row changed.
+    QVector<quint8> m_dirtyRows;
+    bool m_recordStats = false;
+    QHash<qint64, CellStats> m_cellStats;
+    VisitStats m_visitStats;
+};
+
+#endif // WORLDOBJECT_H
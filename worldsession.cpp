@@ -0,0 +1,78 @@
+#include "worldsession.h"
+
+#include <QHBoxLayout>
+#include <QFileInfo>
+
+WorldSession::WorldSession(QObject *parent)
+    : QObject{parent},
+    m_world(new WorldObject(this)),
+    m_autosaver(new WorldAutosaver(m_world, this)),
+    m_page(new QWidget)
+{
+    new QHBoxLayout(m_page);
+    // The trace of a world that is loaded in the background (see MainWindow::loadWorld) is cleared, like the view does.
+    connect(m_world, &WorldObject::newWorldLoaded, this, [this]() {
+        if (!m_debugWidget)
+            m_parked.reset();
+    });
+}
+
+WorldObject *WorldSession::world() {
+    return m_world;
+}
+
+WorldAutosaver *WorldSession::autosaver() {
+    return m_autosaver;
+}
+
+QWidget *WorldSession::page() {
+    return m_page;
+}
+
+void WorldSession::showView() {
+    if (m_worldWidget)
+        return;
+    QHBoxLayout *layout = static_cast<QHBoxLayout*>(m_page->layout());
+    layout->addWidget(m_worldWidget = new WorldWidget(m_world, m_page));
+    layout->setAlignment(m_worldWidget, Qt::AlignTop);
+    layout->addWidget(m_debugWidget = new DebugTraceWidget(m_page, m_world, std::move(m_parked)));
+}
+
+void WorldSession::hideView() {
+    if (!m_worldWidget)
+        return;
+    m_parked = m_debugWidget->park();
+    delete m_debugWidget;
+    delete m_worldWidget;
+    m_debugWidget = nullptr;
+    m_worldWidget = nullptr;
+}
+
+WorldWidget *WorldSession::worldWidget() {
+    return m_worldWidget;
+}
+
+DebugTraceWidget *WorldSession::debugWidget() {
+    return m_debugWidget;
+}
+
+QVector<TraceEvent> WorldSession::traceEvents(WorldSnapshot *start) {
+    if (m_debugWidget) {
+        *start = m_debugWidget->startSnapshot();
+        return m_debugWidget->events();
+    }
+    if (!m_parked) {
+        *start = m_world->snapshot();
+        return {};
+    }
+    // A parked trace is read through a widget of its own, without building the world view.
+    DebugTraceWidget trace(nullptr, m_world, std::move(m_parked));
+    *start = trace.startSnapshot();
+    const QVector<TraceEvent> events = trace.events();
+    m_parked = trace.park();
+    return events;
+}
+
+QString WorldSession::title() const {
+    return worldFile.isEmpty() ? "Untitled" : QFileInfo(worldFile).fileName();
+}
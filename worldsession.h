@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QObject>
+#include <QWidget>
+#include <memory>
+
+#include "worldobject.h"
+#include "worldwidget.h"
+#include "debugtracewidget.h"
+#include "worldautosaver.h"
+
+/*
+ * A world with its debug trace: a tab of the main window. Several sessions can be open, e.g. to run the same
+ * program on different worlds.
+ *
+ * Only the session of the current tab has a view: a WorldWidget (with a label per field) and a DebugTraceWidget.
+ * When the tab is left its view is deleted and the trace items are parked (see DebugTraceWidget::park), so a
+ * session in the background only costs its fields and trace items. The view is built again when the tab is shown.
+ */
+
+// A program run with the trace it produced. Trace events before firstEvent were there before the run.
+// Programs are looked up by name again, a plugin may be reloaded in the mean time.
+struct AgentRun {
+    QString name;
+    QVector<TraceEvent> events;
+    int firstEvent = 0;
+};
+
+class WorldSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WorldSession(QObject *parent = nullptr);
+
+    WorldObject *world();
+    WorldAutosaver *autosaver();
+    // The page of the tab, the view is built in it. Owned by the tab widget.
+    QWidget *page();
+
+    // Build the view in the page: the world as it is and the trace where it was parked.
+    void showView();
+    // Delete the view, the trace is parked.
+    void hideView();
+    // Both are nullptr without a view.
+    WorldWidget *worldWidget();
+    DebugTraceWidget *debugWidget();
+
+    // Returns the events of the trace and sets start to the world before them, with or without a view.
+    QVector<TraceEvent> traceEvents(WorldSnapshot *start);
+
+    // Title of the tab: the file name of the world.
+    QString title() const;
+
+    // Last opened or saved world file.
+    QString worldFile;
+    bool saved = true;
+    // The last program run in this session.
+    AgentRun lastRun;
+    // The world this one is compared with (see worlddiff.h), nullptr for none. Owned by the session.
+    WorldObject *goalWorld = nullptr;
+
+private:
+    WorldObject *m_world;
+    WorldAutosaver *m_autosaver;
+    QWidget *m_page;
+    WorldWidget *m_worldWidget = nullptr;
+    DebugTraceWidget *m_debugWidget = nullptr;
+    // The trace while there is no view, nullptr for an empty trace.
+    std::unique_ptr<DebugTraceWidget::Parked> m_parked;
+};
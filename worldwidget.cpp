@@ -1,124 +1,380 @@
-#include "worldwidget.h"
-
-#include <QGridLayout>
-#include <QLabel>
-#include <QPixmap>
-#include <QSizePolicy>
-#include <QCoreApplication>
-#include <QTimer>
-
-const int field_size = 20;
-
-WorldWidget::WorldWidget(QWidget *parent)
-    : QWidget{parent},
-    WALL_PM{QPixmap(":/images/wall.jpg").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    BALL_PM{QPixmap(":/images/ball.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    EMPTY_PM{QPixmap(":/images/emptyField.PNG").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_NORTH_PM{QPixmap(":/images/CharlesNorth.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_EAST_PM{QPixmap(":/images/CharlesEast.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_SOUTH_PM{QPixmap(":/images/CharlesSouth.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_WEST_PM{QPixmap(":/images/CharlesWest.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_NORTH_BALL_PM{QPixmap(":/images/CharlesNorthBall.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_EAST_BALL_PM{QPixmap(":/images/CharlesEastBall.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_SOUTH_BALL_PM{QPixmap(":/images/CharlesSouthBall.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)},
-    CHARLES_WEST_BALL_PM{QPixmap(":/images/CharlesWestBall.png").scaled(field_size, field_size, Qt::IgnoreAspectRatio)}
-
-{
-    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
-    m_grid->setSpacing(0);
-
-    connect(m_world, &WorldObject::emitsTurnedOn, this, &WorldWidget::loadUIFromWorld);
-    connect(m_world, &WorldObject::charlesPositionChanged, this, &WorldWidget::onCharlesChanged);
-    connect(m_world, &WorldObject::newWorldLoaded, this, &WorldWidget::loadUIFromWorld);
-    connect(m_world, &WorldObject::fieldChanged, this, &WorldWidget::onFieldChanged);
-
-    loadUIFromWorld();
-}
-
-WorldObject *WorldWidget::world() {
-    return m_world;
-}
-
-const WorldObject *WorldWidget::world() const {
-    return m_world;
-}
-
-void WorldWidget::setUpdatingUI(bool on) {
-    m_world->setEmitUpdates(on);
-}
-
-void WorldWidget::onCharlesChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection) {
-    if (oldPosition != newPosition) {
-        // Clean up old label that is now just a field.
-        QLayoutItem *oldCharles = m_grid->itemAt(m_world->pointToIndex(oldPosition));
-        QLabel * oldLabel = dynamic_cast<QLabel *>(oldCharles->widget());
-        assert(oldLabel && "WorldWidget::onPosChanged: Old Label is unexpectedly null");
-        oldLabel->setPixmap(pixmapFromField(m_world->get(oldPosition)));
-    }
-    QLayoutItem *newCharles = m_grid->itemAt(m_world->pointToIndex(newPosition));
-    QLabel *newLabel = dynamic_cast<QLabel*>(newCharles->widget());
-    assert(newLabel && "WorldWidget::onCharlesChanged: New Label is unexpectedly null.");
-    newLabel->setPixmap(pixmapFromDirection(newDirection, m_world->get(newPosition)));
-}
-
-void WorldWidget::onFieldChanged(QPoint p) {
-    QPixmap pixmap = m_world->getCharlesPos() == p ?
-                        pixmapFromDirection(m_world->getCharlesDir(), m_world->get(p)) :
-                        pixmapFromField(m_world->get(p));
-
-    QLayoutItem *item = m_grid->itemAt(m_world->pointToIndex(m_world->getCharlesPos()));
-    QLabel * label = dynamic_cast<QLabel *>(item->widget());
-    assert(label && "WorldWidget::onFieldChanged: Label cannot be null pointer.");
-    label->setPixmap((pixmap));
-}
-
-const QPixmap &WorldWidget::pixmapFromField(Field f) const {
-    switch(f) {
-    case Field::Empty:
-        return EMPTY_PM;
-    case Field::Ball:
-        return BALL_PM;
-    case Field::Wall:
-        return WALL_PM;
-    }
-    return EMPTY_PM; // False Positive compiler warning.
-}
-
-const QPixmap &WorldWidget::pixmapFromDirection(Direction d, Field f) const
-{
-    switch(d) {
-    case Direction::North:
-        return f == Field::Ball ? CHARLES_NORTH_BALL_PM : CHARLES_NORTH_PM;
-    case Direction::East:
-        return f == Field::Ball ? CHARLES_EAST_BALL_PM : CHARLES_EAST_PM;
-    case Direction::South:
-        return f == Field::Ball ? CHARLES_SOUTH_BALL_PM : CHARLES_SOUTH_PM;
-    case Direction::West:
-        return f == Field::Ball ? CHARLES_WEST_BALL_PM : CHARLES_WEST_PM;
-    }
-    return CHARLES_NORTH_PM; // False Positive compiler warning.
-}
-
-void WorldWidget::loadUIFromWorld() {
-    clearUI();
-    for (int y = 0; y < m_world->size().height(); ++y) {
-        for (int x = 0; x < m_world->size().width(); ++x) {
-            QLabel *l = new QLabel(this);
-
-            if (m_world->getCharlesPos() == QPoint(x, y))
-                l->setPixmap(pixmapFromDirection(m_world->getCharlesDir(), m_world->get(QPoint(x, y))));
-            else
-                l->setPixmap(pixmapFromField(m_world->get(QPoint(x, y))));
-            m_grid->addWidget(l, y, x);
-        }
-    }
-}
-
-void WorldWidget::clearUI() {
-    //https://doc.qt.io/qt-6/qlayout.html#takeAt
-    QLayoutItem *child;
-    while ((child = m_grid->takeAt(0)) != nullptr) {
-        delete child->widget();
-        delete child;
-    }
-}
+#include "worldwidget.h"
+#include "sprites.h"
+#include "worlddiff.h"
+#include "renderstats.h"
+
+#include <QGridLayout>
+#include <QLabel>
+#include <QPixmap>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QSizePolicy>
+#include <QCoreApplication>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <utility>
+
+// Worlds with more fields than this are not displayed, one label per field would not fit in memory.
+const qint64 max_displayed_fields = 200 * 200;
+
+/*
+ * The heatmap: fields are tinted red by how often a robot stepped onto them, the most visited field the strongest.
+ * Fields that were visited more than once show the count. It lets mouse events through to the labels below.
+ */
+class HeatmapOverlay : public QWidget
+{
+public:
+    HeatmapOverlay(const WorldObject *world, const QGridLayout *grid, QWidget *parent)
+        : QWidget{parent},
+        m_world(world),
+        m_grid(grid)
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setAttribute(Qt::WA_NoSystemBackground);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *event) override {
+        const QHash<qint64, CellStats> &stats = m_world->cellStats();
+        if (m_world->fieldCount() > max_displayed_fields || stats.isEmpty())
+            return;
+        quint32 maxVisits = 1;
+        for (const CellStats &c : stats)
+            maxVisits = qMax(maxVisits, c.visits);
+
+        QPainter painter(this);
+        QFont font = painter.font();
+        font.setPixelSize(9);
+        painter.setFont(font);
+        for (auto it = stats.constBegin(); it != stats.constEnd(); ++it) {
+            if (it->visits == 0)
+                continue;
+            const QLayoutItem *item = m_grid->itemAt(static_cast<int>(it.key()));
+            if (!item || !event->rect().intersects(item->geometry()))
+                continue;
+            const QRect r = item->geometry();
+            painter.fillRect(r, QColor(255, 0, 0, 40 + 150 * it->visits / maxVisits));
+            if (it->visits > 1) {
+                painter.setPen(Qt::white);
+                painter.drawText(r, Qt::AlignCenter, QString::number(it->visits));
+            }
+        }
+    }
+
+private:
+    const WorldObject *m_world;
+    const QGridLayout *m_grid;
+};
+
+/*
+ * The goal differences: fields that differ from the goal world get an orange frame, a robot that is not where
+ * the goal has it gets a circle on the goal position. The differences are compared again on every paint, which
+ * takes microseconds for the worlds that are displayed.
+ */
+class DiffOverlay : public QWidget
+{
+public:
+    DiffOverlay(const WorldObject *world, const QGridLayout *grid, QWidget *parent)
+        : QWidget{parent},
+        m_world(world),
+        m_grid(grid)
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setAttribute(Qt::WA_NoSystemBackground);
+    }
+
+    void setGoal(const WorldObject *goal) {
+        m_goal = goal;
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent *event) override {
+        if (!m_goal || m_world->fieldCount() > max_displayed_fields)
+            return;
+        const WorldDiff diff = diffWorlds(*m_world, *m_goal);
+        QPainter painter(this);
+        painter.setBrush(Qt::NoBrush);
+        painter.setPen(QPen(QColor(255, 140, 0), 2));
+        for (QPoint p : diff.cells) {
+            const QRect r = fieldRect(p);
+            if (r.isValid() && event->rect().intersects(r))
+                painter.drawRect(r.adjusted(1, 1, -1, -1));
+        }
+        painter.setPen(QPen(QColor(255, 140, 0), 2, Qt::DashLine));
+        for (const RobotMismatch &m : diff.robots) {
+            const QRect r = fieldRect(m.expectedPos);
+            if (r.isValid() && event->rect().intersects(r))
+                painter.drawEllipse(r.adjusted(3, 3, -3, -3));
+        }
+    }
+
+private:
+    // Returns the geometry of the label of p, an invalid rect if there is none.
+    QRect fieldRect(QPoint p) const {
+        if (!QRect(QPoint(0, 0), m_world->size()).contains(p))
+            return QRect();
+        const QLayoutItem *item = m_grid->itemAt(static_cast<int>(m_world->pointToIndex(p)));
+        return item ? item->geometry() : QRect();
+    }
+
+    const WorldObject *m_world;
+    const QGridLayout *m_grid;
+    const WorldObject *m_goal = nullptr;
+};
+
+/*
+ * The heads-up display of the render statistics: a line per measure with its percentiles. It is repainted
+ * twice a second rather than on every frame, which would make every frame cause another one. The timer only runs
+ * while it is shown, and the frames it causes are not measured (see takeRefresh()).
+ */
+class StatsOverlay : public QWidget
+{
+public:
+    StatsOverlay(QWidget *parent)
+        : QWidget{parent},
+        m_timer(new QTimer(this))
+    {
+        setAttribute(Qt::WA_TransparentForMouseEvents);
+        setAttribute(Qt::WA_NoSystemBackground);
+        m_timer->setInterval(500);
+        connect(m_timer, &QTimer::timeout, this, [this]() {
+            m_refresh = true;
+            update();
+        });
+    }
+
+    // Returns true iff the overlay asked for a frame since the last call.
+    bool takeRefresh() {
+        return std::exchange(m_refresh, false);
+    }
+
+protected:
+    void showEvent(QShowEvent *event) override {
+        QWidget::showEvent(event);
+        m_timer->start();
+    }
+
+    void hideEvent(QHideEvent *event) override {
+        QWidget::hideEvent(event);
+        m_timer->stop();
+        m_refresh = false;
+    }
+
+    void paintEvent(QPaintEvent *event) override {
+        Q_UNUSED(event);
+        const QStringList lines = RenderStats::instance().report();
+        QPainter painter(this);
+        QFont font = painter.font();
+        font.setPixelSize(10);
+        painter.setFont(font);
+        const QFontMetrics metrics(font);
+        int width = 0;
+        for (const QString &line : lines)
+            width = qMax(width, metrics.horizontalAdvance(line));
+        const QRect box(0, 0, width + 8, metrics.height() * lines.size() + 8);
+        painter.fillRect(box, QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(box.adjusted(4, 4, -4, -4), Qt::AlignLeft | Qt::AlignTop, lines.join('\n'));
+    }
+
+private:
+    QTimer *m_timer;
+    bool m_refresh = false;
+};
+
+WorldWidget::WorldWidget(WorldObject *world, QWidget *parent)
+    : QWidget{parent},
+    m_world(world)
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    m_grid->setSpacing(0);
+    m_heatmap = new HeatmapOverlay(m_world, m_grid, this);
+    m_heatmap->hide();
+    m_diff = new DiffOverlay(m_world, m_grid, this);
+    m_diff->hide();
+    m_stats = new StatsOverlay(this);
+    m_stats->hide();
+
+    connect(m_world, &WorldObject::emitsTurnedOn, this, &WorldWidget::loadUIFromWorld);
+    connect(m_world, &WorldObject::charlesPositionChanged, this, &WorldWidget::onCharlesChanged);
+    connect(m_world, &WorldObject::newWorldLoaded, this, &WorldWidget::loadUIFromWorld);
+    connect(m_world, &WorldObject::fieldChanged, this, &WorldWidget::onFieldChanged);
+    connect(m_world, &WorldObject::regionChanged, this, &WorldWidget::onRegionChanged);
+
+    loadUIFromWorld();
+}
+
+WorldObject *WorldWidget::world() {
+    return m_world;
+}
+
+const WorldObject *WorldWidget::world() const {
+    return m_world;
+}
+
+void WorldWidget::setUpdatingUI(bool on) {
+    m_world->setEmitUpdates(on);
+}
+
+void WorldWidget::setHeatmapVisible(bool on) {
+    m_heatmap->setVisible(on);
+    m_heatmap->raise();
+    m_diff->raise();
+    m_stats->raise();
+}
+
+void WorldWidget::setGoalWorld(const WorldObject *goal) {
+    static_cast<DiffOverlay*>(m_diff)->setGoal(goal);
+    m_diff->setVisible(goal != nullptr);
+    m_diff->raise();
+    m_stats->raise();
+}
+
+void WorldWidget::setRenderStatsVisible(bool on) {
+    m_stats->setVisible(on);
+    m_stats->raise();
+}
+
+int WorldWidget::takeRepaintedCells() {
+    return std::exchange(m_repaintedCells, 0);
+}
+
+bool WorldWidget::takeStatsRefresh() {
+    return static_cast<StatsOverlay*>(m_stats)->takeRefresh();
+}
+
+void WorldWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    m_heatmap->setGeometry(rect());
+    m_diff->setGeometry(rect());
+    m_stats->setGeometry(rect());
+}
+
+void WorldWidget::mousePressEvent(QMouseEvent *event) {
+    // The labels do not take clicks, they come here. The label is found by its place in the grid.
+    QWidget *label = childAt(event->position().toPoint());
+    const int index = label && isDisplayed() ? m_grid->indexOf(label) : -1;
+    if (index == -1) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    const int width = m_world->size().width();
+    emit fieldClicked(QPoint(index % width, index / width));
+}
+
+void WorldWidget::onCharlesChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection) {
+    Q_UNUSED(newDirection);
+    if (!isDisplayed())
+        return;
+    // The old field may be taken by another robot in the same tick, so always look at the world.
+    if (oldPosition != newPosition)
+        updateLabel(oldPosition);
+    updateLabel(newPosition);
+    // The counters of other fields change relative to the most visited one, so redraw it all.
+    if (m_heatmap->isVisible())
+        m_heatmap->update();
+    updateDiff();
+}
+
+void WorldWidget::onFieldChanged(QPoint p) {
+    if (!isDisplayed())
+        return;
+    updateLabel(p);
+    updateDiff();
+}
+
+void WorldWidget::onRegionChanged(QRect region) {
+    if (!isDisplayed())
+        return;
+    // Each setPixmap would schedule its own repaint, with updates off the labels are painted together afterwards.
+    setUpdatesEnabled(false);
+    for (int y = region.top(); y <= region.bottom(); ++y) {
+        for (int x = region.left(); x <= region.right(); ++x)
+            updateLabel(QPoint(x, y));
+    }
+    setUpdatesEnabled(true);
+    updateDiff();
+}
+
+const QPixmap &WorldWidget::pixmapFromField(Field f) const {
+    return SpritePixmaps::instance().field(f);
+}
+
+const QPixmap &WorldWidget::pixmapFromDirection(Direction d, Field f) const
+{
+    return SpritePixmaps::instance().robot(d, f);
+}
+
+const QPixmap &WorldWidget::pixmapAt(QPoint p) const {
+    int robot = m_world->robotAt(p);
+    if (robot != -1)
+        return pixmapFromDirection(m_world->robots()[robot].dir, m_world->get(p));
+    return pixmapFromField(m_world->get(p));
+}
+
+void WorldWidget::updateLabel(QPoint p) {
+    QLayoutItem *item = m_grid->itemAt(m_world->pointToIndex(p));
+    QLabel *label = dynamic_cast<QLabel *>(item->widget());
+    assert(label && "WorldWidget::updateLabel: Label cannot be null pointer.");
+    label->setPixmap(pixmapAt(p));
+    ++m_repaintedCells;
+    // Robots are told apart by their id in the tooltip.
+    int robot = m_world->robotAt(p);
+    if (m_world->robotCount() > 1)
+        label->setToolTip(robot == -1 ? QString() : QString("Robot %1").arg(m_world->robots()[robot].id));
+}
+
+void WorldWidget::loadUIFromWorld() {
+    // Includes clearUI(), which is also measured on its own.
+    QElapsedTimer timer;
+    timer.start();
+    clearUI();
+    if (!isDisplayed()) {
+        m_grid->addWidget(new QLabel(QString("World of %1 x %2 fields is too large to display.")
+                                         .arg(m_world->size().width()).arg(m_world->size().height()), this), 0, 0);
+        RenderStats::instance().record(RenderMeasure::LoadUITime, timer.nsecsElapsed() / 1000);
+        return;
+    }
+    for (int y = 0; y < m_world->size().height(); ++y) {
+        for (int x = 0; x < m_world->size().width(); ++x) {
+            QLabel *l = new QLabel(this);
+            l->setPixmap(pixmapAt(QPoint(x, y)));
+            m_grid->addWidget(l, y, x);
+        }
+    }
+    m_repaintedCells += static_cast<int>(m_world->fieldCount());
+    if (m_world->robotCount() > 1) {
+        for (const Robot &r : m_world->robots())
+            updateLabel(r.pos);
+    }
+    // New labels are stacked on top, the heatmap and the goal differences go back over them.
+    m_heatmap->raise();
+    m_heatmap->update();
+    m_diff->raise();
+    m_stats->raise();
+    updateDiff();
+    RenderStats::instance().record(RenderMeasure::LoadUITime, timer.nsecsElapsed() / 1000);
+}
+
+void WorldWidget::clearUI() {
+    QElapsedTimer timer;
+    timer.start();
+    //https://doc.qt.io/qt-6/qlayout.html#takeAt
+    QLayoutItem *child;
+    while ((child = m_grid->takeAt(0)) != nullptr) {
+        delete child->widget();
+        delete child;
+    }
+    RenderStats::instance().record(RenderMeasure::ClearUITime, timer.nsecsElapsed() / 1000);
+}
+
+bool WorldWidget::isDisplayed() const {
+    return m_world->fieldCount() <= max_displayed_fields;
+}
+
+void WorldWidget::updateDiff() {
+    if (m_diff->isVisible())
+        m_diff->update();
+}
@@ -1,45 +1,79 @@
-#ifndef WORLDWIDGET_H
-#define WORLDWIDGET_H
-
-#include <QWidget>
-#include <QGridLayout>
-#include "worldobject.h"
-
-class WorldWidget : public QWidget
-{
-    Q_OBJECT
-public:
-    explicit WorldWidget(QWidget *parent = nullptr);
-
-    WorldObject *world();
-    const WorldObject *world() const;
-
-    // Dis/enable updating the UI (because executing student programs that change a lot gets slow).
-    void setUpdatingUI(bool on);
-
-public slots:
-    // Update UI for a change in Charles' position and/or direction.
-    void onCharlesChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection);
-    // Update UI for a single field change.
-    void onFieldChanged(QPoint p);
-    // Load grid UI from a new WorldObject.
-    void loadUIFromWorld();
-
-private:
-    // Would like the QPixmap to be global/static constants. But this gave me some struggle (because QApplication must be started before).
-    const QPixmap WALL_PM, BALL_PM, EMPTY_PM,
-        CHARLES_NORTH_PM, CHARLES_EAST_PM, CHARLES_SOUTH_PM, CHARLES_WEST_PM,
-        CHARLES_NORTH_BALL_PM, CHARLES_EAST_BALL_PM, CHARLES_SOUTH_BALL_PM, CHARLES_WEST_BALL_PM;
-    // Return pixmap representing a field.
-    const QPixmap &pixmapFromField(Field f) const;
-    // Return Charles pixmap facing the corresponding direction.
-    const QPixmap &pixmapFromDirection(Direction d, Field f) const;
-
-    // Clear the UI. In the end m_grid will be empty.
-    void clearUI();
-
-    WorldObject *m_world = new WorldObject(this);
-    QGridLayout *m_grid = new QGridLayout(this);
-};
-
-#endif // WORLDWIDGET_H
+#ifndef WORLDWIDGET_H
+#define WORLDWIDGET_H
+
+#include <QWidget>
+#include <QGridLayout>
+#include "worldobject.h"
+
+class WorldWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    // Shows world, which is owned by the caller (see WorldSession).
+    explicit WorldWidget(WorldObject *world, QWidget *parent = nullptr);
+
+    WorldObject *world();
+    const WorldObject *world() const;
+
+    // Dis/enable updating the UI (because executing student programs that change a lot gets slow).
+    void setUpdatingUI(bool on);
+    // Returns the number of fields that got a new pixmap since the last call, for the render statistics.
+    int takeRepaintedCells();
+    // Returns true iff the render statistics overlay asked for a frame since the last call, to refresh itself.
+    bool takeStatsRefresh();
+
+public slots:
+    // Show/hide the visit counters of the world (see WorldObject::cellStats()) over the fields.
+    void setHeatmapVisible(bool on);
+    // Mark the fields and robots that differ from goal (see worlddiff.h), nullptr for none. goal is owned by the caller.
+    void setGoalWorld(const WorldObject *goal);
+    // Show/hide the render statistics (see renderstats.h) over the top left corner.
+    void setRenderStatsVisible(bool on);
+
+signals:
+    // Field p was clicked.
+    void fieldClicked(QPoint p);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+
+public slots:
+    // Update UI for a change in Charles' position and/or direction.
+    void onCharlesChanged(QPoint oldPosition, QPoint newPosition, Direction newDirection);
+    // Update UI for a single field change.
+    void onFieldChanged(QPoint p);
+    // Update UI for a change of the fields in region, repainted once.
+    void onRegionChanged(QRect region);
+    // Load grid UI from a new WorldObject.
+    void loadUIFromWorld();
+
+private:
+    // Return pixmap representing a field.
+    const QPixmap &pixmapFromField(Field f) const;
+    // Return Charles pixmap facing the corresponding direction.
+    const QPixmap &pixmapFromDirection(Direction d, Field f) const;
+    // Return the pixmap for point p: a robot if one stands on p, the field otherwise.
+    const QPixmap &pixmapAt(QPoint p) const;
+    // Update the label of point p to the world.
+    void updateLabel(QPoint p);
+
+    // Clear the UI. In the end m_grid will be empty.
+    void clearUI();
+    // Returns true iff the world has a label for every field (huge worlds are not displayed).
+    bool isDisplayed() const;
+    // Repaint the goal differences, after the world changed.
+    void updateDiff();
+
+    WorldObject *m_world;
+    QGridLayout *m_grid = new QGridLayout(this);
+    // Drawn on top of the labels, hidden unless the heatmap is on.
+    QWidget *m_heatmap;
+    // Drawn on top of the labels (and the heatmap), hidden without a goal world.
+    QWidget *m_diff;
+    // Drawn on top of everything, hidden unless the render statistics are on.
+    QWidget *m_stats;
+    int m_repaintedCells = 0;
+};
+
+#endif // WORLDWIDGET_H